@@ -65,7 +65,7 @@ namespace ObjectPool
       public:
 
          static void* operator new(std::size_t size);
-         static void  operator delete(void* object);
+         static void  operator delete(void* object, std::size_t size);
          static void info(FILE* output=stderr);
 
       private:
@@ -85,9 +85,9 @@ namespace ObjectPool
    } /* operator new */
 
    template <class Base, class AccessPolicy>
-   inline void Allocatable<Base,AccessPolicy> :: operator delete(void* object)
+   inline void Allocatable<Base,AccessPolicy> :: operator delete(void* object, std::size_t size)
    {
-      ourPool.release(object);
+      ourPool.release(object, size);
    } /* operator delete */
 
    template <class Base, class AccessPolicy>
@@ -103,6 +103,8 @@ namespace ObjectPool
    /* This is an alternative allocation - introduce new and delete */
    /* using macro. Good for quick testing without serious class    */
    /* hierarchy changes. Required corresponded _SUPPORT macro.     */
+   /* Size passed to delete tells objects of bigger derived classes */
+   /* (allocated by global new) from objects of the pool.           */
    #define OBJECT_POOL_ALLOCATION()                                  \
          private:                                                    \
             static ObjectPool::Pool<ObjectPool::LockPolicy> ourPool; \
@@ -111,13 +113,14 @@ namespace ObjectPool
             {                                                        \
                return ourPool.allocate(size);                        \
             }                                                        \
-            static inline void operator delete(void* object)         \
+            static inline void operator delete(void* object,         \
+                                               std::size_t size)     \
             {                                                        \
-               ourPool.release(object);                              \
+               ourPool.release(object, size);                        \
             }
 
    #define OBJECT_POOL_ALLOCATION_SUPPORT(klass,chunkSize)     \
-         ObjectPool::Pool<ObjectPool::LockPolicy> klass :: ourPool(sizeof(klass), chunkSize)
+         ObjectPool::Pool<ObjectPool::LockPolicy> klass :: ourPool(sizeof(klass), chunkSize, #klass)
 
    #define OBJECT_POOL_ALLOCATION_SUPPORT_COMPACT(klass)       OBJECT_POOL_ALLOCATION_SUPPORT(klass, OP_MIN_CHUNK_SIZE)
    #define OBJECT_POOL_ALLOCATION_SUPPORT_DEFAULT(klass)       OBJECT_POOL_ALLOCATION_SUPPORT(klass, OP_DEF_CHUNK_SIZE)
@@ -28,6 +28,9 @@
  *
  * 20-Jul-2006 Leonid Moiseichuk
  * - initial version created.
+ *
+ * Slots are now kept in a free list instead of a bitmap, and chunks are
+ * aligned to their size so the owner of an object is found directly.
  * ========================================================================= */
 
 /* ========================================================================= *
@@ -46,7 +49,7 @@ namespace ObjectPool
    void Chunk :: info(FILE* output) const
    {
 #if OP_STATISTICS
-      fprintf(output, "  0x%p: free %u used %u succ 0x%p\n", (void*)this, myFreeCounter, myUsedCounter, (void*)mySuccessor);
+      fprintf(output, "  %p: used %u fresh %u succ %p\n", (void*)this, myUsedCounter, myFreshIndex, (void*)mySuccessor);
 #endif
    } /* info */
 
@@ -56,71 +59,61 @@ namespace ObjectPool
       /* Clean-up whole shared structure */
       memset(&shared, 0, sizeof(Chunk::Shared));
 
-      /* Initialize basic fields */
+      /* Initialize basic fields, free slots have to keep a link */
+      if (objectSizeOf < sizeof(void*))
+         objectSizeOf = sizeof(void*);
       shared.objectSizeOf = OP_ALIGN(objectSizeOf, OP_MEMORY_ALIGNMENT);
-      shared.bitmapOffset = OP_ALIGN(sizeof(Chunk), OP_MEMORY_ALIGNMENT);
+      shared.memoryOffset = OP_ALIGN(sizeof(Chunk), OP_MEMORY_ALIGNMENT);
 
-      /* Check requested chunk size */
-      if (chunkSize < OP_MIN_CHUNK_SIZE)
-         chunkSize = OP_MIN_CHUNK_SIZE;
+      /* Chunk size shall be a power of two not less than requested */
+      shared.chunkSize = OP_MIN_CHUNK_SIZE;
+      while (shared.chunkSize < chunkSize)
+         shared.chunkSize <<= 1;
 
-      /* Calculate initial size of bitmap (and number of objects in chunk) */
-      shared.bitmapCounter = (chunkSize / (shared.objectSizeOf << 1)) / BITMAP_CAPACITY;
+      /* Big objects are allowed but every chunk should keep a few of them */
+      while (shared.chunkSize - shared.memoryOffset < OP_MIN_CHUNK_OBJECTS * shared.objectSizeOf)
+         shared.chunkSize <<= 1;
 
-      /* Calculate parameters of chunk for specified counter of objects */
-      do
-      {
-         shared.bitmapCounter++;
-         shared.objectCounter = shared.bitmapCounter * BITMAP_CAPACITY;
-         shared.memoryOffset  = shared.bitmapOffset + OP_ALIGN(shared.bitmapCounter * sizeof(BITMAP), OP_MEMORY_ALIGNMENT);
-         shared.memoryCounter = shared.objectCounter * shared.objectSizeOf;
-         shared.chunkSize     = shared.memoryOffset  + shared.memoryCounter;
-      } while (shared.chunkSize < chunkSize);
+      shared.objectCounter = (shared.chunkSize - shared.memoryOffset) / shared.objectSizeOf;
    } /* setup */
 
 
-   #define TEST_FREE(t,m)  ((t) != ((t) & (m)))
-
-   bool Chunk :: occupyFreeSlot(const Chunk::Shared& shared, unsigned& o_index)
+   Chunk* Chunk :: create(const Chunk::Shared& shared)
    {
-      /* Looking for free slot in bitmap */
-      BITMAP*  bitmap = THIS_CHUNK_BITMAP(shared);
-      unsigned index;
-      unsigned bitno;
+      void* memory;
+
+      /* Chunk is aligned to its size to make owner() working */
+#ifdef OP_WINDOWS
+      memory = _aligned_malloc(shared.chunkSize, shared.chunkSize);
+#else
+      if ( posix_memalign(&memory, shared.chunkSize, shared.chunkSize) )
+         memory = NULL;
+#endif
 
-      for (index = 0; index < shared.bitmapCounter; index++)
+      if ( memory )
       {
-         const unsigned checked = bitmap[index];
-
-         /* Check for available bits in this word */
-         if (BITMAP_NO_FREE == checked)
-            continue;
-
-         /* Some bits are not used, determine which one      */
-         /* WARNING: this statement is hardcoded for 32 bits */
-         if ( TEST_FREE(0x0000ffff, checked) )
-         {
-            bitno = (TEST_FREE(0x000000ff, checked) ? 0 : 8);
-         }
-         else
-         {
-            bitno = (TEST_FREE(0x00ff0000, checked) ? 16 : 24);
-         }
+         Chunk* chunk = (Chunk*)memory;
 
-         /* Find the free block in bitmap */
-         while (0 != (checked & (1 << bitno)))
-            bitno++;
+         chunk->mySuccessor   = NULL;
+         chunk->myPredecessor = NULL;
+         chunk->myFreeList    = NULL;
+         chunk->myFreshIndex  = 0;
+         chunk->myUsedCounter = 0;
 
-         /* We found that some bit in usage is zero --> occupy it */
-         bitmap[index] |= (1 << bitno);
-         o_index = index * BITMAP_CAPACITY + bitno;
+         return chunk;
+      }
 
-         return true;
+      return NULL;
+   } /* create */
 
-      }
 
-      return false;
-   } /* occupyFreeSlot */
+   void Chunk :: destroy(Chunk* chunk)
+   {
+#ifdef OP_WINDOWS
+      _aligned_free(chunk);
+#else
+      free(chunk);
+#endif
+   } /* destroy */
 
 } /* Namespace ObjectPool */
-
@@ -28,6 +28,9 @@
  *
  * 18-Jul-2006 Leonid Moiseichuk
  * - initial version created.
+ *
+ * Slots are now kept in a free list instead of a bitmap, and chunks are
+ * aligned to their size so the owner of an object is found directly.
  * ========================================================================= */
 
 #ifndef OBJECT_POOL_CHUNK_H_USED
@@ -52,6 +55,8 @@ namespace ObjectPool
 
    /* This piece of memory requested from the OS. All chunks in pool have the same   */
    /* parameters like size and object sizeof, so these values are stored in the pool */
+   /* Chunks are aligned to their size (a power of two), so the chunk that owns an   */
+   /* object is found by masking the object address.                                 */
 
    class Chunk
    {
@@ -65,62 +70,52 @@ namespace ObjectPool
             /* Number of objects that can be allocated in chunk */
             unsigned    objectCounter;
 
-            /* Offset to bitmap that stored usage/free bits */
-            unsigned    bitmapOffset;
-            /* Counter of items in bitmap (now unsigned words)*/
-            unsigned    bitmapCounter;
-
             /* Offset to memory that used to allocate/free */
             unsigned    memoryOffset;
-            /* Counter of bytes that allocated to store data */
-            unsigned    memoryCounter;
 
-            /* Size of whole chunk (header, bitmap and memory)*/
+            /* Size of whole chunk (header and memory), power of two */
             unsigned    chunkSize;
          };
 
       private:
 
-         /* Who is next? */
+         /* Neighbours in the pool list of chunks, chunks with free slots first */
          Chunk*         mySuccessor;
+         Chunk*         myPredecessor;
+
+         /* Released slots, linked through their first word */
+         void*          myFreeList;
+
+         /* Slots from this index up to the end were never allocated */
+         unsigned       myFreshIndex;
 
          /* That is header data which is unique for every chunk */
          unsigned       myUsedCounter;
-         unsigned       myFreeCounter;
-
-         /* Data type for storing bitmap data */
-         typedef unsigned  BITMAP;
-         #define BITMAP_NO_FREE           ((BITMAP)-1)
-         #define BITMAP_CAPACITY          (sizeof(BITMAP) * 8)
 
          /* Head of this chunk in memory */
          #define THIS_CHUNK_HEAD()        ((unsigned char*)this)
 
-         /* Tail of this chunk in memory */
-         #define THIS_CHUNK_TAIL(s)       (THIS_CHUNK_HEAD() + (s).chunkSize)
-
-         /* Allocated bitmap data which aligned to OP_MEMORY_ALIGNMENT */
-         #define THIS_CHUNK_BITMAP(s)    ((BITMAP*)(THIS_CHUNK_HEAD() + (s).bitmapOffset))
-
-         /* The next is memory allocated for storing objects, also aligned  */
+         /* The next is memory allocated for storing objects, aligned */
          #define THIS_CHUNK_MEMORY(s)    (THIS_CHUNK_HEAD() + (s).memoryOffset)
 
       public:
 
-         /* Allocates memory slot and returns pointer or NULL if allocation failed */
-         unsigned char* allocate(const Chunk::Shared& shared);
+         /* Allocates memory slot and returns pointer or NULL if chunk is full */
+         void* allocate(const Chunk::Shared& shared);
 
-         /* Release memory, returns true if operation passed or false otherwise */
-         bool release(const Chunk::Shared& shared, unsigned char* object);
+         /* Release memory slot which belongs to this chunk */
+         void release(void* object);
 
          /* Returns true if memory for allocation is available */
-         bool avail() const;
+         bool avail(const Chunk::Shared& shared) const;
          /* Returns true if all memory is released */
          bool empty() const;
 
-         /* Elements of sigle list control */
+         /* Elements of double list control */
          Chunk*   succ() const;
          void     succ(Chunk* aSuccessor);
+         Chunk*   pred() const;
+         void     pred(Chunk* aPredecessor);
 
          /* Display information about chunk */
          void info(FILE* output) const;
@@ -132,14 +127,18 @@ namespace ObjectPool
          /* Form of constructor to create chunk object with specified parameters */
          static Chunk* create(const Chunk::Shared& shared);
 
+         /* Returns memory of the chunk to the OS */
+         static void destroy(Chunk* chunk);
+
+         /* Returns the chunk which contains the specified object */
+         static Chunk* owner(const Chunk::Shared& shared, void* object);
+
       private:    /* Usage of these methods is prohibited outside */
          Chunk();
          ~Chunk();
          Chunk(const Chunk&);
          void operator=(const Chunk&);
 
-         bool occupyFreeSlot(const Chunk::Shared& shared, unsigned& o_index);
-
    }; /* Class Chunk */
 
 
@@ -149,30 +148,9 @@ namespace ObjectPool
    inline Chunk :: ~Chunk()
    {}
 
-   inline Chunk* Chunk :: create(const Chunk::Shared& shared)
+   inline bool Chunk :: avail(const Chunk::Shared& shared) const
    {
-      /* In this operation malloc is faster than new */
-      Chunk* chunk = (Chunk*)malloc(shared.chunkSize);
-      if ( chunk )
-      {
-         BITMAP* bitmap = (BITMAP*)((unsigned char*)chunk + shared.bitmapOffset);
-         BITMAP* finish = bitmap + shared.bitmapCounter;
-
-         chunk->mySuccessor   = NULL;
-         chunk->myFreeCounter = shared.objectCounter;
-         chunk->myUsedCounter = 0;
-
-         /* Bitmaps are usually short (less 128 words), so use memset are not effective */
-         while (bitmap < finish)
-            *bitmap++ = 0;
-      }
-
-      return chunk;
-   } /* create */
-
-   inline bool Chunk :: avail() const
-   {
-      return (myFreeCounter > 0);
+      return (myFreeList || myFreshIndex < shared.objectCounter);
    }
 
    inline bool Chunk :: empty() const
@@ -190,47 +168,51 @@ namespace ObjectPool
       mySuccessor = aSuccessor;
    }
 
-   inline unsigned char* Chunk :: allocate(const Chunk::Shared& shared)
+   inline Chunk* Chunk :: pred() const
    {
-      if ( myFreeCounter > 0 )
-      {
-         unsigned index;
-
-         if ( occupyFreeSlot(shared, index) )
-         {
-            myFreeCounter--;
-            myUsedCounter++;
+      return myPredecessor;
+   }
 
-            return (THIS_CHUNK_MEMORY(shared) + index * shared.objectSizeOf);
-         }
-      }
+   inline void Chunk :: pred(Chunk* aPredecessor)
+   {
+      myPredecessor = aPredecessor;
+   }
 
-      return NULL;
-   } /* allocate */
+   inline Chunk* Chunk :: owner(const Chunk::Shared& shared, void* object)
+   {
+      return (Chunk*)((unsigned long)object & ~(unsigned long)(shared.chunkSize - 1));
+   }
 
-   inline bool Chunk :: release(const Chunk::Shared& shared, unsigned char* object)
+   inline void* Chunk :: allocate(const Chunk::Shared& shared)
    {
-      unsigned char* memory = THIS_CHUNK_MEMORY(shared);
+      void* object;
 
-      if (memory <= object && object < THIS_CHUNK_TAIL(shared))
+      if ( myFreeList )
       {
-         BITMAP* bitmap = THIS_CHUNK_BITMAP(shared);
-         /* Calculate object index and corresponded index and mask for bitmap */
-         const unsigned o_index = (object - memory) / shared.objectSizeOf;
-         const unsigned b_index = o_index / BITMAP_CAPACITY;
-         const BITMAP   b_mask  = 1 << (o_index % BITMAP_CAPACITY);
-
-         if (bitmap[b_index] & b_mask)
-         {
-            bitmap[b_index] &= ~b_mask;
-            myUsedCounter--;
-            myFreeCounter++;
-         }
-
-         return true;
+         /* Reuse the most recently released slot */
+         object = myFreeList;
+         myFreeList = *(void**)object;
       }
+      else if (myFreshIndex < shared.objectCounter)
+      {
+         /* Slots are handed out in order first, so new chunks need no set up */
+         object = THIS_CHUNK_MEMORY(shared) + myFreshIndex * shared.objectSizeOf;
+         myFreshIndex++;
+      }
+      else
+      {
+         return NULL;
+      }
+
+      myUsedCounter++;
+      return object;
+   } /* allocate */
 
-      return false;
+   inline void Chunk :: release(void* object)
+   {
+      *(void**)object = myFreeList;
+      myFreeList = object;
+      myUsedCounter--;
    } /* release */
 
 } /* Namespace ObjectPool */
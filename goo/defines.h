@@ -46,9 +46,28 @@
 /* Default size of chunk size (piece of memory requested from the OS) */
 #define OP_DEF_CHUNK_SIZE     (32 * 1024)
 
+/* Minimal number of objects in chunk, chunk is enlarged for big objects */
+#define OP_MIN_CHUNK_OBJECTS  (8)
+
 /* Alignment of objects, according to ANSI C Standard shall be 16 */
 #define OP_MEMORY_ALIGNMENT   (8)
 
+/* Every thread keeps released objects of a pool in a small cache, so */
+/* the pool lock is taken only to move OP_CACHE_BATCH objects at once */
+#if defined(OP_UNIX) && defined(__GNUC__)
+#define OP_THREAD_CACHE       1
+#define OP_THREAD_LOCAL       __thread
+#else
+#define OP_THREAD_CACHE       0
+#endif
+
+/* Size of thread cache and number of objects moved from/to the pool */
+#define OP_CACHE_SIZE         (32)
+#define OP_CACHE_BATCH        (16)
+
+/* Number of pools which may have thread caches, others use lock always */
+#define OP_MAX_POOLS          (32)
+
 
 /* Make capacity calculation for some array */
 #define OP_CAPACITY(a)        (sizeof(a) / sizeof(*a))
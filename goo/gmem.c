@@ -12,6 +12,9 @@
 #include <stddef.h>
 #include <string.h>
 #include "gmem.h"
+#if GOO_MEMORY_STATS
+#include <time.h>
+#endif
 
 #if GOO_MEMORY
 
@@ -233,3 +236,71 @@ char *copyString(char *s) {
 
 #endif /* if GOO_MEMORY */
 
+
+#if GOO_MEMORY_STATS
+
+static __thread GMemStats gMemStats;
+static __thread long gMemNsecs;
+
+static long gMemClock(void) {
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1000000000L + t.tv_nsec;
+}
+
+void *gMemStatMalloc(size_t size) {
+  long t;
+  void *p;
+
+  t = gMemClock();
+  p = malloc(size);
+  gMemNsecs += gMemClock() - t;
+  ++gMemStats.mallocs;
+  gMemStats.bytes += size;
+  return p;
+}
+
+void *gMemStatRealloc(void *p, size_t size) {
+  long t;
+  void *q;
+
+  t = gMemClock();
+  q = realloc(p, size);
+  gMemNsecs += gMemClock() - t;
+  ++gMemStats.reallocs;
+  gMemStats.bytes += size;
+  return q;
+}
+
+void gMemStatFree(void *p) {
+  long t;
+
+  if (p) {
+    t = gMemClock();
+    free(p);
+    gMemNsecs += gMemClock() - t;
+    ++gMemStats.frees;
+  }
+}
+
+void gMemGetStats(GMemStats *stats) {
+  *stats = gMemStats;
+  stats->usecs = gMemNsecs / 1000;
+}
+
+void gMemResetStats(void) {
+  memset(&gMemStats, 0, sizeof(GMemStats));
+  gMemNsecs = 0;
+}
+
+#else
+
+void gMemGetStats(GMemStats *stats) {
+  memset(stats, 0, sizeof(GMemStats));
+}
+
+void gMemResetStats(void) {
+}
+
+#endif /* GOO_MEMORY_STATS */
@@ -21,6 +21,13 @@ extern "C" {
 /* Switching off this staff by default because it mostly useless */
 #define GOO_MEMORY	0
 
+/* Count the allocations made by each thread, and the time spent in
+ * them (see gMemGetStats).  This is for profiling only: it adds two
+ * clock reads to every call. */
+#ifndef GOO_MEMORY_STATS
+#define GOO_MEMORY_STATS	0
+#endif
+
 #if GOO_MEMORY
 	
 /*
@@ -72,12 +79,28 @@ extern char *copyString(char *s);
 #define VISIBILITY
 #endif
 
+#if GOO_MEMORY_STATS
+
+extern void *gMemStatMalloc(size_t size);
+extern void *gMemStatRealloc(void *p, size_t size);
+extern void gMemStatFree(void *p);
+
+#define gmalloc(size)			gMemStatMalloc(size)
+#define grealloc(ptr,size)		gMemStatRealloc(ptr, size)
+#define gmallocn(n_obj,s_obj)		gMemStatMalloc((n_obj) * (s_obj))
+#define greallocn(ptr,n_obj,s_obj)	gMemStatRealloc(ptr, (n_obj) * (s_obj))
+#define gfree(ptr)			gMemStatFree(ptr)
+
+#else
+
 #define gmalloc(size)			(VISIBILITY malloc(size))
 #define grealloc(ptr,size)		(VISIBILITY realloc(ptr, size))
 #define gmallocn(n_obj,s_obj)		(VISIBILITY malloc((n_obj) * (s_obj)))
 #define greallocn(ptr,n_obj,s_obj)	(VISIBILITY realloc(ptr, (n_obj) * (s_obj)))
 #define gfree(ptr)			(VISIBILITY free(ptr))
 
+#endif /* GOO_MEMORY_STATS */
+
 
 
 /* Faster version of string duplication function */
@@ -97,6 +120,22 @@ static inline char* copyString(const char* s)
 
 #endif /* if GOO_MEMORY */
 
+/*
+ * Allocation statistics for the calling thread, counted since the
+ * last call to gMemResetStats.  All zero unless GOO_MEMORY_STATS is
+ * set.  C++ new and delete are included.
+ */
+typedef struct {
+  unsigned long mallocs;	/* gmalloc calls (and new) */
+  unsigned long reallocs;	/* grealloc calls */
+  unsigned long frees;		/* gfree calls with a non-NULL pointer */
+  unsigned long bytes;		/* bytes requested by gmalloc/grealloc */
+  unsigned long usecs;		/* time spent in all of the above */
+} GMemStats;
+
+extern void gMemGetStats(GMemStats *stats);
+extern void gMemResetStats(void);
+
 
 #ifdef __cplusplus
 }
@@ -30,3 +30,37 @@ void operator delete[](void *p) {
 }
 
 #endif /* GOO_MEMORY and DEBUG_MEM */
+
+#if !GOO_MEMORY && GOO_MEMORY_STATS
+
+// count new and delete in the allocation statistics too
+
+void *operator new(size_t size) {
+  void *p;
+
+  if (!(p = gMemStatMalloc(size ? size : 1))) {
+    fprintf(stderr, "Out of memory\n");
+    exit(1);
+  }
+  return p;
+}
+
+void *operator new[](size_t size) {
+  void *p;
+
+  if (!(p = gMemStatMalloc(size ? size : 1))) {
+    fprintf(stderr, "Out of memory\n");
+    exit(1);
+  }
+  return p;
+}
+
+void operator delete(void *p) {
+  gMemStatFree(p);
+}
+
+void operator delete[](void *p) {
+  gMemStatFree(p);
+}
+
+#endif /* GOO_MEMORY_STATS */
@@ -0,0 +1,179 @@
+/* ========================================================================= *
+ * File: pool.cpp
+ *
+ * Copyright (C) 2006 Nokia. All rights reserved.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307 USA
+ *
+ * Description:
+ *    Object Pool parts which do not depend on access policy: registry of
+ *    pools, thread caches, trim and report of all pools.
+ * ========================================================================= */
+
+/* ========================================================================= *
+ * Includes.
+ * ========================================================================= */
+
+#include <time.h>
+#include "lock.h"
+#include "pool.h"
+
+/* ========================================================================= *
+ * Local data.
+ * ========================================================================= */
+
+namespace ObjectPool
+{
+#if OP_THREAD_CACHE
+   OP_THREAD_LOCAL Cache opCaches[OP_MAX_POOLS];
+
+   /* Set when flushThread() is registered for the current thread */
+   static OP_THREAD_LOCAL bool opAttached;
+
+   /* Key to call flushThread() at thread exit */
+   static pthread_key_t  opThreadKey;
+   static pthread_once_t opThreadOnce = PTHREAD_ONCE_INIT;
+#endif
+
+   /* List of all pools and number of assigned cache indexes */
+   static PoolBase*  opPools;
+   static unsigned   opIndexes;
+
+   /* Protects the list above, locked before any pool */
+   static LockPolicy& registry()
+   {
+      static LockPolicy lock;
+      return lock;
+   } /* registry */
+
+/* ========================================================================= *
+ * Interface.
+ * ========================================================================= */
+
+   double nanoseconds()
+   {
+#ifdef OP_WINDOWS
+      LARGE_INTEGER counter;
+      LARGE_INTEGER frequency;
+
+      QueryPerformanceCounter(&counter);
+      QueryPerformanceFrequency(&frequency);
+      return (double)counter.QuadPart * 1e9 / (double)frequency.QuadPart;
+#else
+      struct timespec ts;
+
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+      return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+#endif
+   } /* nanoseconds */
+
+
+   PoolBase :: PoolBase(const char* name)
+      : myName(name)
+   {
+      Guard<LockPolicy> guard(registry());
+
+#if OP_THREAD_CACHE
+      myIndex = (opIndexes < OP_MAX_POOLS ? opIndexes++ : OP_MAX_POOLS);
+#else
+      myIndex = OP_MAX_POOLS;
+#endif
+
+      myNext  = opPools;
+      opPools = this;
+   } /* PoolBase */
+
+   PoolBase :: ~PoolBase()
+   {
+      Guard<LockPolicy> guard(registry());
+      PoolBase** cursor;
+
+      for (cursor = &opPools; *cursor; cursor = &(*cursor)->myNext)
+      {
+         if (this == *cursor)
+         {
+            *cursor = myNext;
+            break;
+         }
+      }
+   } /* ~PoolBase */
+
+
+#if OP_THREAD_CACHE
+   static void detachThread(void*)
+   {
+      PoolBase::flushThread();
+      opAttached = false;
+   } /* detachThread */
+
+   static void createThreadKey()
+   {
+      pthread_key_create(&opThreadKey, detachThread);
+   } /* createThreadKey */
+#endif
+
+   void PoolBase :: attach()
+   {
+#if OP_THREAD_CACHE
+      if ( !opAttached )
+      {
+         /* Value is not used but shall be not NULL to get detachThread() called */
+         pthread_once(&opThreadOnce, createThreadKey);
+         pthread_setspecific(opThreadKey, &opAttached);
+         opAttached = true;
+      }
+#endif
+   } /* attach */
+
+   void PoolBase :: flushThread()
+   {
+#if OP_THREAD_CACHE
+      Guard<LockPolicy> guard(registry());
+      PoolBase* cursor;
+
+      for (cursor = opPools; cursor; cursor = cursor->myNext)
+      {
+         if (Cache* cache = cursor->cache())
+         {
+            if (cache->count > 0)
+               cursor->flush(*cache);
+         }
+      }
+#endif
+   } /* flushThread */
+
+
+   void trim()
+   {
+      PoolBase::flushThread();
+
+      Guard<LockPolicy> guard(registry());
+      PoolBase* cursor;
+
+      for (cursor = opPools; cursor; cursor = cursor->myNext)
+         cursor->trim();
+   } /* trim */
+
+   void report(FILE* output)
+   {
+      Guard<LockPolicy> guard(registry());
+      PoolBase* cursor;
+
+      for (cursor = opPools; cursor; cursor = cursor->myNext)
+         cursor->info(output);
+   } /* report */
+
+} /* Namespace ObjectPool */
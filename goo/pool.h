@@ -27,6 +27,10 @@
  *
  * 19-Jul-2006 Leonid Moiseichuk
  * - initial version created.
+ *
+ * Chunks with free slots are kept in front of the list, and released
+ * objects go to a per-thread cache first, so allocate and release do not
+ * search and usually do not lock.  Empty chunks are returned by trim().
  * ========================================================================= */
 
 #ifndef OBJECT_POOL_POOL_H_USED
@@ -38,6 +42,8 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <new>
 
 #include "defines.h"
 #include "guard.h"
@@ -51,12 +57,123 @@
 namespace ObjectPool
 {
 
+   /* Objects released by one thread and not returned to the pool yet */
+   struct Cache
+   {
+      void*          objects[OP_CACHE_SIZE];
+      unsigned       count;
+
+      /* Operations served by this cache since the last refill or flush */
+      unsigned long  allocated;
+      unsigned long  released;
+   };
+
+#if OP_THREAD_CACHE
+   /* Caches of the current thread, indexed by pool */
+   extern OP_THREAD_LOCAL Cache opCaches[OP_MAX_POOLS];
+#endif
+
+   /* Pool usage counters, available if OP_STATISTICS enabled */
+   struct Statistics
+   {
+      unsigned long  allocated;
+      unsigned long  released;
+      unsigned long  oversized;
+      unsigned long  refills;
+      unsigned long  flushes;
+
+      unsigned long  chunksCreated;
+      unsigned long  chunksFreed;
+      unsigned long  chunks;
+      unsigned long  chunksPeak;
+
+      /* Time spent under the lock, nanoseconds */
+      double         lockedTime;
+      /* Time of the pool creation, nanoseconds */
+      double         startTime;
+   };
+
+   /* Returns monotonic time in nanoseconds */
+   double nanoseconds();
+
+
+   /* Part of pool which does not depend on access policy. All pools */
+   /* are registered to make trim() and report() working for them.   */
+   class PoolBase
+   {
+      protected:
+
+         /* Name of pool to be shown by info() */
+         const char*    myName;
+
+         /* Index of thread cache, OP_MAX_POOLS if pool has no cache */
+         unsigned       myIndex;
+
+         /* Next registered pool */
+         PoolBase*      myNext;
+
+      public:
+
+         PoolBase(const char* name);
+         virtual ~PoolBase();
+
+         /* Returns all objects from the cache to the pool */
+         virtual void flush(Cache& cache) = 0;
+
+         /* Returns memory of empty chunks to the OS */
+         virtual void trim() = 0;
+
+         /* Display information about pool */
+         virtual void info(FILE* output) = 0;
+
+         friend void trim();
+         friend void report(FILE* output);
+
+      protected:
+
+         /* Returns the cache of this pool for the current thread or NULL */
+         Cache* cache() const;
+
+         /* Makes sure the caches of the current thread are flushed at exit */
+         static void attach();
+
+      public:
+
+         /* Returns objects from all caches of the current thread to pools */
+         static void flushThread();
+
+      private:    /* Usage of these methods is prohibited outside */
+         PoolBase();
+         PoolBase(const PoolBase&);
+         void operator=(const PoolBase&);
+
+   }; /* Class PoolBase */
+
+
+   inline Cache* PoolBase :: cache() const
+   {
+#if OP_THREAD_CACHE
+      return (myIndex < OP_MAX_POOLS ? opCaches + myIndex : NULL);
+#else
+      return NULL;
+#endif
+   } /* cache */
+
+
+   /* Flushes caches of the current thread and returns empty chunks of all */
+   /* pools to the OS, for example when a page of document is rendered.   */
+   void trim();
+
+   /* Displays information about all pools */
+   void report(FILE* output);
+
+
    /* Pool is managing a set of objects that located in chunk(s).      */
    /* Every object will have predefined size not bigger than requested */
    /* If you trying to allocate big object the standard new operator   */
    /* be called automatical.                                           */
    template <class AccessPolicy>
-   class Pool
+   class Pool: public PoolBase
    {
       private:
 
@@ -66,31 +183,50 @@ namespace ObjectPool
          /* Shared chunks information */
          Chunk::Shared  myShared;
 
-         /* Pointers to first chunk in list */
+         /* Pointers to first and last chunks in list, first have free slots */
          Chunk*         myChunk;
+         Chunk*         myLast;
+
+#if OP_STATISTICS
+         Statistics     myStatistics;
+#endif
 
       public:
 
-         /* Constructor of pool object. You can specify 2 parameters:    */
+         /* Constructor of pool object. You can specify 3 parameters:    */
          /* - objectSizeOf - size of every allocated object, pool will   */
          /*   provide the requested or greater size. Bigger objects will */
          /*   be allocated using standard operator new.                  */
-         /* - chunkSize - prefered size of chunk, maybe a bit bigger due */
-         /*   to chunk support information and alignment.                */
-         Pool(unsigned objectSizeOf, unsigned chunkSize=OP_DEF_CHUNK_SIZE);
-         ~Pool();
+         /* - chunkSize - prefered size of chunk, rounded up to power of */
+         /*   two because chunks are aligned to their size.             */
+         /* - name - shown in statistics.                                */
+         Pool(unsigned objectSizeOf, unsigned chunkSize=OP_DEF_CHUNK_SIZE, const char* name=NULL);
+         virtual ~Pool();
 
          void* allocate(size_t size);
-         void  release(void* ptr);
 
-         void  info(FILE* output);
+         /* Size shall be the same as for allocate() */
+         void  release(void* ptr, size_t size);
+
+         virtual void  flush(Cache& cache);
+         virtual void  trim();
+         virtual void  info(FILE* output);
 
       private:    /* Usage of these methods is prohibited outside */
          Pool();
          Pool(const Pool&);
          void operator=(const Pool&);
 
-         void escalate(Chunk* pred);
+         /* Slow paths, shall be called under the lock */
+         void* take();
+         void  give(void* ptr);
+         void  refill(Cache& cache);
+         void  unload(Cache& cache, unsigned count);
+
+         /* Moves chunk to the head or tail of list */
+         void  unlink(Chunk* chunk);
+         void  prepend(Chunk* chunk);
+         void  append(Chunk* chunk);
 
    }; /* Class Pool */
 
@@ -100,128 +236,291 @@ namespace ObjectPool
    {}
 
    template <class AccessPolicy>
-   inline Pool<AccessPolicy> :: Pool(unsigned objectSizeOf, unsigned chunkSize)
-      : myAccess()
+   inline Pool<AccessPolicy> :: Pool(unsigned objectSizeOf, unsigned chunkSize, const char* name)
+      : PoolBase(name), myAccess()
    {
       Guard<AccessPolicy> guard(myAccess);
       Chunk::setup(myShared, objectSizeOf, chunkSize);
       myChunk = NULL;
+      myLast  = NULL;
+#if OP_STATISTICS
+      memset(&myStatistics, 0, sizeof(myStatistics));
+      myStatistics.startTime = nanoseconds();
+#endif
    } /* Pool */
 
    template <class AccessPolicy>
    Pool<AccessPolicy> :: ~Pool()
    {
       Guard<AccessPolicy> guard(myAccess);
+
+      /* Objects cached by this thread are not valid anymore */
+      if (Cache* cache = this->cache())
+         cache->count = 0;
+
       while ( myChunk )
       {
          Chunk* helper = myChunk;
          myChunk = myChunk->succ();
-         free(helper);
+         Chunk::destroy(helper);
       }
    } /* ~Pool */
 
    template <class AccessPolicy>
-   inline void Pool<AccessPolicy> :: escalate(Chunk* pred)
+   inline void Pool<AccessPolicy> :: unlink(Chunk* chunk)
+   {
+      if ( chunk->pred() )
+         chunk->pred()->succ(chunk->succ());
+      else
+         myChunk = chunk->succ();
+
+      if ( chunk->succ() )
+         chunk->succ()->pred(chunk->pred());
+      else
+         myLast = chunk->pred();
+   } /* unlink */
+
+   template <class AccessPolicy>
+   inline void Pool<AccessPolicy> :: prepend(Chunk* chunk)
    {
-      if ( pred )
+      chunk->pred(NULL);
+      chunk->succ(myChunk);
+      if ( myChunk )
+         myChunk->pred(chunk);
+      else
+         myLast = chunk;
+      myChunk = chunk;
+   } /* prepend */
+
+   template <class AccessPolicy>
+   inline void Pool<AccessPolicy> :: append(Chunk* chunk)
+   {
+      chunk->succ(NULL);
+      chunk->pred(myLast);
+      if ( myLast )
+         myLast->succ(chunk);
+      else
+         myChunk = chunk;
+      myLast = chunk;
+   } /* append */
+
+
+   template <class AccessPolicy>
+   void* Pool<AccessPolicy> :: take()
+   {
+      Chunk* chunk = myChunk;
+
+      /* Chunks with free slots are always in front of the list */
+      if (NULL == chunk || !chunk->avail(myShared))
       {
-         Chunk* curr = pred->succ();
+         chunk = Chunk::create(myShared);
+         if (NULL == chunk)
+            throw std::bad_alloc();
 
-         pred->succ(curr->succ());
-         curr->succ(myChunk);
-         myChunk = curr;
+         prepend(chunk);
+#if OP_STATISTICS
+         myStatistics.chunksCreated++;
+         if (++myStatistics.chunks > myStatistics.chunksPeak)
+            myStatistics.chunksPeak = myStatistics.chunks;
+#endif
+      }
+
+      void* object = chunk->allocate(myShared);
+
+      /* Full chunk goes to the tail */
+      if ( !chunk->avail(myShared) && chunk != myLast )
+      {
+         unlink(chunk);
+         append(chunk);
       }
-   } /* escalate */
 
+      return object;
+   } /* take */
 
    template <class AccessPolicy>
-   void* Pool<AccessPolicy> :: allocate(size_t size)
+   void Pool<AccessPolicy> :: give(void* ptr)
+   {
+      Chunk* chunk = Chunk::owner(myShared, ptr);
+      const bool full = !chunk->avail(myShared);
+
+      chunk->release(ptr);
+
+      /* Chunk got a free slot, move it to the head */
+      if ( full && chunk != myChunk )
+      {
+         unlink(chunk);
+         prepend(chunk);
+      }
+   } /* give */
+
+   template <class AccessPolicy>
+   void Pool<AccessPolicy> :: refill(Cache& cache)
+   {
+      attach();
+
+      Guard<AccessPolicy> guard(myAccess);
+#if OP_STATISTICS
+      const double start = nanoseconds();
+      myStatistics.allocated += cache.allocated;
+      myStatistics.released  += cache.released;
+      myStatistics.refills++;
+      cache.allocated = cache.released = 0;
+#endif
+
+      while (cache.count < OP_CACHE_BATCH)
+         cache.objects[cache.count++] = take();
+
+#if OP_STATISTICS
+      myStatistics.lockedTime += nanoseconds() - start;
+#endif
+   } /* refill */
+
+   template <class AccessPolicy>
+   void Pool<AccessPolicy> :: unload(Cache& cache, unsigned count)
    {
       Guard<AccessPolicy> guard(myAccess);
+#if OP_STATISTICS
+      const double start = nanoseconds();
+      myStatistics.allocated += cache.allocated;
+      myStatistics.released  += cache.released;
+      myStatistics.flushes++;
+      cache.allocated = cache.released = 0;
+#endif
+
+      while (count-- > 0)
+         give(cache.objects[--cache.count]);
+
+#if OP_STATISTICS
+      myStatistics.lockedTime += nanoseconds() - start;
+#endif
+   } /* unload */
+
+   template <class AccessPolicy>
+   void Pool<AccessPolicy> :: flush(Cache& cache)
+   {
+      unload(cache, cache.count);
+   } /* flush */
+
 
+   template <class AccessPolicy>
+   inline void* Pool<AccessPolicy> :: allocate(size_t size)
+   {
       if (size <= myShared.objectSizeOf)
       {
-         Chunk* previous;
-         Chunk* cursor;
-
-         /* Search for chunk that can allocate object */
-         for (previous = NULL, cursor = myChunk; cursor; previous = cursor, cursor = cursor->succ())
+         if (Cache* cache = this->cache())
          {
-            if (void* object = cursor->allocate(myShared))
-            {
-               escalate(previous);
-               return object;
-            }
-         }
+            if (0 == cache->count)
+               refill(*cache);
 
-         /* No free slots in chunks - add a new chunk */
-         cursor = Chunk::create(myShared);
-         if ( cursor )
-         {
-            cursor->succ(myChunk);
-            myChunk = cursor;
-            return cursor->allocate(myShared);
+            cache->allocated++;
+            return cache->objects[--cache->count];
          }
+
+         Guard<AccessPolicy> guard(myAccess);
+#if OP_STATISTICS
+         myStatistics.allocated++;
+#endif
+         return take();
       }
 
-      /* We can also return null but be safe */
+      /* Too big object for this pool */
       OP_TRACE(size);
-      return ::operator new(size, std::nothrow);
+#if OP_STATISTICS
+      {
+         Guard<AccessPolicy> guard(myAccess);
+         myStatistics.oversized++;
+      }
+#endif
+      return ::operator new(size);
    } /* allocate */
 
    template <class AccessPolicy>
-   void Pool<AccessPolicy> :: release(void* ptr)
+   inline void Pool<AccessPolicy> :: release(void* ptr, size_t size)
+   {
+      if (NULL == ptr)
+         return;
+
+      /* Object is located not in pool */
+      if (size > myShared.objectSizeOf)
+      {
+         OP_TRACE(ptr);
+         ::operator delete(ptr);
+         return;
+      }
+
+      if (Cache* cache = this->cache())
+      {
+         if (OP_CACHE_SIZE == cache->count)
+            unload(*cache, OP_CACHE_BATCH);
+         else if (0 == cache->count)
+            attach();
+
+         cache->released++;
+         cache->objects[cache->count++] = ptr;
+         return;
+      }
+
+      Guard<AccessPolicy> guard(myAccess);
+#if OP_STATISTICS
+      myStatistics.released++;
+#endif
+      give(ptr);
+   } /* release */
+
+
+   template <class AccessPolicy>
+   void Pool<AccessPolicy> :: trim()
    {
       Guard<AccessPolicy> guard(myAccess);
-      Chunk* previous;
-      Chunk* cursor;
+      Chunk* cursor = myChunk;
 
-      for (previous = NULL, cursor = myChunk; cursor; previous = cursor, cursor = cursor->succ())
+      /* Empty chunks have free slots, so they are in front of the list */
+      while (cursor && cursor->avail(myShared))
       {
-         if ( cursor->release(myShared, (unsigned char*)ptr) )
+         Chunk* helper = cursor;
+         cursor = cursor->succ();
+
+         if ( helper->empty() )
          {
-            if ( cursor->empty() )
-            {
-               if ( previous )
-                  previous->succ(cursor->succ());
-               else
-                  myChunk = cursor->succ();
-
-               free(cursor);
-            }
-            else
-            {
-               /* Escalate this chunk because it has free slots */
-               escalate(previous);
-            }
-
-            return;
+            unlink(helper);
+            Chunk::destroy(helper);
+#if OP_STATISTICS
+            myStatistics.chunksFreed++;
+            myStatistics.chunks--;
+#endif
          }
       }
-
-      /* Object is located not in pool */
-      OP_TRACE(ptr);
-      ::operator delete(ptr, std::nothrow);
-   } /* release */
+   } /* trim */
 
    template <class AccessPolicy>
    void Pool<AccessPolicy> :: info(FILE* output)
    {
 #if OP_STATISTICS
+      Cache* cache = this->cache();
       Guard<AccessPolicy> guard(myAccess);
-      const Chunk* cursor = myChunk;
+      unsigned long allocated = myStatistics.allocated;
+      unsigned long released  = myStatistics.released;
+      double seconds = (nanoseconds() - myStatistics.startTime) / 1e9;
 
-      fprintf(output, "characteristics of pool 0x%08x:\n", (unsigned)this);
+      /* Operations of other threads are counted when their caches are refilled or flushed */
+      if ( cache )
+      {
+         allocated += cache->allocated;
+         released  += cache->released;
+      }
+
+      fprintf(output, "characteristics of pool %s (%p):\n", (myName ? myName : "unnamed"), (void*)this);
       fprintf(output, "- objectSizeOf  %u\n", myShared.objectSizeOf);
       fprintf(output, "- objectCounter %u\n", myShared.objectCounter);
-      fprintf(output, "- bitmapOffset  %u\n", myShared.bitmapOffset);
-      fprintf(output, "- bitmapCounter %u\n", myShared.bitmapCounter);
       fprintf(output, "- memoryOffset  %u\n", myShared.memoryOffset);
-      fprintf(output, "- memoryCounter %u\n", myShared.memoryCounter);
       fprintf(output, "- chunkSize     %u\n", myShared.chunkSize);
-
-      for (cursor = myChunk; cursor; cursor = cursor->succ())
-         cursor->info(output);
+      fprintf(output, "- chunks        %lu (peak %lu, created %lu, freed %lu)\n",
+                  myStatistics.chunks, myStatistics.chunksPeak, myStatistics.chunksCreated, myStatistics.chunksFreed);
+      fprintf(output, "- allocated     %lu (%.0f/s), oversized %lu\n",
+                  allocated, (seconds > 0 ? allocated / seconds : 0.0), myStatistics.oversized);
+      fprintf(output, "- released      %lu\n", released);
+      fprintf(output, "- locked        %lu refills, %lu flushes, %.3f ms\n",
+                  myStatistics.refills, myStatistics.flushes, myStatistics.lockedTime / 1e6);
 #endif
    } /* info */
 
@@ -24,16 +24,45 @@
 #include "SplashScreen.h"
 #include "SplashFont.h"
 #include "SplashGlyphBitmap.h"
+#include "SplashKernels.h"
 #include "Splash.h"
 
 //------------------------------------------------------------------------
 
-static void blendNormal(SplashColorPtr src, SplashColorPtr dest,
-			SplashColorPtr blend, SplashColorMode cm) {
-  int i;
+// number of pixels per alpha and color buffer in the span kernels
+#define splashKernelChunk 256
+
+//------------------------------------------------------------------------
+// SplashSpan
+//------------------------------------------------------------------------
 
-  for (i = 0; i < splashColorModeNComps[cm]; ++i) {
-    blend[i] = src[i];
+// A run of pixels [x0, x1] on row y, entirely inside the clip region,
+// as handed to the span kernels.  The source color is one of:
+//   - a static color: <pattern> and <src> are NULL
+//   - a pattern: <pattern> is set
+//   - a row of pixels (images): <src> is set
+struct SplashSpan {
+  int x0, x1, y;
+  SplashPattern *pattern;	// non-static pattern, or NULL
+  SplashColor color;		// the color, if it is static
+  SplashColorPtr src;		// pixel colors, in the bitmap's format
+				//   (one byte per pixel for Mono1), or NULL
+  SplashCoord alpha;
+  SplashCoord *srcAlpha;	// per-pixel alpha, used in place of
+				//   <alpha>, or NULL
+  Guchar *coverage;		// per-pixel coverage (anti-aliased edges
+				//   and glyphs), or NULL; not used with
+				//   Mono1 bitmaps
+  void (Splash::*kernel)(SplashSpan *span);
+};
+
+// Set the source color of <span> to <pattern>.
+static inline void setSpanPattern(SplashSpan *span, SplashPattern *pattern) {
+  if (pattern->isStatic()) {
+    pattern->getColor(0, 0, span->color);
+    span->pattern = NULL;
+  } else {
+    span->pattern = pattern;
   }
 }
 
@@ -41,11 +70,20 @@ static void blendNormal(SplashColorPtr src, SplashColorPtr dest,
 // Splash
 //------------------------------------------------------------------------
 
-Splash::Splash(SplashBitmap *bitmapA) {
+Splash::Splash(SplashBitmap *bitmapA, GBool vectorAntialiasA) {
   bitmap = bitmapA;
   state = new SplashState(bitmap->width, bitmap->height);
   softMask = NULL;
   clearModRegion();
+  vectorAntialias = gFalse;
+  aaBuf = NULL;
+  setVectorAntialias(vectorAntialiasA);
+  strokeXPath = new SplashXPath();
+  dashXPath = new SplashXPath();
+  strokePiece = new SplashPath();
+  strokeOutline = new SplashPath();
+  fillXPath = new SplashXPath();
+  fillScanner = NULL;
   debugMode = gFalse;
 }
 
@@ -57,6 +95,15 @@ Splash::~Splash() {
   if (softMask) {
     delete softMask;
   }
+  gfree(aaBuf);
+  delete strokeXPath;
+  delete dashXPath;
+  delete strokePiece;
+  delete strokeOutline;
+  delete fillXPath;
+  if (fillScanner) {
+    delete fillScanner;
+  }
 }
 
 //------------------------------------------------------------------------
@@ -182,15 +229,18 @@ void Splash::setLineDash(SplashCoord *lineDash, int lineDashLength,
 
 void Splash::clipResetToRect(SplashCoord x0, SplashCoord y0,
 			     SplashCoord x1, SplashCoord y1) {
+  state->unshareClip();
   state->clip->resetToRect(x0, y0, x1, y1);
 }
 
 SplashError Splash::clipToRect(SplashCoord x0, SplashCoord y0,
 			       SplashCoord x1, SplashCoord y1) {
+  state->unshareClip();
   return state->clip->clipToRect(x0, y0, x1, y1);
 }
 
 SplashError Splash::clipToPath(SplashPath *path, GBool eo) {
+  state->unshareClip();
   return state->clip->clipToPath(path, state->flatness, eo);
 }
 
@@ -201,7 +251,7 @@ SplashError Splash::clipToPath(SplashPath *path, GBool eo) {
 void Splash::saveState() {
   SplashState *newState;
 
-  newState = state->copy();
+  newState = new SplashState(state, gTrue);
   newState->next = state;
   state = newState;
 }
@@ -229,6 +279,13 @@ void Splash::setSoftMask(SplashBitmap *softMaskA) {
   softMask = softMaskA;
 }
 
+void Splash::setVectorAntialias(GBool vectorAntialiasA) {
+  vectorAntialias = vectorAntialiasA && bitmap->mode != splashModeMono1;
+  if (vectorAntialias && !aaBuf) {
+    aaBuf = (Guchar *)gmalloc(bitmap->width);
+  }
+}
+
 //------------------------------------------------------------------------
 // modified region
 //------------------------------------------------------------------------
@@ -388,7 +445,7 @@ void Splash::clear(SplashColorPtr color) {
 }
 
 SplashError Splash::stroke(SplashPath *path) {
-  SplashXPath *xPath, *xPath2;
+  SplashXPath *xPath;
 
   if (debugMode) {
     printf("stroke [dash:%d] [width:%.2f]:\n",
@@ -399,121 +456,146 @@ SplashError Splash::stroke(SplashPath *path) {
   if (path->length == 0) {
     return splashErrEmptyPath;
   }
-  xPath = new SplashXPath(path, state->flatness, gFalse);
+  xPath = strokeXPath;
+  xPath->reset(path, state->flatness, gFalse);
   if (xPath->length == 0) {
-    delete xPath;
     return splashErrEmptyPath;
   }
-  if (state->lineDashLength > 0) {
-    xPath2 = makeDashedPath(xPath);
-    delete xPath;
-    xPath = xPath2;
-  }
   if (state->lineWidth <= 1) {
     strokeNarrow(xPath);
   } else {
+    if (state->lineDashLength > 0) {
+      xPath = makeDashedPath(xPath);
+    }
     strokeWide(xPath);
   }
-  delete xPath;
   return splashOk;
 }
 
+// Thin (width <= 1) strokes are drawn one segment at a time, straight
+// into the bitmap: aliased segments one span per row (or one pixel per
+// row, for steep segments), and anti-aliased ones with Wu's algorithm,
+// i.e., two pixels per column (or row) weighted by the distance to the
+// line.  Dash patterns are applied on the fly, so dashed hairlines
+// don't go through makeDashedPath.  Joins and caps don't matter at
+// this width.
 void Splash::strokeNarrow(SplashXPath *xPath) {
   SplashXPathSeg *seg;
-  int x0, x1, x2, x3, y0, y1, x, y, t;
-  SplashCoord dx, dy, dxdy;
-  SplashClipResult clipRes;
+  SplashColor color;
+  SplashCoord lineDashTotal, lineDashStartPhase, lineDashDist;
+  SplashCoord sx0, sy0, sx1, sy1, ax0, ay0, ax1, ay1, dist;
+  GBool solid, lineDashStartOn, lineDashOn, atSegEnd, atDashEnd;
+  int lineDashStartIdx, lineDashIdx;
   int nClipRes[3];
   int i;
 
   memset(&nClipRes, 0, sizeof(nClipRes));
-  
-  for (i = 0, seg = xPath->segs; i < xPath->length; ++i, ++seg) {
 
-    x0 = splashFloor(seg->x0);
-    x1 = splashFloor(seg->x1);
-    y0 = splashFloor(seg->y0);
-    y1 = splashFloor(seg->y1);
+  // opaque solid colors are written directly; everything else goes
+  // through the span kernels
+  solid = state->strokePattern->isStatic() && state->strokeAlpha == 1 &&
+	  !softMask && !state->blendFunc;
+  if (state->strokePattern->isStatic()) {
+    state->strokePattern->getColor(0, 0, color);
+  }
 
-    // horizontal segment
-    if (y0 == y1) {
-      if (x0 > x1) {
-	t = x0; x0 = x1; x1 = t;
-      }
-      if ((clipRes = state->clip->testSpan(x0, x1, y0))
-	  != splashClipAllOutside) {
-	drawSpan(x0, x1, y0, state->strokePattern, state->strokeAlpha,
-		 clipRes == splashClipAllInside);
-      }
-
-    // segment with |dx| > |dy|
-    } else if (splashAbs(seg->dxdy) > 1) {
-      dx = seg->x1 - seg->x0;
-      dy = seg->y1 - seg->y0;
-      dxdy = seg->dxdy;
-      if (y0 > y1) {
-	t = y0; y0 = y1; y1 = t;
-	t = x0; x0 = x1; x1 = t;
-	dx = -dx;
-	dy = -dy;
-      }
-      if ((clipRes = state->clip->testRect(x0 <= x1 ? x0 : x1, y0,
-					   x0 <= x1 ? x1 : x0, y1))
-	  != splashClipAllOutside) {
-	if (dx > 0) {
-	  x2 = x0;
-	  x3 = splashFloor(seg->x0 + ((SplashCoord)y0 + 1 - seg->y0) * dxdy);
-	  drawSpan(x2, (x2 <= x3 - 1) ? x3 - 1 : x2, y0, state->strokePattern,
-		   state->strokeAlpha, clipRes == splashClipAllInside);
-	  x2 = x3;
-	  for (y = y0 + 1; y <= y1 - 1; ++y) {
-	    x3 = splashFloor(seg->x0 + ((SplashCoord)y + 1 - seg->y0) * dxdy);
-	    drawSpan(x2, x3 - 1, y, state->strokePattern,
-		     state->strokeAlpha, clipRes == splashClipAllInside);
-	    x2 = x3;
-	  }
-	  drawSpan(x2, x2 <= x1 ? x1 : x2, y1, state->strokePattern,
-		   state->strokeAlpha, clipRes == splashClipAllInside);
-	} else {
-	  x2 = x0;
-	  x3 = splashFloor(seg->x0 + ((SplashCoord)y0 + 1 - seg->y0) * dxdy);
-	  drawSpan((x3 + 1 <= x2) ? x3 + 1 : x2, x2, y0, state->strokePattern,
-		   state->strokeAlpha, clipRes == splashClipAllInside);
-	  x2 = x3;
-	  for (y = y0 + 1; y <= y1 - 1; ++y) {
-	    x3 = splashFloor(seg->x0 + ((SplashCoord)y + 1 - seg->y0) * dxdy);
-	    drawSpan(x3 + 1, x2, y, state->strokePattern,
-		     state->strokeAlpha, clipRes == splashClipAllInside);
-	    x2 = x3;
-	  }
-	  drawSpan(x1, (x1 <= x2) ? x2 : x1, y1, state->strokePattern,
-		   state->strokeAlpha, clipRes == splashClipAllInside);
-	}
+  if (state->lineDashLength == 0) {
+    for (i = 0, seg = xPath->segs; i < xPath->length; ++i, ++seg) {
+      if (vectorAntialias) {
+	++nClipRes[strokeNarrowAASeg(seg->x0, seg->y0, seg->x1, seg->y1,
+				     solid, color)];
+      } else {
+	++nClipRes[strokeNarrowSeg(seg->x0, seg->y0, seg->x1, seg->y1,
+				   seg->dxdy, solid, color)];
       }
+    }
 
-    // segment with |dy| > |dx|
-    } else {
-      dxdy = seg->dxdy;
-      if (y0 > y1) {
-	t = x0; x0 = x1; x1 = t;
-	t = y0; y0 = y1; y1 = t;
-      }
-      if ((clipRes = state->clip->testRect(x0 <= x1 ? x0 : x1, y0,
-					   x0 <= x1 ? x1 : x0, y1))
-	  != splashClipAllOutside) {
-	drawPixel(x0, y0, state->strokePattern, state->strokeAlpha,
-		  clipRes == splashClipAllInside);
-	for (y = y0 + 1; y <= y1 - 1; ++y) {
-	  x = splashFloor(seg->x0 + ((SplashCoord)y - seg->y0) * dxdy);
-	  drawPixel(x, y, state->strokePattern, state->strokeAlpha,
-		    clipRes == splashClipAllInside);
+  } else {
+    // this walks the dash pattern exactly like makeDashedPath does
+    lineDashTotal = 0;
+    for (i = 0; i < state->lineDashLength; ++i) {
+      lineDashTotal += state->lineDash[i];
+    }
+    lineDashStartPhase = state->lineDashPhase;
+    i = splashFloor(lineDashStartPhase / lineDashTotal);
+    lineDashStartPhase -= (SplashCoord)i * lineDashTotal;
+    lineDashStartOn = gTrue;
+    lineDashStartIdx = 0;
+    while (lineDashStartPhase >= state->lineDash[lineDashStartIdx]) {
+      lineDashStartOn = !lineDashStartOn;
+      lineDashStartPhase -= state->lineDash[lineDashStartIdx];
+      ++lineDashStartIdx;
+    }
+
+    i = 0;
+    seg = xPath->segs;
+    sx0 = seg->x0;
+    sy0 = seg->y0;
+    sx1 = seg->x1;
+    sy1 = seg->y1;
+    dist = splashDist(sx0, sy0, sx1, sy1);
+    lineDashOn = lineDashStartOn;
+    lineDashIdx = lineDashStartIdx;
+    lineDashDist = state->lineDash[lineDashIdx] - lineDashStartPhase;
+
+    while (i < xPath->length) {
+      ax0 = sx0;
+      ay0 = sy0;
+      if (dist <= lineDashDist) {
+	ax1 = sx1;
+	ay1 = sy1;
+	lineDashDist -= dist;
+	dist = 0;
+	atSegEnd = gTrue;
+	atDashEnd = lineDashDist == 0 || (seg->flags & splashXPathLast);
+      } else {
+	ax1 = sx0 + (lineDashDist / dist) * (sx1 - sx0);
+	ay1 = sy0 + (lineDashDist / dist) * (sy1 - sy0);
+	sx0 = ax1;
+	sy0 = ay1;
+	dist -= lineDashDist;
+	lineDashDist = 0;
+	atSegEnd = gFalse;
+	atDashEnd = gTrue;
+      }
+
+      if (lineDashOn) {
+	if (vectorAntialias) {
+	  ++nClipRes[strokeNarrowAASeg(ax0, ay0, ax1, ay1, solid, color)];
+	} else {
+	  ++nClipRes[strokeNarrowSeg(ax0, ay0, ax1, ay1,
+				     (ay0 == ay1 || ax0 == ax1)
+				       ? (SplashCoord)0
+				       : (ax1 - ax0) / (ay1 - ay0),
+				     solid, color)];
+	}
+      }
+
+      if (atDashEnd) {
+	lineDashOn = !lineDashOn;
+	if (++lineDashIdx == state->lineDashLength) {
+	  lineDashIdx = 0;
+	}
+	lineDashDist = state->lineDash[lineDashIdx];
+      }
+      if (atSegEnd) {
+	if (++i < xPath->length) {
+	  ++seg;
+	  sx0 = seg->x0;
+	  sy0 = seg->y0;
+	  sx1 = seg->x1;
+	  sy1 = seg->y1;
+	  dist = splashDist(sx0, sy0, sx1, sy1);
+	  if (seg->flags & splashXPathFirst) {
+	    lineDashOn = lineDashStartOn;
+	    lineDashIdx = lineDashStartIdx;
+	    lineDashDist = state->lineDash[lineDashIdx] - lineDashStartPhase;
+	  }
 	}
-	drawPixel(x1, y1, state->strokePattern, state->strokeAlpha,
-		  clipRes == splashClipAllInside);
       }
     }
-    ++nClipRes[clipRes];
   }
+
   if (nClipRes[splashClipPartial] ||
       (nClipRes[splashClipAllInside] && nClipRes[splashClipAllOutside])) {
     opClipRes = splashClipPartial;
@@ -524,15 +606,280 @@ void Splash::strokeNarrow(SplashXPath *xPath) {
   }
 }
 
+// Draw the aliased hairline from (<sx0>,<sy0>) to (<sx1>,<sy1>): each
+// row gets the pixels between the segment's intersections with the
+// row's top and bottom edges.  If <solid> is set, <color> is stored
+// directly; otherwise the pixels go through one span kernel, chosen
+// once for the segment.
+// Returns the clipping status of the segment.
+SplashClipResult Splash::strokeNarrowSeg(SplashCoord sx0, SplashCoord sy0,
+					 SplashCoord sx1, SplashCoord sy1,
+					 SplashCoord dxdy, GBool solid,
+					 SplashColorPtr color) {
+  SplashSpan span;
+  SplashColorPtr p;
+  SplashCoord dx;
+  SplashClipResult clipRes;
+  GBool noClip;
+  int x0, x1, x2, x3, y0, y1, x, y, t, nComps, rowSize;
+
+  x0 = splashFloor(sx0);
+  x1 = splashFloor(sx1);
+  y0 = splashFloor(sy0);
+  y1 = splashFloor(sy1);
+
+  setSpanPattern(&span, state->strokePattern);
+  span.src = NULL;
+  span.alpha = state->strokeAlpha;
+  span.srcAlpha = NULL;
+  span.coverage = NULL;
+  span.kernel = getSpanKernel(&span);
+
+  // horizontal segment
+  if (y0 == y1) {
+    if (x0 > x1) {
+      t = x0; x0 = x1; x1 = t;
+    }
+    if ((clipRes = state->clip->testSpan(x0, x1, y0))
+	!= splashClipAllOutside) {
+      drawSpanRuns(&span, x0, x1, y0, clipRes == splashClipAllInside);
+    }
+    return clipRes;
+  }
+
+  dx = sx1 - sx0;
+  if (y0 > y1) {
+    t = y0; y0 = y1; y1 = t;
+    t = x0; x0 = x1; x1 = t;
+    dx = -dx;
+  }
+  if ((clipRes = state->clip->testRect(x0 <= x1 ? x0 : x1, y0,
+				       x0 <= x1 ? x1 : x0, y1))
+      == splashClipAllOutside) {
+    return clipRes;
+  }
+  noClip = clipRes == splashClipAllInside;
+
+  // segment with |dx| > |dy|: one span per row
+  if (splashAbs(dxdy) > 1) {
+    if (dx > 0) {
+      x2 = x0;
+      x3 = splashFloor(sx0 + ((SplashCoord)y0 + 1 - sy0) * dxdy);
+      drawSpanRuns(&span, x2, (x2 <= x3 - 1) ? x3 - 1 : x2, y0, noClip);
+      x2 = x3;
+      for (y = y0 + 1; y <= y1 - 1; ++y) {
+	x3 = splashFloor(sx0 + ((SplashCoord)y + 1 - sy0) * dxdy);
+	drawSpanRuns(&span, x2, x3 - 1, y, noClip);
+	x2 = x3;
+      }
+      drawSpanRuns(&span, x2, x2 <= x1 ? x1 : x2, y1, noClip);
+    } else {
+      x2 = x0;
+      x3 = splashFloor(sx0 + ((SplashCoord)y0 + 1 - sy0) * dxdy);
+      drawSpanRuns(&span, (x3 + 1 <= x2) ? x3 + 1 : x2, x2, y0, noClip);
+      x2 = x3;
+      for (y = y0 + 1; y <= y1 - 1; ++y) {
+	x3 = splashFloor(sx0 + ((SplashCoord)y + 1 - sy0) * dxdy);
+	drawSpanRuns(&span, x3 + 1, x2, y, noClip);
+	x2 = x3;
+      }
+      drawSpanRuns(&span, x1, (x1 <= x2) ? x2 : x1, y1, noClip);
+    }
+
+  // segment with |dy| > |dx|: one pixel per row
+  } else if (solid && bitmap->mode != splashModeMono1) {
+    nComps = splashColorModeNComps[bitmap->mode];
+    rowSize = bitmap->rowSize;
+    for (y = y0; y <= y1; ++y) {
+      if (y == y0) {
+	x = x0;
+      } else if (y == y1) {
+	x = x1;
+      } else {
+	x = splashFloor(sx0 + ((SplashCoord)y - sy0) * dxdy);
+      }
+      if (noClip || state->clip->test(x, y)) {
+	p = &bitmap->data[y * rowSize + nComps * x];
+	switch (nComps) {
+	case 1:
+	  p[0] = color[0];
+	  break;
+	case 2:
+	  p[0] = color[0];
+	  p[1] = color[1];
+	  break;
+	case 3:
+	  p[0] = color[0];
+	  p[1] = color[1];
+	  p[2] = color[2];
+	  break;
+	default:
+	  memcpy(p, color, nComps);
+	  break;
+	}
+	updateModX(x);
+	updateModY(y);
+      }
+    }
+  } else {
+    for (y = y0; y <= y1; ++y) {
+      if (y == y0) {
+	x = x0;
+      } else if (y == y1) {
+	x = x1;
+      } else {
+	x = splashFloor(sx0 + ((SplashCoord)y - sy0) * dxdy);
+      }
+      drawPixel(&span, x, y, noClip);
+    }
+  }
+  return clipRes;
+}
+
+// Draw the anti-aliased hairline from (<sx0>,<sy0>) to (<sx1>,<sy1>)
+// with Wu's algorithm: the line is treated as one pixel wide, and in
+// each column (or row, for steep lines) it crosses, the coverage is
+// split between the two pixels which overlap it.  The end columns are
+// weighted by the part of the column the segment spans.  Returns the
+// clipping status of the segment.
+SplashClipResult Splash::strokeNarrowAASeg(SplashCoord sx0, SplashCoord sy0,
+					   SplashCoord sx1, SplashCoord sy1,
+					   GBool solid, SplashColorPtr color) {
+  SplashSpan span;
+  SplashCoord t, grad, a, b, c, f, w;
+  SplashClipResult clipRes;
+  GBool steep, noClip;
+  int xMinI, yMinI, xMaxI, yMaxI, i0, i1, i, j;
+
+  // the bounding box includes the neighboring pixels
+  xMinI = splashFloor((sx0 < sx1 ? sx0 : sx1) - 0.5);
+  xMaxI = splashFloor((sx0 < sx1 ? sx1 : sx0) + 0.5);
+  yMinI = splashFloor((sy0 < sy1 ? sy0 : sy1) - 0.5);
+  yMaxI = splashFloor((sy0 < sy1 ? sy1 : sy0) + 0.5);
+  if ((clipRes = state->clip->testRect(xMinI, yMinI, xMaxI, yMaxI))
+      == splashClipAllOutside) {
+    return clipRes;
+  }
+  noClip = clipRes == splashClipAllInside;
+
+  if (state->strokePattern->isStatic()) {
+    splashColorCopy(span.color, color);
+    span.pattern = NULL;
+  } else {
+    span.pattern = state->strokePattern;
+  }
+  span.src = NULL;
+  span.alpha = state->strokeAlpha;
+  span.srcAlpha = NULL;
+  span.coverage = span.color;	// (any non-NULL pointer)
+  span.kernel = getSpanKernel(&span);
+
+  // zero-length segment: draw a single pixel, like strokeNarrowSeg
+  if (sx0 == sx1 && sy0 == sy1) {
+    drawAAPixel(splashFloor(sx0), splashFloor(sy0), 255, &span, solid,
+		noClip);
+    return clipRes;
+  }
+
+  // step along the major axis, left to right (top to bottom)
+  steep = splashAbs(sy1 - sy0) > splashAbs(sx1 - sx0);
+  if (steep) {
+    t = sx0; sx0 = sy0; sy0 = t;
+    t = sx1; sx1 = sy1; sy1 = t;
+  }
+  if (sx0 > sx1) {
+    t = sx0; sx0 = sx1; sx1 = t;
+    t = sy0; sy0 = sy1; sy1 = t;
+  }
+  grad = (sy1 - sy0) / (sx1 - sx0);
+  i0 = splashFloor(sx0);
+  i1 = splashFloor(sx1);
+  for (i = i0; i <= i1; ++i) {
+    a = (SplashCoord)i > sx0 ? (SplashCoord)i : sx0;
+    b = (SplashCoord)(i + 1) < sx1 ? (SplashCoord)(i + 1) : sx1;
+    if ((w = b - a) <= 0) {
+      continue;
+    }
+    // top edge of the line, at the middle of the covered part of
+    // the column
+    c = sy0 + ((SplashCoord)0.5 * (a + b) - sx0) * grad - (SplashCoord)0.5;
+    j = splashFloor(c);
+    f = c - j;
+    if (steep) {
+      drawAAPixel(j, i, (int)(w * (1 - f) * 255 + 0.5), &span, solid,
+		  noClip);
+      drawAAPixel(j + 1, i, (int)(w * f * 255 + 0.5), &span, solid,
+		  noClip);
+    } else {
+      drawAAPixel(i, j, (int)(w * (1 - f) * 255 + 0.5), &span, solid,
+		  noClip);
+      drawAAPixel(i, j + 1, (int)(w * f * 255 + 0.5), &span, solid,
+		  noClip);
+    }
+  }
+  return clipRes;
+}
+
+// Draw one pixel of an anti-aliased hairline with coverage <cov> (0
+// to 255).  If <solid> is set, <span>'s color is blended in directly;
+// otherwise this goes through <span>'s kernel.
+inline void Splash::drawAAPixel(int x, int y, int cov, SplashSpan *span,
+				GBool solid, GBool noClip) {
+  SplashColorPtr p;
+  Guchar c;
+  int nComps, i;
+
+  if (cov <= 0 || !(noClip || state->clip->test(x, y))) {
+    return;
+  }
+  updateModX(x);
+  updateModY(y);
+  if (solid) {
+    nComps = splashColorModeNComps[bitmap->mode];
+    p = &bitmap->data[y * bitmap->rowSize + nComps * x];
+    if (cov >= 255) {
+      for (i = 0; i < nComps; ++i) {
+	p[i] = span->color[i];
+      }
+    } else {
+      for (i = 0; i < nComps; ++i) {
+	p[i] = (cov * span->color[i] + (255 - cov) * p[i]) >> 8;
+      }
+    }
+  } else {
+    c = cov > 255 ? 255 : (Guchar)cov;
+    span->x0 = span->x1 = x;
+    span->y = y;
+    span->coverage = &c;
+    (this->*span->kernel)(span);
+  }
+}
+
+// With vector anti-aliasing, the pieces (segments, caps, and joins)
+// are collected into a single path and filled once with the nonzero
+// winding rule: filling them one at a time would blend the partially
+// covered pixels along every seam twice, which shows up as faint lines
+// across wide strokes.  For this to work, every piece must wind the
+// same way (the segment outlines are all clockwise, so the joins are
+// emitted clockwise too).
 void Splash::strokeWide(SplashXPath *xPath) {
   SplashXPathSeg *seg, *seg2;
-  SplashPath *widePath;
+  SplashPath *widePath, *strokePath;
   SplashCoord d, dx, dy, wdx, wdy, dxPrev, dyPrev, wdxPrev, wdyPrev;
   SplashCoord dotprod, miter;
-  int i, j;
+  SplashCoord joinX[3], joinY[3];
+  GBool joinCCW;
+  int nJoin, i, j;
 
   dx = dy = wdx = wdy = 0; // make gcc happy
   dxPrev = dyPrev = wdxPrev = wdyPrev = 0; // make gcc happy
+  widePath = strokePiece;
+  if (vectorAntialias) {
+    strokePath = strokeOutline;
+    strokePath->reset();
+  } else {
+    strokePath = NULL;
+  }
 
   for (i = 0, seg = xPath->segs; i < xPath->length; ++i, ++seg) {
 
@@ -580,7 +927,7 @@ void Splash::strokeWide(SplashXPath *xPath) {
     wdy = (SplashCoord)0.5 * state->lineWidth * dy;
 
     // initialize the path (which will be filled)
-    widePath = new SplashPath();
+    widePath->reset();
     widePath->moveTo(seg->x0 - wdy, seg->y0 + wdx);
 
     // draw the start cap
@@ -628,67 +975,94 @@ void Splash::strokeWide(SplashXPath *xPath) {
     widePath->lineTo(seg->x0 - wdy, seg->y0 + wdx);
 
     // fill the segment
-    fillWithPattern(widePath, gTrue, state->strokePattern, state->strokeAlpha);
-    delete widePath;
+    if (strokePath) {
+      strokePath->append(widePath);
+    } else {
+      fillWithPattern(widePath, gTrue, state->strokePattern,
+		      state->strokeAlpha);
+    }
 
     // draw the line join
     if (!(seg->flags & splashXPathEnd0)) {
-      widePath = NULL;
+      widePath->reset();
+      nJoin = 0;
+      joinCCW = gFalse;
       switch (state->lineJoin) {
       case splashLineJoinMiter:
 	dotprod = -(dx * dxPrev + dy * dyPrev);
-	if (splashAbs(splashAbs(dotprod) - 1) > 0.01) {
-	  widePath = new SplashPath();
-	  widePath->moveTo(seg->x0, seg->y0);
-	  miter = (SplashCoord)2 / ((SplashCoord)1 - dotprod);
-	  if (splashSqrt(miter) <= state->miterLimit) {
-	    miter = splashSqrt(miter - 1);
-	    if (dy * dxPrev > dx * dyPrev) {
-	      widePath->lineTo(seg->x0 + wdyPrev, seg->y0 - wdxPrev);
-	      widePath->lineTo(seg->x0 + wdy - miter * wdx,
-			       seg->y0 - wdx - miter * wdy);
-	      widePath->lineTo(seg->x0 + wdy, seg->y0 - wdx);
-	    } else {
-	      widePath->lineTo(seg->x0 - wdyPrev, seg->y0 + wdxPrev);
-	      widePath->lineTo(seg->x0 - wdy - miter * wdx,
-			       seg->y0 + wdx - miter * wdy);
-	      widePath->lineTo(seg->x0 - wdy, seg->y0 + wdx);
-	    }
+	if (splashAbs(splashAbs(dotprod) - 1) <= 0.01) {
+	  break;
+	}
+	miter = (SplashCoord)2 / ((SplashCoord)1 - dotprod);
+	if (splashSqrt(miter) <= state->miterLimit) {
+	  miter = splashSqrt(miter - 1);
+	  if (dy * dxPrev > dx * dyPrev) {
+	    joinX[0] = seg->x0 + wdyPrev;
+	    joinY[0] = seg->y0 - wdxPrev;
+	    joinX[1] = seg->x0 + wdy - miter * wdx;
+	    joinY[1] = seg->y0 - wdx - miter * wdy;
+	    joinX[2] = seg->x0 + wdy;
+	    joinY[2] = seg->y0 - wdx;
 	  } else {
-	    if (dy * dxPrev > dx * dyPrev) {
-	      widePath->lineTo(seg->x0 + wdyPrev, seg->y0 - wdxPrev);
-	      widePath->lineTo(seg->x0 + wdy, seg->y0 - wdx);
-	    } else {
-	      widePath->lineTo(seg->x0 - wdyPrev, seg->y0 + wdxPrev);
-	      widePath->lineTo(seg->x0 - wdy, seg->y0 + wdx);
-	    }
+	    joinX[0] = seg->x0 - wdyPrev;
+	    joinY[0] = seg->y0 + wdxPrev;
+	    joinX[1] = seg->x0 - wdy - miter * wdx;
+	    joinY[1] = seg->y0 + wdx - miter * wdy;
+	    joinX[2] = seg->x0 - wdy;
+	    joinY[2] = seg->y0 + wdx;
+	    joinCCW = gTrue;
 	  }
+	  nJoin = 3;
+	  break;
+	}
+	// the miter limit was exceeded -- draw a bevel join instead
+      case splashLineJoinBevel:
+	if (dy * dxPrev > dx * dyPrev) {
+	  joinX[0] = seg->x0 + wdyPrev;
+	  joinY[0] = seg->y0 - wdxPrev;
+	  joinX[1] = seg->x0 + wdy;
+	  joinY[1] = seg->y0 - wdx;
+	} else {
+	  joinX[0] = seg->x0 - wdyPrev;
+	  joinY[0] = seg->y0 + wdxPrev;
+	  joinX[1] = seg->x0 - wdy;
+	  joinY[1] = seg->y0 + wdx;
+	  joinCCW = gTrue;
 	}
+	nJoin = 2;
 	break;
       case splashLineJoinRound:
-	widePath = new SplashPath();
 	widePath->moveTo(seg->x0 + wdy, seg->y0 - wdx);
 	widePath->arcCWTo(seg->x0 + wdy, seg->y0 - wdx, seg->x0, seg->y0);
 	break;
-      case splashLineJoinBevel:
-	widePath = new SplashPath();
+      }
+      if (nJoin > 0) {
 	widePath->moveTo(seg->x0, seg->y0);
-	if (dy * dxPrev > dx * dyPrev) {
-	  widePath->lineTo(seg->x0 + wdyPrev, seg->y0 - wdxPrev);
-	  widePath->lineTo(seg->x0 + wdy, seg->y0 - wdx);
+	if (strokePath && joinCCW) {
+	  for (j = nJoin - 1; j >= 0; --j) {
+	    widePath->lineTo(joinX[j], joinY[j]);
+	  }
 	} else {
-	  widePath->lineTo(seg->x0 - wdyPrev, seg->y0 + wdxPrev);
-	  widePath->lineTo(seg->x0 - wdy, seg->y0 + wdx);
+	  for (j = 0; j < nJoin; ++j) {
+	    widePath->lineTo(joinX[j], joinY[j]);
+	  }
 	}
-	break;
       }
-      if (widePath) {
-	fillWithPattern(widePath, gTrue, state->strokePattern,
-			state->strokeAlpha);
-	delete widePath;
+      if (widePath->length > 0) {
+	if (strokePath) {
+	  strokePath->append(widePath);
+	} else {
+	  fillWithPattern(widePath, gTrue, state->strokePattern,
+			  state->strokeAlpha);
+	}
       }
     }
   }
+
+  if (strokePath) {
+    fillWithPattern(strokePath, gFalse, state->strokePattern,
+		    state->strokeAlpha);
+  }
 }
 
 SplashXPath *Splash::makeDashedPath(SplashXPath *xPath) {
@@ -702,7 +1076,8 @@ SplashXPath *Splash::makeDashedPath(SplashXPath *xPath) {
   SplashCoord sx0, sy0, sx1, sy1, ax0, ay0, ax1, ay1, dist;
   int i;
 
-  dPath = new SplashXPath();
+  dPath = dashXPath;
+  dPath->length = 0;
 
   lineDashTotal = 0;
   for (i = 0; i < state->lineDashLength; ++i) {
@@ -814,20 +1189,41 @@ SplashError Splash::fill(SplashPath *path, GBool eo) {
 SplashError Splash::fillWithPattern(SplashPath *path, GBool eo,
 				    SplashPattern *pattern,
 				    SplashCoord alpha) {
+  SplashSpan span;
   SplashXPath *xPath;
   SplashXPathScanner *scanner;
+  SplashCoord rxMin, ryMin, rxMax, ryMax;
+  Guchar *line;
   int xMinI, yMinI, xMaxI, yMaxI, x0, x1, y;
   SplashClipResult clipRes, clipRes2;
+  GBool more;
 
   if (path->length == 0) {
     return splashErrEmptyPath;
   }
-  xPath = new SplashXPath(path, state->flatness, gTrue);
-  xPath->sort();
-  scanner = new SplashXPathScanner(xPath, eo);
 
-  // get the min and max x and y values
-  scanner->getBBox(&xMinI, &yMinI, &xMaxI, &yMaxI);
+  // Axis-aligned rectangles (table cells, backgrounds, rules) are
+  // very common.  The scan converter fills every pixel touched by a
+  // rectangle, i.e., exactly the pixels in its integer bounding box,
+  // so those can skip the expanded path and scanner.  (Anti-aliased
+  // rectangles need partial coverage along their edges, so they go
+  // through the scanner like everything else.)
+  if (!vectorAntialias && path->getRect(&rxMin, &ryMin, &rxMax, &ryMax)) {
+    xPath = NULL;
+    scanner = NULL;
+    xMinI = splashFloor(rxMin);
+    yMinI = splashFloor(ryMin);
+    xMaxI = splashFloor(rxMax);
+    yMaxI = splashFloor(ryMax);
+  } else {
+    xPath = fillXPath;
+    xPath->reset(path, state->flatness, gTrue);
+    xPath->sort();
+    scanner = getFillScanner(xPath, eo);
+
+    // get the min and max x and y values
+    scanner->getBBox(&xMinI, &yMinI, &xMaxI, &yMaxI);
+  }
 
   // check clipping
   if ((clipRes = state->clip->testRect(xMinI, yMinI, xMaxI, yMaxI))
@@ -841,32 +1237,76 @@ SplashError Splash::fillWithPattern(SplashPath *path, GBool eo,
       yMaxI = state->clip->getYMax();
     }
 
+    // draw the anti-aliased rows
+    if (vectorAntialias) {
+      if (xMinI < state->clip->getXMin()) {
+	xMinI = state->clip->getXMin();
+      }
+      if (xMaxI > state->clip->getXMax()) {
+	xMaxI = state->clip->getXMax();
+      }
+      for (y = yMinI; y <= yMaxI; ++y) {
+	scanner->renderAALine(aaBuf + xMinI, xMinI, xMaxI, y, &x0, &x1);
+	if (x0 > x1) {
+	  continue;
+	}
+	line = aaBuf + x0;
+	if (clipRes != splashClipAllInside) {
+	  state->clip->clipAALine(line, x0, x1, y);
+	}
+	drawAALine(line, x0, x1, y, pattern, alpha);
+      }
+
     // draw the spans
-    for (y = yMinI; y <= yMaxI; ++y) {
-      while (scanner->getNextSpan(y, &x0, &x1)) {
-	if (clipRes == splashClipAllInside) {
-	  drawSpan(x0, x1, y, pattern, alpha, gTrue);
+    } else {
+      setSpanPattern(&span, pattern);
+      span.src = NULL;
+      span.alpha = alpha;
+      span.srcAlpha = NULL;
+      span.coverage = NULL;
+      span.kernel = getSpanKernel(&span);
+      for (y = yMinI; y <= yMaxI; ++y) {
+	if (scanner) {
+	  more = scanner->getNextSpan(y, &x0, &x1);
 	} else {
-	  // limit the x range
-	  if (x0 < state->clip->getXMin()) {
-	    x0 = state->clip->getXMin();
-	  }
-	  if (x1 > state->clip->getXMax()) {
-	    x1 = state->clip->getXMax();
+	  x0 = xMinI;
+	  x1 = xMaxI;
+	  more = gTrue;
+	}
+	while (more) {
+	  if (clipRes == splashClipAllInside) {
+	    drawSpanRuns(&span, x0, x1, y, gTrue);
+	  } else {
+	    // limit the x range
+	    if (x0 < state->clip->getXMin()) {
+	      x0 = state->clip->getXMin();
+	    }
+	    if (x1 > state->clip->getXMax()) {
+	      x1 = state->clip->getXMax();
+	    }
+	    clipRes2 = state->clip->testSpan(x0, x1, y);
+	    drawSpanRuns(&span, x0, x1, y, clipRes2 == splashClipAllInside);
 	  }
-	  clipRes2 = state->clip->testSpan(x0, x1, y);
-	  drawSpan(x0, x1, y, pattern, alpha, clipRes2 == splashClipAllInside);
+	  more = scanner && scanner->getNextSpan(y, &x0, &x1);
 	}
       }
     }
   }
   opClipRes = clipRes;
 
-  delete scanner;
-  delete xPath;
   return splashOk;
 }
 
+// Returns the (reused) scanner for fillXPath.
+SplashXPathScanner *Splash::getFillScanner(SplashXPath *xPath, GBool eo) {
+  if (fillScanner) {
+    fillScanner->reset(xPath, eo);
+  } else {
+    fillScanner = new SplashXPathScanner(xPath, eo);
+  }
+  return fillScanner;
+}
+
 SplashError Splash::xorFill(SplashPath *path, GBool eo) {
   SplashXPath *xPath;
   SplashXPathScanner *scanner;
@@ -876,9 +1316,10 @@ SplashError Splash::xorFill(SplashPath *path, GBool eo) {
   if (path->length == 0) {
     return splashErrEmptyPath;
   }
-  xPath = new SplashXPath(path, state->flatness, gTrue);
+  xPath = fillXPath;
+  xPath->reset(path, state->flatness, gTrue);
   xPath->sort();
-  scanner = new SplashXPathScanner(xPath, eo);
+  scanner = getFillScanner(xPath, eo);
 
   // get the min and max x and y values
   scanner->getBBox(&xMinI, &yMinI, &xMaxI, &yMaxI);
@@ -917,897 +1358,752 @@ SplashError Splash::xorFill(SplashPath *path, GBool eo) {
   }
   opClipRes = clipRes;
 
-  delete scanner;
-  delete xPath;
   return splashOk;
 }
 
-void Splash::drawPixel(int x, int y, SplashColorPtr color,
-		       SplashCoord alpha, GBool noClip) {
-  SplashBlendFunc blendFunc;
-  SplashColorPtr p;
-  SplashColor dest, blend;
-  int alpha2, ialpha2;
-  Guchar t;
+SplashError Splash::gouraudTriangle(SplashCoord x0, SplashCoord y0,
+				    SplashColorPtr color0,
+				    SplashCoord x1, SplashCoord y1,
+				    SplashColorPtr color1,
+				    SplashCoord x2, SplashCoord y2,
+				    SplashColorPtr color2) {
+  SplashCoord vx[3], vy[3];
+  SplashCoord vc[3][splashMaxColorComps];
+  int nComps, i;
+
+  vx[0] = x0;  vy[0] = y0;
+  vx[1] = x1;  vy[1] = y1;
+  vx[2] = x2;  vy[2] = y2;
+  nComps = splashColorModeNComps[bitmap->mode];
+  for (i = 0; i < nComps; ++i) {
+    vc[0][i] = color0[i];
+    vc[1][i] = color1[i];
+    vc[2][i] = color2[i];
+  }
+  return gouraudFill(vx, vy, vc, nComps, NULL, 0);
+}
 
-  if (noClip || state->clip->test(x, y)) {
-    if (alpha != 1 || softMask || state->blendFunc) {
-      blendFunc = state->blendFunc ? state->blendFunc : &blendNormal;
-      if (softMask) {
-	alpha2 = (int)(alpha * softMask->data[y * softMask->rowSize + x]);
+SplashError Splash::gouraudTriangle(SplashCoord x0, SplashCoord y0,
+				    SplashCoord t0,
+				    SplashCoord x1, SplashCoord y1,
+				    SplashCoord t1,
+				    SplashCoord x2, SplashCoord y2,
+				    SplashCoord t2,
+				    SplashColor *lookup, int lookupSize) {
+  SplashCoord vx[3], vy[3];
+  SplashCoord vc[3][splashMaxColorComps];
+
+  if (lookupSize < 1) {
+    return splashErrEmptyPath;
+  }
+  vx[0] = x0;  vy[0] = y0;
+  vx[1] = x1;  vy[1] = y1;
+  vx[2] = x2;  vy[2] = y2;
+  vc[0][0] = t0 * (lookupSize - 1);
+  vc[1][0] = t1 * (lookupSize - 1);
+  vc[2][0] = t2 * (lookupSize - 1);
+  return gouraudFill(vx, vy, vc, 1, lookup, lookupSize);
+}
+
+// Scan converts a triangle, one scanline at a time.  A pixel is drawn
+// if any part of it is inside the triangle (the same rule used by
+// fillWithPattern, so adjacent triangles in a mesh don't leave
+// cracks).  Color channels are evaluated at pixel centers from the
+// plane through the three vertices, and are stepped along each span
+// in 16.16 fixed point.
+SplashError Splash::gouraudFill(SplashCoord *vx, SplashCoord *vy,
+				SplashCoord (*vc)[splashMaxColorComps],
+				int nChannels,
+				SplashColor *lookup, int lookupSize) {
+  SplashCoord xMin, yMin, xMax, yMax, det, dx1, dy1, dx2, dy2;
+  SplashCoord dcdx[splashMaxColorComps], dcdy[splashMaxColorComps];
+  SplashCoord c0[splashMaxColorComps];
+  SplashCoord xl, xr, ya, yb, yy0, yy1, xx0, xx1, c, cEnd;
+  int lo[splashMaxColorComps], hi[splashMaxColorComps];
+  int cur[splashMaxColorComps], step[splashMaxColorComps];
+  SplashSpan span;
+  SplashColor pixel;
+  SplashColorPtr color, p;
+  GBool clamp, noClip, direct, found;
+  int xMinI, yMinI, xMaxI, yMaxI, x0, x1, x, y, nComps, i, j, a, b, t;
+  SplashClipResult clipRes, clipRes2;
+
+  if (bitmap->mode == splashModeMono1) {
+    return splashErrModeMismatch;
+  }
+  nComps = splashColorModeNComps[bitmap->mode];
+
+  // get the bounding box
+  xMin = xMax = vx[0];
+  yMin = yMax = vy[0];
+  for (i = 1; i < 3; ++i) {
+    if (vx[i] < xMin) {
+      xMin = vx[i];
+    } else if (vx[i] > xMax) {
+      xMax = vx[i];
+    }
+    if (vy[i] < yMin) {
+      yMin = vy[i];
+    } else if (vy[i] > yMax) {
+      yMax = vy[i];
+    }
+  }
+  xMinI = splashFloor(xMin);
+  yMinI = splashFloor(yMin);
+  xMaxI = splashFloor(xMax);
+  yMaxI = splashFloor(yMax);
+
+  // check clipping
+  if ((clipRes = state->clip->testRect(xMinI, yMinI, xMaxI, yMaxI))
+      == splashClipAllOutside) {
+    opClipRes = clipRes;
+    return splashOk;
+  }
+  if (yMinI < state->clip->getYMin()) {
+    yMinI = state->clip->getYMin();
+  }
+  if (yMaxI > state->clip->getYMax()) {
+    yMaxI = state->clip->getYMax();
+  }
+
+  // compute the color gradient (a degenerate triangle gets the
+  // average of the vertex colors), and the range of each channel --
+  // pixels which are only partly inside the triangle may extrapolate
+  // past the vertex colors, so they get clamped to this range
+  dx1 = vx[1] - vx[0];
+  dy1 = vy[1] - vy[0];
+  dx2 = vx[2] - vx[0];
+  dy2 = vy[2] - vy[0];
+  det = dx1 * dy2 - dx2 * dy1;
+  for (i = 0; i < nChannels; ++i) {
+    if (det != 0) {
+      dcdx[i] = ((vc[1][i] - vc[0][i]) * dy2 - (vc[2][i] - vc[0][i]) * dy1)
+	        / det;
+      dcdy[i] = ((vc[2][i] - vc[0][i]) * dx1 - (vc[1][i] - vc[0][i]) * dx2)
+	        / det;
+      c0[i] = vc[0][i] - dcdx[i] * vx[0] - dcdy[i] * vy[0];
+    } else {
+      dcdx[i] = dcdy[i] = 0;
+      c0[i] = (vc[0][i] + vc[1][i] + vc[2][i]) / 3;
+    }
+    lo[i] = hi[i] = splashRound(vc[0][i] * 65536);
+    for (j = 1; j < 3; ++j) {
+      t = splashRound(vc[j][i] * 65536);
+      if (t < lo[i]) {
+	lo[i] = t;
+      } else if (t > hi[i]) {
+	hi[i] = t;
+      }
+    }
+    if (lookup) {
+      if (lo[i] < 0) {
+	lo[i] = 0;
+      }
+      if (hi[i] > (lookupSize - 1) << 16) {
+	hi[i] = (lookupSize - 1) << 16;
+      }
+    }
+    // slivers can have huge gradients; anything over 4096 per pixel
+    // crosses the whole range in one step anyway
+    if (dcdx[i] > 4096) {
+      step[i] = 4096 << 16;
+    } else if (dcdx[i] < -4096) {
+      step[i] = -4096 << 16;
+    } else {
+      step[i] = splashRound(dcdx[i] * 65536);
+    }
+  }
+
+  direct = state->fillAlpha == 1 && !softMask && !state->blendFunc;
+  color = pixel;
+  span.pattern = NULL;
+  span.src = NULL;
+  span.alpha = state->fillAlpha;
+  span.srcAlpha = NULL;
+  span.coverage = NULL;
+  span.kernel = getSpanKernel(&span);
+
+  for (y = yMinI; y <= yMaxI; ++y) {
+
+    // find the x extent of the triangle within this scanline
+    xl = xr = 0; // make gcc happy
+    found = gFalse;
+    for (i = 0; i < 3; ++i) {
+      a = i;
+      b = (i == 2) ? 0 : i + 1;
+      if (vy[a] > vy[b]) {
+	t = a;  a = b;  b = t;
+      }
+      ya = vy[a];
+      yb = vy[b];
+      if (yb < y || ya > y + 1) {
+	continue;
+      }
+      if (ya == yb) {
+	xx0 = vx[a];
+	xx1 = vx[b];
       } else {
-	alpha2 = (int)(alpha * 255);
-      }
-      ialpha2 = 255 - alpha2;
-      switch (bitmap->mode) {
-      case splashModeMono1:
-	p = &bitmap->data[y * bitmap->rowSize + (x >> 3)];
-	dest[0] = (*p >> (7 - (x & 7))) & 1;
-	(*blendFunc)(color, dest, blend, bitmap->mode);
-	t = (alpha2 * blend[0] + ialpha2 * dest[0]) >> 8;
-	if (t) {
-	  *p |= 0x80 >> (x & 7);
-	} else {
-	  *p &= ~(0x80 >> (x & 7));
+	yy0 = (ya > y) ? ya : (SplashCoord)y;
+	yy1 = (yb < y + 1) ? yb : (SplashCoord)(y + 1);
+	xx0 = vx[a] + (yy0 - ya) * (vx[b] - vx[a]) / (yb - ya);
+	xx1 = vx[a] + (yy1 - ya) * (vx[b] - vx[a]) / (yb - ya);
+      }
+      if (xx0 > xx1) {
+	c = xx0;  xx0 = xx1;  xx1 = c;
+      }
+      if (!found) {
+	xl = xx0;
+	xr = xx1;
+	found = gTrue;
+      } else {
+	if (xx0 < xl) {
+	  xl = xx0;
+	}
+	if (xx1 > xr) {
+	  xr = xx1;
 	}
-	break;
-      case splashModeMono8:
-	p = &bitmap->data[y * bitmap->rowSize + x];
-	(*blendFunc)(color, p, blend, bitmap->mode);
-	// note: floor(x / 255) = x >> 8 (for 16-bit x)
-	p[0] = (alpha2 * blend[0] + ialpha2 * p[0]) >> 8;
-	break;
-      case splashModeAMono8:
-	p = &bitmap->data[y * bitmap->rowSize + 2 * x];
-	(*blendFunc)(color, p, blend, bitmap->mode);
-	p[0] = (alpha2 * blend[0] + ialpha2 * p[0]) >> 8;
-	p[1] = (alpha2 * blend[1] + ialpha2 * p[1]) >> 8;
-	break;
-      case splashModeRGB8:
-      case splashModeBGR8:
-	p = &bitmap->data[y * bitmap->rowSize + 3 * x];
-	(*blendFunc)(color, p, blend, bitmap->mode);
-	p[0] = (alpha2 * blend[0] + ialpha2 * p[0]) >> 8;
-	p[1] = (alpha2 * blend[1] + ialpha2 * p[1]) >> 8;
-	p[2] = (alpha2 * blend[2] + ialpha2 * p[2]) >> 8;
-	break;
-      case splashModeARGB8:
-      case splashModeBGRA8:
-#if SPLASH_CMYK
-      case splashModeCMYK8:
-#endif
-	p = &bitmap->data[y * bitmap->rowSize + 4 * x];
-	(*blendFunc)(color, p, blend, bitmap->mode);
-	p[0] = (alpha2 * blend[0] + ialpha2 * p[0]) >> 8;
-	p[1] = (alpha2 * blend[1] + ialpha2 * p[1]) >> 8;
-	p[2] = (alpha2 * blend[2] + ialpha2 * p[2]) >> 8;
-	p[3] = (alpha2 * blend[3] + ialpha2 * p[3]) >> 8;
-	break;
-#if SPLASH_CMYK
-      case splashModeACMYK8:
-	p = &bitmap->data[y * bitmap->rowSize + 5 * x];
-	(*blendFunc)(color, p, blend, bitmap->mode);
-	p[0] = (alpha2 * blend[0] + ialpha2 * p[0]) >> 8;
-	p[1] = (alpha2 * blend[1] + ialpha2 * p[1]) >> 8;
-	p[2] = (alpha2 * blend[2] + ialpha2 * p[2]) >> 8;
-	p[3] = (alpha2 * blend[3] + ialpha2 * p[3]) >> 8;
-	p[4] = (alpha2 * blend[4] + ialpha2 * p[4]) >> 8;
-	break;
-#endif
       }
+    }
+    if (!found) {
+      continue;
+    }
+    x0 = splashFloor(xl);
+    x1 = splashFloor(xr);
+
+    // clip the span
+    if (clipRes == splashClipAllInside) {
+      noClip = gTrue;
     } else {
-      switch (bitmap->mode) {
-      case splashModeMono1:
-	p = &bitmap->data[y * bitmap->rowSize + (x >> 3)];
-	if (color[0]) {
-	  *p |= 0x80 >> (x & 7);
-	} else {
-	  *p &= ~(0x80 >> (x & 7));
-	}
-	break;
-      case splashModeMono8:
-	p = &bitmap->data[y * bitmap->rowSize + x];
-	p[0] = color[0];
-	break;
-      case splashModeAMono8:
-	p = &bitmap->data[y * bitmap->rowSize + 2 * x];
-	p[0] = color[0];
-	p[1] = color[1];
-	break;
-      case splashModeRGB8:
-      case splashModeBGR8:
-	p = &bitmap->data[y * bitmap->rowSize + 3 * x];
-	p[0] = color[0];
-	p[1] = color[1];
-	p[2] = color[2];
-	break;
-      case splashModeARGB8:
-      case splashModeBGRA8:
-#if SPLASH_CMYK
-      case splashModeCMYK8:
-#endif
-	p = &bitmap->data[y * bitmap->rowSize + 4 * x];
-	p[0] = color[0];
-	p[1] = color[1];
-	p[2] = color[2];
-	p[3] = color[3];
-	break;
-#if SPLASH_CMYK
-      case splashModeACMYK8:
-	p = &bitmap->data[y * bitmap->rowSize + 5 * x];
-	p[0] = color[0];
-	p[1] = color[1];
-	p[2] = color[2];
-	p[3] = color[3];
-	p[4] = color[4];
-	break;
-#endif
+      if (x0 < state->clip->getXMin()) {
+	x0 = state->clip->getXMin();
       }
+      if (x1 > state->clip->getXMax()) {
+	x1 = state->clip->getXMax();
+      }
+      if (x0 > x1) {
+	continue;
+      }
+      clipRes2 = state->clip->testSpan(x0, x1, y);
+      if (clipRes2 == splashClipAllOutside) {
+	continue;
+      }
+      noClip = clipRes2 == splashClipAllInside;
     }
-    updateModX(x);
-    updateModY(y);
-  }
-}
 
-void Splash::drawPixel(int x, int y, SplashPattern *pattern,
-		       SplashCoord alpha, GBool noClip) {
-  SplashBlendFunc blendFunc;
-  SplashColor color;
-  SplashColorPtr p;
-  SplashColor dest, blend;
-  int alpha2, ialpha2;
-  Guchar t;
+    // set up the color stepping -- clamping is only needed if the
+    // span extrapolates out of range at either end
+    clamp = gFalse;
+    for (i = 0; i < nChannels; ++i) {
+      c = (c0[i] + dcdx[i] * (x0 + 0.5) + dcdy[i] * (y + 0.5)) * 65536;
+      cEnd = c + dcdx[i] * (x1 - x0) * 65536;
+      if (c < lo[i] || c > hi[i] || cEnd < lo[i] || cEnd > hi[i]) {
+	clamp = gTrue;
+	if (c < lo[i] - (1 << 28)) {
+	  c = lo[i] - (1 << 28);
+	} else if (c > hi[i] + (1 << 28)) {
+	  c = hi[i] + (1 << 28);
+	}
+      }
+      cur[i] = splashRound(c);
+    }
 
-  if (noClip || state->clip->test(x, y)) {
-    if (alpha != 1 || softMask || state->blendFunc) {
-      blendFunc = state->blendFunc ? state->blendFunc : &blendNormal;
-      pattern->getColor(x, y, color);
-      if (softMask) {
-	alpha2 = (int)(alpha * softMask->data[y * softMask->rowSize + x]);
+    p = &bitmap->data[y * bitmap->rowSize + nComps * x0];
+    for (x = x0; x <= x1; ++x, p += nComps) {
+      if (clamp) {
+	for (i = 0; i < nChannels; ++i) {
+	  t = cur[i] < lo[i] ? lo[i] : cur[i] > hi[i] ? hi[i] : cur[i];
+	  if (lookup) {
+	    color = lookup[(t + 0x8000) >> 16];
+	  } else {
+	    pixel[i] = (Guchar)((t + 0x8000) >> 16);
+	  }
+	  // the value changes monotonically along the span, so once it
+	  // has moved past the range it can stay there
+	  cur[i] += step[i];
+	  if (step[i] > 0 && cur[i] > hi[i]) {
+	    cur[i] = hi[i];
+	  } else if (step[i] < 0 && cur[i] < lo[i]) {
+	    cur[i] = lo[i];
+	  }
+	}
       } else {
-	alpha2 = (int)(alpha * 255);
-      }
-      ialpha2 = 255 - alpha2;
-      switch (bitmap->mode) {
-      case splashModeMono1:
-	p = &bitmap->data[y * bitmap->rowSize + (x >> 3)];
-	dest[0] = (*p >> (7 - (x & 7))) & 1;
-	(*blendFunc)(color, dest, blend, bitmap->mode);
-	t = (alpha2 * blend[0] + ialpha2 * dest[0]) >> 8;
-	if (t) {
-	  *p |= 0x80 >> (x & 7);
-	} else {
-	  *p &= ~(0x80 >> (x & 7));
+	for (i = 0; i < nChannels; ++i) {
+	  if (lookup) {
+	    color = lookup[(cur[i] + 0x8000) >> 16];
+	  } else {
+	    pixel[i] = (Guchar)((cur[i] + 0x8000) >> 16);
+	  }
+	  cur[i] += step[i];
 	}
-	break;
-      case splashModeMono8:
-	p = &bitmap->data[y * bitmap->rowSize + x];
-	(*blendFunc)(color, p, blend, bitmap->mode);
-	// note: floor(x / 255) = x >> 8 (for 16-bit x)
-	p[0] = (alpha2 * blend[0] + ialpha2 * p[0]) >> 8;
-	break;
-      case splashModeAMono8:
-	p = &bitmap->data[y * bitmap->rowSize + 2 * x];
-	(*blendFunc)(color, p, blend, bitmap->mode);
-	p[0] = (alpha2 * blend[0] + ialpha2 * p[0]) >> 8;
-	p[1] = (alpha2 * blend[1] + ialpha2 * p[1]) >> 8;
-	break;
-      case splashModeRGB8:
-      case splashModeBGR8:
-	p = &bitmap->data[y * bitmap->rowSize + 3 * x];
-	(*blendFunc)(color, p, blend, bitmap->mode);
-	p[0] = (alpha2 * blend[0] + ialpha2 * p[0]) >> 8;
-	p[1] = (alpha2 * blend[1] + ialpha2 * p[1]) >> 8;
-	p[2] = (alpha2 * blend[2] + ialpha2 * p[2]) >> 8;
-	break;
-      case splashModeARGB8:
-      case splashModeBGRA8:
-#if SPLASH_CMYK
-      case splashModeCMYK8:
-#endif
-	p = &bitmap->data[y * bitmap->rowSize + 4 * x];
-	(*blendFunc)(color, p, blend, bitmap->mode);
-	p[0] = (alpha2 * blend[0] + ialpha2 * p[0]) >> 8;
-	p[1] = (alpha2 * blend[1] + ialpha2 * p[1]) >> 8;
-	p[2] = (alpha2 * blend[2] + ialpha2 * p[2]) >> 8;
-	p[3] = (alpha2 * blend[3] + ialpha2 * p[3]) >> 8;
-	break;
-#if SPLASH_CMYK
-      case splashModeACMYK8:
-	p = &bitmap->data[y * bitmap->rowSize + 5 * x];
-	(*blendFunc)(color, p, blend, bitmap->mode);
-	p[0] = (alpha2 * blend[0] + ialpha2 * p[0]) >> 8;
-	p[1] = (alpha2 * blend[1] + ialpha2 * p[1]) >> 8;
-	p[2] = (alpha2 * blend[2] + ialpha2 * p[2]) >> 8;
-	p[3] = (alpha2 * blend[3] + ialpha2 * p[3]) >> 8;
-	p[4] = (alpha2 * blend[4] + ialpha2 * p[4]) >> 8;
-	break;
-#endif
       }
-    } else {
-      pattern->getColor(x, y, color);
-      switch (bitmap->mode) {
-      case splashModeMono1:
-	p = &bitmap->data[y * bitmap->rowSize + (x >> 3)];
-	if (color[0]) {
-	  *p |= 0x80 >> (x & 7);
+      if (noClip || state->clip->test(x, y)) {
+	if (direct) {
+	  for (i = 0; i < nComps; ++i) {
+	    p[i] = color[i];
+	  }
 	} else {
-	  *p &= ~(0x80 >> (x & 7));
+	  splashColorCopy(span.color, color);
+	  drawPixel(&span, x, y, gTrue);
 	}
-	break;
-      case splashModeMono8:
-	p = &bitmap->data[y * bitmap->rowSize + x];
-	p[0] = color[0];
-	break;
-      case splashModeAMono8:
-	p = &bitmap->data[y * bitmap->rowSize + 2 * x];
-	p[0] = color[0];
-	p[1] = color[1];
-	break;
-      case splashModeRGB8:
-      case splashModeBGR8:
-	p = &bitmap->data[y * bitmap->rowSize + 3 * x];
-	p[0] = color[0];
-	p[1] = color[1];
-	p[2] = color[2];
-	break;
-      case splashModeARGB8:
-      case splashModeBGRA8:
-#if SPLASH_CMYK
-      case splashModeCMYK8:
-#endif
-	p = &bitmap->data[y * bitmap->rowSize + 4 * x];
-	p[0] = color[0];
-	p[1] = color[1];
-	p[2] = color[2];
-	p[3] = color[3];
-	break;
-#if SPLASH_CMYK
-      case splashModeACMYK8:
-	p = &bitmap->data[y * bitmap->rowSize + 5 * x];
-	p[0] = color[0];
-	p[1] = color[1];
-	p[2] = color[2];
-	p[3] = color[3];
-	p[4] = color[4];
-	break;
-#endif
       }
     }
+    updateModX(x0);
+    updateModX(x1);
+    updateModY(y);
+  }
+  opClipRes = clipRes;
+
+  return splashOk;
+}
+
+// Draw pixel (<x>, <y>) with <span>'s kernel.
+inline void Splash::drawPixel(SplashSpan *span, int x, int y,
+			      GBool noClip) {
+  if (noClip || state->clip->test(x, y)) {
+    span->x0 = span->x1 = x;
+    span->y = y;
+    (this->*span->kernel)(span);
     updateModX(x);
     updateModY(y);
   }
 }
 
-void Splash::drawSpan(int x0, int x1, int y, SplashPattern *pattern,
-		      SplashCoord alpha, GBool noClip) {
-  SplashBlendFunc blendFunc;
-  SplashColor color;
-  SplashColorPtr p;
-  SplashColor dest, blend;
-  Guchar mask, t;
-  int alpha2, ialpha2;
-  int i, j, n;
+// Pick the kernel for <span>, given the bitmap's color mode and the
+// current state.  Each kernel handles one case, so that the pixel
+// loops don't test anything per pixel:
+//   - spanSolid*:     opaque static color
+//   - spanCopy*:      opaque pattern or pixel row
+//   - spanCoverage:   opaque static color with coverage
+//   - spanBlendSolid: static color with constant alpha and/or soft
+//                     mask, normal blend mode
+//   - spanBlend:      anything else in the normal blend mode
+//   - spanBlendFunc:  other blend modes
+//   - spanBlendMono1: any non-opaque span on a Mono1 bitmap
+// The solid, coverage, and blend kernels use the vector pixel loops
+// in SplashKernels.
+Splash::SpanKernel Splash::getSpanKernel(SplashSpan *span) {
+  GBool opaque, isStatic;
+
+  opaque = span->alpha == 1 && !span->srcAlpha && !softMask &&
+           !state->blendFunc;
+  isStatic = !span->pattern && !span->src;
+  if (bitmap->mode == splashModeMono1) {
+    if (!opaque) {
+      return &Splash::spanBlendMono1;
+    }
+    return isStatic ? &Splash::spanSolidMono1 : &Splash::spanCopyMono1;
+  }
+  if (state->blendFunc) {
+    return &Splash::spanBlendFunc;
+  }
+  if (span->coverage) {
+    return (opaque && isStatic) ? &Splash::spanCoverage : &Splash::spanBlend;
+  }
+  if (opaque) {
+    return isStatic ? &Splash::spanSolid : &Splash::spanCopy;
+  }
+  if (isStatic && !span->srcAlpha) {
+    return &Splash::spanBlendSolid;
+  }
+  return &Splash::spanBlend;
+}
 
-  n = x1 - x0 + 1;
+// Draw <span> with its kernel.  Unless <noClip> is set, it is first
+// cut into the runs which are visible through the clip region
+// (SplashClip::getSpans).
+void Splash::drawSpanRuns(SplashSpan *span, GBool noClip) {
+  SplashSpan run;
+  int *spans;
+  int nSpans, d, i;
 
   if (noClip) {
-    updateModX(x0);
-    updateModX(x1);
-    updateModY(y);
+    updateModX(span->x0);
+    updateModX(span->x1);
+    updateModY(span->y);
+    if (span->x0 <= span->x1) {
+      (this->*span->kernel)(span);
+    }
+    return;
   }
 
-  if (alpha != 1 || softMask || state->blendFunc) {
-    blendFunc = state->blendFunc ? state->blendFunc : &blendNormal;
-    if (softMask) {
-      alpha2 = ialpha2 = 0; // make gcc happy
-    } else {
-      alpha2 = (int)(alpha * 255);
-      ialpha2 = 255 - alpha2;
-    }
-    switch (bitmap->mode) {
-    case splashModeMono1:
-      p = &bitmap->data[y * bitmap->rowSize + (x0 >> 3)];
-      i = 0;
-      if (pattern->isStatic()) {
-	pattern->getColor(0, 0, color);
-	if ((j = x0 & 7)) {
-	  mask = 0x80 >> j;
-	  for (; j < 8 && i < n; ++i, ++j) {
-	    if (noClip || state->clip->test(x0 + i, y)) {
-	      if (softMask) {
-		alpha2 = (int)(alpha *
-			       softMask->data[y * softMask->rowSize + x0 + i]);
-		ialpha2 = 255 - alpha2;
-	      }
-	      dest[0] = (*p >> (7 - j)) & 1;
-	      (*blendFunc)(color, dest, blend, bitmap->mode);
-	      t = (alpha2 * blend[0] + ialpha2 * dest[0]) >> 8;
-	      if (t) {
-		*p |= mask;
-	      } else {
-		*p &= ~mask;
-	      }
-	      if (!noClip) {
-		updateModX(x0 + i);
-		updateModY(y);
-	      }
-	    }
-	    mask >>= 1;
-	  }
-	  ++p;
+  run = *span;
+  spans = state->clip->getSpans(span->y, &nSpans);
+  for (i = 0; i < nSpans && spans[2*i] <= span->x1; ++i) {
+    if (spans[2*i+1] >= span->x0) {
+      run.x0 = spans[2*i] > span->x0 ? spans[2*i] : span->x0;
+      run.x1 = spans[2*i+1] < span->x1 ? spans[2*i+1] : span->x1;
+      if ((d = run.x0 - span->x0) > 0) {
+	if (span->src) {
+	  run.src = span->src + d * splashColorModeNComps[bitmap->mode];
 	}
-	while (i < n) {
-	  mask = 0x80;
-	  for (j = 0; j < 8 && i < n; ++i, ++j) {
-	    if (noClip || state->clip->test(x0 + i, y)) {
-	      if (softMask) {
-		alpha2 = (int)(alpha *
-			       softMask->data[y * softMask->rowSize + x0 + i]);
-		ialpha2 = 255 - alpha2;
-	      }
-	      dest[0] = (*p >> (7 - j)) & 1;
-	      (*blendFunc)(color, dest, blend, bitmap->mode);
-	      t = (alpha2 * blend[0] + ialpha2 * dest[0]) >> 8;
-	      if (t) {
-		*p |= mask;
-	      } else {
-		*p &= ~mask;
-	      }
-	      if (!noClip) {
-		updateModX(x0 + i);
-		updateModY(y);
-	      }
-	    }
-	    mask >>= 1;
-	  }
-	  ++p;
+	if (span->srcAlpha) {
+	  run.srcAlpha = span->srcAlpha + d;
 	}
-      } else {
-	if ((j = x0 & 7)) {
-	  mask = 0x80 >> j;
-	  for (; j < 8 && i < n; ++i, ++j) {
-	    if (noClip || state->clip->test(x0 + i, y)) {
-	      pattern->getColor(x0 + i, y, color);
-	      if (softMask) {
-		alpha2 = (int)(alpha *
-			       softMask->data[y * softMask->rowSize + x0 + i]);
-		ialpha2 = 255 - alpha2;
-	      }
-	      dest[0] = (*p >> (7 - j)) & 1;
-	      (*blendFunc)(color, dest, blend, bitmap->mode);
-	      t = (alpha2 * blend[0] + ialpha2 * dest[0]) >> 8;
-	      if (t) {
-		*p |= mask;
-	      } else {
-		*p &= ~mask;
-	      }
-	      if (!noClip) {
-		updateModX(x0 + i);
-		updateModY(y);
-	      }
-	    }
-	    mask >>= 1;
-	  }
-	  ++p;
-	}
-	while (i < n) {
-	  mask = 0x80;
-	  for (j = 0; j < 8 && i < n; ++i, ++j) {
-	    if (noClip || state->clip->test(x0 + i, y)) {
-	      pattern->getColor(x0 + i, y, color);
-	      if (softMask) {
-		alpha2 = (int)(alpha *
-			       softMask->data[y * softMask->rowSize + x0 + i]);
-		ialpha2 = 255 - alpha2;
-	      }
-	      dest[0] = (*p >> (7 - j)) & 1;
-	      (*blendFunc)(color, dest, blend, bitmap->mode);
-	      t = (alpha2 * blend[0] + ialpha2 * dest[0]) >> 8;
-	      if (t) {
-		*p |= mask;
-	      } else {
-		*p &= ~mask;
-	      }
-	      if (!noClip) {
-		updateModX(x0 + i);
-		updateModY(y);
-	      }
-	    }
-	    mask >>= 1;
-	  }
-	  ++p;
+	if (span->coverage) {
+	  run.coverage = span->coverage + d;
 	}
       }
-      break;
-
-    case splashModeMono8:
-      p = &bitmap->data[y * bitmap->rowSize + x0];
-      if (pattern->isStatic()) {
-	pattern->getColor(0, 0, color);
-	for (i = 0; i < n; ++i) {
-	  if (noClip || state->clip->test(x0 + i, y)) {
-	    if (softMask) {
-	      alpha2 = (int)(alpha *
-			     softMask->data[y * softMask->rowSize + x0 + i]);
-	      ialpha2 = 255 - alpha2;
-	    }
-	    (*blendFunc)(color, p, blend, bitmap->mode);
-	    *p = (alpha2 * blend[0] + ialpha2 * *p) >> 8;
-	    if (!noClip) {
-	      updateModX(x0 + i);
-	      updateModY(y);
-	    }
-	  }
-	  ++p;
-	}
-      } else {
-	for (i = 0; i < n; ++i) {
-	  if (noClip || state->clip->test(x0 + i, y)) {
-	    pattern->getColor(x0 + i, y, color);
-	    if (softMask) {
-	      alpha2 = (int)(alpha *
-			     softMask->data[y * softMask->rowSize + x0 + i]);
-	      ialpha2 = 255 - alpha2;
-	    }
-	    (*blendFunc)(color, p, blend, bitmap->mode);
-	    *p = (alpha2 * blend[0] + ialpha2 * *p) >> 8;
-	    if (!noClip) {
-	      updateModX(x0 + i);
-	      updateModY(y);
-	    }
-	  }
-	  ++p;
-	}
+      updateModX(run.x0);
+      updateModX(run.x1);
+      updateModY(run.y);
+      if (run.x0 <= run.x1) {
+	(this->*run.kernel)(&run);
       }
-      break;
+    }
+  }
+}
 
-    case splashModeAMono8:
-      p = &bitmap->data[y * bitmap->rowSize + 2 * x0];
-      if (pattern->isStatic()) {
-	pattern->getColor(0, 0, color);
-	for (i = 0; i < n; ++i) {
-	  if (noClip || state->clip->test(x0 + i, y)) {
-	    if (softMask) {
-	      alpha2 = (int)(alpha *
-			     softMask->data[y * softMask->rowSize + x0 + i]);
-	      ialpha2 = 255 - alpha2;
-	    }
-	    (*blendFunc)(color, p, blend, bitmap->mode);
-	    p[0] = (alpha2 * blend[0] + ialpha2 * p[0]) >> 8;
-	    p[1] = (alpha2 * blend[1] + ialpha2 * p[1]) >> 8;
-	    if (!noClip) {
-	      updateModX(x0 + i);
-	      updateModY(y);
-	    }
-	  }
-	  p += 2;
-	}
-      } else {
-	for (i = 0; i < n; ++i) {
-	  if (noClip || state->clip->test(x0 + i, y)) {
-	    pattern->getColor(x0 + i, y, color);
-	    if (softMask) {
-	      alpha2 = (int)(alpha *
-			     softMask->data[y * softMask->rowSize + x0 + i]);
-	      ialpha2 = 255 - alpha2;
-	    }
-	    (*blendFunc)(color, p, blend, bitmap->mode);
-	    p[0] = (alpha2 * blend[0] + ialpha2 * p[0]) >> 8;
-	    p[1] = (alpha2 * blend[1] + ialpha2 * p[1]) >> 8;
-	    if (!noClip) {
-	      updateModX(x0 + i);
-	      updateModY(y);
-	    }
-	  }
-	  p += 2;
-	}
-      }
-      break;
+// Draw pixels [<x0>, <x1>] on row <y> with <span>'s kernel.
+void Splash::drawSpanRuns(SplashSpan *span, int x0, int x1, int y,
+			  GBool noClip) {
+  span->x0 = x0;
+  span->x1 = x1;
+  span->y = y;
+  drawSpanRuns(span, noClip);
+}
 
-    case splashModeRGB8:
-    case splashModeBGR8:
-      p = &bitmap->data[y * bitmap->rowSize + 3 * x0];
-      if (pattern->isStatic()) {
-	pattern->getColor(0, 0, color);
-	for (i = 0; i < n; ++i) {
-	  if (noClip || state->clip->test(x0 + i, y)) {
-	    if (softMask) {
-	      alpha2 = (int)(alpha *
-			     softMask->data[y * softMask->rowSize + x0 + i]);
-	      ialpha2 = 255 - alpha2;
-	    }
-	    (*blendFunc)(color, p, blend, bitmap->mode);
-	    p[0] = (alpha2 * blend[0] + ialpha2 * p[0]) >> 8;
-	    p[1] = (alpha2 * blend[1] + ialpha2 * p[1]) >> 8;
-	    p[2] = (alpha2 * blend[2] + ialpha2 * p[2]) >> 8;
-	    if (!noClip) {
-	      updateModX(x0 + i);
-	      updateModY(y);
-	    }
-	  }
-	  p += 3;
-	}
-      } else {
-	for (i = 0; i < n; ++i) {
-	  if (noClip || state->clip->test(x0 + i, y)) {
-	    pattern->getColor(x0 + i, y, color);
-	    if (softMask) {
-	      alpha2 = (int)(alpha *
-			     softMask->data[y * softMask->rowSize + x0 + i]);
-	      ialpha2 = 255 - alpha2;
-	    }
-	    (*blendFunc)(color, p, blend, bitmap->mode);
-	    p[0] = (alpha2 * blend[0] + ialpha2 * p[0]) >> 8;
-	    p[1] = (alpha2 * blend[1] + ialpha2 * p[1]) >> 8;
-	    p[2] = (alpha2 * blend[2] + ialpha2 * p[2]) >> 8;
-	    if (!noClip) {
-	      updateModX(x0 + i);
-	      updateModY(y);
-	    }
-	  }
-	  p += 3;
-	}
-      }
-      break;
+// Draw an anti-aliased row: <line> holds the coverage of pixels
+// [<x0>,<x1>], already scaled by the clip region.  Fully covered runs
+// are drawn as plain spans; partially covered runs scale the alpha by
+// the coverage.
+void Splash::drawAALine(Guchar *line, int x0, int x1, int y,
+			SplashPattern *pattern, SplashCoord alpha) {
+  SplashSpan span, fullSpan;
+  int x, xx;
+
+  span.y = y;
+  setSpanPattern(&span, pattern);
+  span.src = NULL;
+  span.alpha = alpha;
+  span.srcAlpha = NULL;
+  span.coverage = line;
+  span.kernel = getSpanKernel(&span);
+  fullSpan = span;
+  fullSpan.coverage = NULL;
+  fullSpan.kernel = getSpanKernel(&fullSpan);
+  x = x0;
+  while (x <= x1) {
+    if (line[x - x0] == 0) {
+      ++x;
+    } else if (line[x - x0] == 255) {
+      for (xx = x + 1; xx <= x1 && line[xx - x0] == 255; ++xx) ;
+      fullSpan.x0 = x;
+      fullSpan.x1 = xx - 1;
+      drawSpanRuns(&fullSpan, gTrue);
+      x = xx;
+    } else {
+      for (xx = x + 1;
+	   xx <= x1 && line[xx - x0] != 0 && line[xx - x0] != 255;
+	   ++xx) ;
+      span.x0 = x;
+      span.x1 = xx - 1;
+      span.coverage = line + (x - x0);
+      drawSpanRuns(&span, gTrue);
+      x = xx;
+    }
+  }
+}
 
-    case splashModeARGB8:
-    case splashModeBGRA8:
-#if SPLASH_CMYK
-    case splashModeCMYK8:
-#endif
-      p = &bitmap->data[y * bitmap->rowSize + 4 * x0];
-      if (pattern->isStatic()) {
-	pattern->getColor(0, 0, color);
-	for (i = 0; i < n; ++i) {
-	  if (noClip || state->clip->test(x0 + i, y)) {
-	    if (softMask) {
-	      alpha2 = (int)(alpha *
-			     softMask->data[y * softMask->rowSize + x0 + i]);
-	      ialpha2 = 255 - alpha2;
-	    }
-	    (*blendFunc)(color, p, blend, bitmap->mode);
-	    p[0] = (alpha2 * blend[0] + ialpha2 * p[0]) >> 8;
-	    p[1] = (alpha2 * blend[1] + ialpha2 * p[1]) >> 8;
-	    p[2] = (alpha2 * blend[2] + ialpha2 * p[2]) >> 8;
-	    p[3] = (alpha2 * blend[3] + ialpha2 * p[3]) >> 8;
-	    if (!noClip) {
-	      updateModX(x0 + i);
-	      updateModY(y);
-	    }
-	  }
-	  p += 4;
-	}
-      } else {
-	for (i = 0; i < n; ++i) {
-	  if (noClip || state->clip->test(x0 + i, y)) {
-	    pattern->getColor(x0 + i, y, color);
-	    if (softMask) {
-	      alpha2 = (int)(alpha *
-			     softMask->data[y * softMask->rowSize + x0 + i]);
-	      ialpha2 = 255 - alpha2;
-	    }
-	    (*blendFunc)(color, p, blend, bitmap->mode);
-	    p[0] = (alpha2 * blend[0] + ialpha2 * p[0]) >> 8;
-	    p[1] = (alpha2 * blend[1] + ialpha2 * p[1]) >> 8;
-	    p[2] = (alpha2 * blend[2] + ialpha2 * p[2]) >> 8;
-	    p[3] = (alpha2 * blend[3] + ialpha2 * p[3]) >> 8;
-	    if (!noClip) {
-	      updateModX(x0 + i);
-	      updateModY(y);
-	    }
-	  }
-	  p += 4;
-	}
-      }
-      break;
-#if SPLASH_CMYK
-    case splashModeACMYK8:
-      p = &bitmap->data[y * bitmap->rowSize + 5 * x0];
-      if (pattern->isStatic()) {
-	pattern->getColor(0, 0, color);
-	for (i = 0; i < n; ++i) {
-	  if (noClip || state->clip->test(x0 + i, y)) {
-	    if (softMask) {
-	      alpha2 = (int)(alpha *
-			     softMask->data[y * softMask->rowSize + x0 + i]);
-	      ialpha2 = 255 - alpha2;
-	    }
-	    (*blendFunc)(color, p, blend, bitmap->mode);
-	    p[0] = (alpha2 * blend[0] + ialpha2 * p[0]) >> 8;
-	    p[1] = (alpha2 * blend[1] + ialpha2 * p[1]) >> 8;
-	    p[2] = (alpha2 * blend[2] + ialpha2 * p[2]) >> 8;
-	    p[3] = (alpha2 * blend[3] + ialpha2 * p[3]) >> 8;
-	    p[4] = (alpha2 * blend[4] + ialpha2 * p[4]) >> 8;
-	    if (!noClip) {
-	      updateModX(x0 + i);
-	      updateModY(y);
-	    }
-	  }
-	  p += 4;
-	}
-      } else {
-	for (i = 0; i < n; ++i) {
-	  if (noClip || state->clip->test(x0 + i, y)) {
-	    pattern->getColor(x0 + i, y, color);
-	    if (softMask) {
-	      alpha2 = (int)(alpha *
-			     softMask->data[y * softMask->rowSize + x0 + i]);
-	      ialpha2 = 255 - alpha2;
-	    }
-	    (*blendFunc)(color, p, blend, bitmap->mode);
-	    p[0] = (alpha2 * blend[0] + ialpha2 * p[0]) >> 8;
-	    p[1] = (alpha2 * blend[1] + ialpha2 * p[1]) >> 8;
-	    p[2] = (alpha2 * blend[2] + ialpha2 * p[2]) >> 8;
-	    p[3] = (alpha2 * blend[3] + ialpha2 * p[3]) >> 8;
-	    p[4] = (alpha2 * blend[4] + ialpha2 * p[4]) >> 8;
-	    if (!noClip) {
-	      updateModX(x0 + i);
-	      updateModY(y);
-	    }
-	  }
-	  p += 4;
-	}
-      }
-      break;
-#endif
+// Get the colors of the <n> pixels starting at <x> in <span>, which
+// must not be static.  Returns a pointer into the span's pixel row, or
+// <buf>, which must have room for splashKernelChunk pixels plus one
+// SplashColor.
+inline SplashColorPtr Splash::getSpanColors(SplashSpan *span, int x, int n,
+					    SplashColorPtr buf) {
+  int nComps, i;
+
+  nComps = splashColorModeNComps[bitmap->mode];
+  if (span->src) {
+    return span->src + (x - span->x0) * nComps;
+  }
+  // getColor may write a full SplashColor: fill in order, so the
+  // extra bytes are overwritten by the next pixel
+  for (i = 0; i < n; ++i) {
+    span->pattern->getColor(x + i, span->y, buf + i * nComps);
+  }
+  return buf;
+}
+
+// Compute the alpha of the <n> pixels starting at <x> in <span>:
+// span (or source pixel) alpha, times the soft mask, times the
+// coverage.
+inline void Splash::getSpanAlpha(SplashSpan *span, int x, int n,
+				 Guchar *buf) {
+  SplashCoord *a;
+  Guchar *q, *cov;
+  int alpha1, alpha2, i;
+
+  q = softMask ? &softMask->data[span->y * softMask->rowSize + x] : NULL;
+  a = span->srcAlpha ? span->srcAlpha + (x - span->x0) : NULL;
+  cov = span->coverage ? span->coverage + (x - span->x0) : NULL;
+  if (!q && !a) {
+    alpha1 = (int)(span->alpha * 255);
+    if (!cov) {
+      memset(buf, alpha1, n);
+      return;
+    }
+    for (i = 0; i < n; ++i) {
+      // div255(alpha * coverage)
+      alpha2 = alpha1 * cov[i] + 128;
+      buf[i] = (alpha2 + (alpha2 >> 8)) >> 8;
+    }
+    return;
+  }
+  for (i = 0; i < n; ++i) {
+    if (q) {
+      alpha1 = (int)((a ? a[i] : span->alpha) * q[i]);
+    } else {
+      alpha1 = (int)(a[i] * 255);
     }
+    if (cov) {
+      alpha2 = alpha1 * cov[i] + 128;
+      alpha1 = (alpha2 + (alpha2 >> 8)) >> 8;
+    }
+    buf[i] = (Guchar)alpha1;
+  }
+}
 
+void Splash::spanSolidMono1(SplashSpan *span) {
+  SplashColorPtr p;
+  Guchar mask0, mask1, fill;
+  int nBytes;
+
+  p = &bitmap->data[span->y * bitmap->rowSize + (span->x0 >> 3)];
+  mask0 = 0xff >> (span->x0 & 7);
+  mask1 = 0xff << (7 - (span->x1 & 7));
+  fill = span->color[0] ? 0xff : 0x00;
+  nBytes = (span->x1 >> 3) - (span->x0 >> 3);
+  if (nBytes == 0) {
+    mask0 &= mask1;
+    *p = (*p & ~mask0) | (fill & mask0);
   } else {
-    switch (bitmap->mode) {
-    case splashModeMono1:
-      p = &bitmap->data[y * bitmap->rowSize + (x0 >> 3)];
-      i = 0;
-      if (pattern->isStatic()) {
-	pattern->getColor(0, 0, color);
-	if ((j = x0 & 7)) {
-	  mask = 0x80 >> j;
-	  for (; j < 8 && i < n; ++i, ++j) {
-	    if (noClip || state->clip->test(x0 + i, y)) {
-	      if (color[0]) {
-		*p |= mask;
-	      } else {
-		*p &= ~mask;
-	      }
-	      if (!noClip) {
-		updateModX(x0 + i);
-		updateModY(y);
-	      }
-	    }
-	    mask >>= 1;
-	  }
-	  ++p;
-	}
-	while (i < n) {
-	  mask = 0x80;
-	  for (j = 0; j < 8 && i < n; ++i, ++j) {
-	    if (noClip || state->clip->test(x0 + i, y)) {
-	      if (color[0]) {
-		*p |= mask;
-	      } else {
-		*p &= ~mask;
-	      }
-	      if (!noClip) {
-		updateModX(x0 + i);
-		updateModY(y);
-	      }
-	    }
-	    mask >>= 1;
-	  }
-	  ++p;
-	}
-      } else {
-	if ((j = x0 & 7)) {
-	  mask = 0x80 >> j;
-	  for (; j < 8 && i < n; ++i, ++j) {
-	    if (noClip || state->clip->test(x0 + i, y)) {
-	      pattern->getColor(x0 + i, y, color);
-	      if (color[0]) {
-		*p |= mask;
-	      } else {
-		*p &= ~mask;
-	      }
-	      if (!noClip) {
-		updateModX(x0 + i);
-		updateModY(y);
-	      }
-	    }
-	    mask >>= 1;
-	  }
-	  ++p;
-	}
-	while (i < n) {
-	  mask = 0x80;
-	  for (j = 0; j < 8 && i < n; ++i, ++j) {
-	    if (noClip || state->clip->test(x0 + i, y)) {
-	      pattern->getColor(x0 + i, y, color);
-	      if (color[0]) {
-		*p |= mask;
-	      } else {
-		*p &= ~mask;
-	      }
-	      if (!noClip) {
-		updateModX(x0 + i);
-		updateModY(y);
-	      }
-	    }
-	    mask >>= 1;
-	  }
-	  ++p;
-	}
-      }
-      break;
+    *p = (*p & ~mask0) | (fill & mask0);
+    memset(p + 1, fill, nBytes - 1);
+    p += nBytes;
+    *p = (*p & ~mask1) | (fill & mask1);
+  }
+}
 
-    case splashModeMono8:
-      p = &bitmap->data[y * bitmap->rowSize + x0];
-      if (pattern->isStatic()) {
-	pattern->getColor(0, 0, color);
-	for (i = 0; i < n; ++i) {
-	  if (noClip || state->clip->test(x0 + i, y)) {
-	    *p = color[0];
-	    if (!noClip) {
-	      updateModX(x0 + i);
-	      updateModY(y);
-	    }
-	  }
-	  ++p;
-	}
-      } else {
-	for (i = 0; i < n; ++i) {
-	  if (noClip || state->clip->test(x0 + i, y)) {
-	    pattern->getColor(x0 + i, y, color);
-	    *p = color[0];
-	    if (!noClip) {
-	      updateModX(x0 + i);
-	      updateModY(y);
-	    }
-	  }
-	  ++p;
-	}
-      }
-      break;
+void Splash::spanSolid(SplashSpan *span) {
+  SplashColorPtr p;
+  int nComps, n, i, j;
 
-    case splashModeAMono8:
-      p = &bitmap->data[y * bitmap->rowSize + 2 * x0];
-      if (pattern->isStatic()) {
-	pattern->getColor(0, 0, color);
-	for (i = 0; i < n; ++i) {
-	  if (noClip || state->clip->test(x0 + i, y)) {
-	    p[0] = color[0];
-	    p[1] = color[1];
-	    if (!noClip) {
-	      updateModX(x0 + i);
-	      updateModY(y);
-	    }
-	  }
-	  p += 2;
-	}
-      } else {
-	for (i = 0; i < n; ++i) {
-	  if (noClip || state->clip->test(x0 + i, y)) {
-	    pattern->getColor(x0 + i, y, color);
-	    p[0] = color[0];
-	    p[1] = color[1];
-	    if (!noClip) {
-	      updateModX(x0 + i);
-	      updateModY(y);
-	    }
-	  }
-	  p += 2;
-	}
+  nComps = splashColorModeNComps[bitmap->mode];
+  p = &bitmap->data[span->y * bitmap->rowSize + nComps * span->x0];
+  n = span->x1 - span->x0 + 1;
+  // short runs (glyph stems, hairlines) aren't worth the call
+  if (n <= 4) {
+    for (i = 0; i < n; ++i, p += nComps) {
+      for (j = 0; j < nComps; ++j) {
+	p[j] = span->color[j];
       }
-      break;
+    }
+    return;
+  }
+  splashFillSpan(p, span->color, nComps, n);
+}
 
-    case splashModeRGB8:
-    case splashModeBGR8:
-      p = &bitmap->data[y * bitmap->rowSize + 3 * x0];
-      if (pattern->isStatic()) {
-	pattern->getColor(0, 0, color);
-	for (i = 0; i < n; ++i) {
-	  if (noClip || state->clip->test(x0 + i, y)) {
-	    p[0] = color[0];
-	    p[1] = color[1];
-	    p[2] = color[2];
-	    if (!noClip) {
-	      updateModX(x0 + i);
-	      updateModY(y);
-	    }
-	  }
-	  p += 3;
-	}
+void Splash::spanCopyMono1(SplashSpan *span) {
+  Guchar colorBuf[splashKernelChunk + splashMaxColorComps];
+  SplashColorPtr p, c;
+  int x, n, i;
+
+  p = &bitmap->data[span->y * bitmap->rowSize];
+  for (x = span->x0; x <= span->x1; x += n) {
+    n = span->x1 - x + 1;
+    if (n > splashKernelChunk) {
+      n = splashKernelChunk;
+    }
+    c = getSpanColors(span, x, n, colorBuf);
+    for (i = 0; i < n; ++i) {
+      if (c[i]) {
+	p[(x + i) >> 3] |= 0x80 >> ((x + i) & 7);
       } else {
-	for (i = 0; i < n; ++i) {
-	  if (noClip || state->clip->test(x0 + i, y)) {
-	    pattern->getColor(x0 + i, y, color);
-	    p[0] = color[0];
-	    p[1] = color[1];
-	    p[2] = color[2];
-	    if (!noClip) {
-	      updateModX(x0 + i);
-	      updateModY(y);
-	    }
-	  }
-	  p += 3;
-	}
+	p[(x + i) >> 3] &= ~(0x80 >> ((x + i) & 7));
       }
-      break;
+    }
+  }
+}
 
-    case splashModeARGB8:
-    case splashModeBGRA8:
-#if SPLASH_CMYK
-    case splashModeCMYK8:
-#endif
-      p = &bitmap->data[y * bitmap->rowSize + 4 * x0];
-      if (pattern->isStatic()) {
-	pattern->getColor(0, 0, color);
-	for (i = 0; i < n; ++i) {
-	  if (noClip || state->clip->test(x0 + i, y)) {
-	    p[0] = color[0];
-	    p[1] = color[1];
-	    p[2] = color[2];
-	    p[3] = color[3];
-	    if (!noClip) {
-	      updateModX(x0 + i);
-	      updateModY(y);
-	    }
-	  }
-	  p += 4;
-	}
+void Splash::spanCopy(SplashSpan *span) {
+  Guchar colorBuf[(splashKernelChunk + 1) * splashMaxColorComps];
+  SplashColorPtr p;
+  int nComps, x, n;
+
+  nComps = splashColorModeNComps[bitmap->mode];
+  p = &bitmap->data[span->y * bitmap->rowSize + nComps * span->x0];
+  if (span->src) {
+    memcpy(p, span->src, (span->x1 - span->x0 + 1) * nComps);
+    return;
+  }
+  for (x = span->x0; x <= span->x1; x += n) {
+    n = span->x1 - x + 1;
+    if (n > splashKernelChunk) {
+      n = splashKernelChunk;
+    }
+    memcpy(p, getSpanColors(span, x, n, colorBuf), n * nComps);
+    p += n * nComps;
+  }
+}
+
+// Opaque static color through an anti-aliased coverage mask:
+//   dest = (coverage * color + (255 - coverage) * dest) >> 8
+// for each pixel with nonzero coverage.
+void Splash::spanCoverage(SplashSpan *span) {
+  int nComps;
+
+  nComps = splashColorModeNComps[bitmap->mode];
+  splashBlendSpanMask(&bitmap->data[span->y * bitmap->rowSize +
+				    nComps * span->x0],
+		      span->color, nComps, span->coverage, gTrue,
+		      span->x1 - span->x0 + 1);
+}
+
+void Splash::spanBlendSolid(SplashSpan *span) {
+  Guchar alphaBuf[splashKernelChunk];
+  SplashColorPtr p;
+  Guchar *q;
+  int nComps, alpha, ialpha, x, n, i;
+
+  nComps = splashColorModeNComps[bitmap->mode];
+  p = &bitmap->data[span->y * bitmap->rowSize + nComps * span->x0];
+  if (!softMask) {
+    n = span->x1 - span->x0 + 1;
+    alpha = (int)(span->alpha * 255);
+    // short runs (image pixels, glyph stems) aren't worth the call
+    if (n <= 4) {
+      ialpha = 255 - alpha;
+      for (x = 0; x < n; ++x, p += nComps) {
+	for (i = 0; i < nComps; ++i) {
+	  p[i] = (alpha * span->color[i] + ialpha * p[i]) >> 8;
+	}
+      }
+      return;
+    }
+    splashBlendSpan(p, span->color, nComps, alpha, n);
+    return;
+  }
+  q = &softMask->data[span->y * softMask->rowSize];
+  for (x = span->x0; x <= span->x1; x += n) {
+    n = span->x1 - x + 1;
+    if (n > splashKernelChunk) {
+      n = splashKernelChunk;
+    }
+    if (span->alpha == 1) {
+      splashBlendSpanMask(p, span->color, nComps, q + x, gFalse, n);
+    } else {
+      splashMulAlphaSpan(alphaBuf, q + x, span->alpha, n);
+      splashBlendSpanMask(p, span->color, nComps, alphaBuf, gFalse, n);
+    }
+    p += n * nComps;
+  }
+}
+
+// Normal blend mode, in any byte-per-component mode:
+//   dest = (alpha * color + (255 - alpha) * dest) >> 8
+// with the alpha from getSpanAlpha.  With coverage, pixels whose
+// alpha is zero are left alone.
+void Splash::spanBlend(SplashSpan *span) {
+  Guchar alphaBuf[splashKernelChunk];
+  Guchar colorBuf[(splashKernelChunk + 1) * splashMaxColorComps];
+  SplashColorPtr p;
+  GBool isStatic, skipZero;
+  int nComps, x, n;
+
+  nComps = splashColorModeNComps[bitmap->mode];
+  isStatic = !span->pattern && !span->src;
+  skipZero = span->coverage != NULL;
+  p = &bitmap->data[span->y * bitmap->rowSize + nComps * span->x0];
+  for (x = span->x0; x <= span->x1; x += n) {
+    n = span->x1 - x + 1;
+    if (n > splashKernelChunk) {
+      n = splashKernelChunk;
+    }
+    getSpanAlpha(span, x, n, alphaBuf);
+    if (isStatic) {
+      splashBlendSpanMask(p, span->color, nComps, alphaBuf, skipZero, n);
+    } else {
+      splashBlendSpanRow(p, getSpanColors(span, x, n, colorBuf), nComps,
+			 alphaBuf, skipZero, n);
+    }
+    p += n * nComps;
+  }
+}
+
+// Other blend modes, in any byte-per-component mode: as spanBlend,
+// with the color replaced by the result of the blend function.
+void Splash::spanBlendFunc(SplashSpan *span) {
+  Guchar alphaBuf[splashKernelChunk];
+  Guchar colorBuf[(splashKernelChunk + 1) * splashMaxColorComps];
+  SplashColor blend;
+  SplashBlendFunc blendFunc;
+  SplashColorPtr p, c;
+  int nComps, cStep, alpha, ialpha, x, n, i, j;
+
+  blendFunc = state->blendFunc;
+  nComps = splashColorModeNComps[bitmap->mode];
+  cStep = (span->pattern || span->src) ? nComps : 0;
+  p = &bitmap->data[span->y * bitmap->rowSize + nComps * span->x0];
+  for (x = span->x0; x <= span->x1; x += n) {
+    n = span->x1 - x + 1;
+    if (n > splashKernelChunk) {
+      n = splashKernelChunk;
+    }
+    getSpanAlpha(span, x, n, alphaBuf);
+    c = cStep ? getSpanColors(span, x, n, colorBuf) : span->color;
+    for (i = 0; i < n; ++i, p += nComps, c += cStep) {
+      (*blendFunc)(c, p, blend, bitmap->mode);
+      alpha = alphaBuf[i];
+      ialpha = 255 - alpha;
+      for (j = 0; j < nComps; ++j) {
+	// note: floor(x / 255) = x >> 8 (for 16-bit x)
+	p[j] = (alpha * blend[j] + ialpha * p[j]) >> 8;
+      }
+    }
+  }
+}
+
+// Any non-opaque span on a Mono1 bitmap, one pixel at a time.
+void Splash::spanBlendMono1(SplashSpan *span) {
+  Guchar alphaBuf[splashKernelChunk];
+  Guchar colorBuf[splashKernelChunk + splashMaxColorComps];
+  SplashColor dest, blendBuf;
+  SplashColorPtr p, c, blend;
+  GBool constAlpha;
+  int cStep, alpha, x, n, i;
+  Guchar t, bit;
+
+  cStep = (span->pattern || span->src) ? 1 : 0;
+  constAlpha = !softMask && !span->srcAlpha;
+  alpha = (int)(span->alpha * 255);
+  p = &bitmap->data[span->y * bitmap->rowSize];
+  for (x = span->x0; x <= span->x1; x += n) {
+    n = span->x1 - x + 1;
+    if (n > splashKernelChunk) {
+      n = splashKernelChunk;
+    }
+    if (!constAlpha) {
+      getSpanAlpha(span, x, n, alphaBuf);
+    }
+    c = cStep ? getSpanColors(span, x, n, colorBuf) : span->color;
+    for (i = 0; i < n; ++i, c += cStep) {
+      bit = 0x80 >> ((x + i) & 7);
+      dest[0] = (p[(x + i) >> 3] & bit) ? 1 : 0;
+      if (state->blendFunc) {
+	(*state->blendFunc)(c, dest, blendBuf, bitmap->mode);
+	blend = blendBuf;
       } else {
-	for (i = 0; i < n; ++i) {
-	  if (noClip || state->clip->test(x0 + i, y)) {
-	    pattern->getColor(x0 + i, y, color);
-	    p[0] = color[0];
-	    p[1] = color[1];
-	    p[2] = color[2];
-	    p[3] = color[3];
-	    if (!noClip) {
-	      updateModX(x0 + i);
-	      updateModY(y);
-	    }
-	  }
-	  p += 4;
-	}
+	blend = c;
       }
-      break;
-#if SPLASH_CMYK
-    case splashModeACMYK8:
-      p = &bitmap->data[y * bitmap->rowSize + 5 * x0];
-      if (pattern->isStatic()) {
-	pattern->getColor(0, 0, color);
-	for (i = 0; i < n; ++i) {
-	  if (noClip || state->clip->test(x0 + i, y)) {
-	    p[0] = color[0];
-	    p[1] = color[1];
-	    p[2] = color[2];
-	    p[3] = color[3];
-	    p[4] = color[4];
-	    if (!noClip) {
-	      updateModX(x0 + i);
-	      updateModY(y);
-	    }
-	  }
-	  p += 4;
-	}
+      if (!constAlpha) {
+	alpha = alphaBuf[i];
+      }
+      t = (alpha * blend[0] + (255 - alpha) * dest[0]) >> 8;
+      if (t) {
+	p[(x + i) >> 3] |= bit;
       } else {
-	for (i = 0; i < n; ++i) {
-	  if (noClip || state->clip->test(x0 + i, y)) {
-	    pattern->getColor(x0 + i, y, color);
-	    p[0] = color[0];
-	    p[1] = color[1];
-	    p[2] = color[2];
-	    p[3] = color[3];
-	    p[4] = color[4];
-	    if (!noClip) {
-	      updateModX(x0 + i);
-	      updateModY(y);
-	    }
-	  }
-	  p += 4;
-	}
+	p[(x + i) >> 3] &= ~bit;
       }
-      break;
-#endif
     }
   }
 }
@@ -1817,15 +2113,26 @@ void Splash::xorSpan(int x0, int x1, int y, SplashPattern *pattern,
   SplashColor color;
   SplashColorPtr p;
   Guchar mask;
-  int i, j, n;
+  int *spans;
+  int nSpans, i, j, n;
+
+  // XOR the visible runs one at a time
+  if (!noClip) {
+    spans = state->clip->getSpans(y, &nSpans);
+    for (i = 0; i < nSpans && spans[2*i] <= x1; ++i) {
+      if (spans[2*i+1] >= x0) {
+	xorSpan(spans[2*i] > x0 ? spans[2*i] : x0,
+		spans[2*i+1] < x1 ? spans[2*i+1] : x1,
+		y, pattern, gTrue);
+      }
+    }
+    return;
+  }
 
   n = x1 - x0 + 1;
-
-  if (noClip) {
-    updateModX(x0);
-    updateModX(x1);
-    updateModY(y);
-  }
+  updateModX(x0);
+  updateModX(x1);
+  updateModY(y);
 
   switch (bitmap->mode) {
   case splashModeMono1:
@@ -1834,15 +2141,9 @@ void Splash::xorSpan(int x0, int x1, int y, SplashPattern *pattern,
     if ((j = x0 & 7)) {
       mask = 0x80 >> j;
       for (; j < 8 && i < n; ++i, ++j) {
-	if (noClip || state->clip->test(x0 + i, y)) {
-	  pattern->getColor(x0 + i, y, color);
-	  if (color[0]) {
-	    *p ^= mask;
-	  }
-	  if (!noClip) {
-	    updateModX(x0 + i);
-	    updateModY(y);
-	  }
+	pattern->getColor(x0 + i, y, color);
+	if (color[0]) {
+	  *p ^= mask;
 	}
 	mask >>= 1;
       }
@@ -1851,15 +2152,9 @@ void Splash::xorSpan(int x0, int x1, int y, SplashPattern *pattern,
     while (i < n) {
       mask = 0x80;
       for (j = 0; j < 8 && i < n; ++i, ++j) {
-	if (noClip || state->clip->test(x0 + i, y)) {
-	  pattern->getColor(x0 + i, y, color);
-	  if (color[0]) {
-	    *p ^= mask;
-	  }
-	  if (!noClip) {
-	    updateModX(x0 + i);
-	    updateModY(y);
-	  }
+	pattern->getColor(x0 + i, y, color);
+	if (color[0]) {
+	  *p ^= mask;
 	}
 	mask >>= 1;
       }
@@ -1870,14 +2165,8 @@ void Splash::xorSpan(int x0, int x1, int y, SplashPattern *pattern,
   case splashModeMono8:
     p = &bitmap->data[y * bitmap->rowSize + x0];
     for (i = 0; i < n; ++i) {
-      if (noClip || state->clip->test(x0 + i, y)) {
-	pattern->getColor(x0 + i, y, color);
-	*p ^= color[0];
-	if (!noClip) {
-	  updateModX(x0 + i);
-	  updateModY(y);
-	}
-      }
+      pattern->getColor(x0 + i, y, color);
+      *p ^= color[0];
       ++p;
     }
     break;
@@ -1885,15 +2174,9 @@ void Splash::xorSpan(int x0, int x1, int y, SplashPattern *pattern,
   case splashModeAMono8:
     p = &bitmap->data[y * bitmap->rowSize + 2 * x0];
     for (i = 0; i < n; ++i) {
-      if (noClip || state->clip->test(x0 + i, y)) {
-	pattern->getColor(x0 + i, y, color);
-	p[0] ^= color[0];
-	p[1] ^= color[1];
-	if (!noClip) {
-	  updateModX(x0 + i);
-	  updateModY(y);
-	}
-      }
+      pattern->getColor(x0 + i, y, color);
+      p[0] ^= color[0];
+      p[1] ^= color[1];
       p += 2;
     }
     break;
@@ -1902,16 +2185,10 @@ void Splash::xorSpan(int x0, int x1, int y, SplashPattern *pattern,
   case splashModeBGR8:
     p = &bitmap->data[y * bitmap->rowSize + 3 * x0];
     for (i = 0; i < n; ++i) {
-      if (noClip || state->clip->test(x0 + i, y)) {
-	pattern->getColor(x0 + i, y, color);
-	p[0] ^= color[0];
-	p[1] ^= color[1];
-	p[2] ^= color[2];
-	if (!noClip) {
-	  updateModX(x0 + i);
-	  updateModY(y);
-	}
-      }
+      pattern->getColor(x0 + i, y, color);
+      p[0] ^= color[0];
+      p[1] ^= color[1];
+      p[2] ^= color[2];
       p += 3;
     }
     break;
@@ -1923,17 +2200,11 @@ void Splash::xorSpan(int x0, int x1, int y, SplashPattern *pattern,
 #endif
     p = &bitmap->data[y * bitmap->rowSize + 4 * x0];
     for (i = 0; i < n; ++i) {
-      if (noClip || state->clip->test(x0 + i, y)) {
-	pattern->getColor(x0 + i, y, color);
-	p[0] ^= color[0];
-	p[1] ^= color[1];
-	p[2] ^= color[2];
-	p[3] ^= color[3];
-	if (!noClip) {
-	  updateModX(x0 + i);
-	  updateModY(y);
-	}
-      }
+      pattern->getColor(x0 + i, y, color);
+      p[0] ^= color[0];
+      p[1] ^= color[1];
+      p[2] ^= color[2];
+      p[3] ^= color[3];
       p += 4;
     }
     break;
@@ -1941,18 +2212,12 @@ void Splash::xorSpan(int x0, int x1, int y, SplashPattern *pattern,
   case splashModeACMYK8:
     p = &bitmap->data[y * bitmap->rowSize + 5 * x0];
     for (i = 0; i < n; ++i) {
-      if (noClip || state->clip->test(x0 + i, y)) {
-	pattern->getColor(x0 + i, y, color);
-	p[0] ^= color[0];
-	p[1] ^= color[1];
-	p[2] ^= color[2];
-	p[3] ^= color[3];
-	p[4] ^= color[4];
-	if (!noClip) {
-	  updateModX(x0 + i);
-	  updateModY(y);
-	}
-      }
+      pattern->getColor(x0 + i, y, color);
+      p[0] ^= color[0];
+      p[1] ^= color[1];
+      p[2] ^= color[2];
+      p[3] ^= color[3];
+      p[4] ^= color[4];
       p += 4;
     }
     break;
@@ -1984,17 +2249,97 @@ SplashError Splash::fillChar(SplashCoord x, SplashCoord y,
   return err;
 }
 
+// Returns true if pixel <x> of glyph row <row> is drawn by an aliased
+// fill.
+static inline GBool glyphPixelSet(SplashGlyphBitmap *glyph, Guchar *row,
+				  int x) {
+  if (glyph->aa) {
+    return row[x] >= 0x80;
+  }
+  return (row[x >> 3] & (0x80 >> (x & 7))) != 0;
+}
+
+// Set (or, if <fill> is false, clear) the bits of Mono1 row <dest>
+// starting at pixel <x0> for the set pixels of glyph row <row>.
+static void glyphRowMono1(SplashGlyphBitmap *glyph, Guchar *row,
+			  SplashColorPtr dest, int x0, GBool fill) {
+  Guchar g, last;
+  int shift, nBytes, i, xx;
+
+  if (glyph->aa) {
+    for (xx = 0; xx < glyph->w; ++xx) {
+      if (row[xx] >= 0x80) {
+	if (fill) {
+	  dest[(x0 + xx) >> 3] |= 0x80 >> ((x0 + xx) & 7);
+	} else {
+	  dest[(x0 + xx) >> 3] &= ~(0x80 >> ((x0 + xx) & 7));
+	}
+      }
+    }
+    return;
+  }
+
+  // shift whole glyph bytes into place; the unused low bits of the
+  // last byte are masked off so nothing is written past pixel x0+w-1
+  dest += x0 >> 3;
+  shift = x0 & 7;
+  nBytes = (glyph->w + 7) >> 3;
+  last = 0xff << (nBytes * 8 - glyph->w);
+  for (i = 0; i < nBytes; ++i) {
+    if (!(g = i == nBytes - 1 ? row[i] & last : row[i])) {
+      continue;
+    }
+    if (fill) {
+      dest[i] |= g >> shift;
+      if (shift && (Guchar)(g << (8 - shift))) {
+	dest[i + 1] |= g << (8 - shift);
+      }
+    } else {
+      dest[i] &= ~(g >> shift);
+      if (shift && (Guchar)(g << (8 - shift))) {
+	dest[i + 1] &= ~(Guchar)(g << (8 - shift));
+      }
+    }
+  }
+}
+
+// Write <color> (<nComps> bytes) to the pixels of row <dest>, starting
+// at pixel <x0>, for the set pixels of bitmap glyph row <row>.
+static void glyphRowSolid(SplashGlyphBitmap *glyph, Guchar *row,
+			  SplashColorPtr dest, int x0, SplashColorPtr color,
+			  int nComps) {
+  SplashColorPtr q;
+  Guchar g;
+  int xx, i, j;
+
+  for (xx = 0; xx < glyph->w; xx += 8) {
+    if (!(g = row[xx >> 3])) {
+      continue;
+    }
+    q = dest + (x0 + xx) * nComps;
+    for (i = 0; i < 8 && xx + i < glyph->w; ++i, q += nComps) {
+      if (g & (0x80 >> i)) {
+	for (j = 0; j < nComps; ++j) {
+	  q[j] = color[j];
+	}
+      }
+    }
+  }
+}
+
+// Each glyph row is drawn through one span kernel, chosen once per
+// glyph.  Anti-aliased rows go through the coverage kernels as whole
+// rows when those can skip zero coverage, and as runs of nonzero
+// coverage otherwise.  Bitmap rows, and anti-aliased rows on Mono1
+// bitmaps (coverage >= 0x80), are drawn as runs of set pixels, or
+// written directly into the bitmap for an unclipped opaque color.
 SplashError Splash::fillGlyph(SplashCoord x, SplashCoord y,
 			      SplashGlyphBitmap *glyph) {
-  SplashBlendFunc blendFunc;
-  int alpha0, alpha, ialpha;
-  Guchar *p;
-  SplashColor fg, dest, blend;
-  SplashColorPtr pix;
+  SplashSpan span;
   SplashClipResult clipRes;
-  GBool noClip;
-  Guchar t;
-  int x0, y0, x1, y1, xx, xx1, yy;
+  GBool noClip, aa, wholeRows;
+  Guchar *p;
+  int x0, y0, gx0, y1, xx, xx1, yy;
 
   x0 = splashFloor(x);
   y0 = splashFloor(y);
@@ -2013,309 +2358,58 @@ SplashError Splash::fillGlyph(SplashCoord x, SplashCoord y,
       updateModY(y0 - glyph->y + glyph->h - 1);
     }
 
-    //~ optimize this
-    if (state->fillAlpha != 1 || softMask || state->blendFunc) {
-      blendFunc = state->blendFunc ? state->blendFunc : &blendNormal;
-      if (glyph->aa) {
-	p = glyph->data;
-	for (yy = 0, y1 = y0 - glyph->y; yy < glyph->h; ++yy, ++y1) {
-	  for (xx = 0, x1 = x0 - glyph->x; xx < glyph->w; ++xx, ++x1) {
-	    alpha = *p++;
-	    if (softMask) {
-	      alpha = (int)(alpha * (int)state->fillAlpha *
-			    softMask->data[y1 * softMask->rowSize + x1]);
-	    } else {
-	      alpha = (int)(alpha * (int)state->fillAlpha);
-	    }
-	    if (alpha > 0) {
-	      if (noClip || state->clip->test(x1, y1)) {
-		ialpha = 255 - alpha;
-		state->fillPattern->getColor(x1, y1, fg);
-		switch (bitmap->mode) {
-		case splashModeMono1:
-		  pix = &bitmap->data[y1 * bitmap->rowSize + (x1 >> 3)];
-		  dest[0] = (*pix >> (7 - (x1 & 7))) & 1;
-		  (*blendFunc)(fg, dest, blend, bitmap->mode);
-		  t = (alpha * blend[0] + ialpha * dest[0]) >> 8;
-		  if (t) {
-		    *pix |= 0x80 >> (x1 & 7);
-		  } else {
-		    *pix &= ~(0x80 >> (x1 & 7));
-		  }
-		  break;
-		case splashModeMono8:
-		  pix = &bitmap->data[y1 * bitmap->rowSize + x1];
-		  (*blendFunc)(fg, pix, blend, bitmap->mode);
-		  // note: floor(x / 255) = x >> 8 (for 16-bit x)
-		  pix[0] = (alpha * blend[0] + ialpha * pix[0]) >> 8;
-		  break;
-		case splashModeAMono8:
-		  pix = &bitmap->data[y1 * bitmap->rowSize + 2 * x1];
-		  (*blendFunc)(fg, pix, blend, bitmap->mode);
-		  pix[0] = (alpha * blend[0] + ialpha * pix[0]) >> 8;
-		  pix[1] = (alpha * blend[1] + ialpha * pix[1]) >> 8;
-		  break;
-		case splashModeRGB8:
-		case splashModeBGR8:
-		  pix = &bitmap->data[y1 * bitmap->rowSize + 3 * x1];
-		  (*blendFunc)(fg, pix, blend, bitmap->mode);
-		  pix[0] = (alpha * blend[0] + ialpha * pix[0]) >> 8;
-		  pix[1] = (alpha * blend[1] + ialpha * pix[1]) >> 8;
-		  pix[2] = (alpha * blend[2] + ialpha * pix[2]) >> 8;
-		  break;
-		case splashModeARGB8:
-		case splashModeBGRA8:
-#if SPLASH_CMYK
-		case splashModeCMYK8:
-#endif
-		  pix = &bitmap->data[y1 * bitmap->rowSize + 4 * x1];
-		  (*blendFunc)(fg, pix, blend, bitmap->mode);
-		  pix[0] = (alpha * blend[0] + ialpha * pix[0]) >> 8;
-		  pix[1] = (alpha * blend[1] + ialpha * pix[1]) >> 8;
-		  pix[2] = (alpha * blend[2] + ialpha * pix[2]) >> 8;
-		  pix[3] = (alpha * blend[3] + ialpha * pix[3]) >> 8;
-		  break;
-#if SPLASH_CMYK
-		case splashModeACMYK8:
-		  pix = &bitmap->data[y1 * bitmap->rowSize + 5 * x1];
-		  (*blendFunc)(fg, pix, blend, bitmap->mode);
-		  pix[0] = (alpha * blend[0] + ialpha * pix[0]) >> 8;
-		  pix[1] = (alpha * blend[1] + ialpha * pix[1]) >> 8;
-		  pix[2] = (alpha * blend[2] + ialpha * pix[2]) >> 8;
-		  pix[3] = (alpha * blend[3] + ialpha * pix[3]) >> 8;
-		  pix[4] = (alpha * blend[4] + ialpha * pix[4]) >> 8;
-		  break;
-#endif
-		}
-		if (!noClip) {
-		  updateModX(x1);
-		  updateModY(y1);
-		}
-	      }
-	    }
-	  }
+    gx0 = x0 - glyph->x;
+    aa = glyph->aa && bitmap->mode != splashModeMono1;
+    setSpanPattern(&span, state->fillPattern);
+    span.src = NULL;
+    span.alpha = state->fillAlpha;
+    span.srcAlpha = NULL;
+    span.coverage = aa ? glyph->data : (Guchar *)NULL;
+    span.kernel = getSpanKernel(&span);
+    wholeRows = aa && (span.kernel == &Splash::spanCoverage ||
+		       span.kernel == &Splash::spanBlend);
+    p = glyph->data;
+    for (yy = 0, y1 = y0 - glyph->y; yy < glyph->h; ++yy, ++y1) {
+      span.y = y1;
+      if (noClip && span.kernel == &Splash::spanSolidMono1) {
+	glyphRowMono1(glyph, p, &bitmap->data[y1 * bitmap->rowSize], gx0,
+		      span.color[0] != 0);
+      } else if (noClip && !glyph->aa && span.kernel == &Splash::spanSolid) {
+	glyphRowSolid(glyph, p, &bitmap->data[y1 * bitmap->rowSize], gx0,
+		      span.color, splashColorModeNComps[bitmap->mode]);
+      } else if (wholeRows) {
+	span.x0 = gx0;
+	span.x1 = gx0 + glyph->w - 1;
+	span.coverage = p;
+	if (noClip) {
+	  (this->*span.kernel)(&span);
+	} else {
+	  drawSpanRuns(&span, gFalse);
 	}
-
       } else {
-	p = glyph->data;
-	for (yy = 0, y1 = y0 - glyph->y; yy < glyph->h; ++yy, ++y1) {
-	  for (xx = 0, x1 = x0 - glyph->x; xx < glyph->w; xx += 8) {
-	    alpha0 = *p++;
-	    for (xx1 = 0; xx1 < 8 && xx + xx1 < glyph->w; ++xx1, ++x1) {
-	      if (alpha0 & 0x80) {
-		if (noClip || state->clip->test(x1, y1)) {
-		  if (softMask) {
-		    alpha = (int)(state->fillAlpha *
-				  softMask->data[y1 * softMask->rowSize + x1]);
-		  } else {
-		    alpha = (int)(state->fillAlpha * 255);
-		  }
-		  ialpha = 255 - alpha;
-		  state->fillPattern->getColor(x1, y1, fg);
-		  switch (bitmap->mode) {
-		  case splashModeMono1:
-		    pix = &bitmap->data[y1 * bitmap->rowSize + (x1 >> 3)];
-		    dest[0] = (*pix >> (7 - (x1 & 7))) & 1;
-		    (*blendFunc)(fg, dest, blend, bitmap->mode);
-		    t = (alpha * blend[0] + ialpha * dest[0]) >> 8;
-		    if (t) {
-		      *pix |= 0x80 >> (x1 & 7);
-		    } else {
-		      *pix &= ~(0x80 >> (x1 & 7));
-		    }
-		    break;
-		  case splashModeMono8:
-		    pix = &bitmap->data[y1 * bitmap->rowSize + x1];
-		    (*blendFunc)(fg, pix, blend, bitmap->mode);
-		    // note: floor(x / 255) = x >> 8 (for 16-bit x)
-		    pix[0] = (alpha * blend[0] + ialpha * pix[0]) >> 8;
-		    break;
-		  case splashModeAMono8:
-		    pix = &bitmap->data[y1 * bitmap->rowSize + 2 * x1];
-		    (*blendFunc)(fg, pix, blend, bitmap->mode);
-		    pix[0] = (alpha * blend[0] + ialpha * pix[0]) >> 8;
-		    pix[1] = (alpha * blend[1] + ialpha * pix[1]) >> 8;
-		    break;
-		  case splashModeRGB8:
-		  case splashModeBGR8:
-		    pix = &bitmap->data[y1 * bitmap->rowSize + 3 * x1];
-		    (*blendFunc)(fg, pix, blend, bitmap->mode);
-		    pix[0] = (alpha * blend[0] + ialpha * pix[0]) >> 8;
-		    pix[1] = (alpha * blend[1] + ialpha * pix[1]) >> 8;
-		    pix[2] = (alpha * blend[2] + ialpha * pix[2]) >> 8;
-		    break;
-		  case splashModeARGB8:
-		  case splashModeBGRA8:
-#if SPLASH_CMYK
-		  case splashModeCMYK8:
-#endif
-		    pix = &bitmap->data[y1 * bitmap->rowSize + 4 * x1];
-		    (*blendFunc)(fg, pix, blend, bitmap->mode);
-		    pix[0] = (alpha * blend[0] + ialpha * pix[0]) >> 8;
-		    pix[1] = (alpha * blend[1] + ialpha * pix[1]) >> 8;
-		    pix[2] = (alpha * blend[2] + ialpha * pix[2]) >> 8;
-		    pix[3] = (alpha * blend[3] + ialpha * pix[3]) >> 8;
-		    break;
-#if SPLASH_CMYK
-		  case splashModeACMYK8:
-		    pix = &bitmap->data[y1 * bitmap->rowSize + 5 * x1];
-		    (*blendFunc)(fg, pix, blend, bitmap->mode);
-		    pix[0] = (alpha * blend[0] + ialpha * pix[0]) >> 8;
-		    pix[1] = (alpha * blend[1] + ialpha * pix[1]) >> 8;
-		    pix[2] = (alpha * blend[2] + ialpha * pix[2]) >> 8;
-		    pix[3] = (alpha * blend[3] + ialpha * pix[3]) >> 8;
-		    pix[4] = (alpha * blend[4] + ialpha * pix[4]) >> 8;
-		    break;
-#endif
-		  }
-		  if (!noClip) {
-		    updateModX(x1);
-		    updateModY(y1);
-		  }
-		}
-	      }
-	      alpha0 <<= 1;
-	    }
+	for (xx = 0; xx < glyph->w; xx = xx1) {
+	  if (aa ? !p[xx] : !glyphPixelSet(glyph, p, xx)) {
+	    xx1 = xx + 1;
+	    continue;
 	  }
-	}
-      }
-
-    } else {
-      if (glyph->aa) {
-	p = glyph->data;
-	for (yy = 0, y1 = y0 - glyph->y; yy < glyph->h; ++yy, ++y1) {
-	  for (xx = 0, x1 = x0 - glyph->x; xx < glyph->w; ++xx, ++x1) {
-	    alpha = *p++;
-	    if (alpha > 0) {
-	      if (noClip || state->clip->test(x1, y1)) {
-		ialpha = 255 - alpha;
-		state->fillPattern->getColor(x1, y1, fg);
-		switch (bitmap->mode) {
-		case splashModeMono1:
-		  if (alpha >= 0x80) {
-		    pix = &bitmap->data[y1 * bitmap->rowSize + (x1 >> 3)];
-		    if (fg[0]) {
-		      *pix |= 0x80 >> (x1 & 7);
-		    } else {
-		      *pix &= ~(0x80 >> (x1 & 7));
-		    }
-		  }
-		  break;
-		case splashModeMono8:
-		  pix = &bitmap->data[y1 * bitmap->rowSize + x1];
-		  // note: floor(x / 255) = x >> 8 (for 16-bit x)
-		  pix[0] = (alpha * fg[0] + ialpha * pix[0]) >> 8;
-		  break;
-		case splashModeAMono8:
-		  pix = &bitmap->data[y1 * bitmap->rowSize + 2 * x1];
-		  pix[0] = (alpha * fg[0] + ialpha * pix[0]) >> 8;
-		  pix[1] = (alpha * fg[1] + ialpha * pix[1]) >> 8;
-		  break;
-		case splashModeRGB8:
-		case splashModeBGR8:
-		  pix = &bitmap->data[y1 * bitmap->rowSize + 3 * x1];
-		  pix[0] = (alpha * fg[0] + ialpha * pix[0]) >> 8;
-		  pix[1] = (alpha * fg[1] + ialpha * pix[1]) >> 8;
-		  pix[2] = (alpha * fg[2] + ialpha * pix[2]) >> 8;
-		  break;
-		case splashModeARGB8:
-		case splashModeBGRA8:
-#if SPLASH_CMYK
-		case splashModeCMYK8:
-#endif
-		  pix = &bitmap->data[y1 * bitmap->rowSize + 4 * x1];
-		  pix[0] = (alpha * fg[0] + ialpha * pix[0]) >> 8;
-		  pix[1] = (alpha * fg[1] + ialpha * pix[1]) >> 8;
-		  pix[2] = (alpha * fg[2] + ialpha * pix[2]) >> 8;
-		  pix[3] = (alpha * fg[3] + ialpha * pix[3]) >> 8;
-		  break;
-#if SPLASH_CMYK
-		case splashModeACMYK8:
-		  pix = &bitmap->data[y1 * bitmap->rowSize + 5 * x1];
-		  pix[0] = (alpha * fg[0] + ialpha * pix[0]) >> 8;
-		  pix[1] = (alpha * fg[1] + ialpha * pix[1]) >> 8;
-		  pix[2] = (alpha * fg[2] + ialpha * pix[2]) >> 8;
-		  pix[3] = (alpha * fg[3] + ialpha * pix[3]) >> 8;
-		  pix[4] = (alpha * fg[4] + ialpha * pix[4]) >> 8;
-		  break;
-#endif
-		}
-		if (!noClip) {
-		  updateModX(x1);
-		  updateModY(y1);
-		}
-	      }
-	    }
+	  if (aa) {
+	    for (xx1 = xx + 1; xx1 < glyph->w && p[xx1]; ++xx1) ;
+	    span.coverage = p + xx;
+	  } else {
+	    for (xx1 = xx + 1;
+		 xx1 < glyph->w && glyphPixelSet(glyph, p, xx1);
+		 ++xx1) ;
 	  }
-	}
-
-      } else {
-	p = glyph->data;
-	for (yy = 0, y1 = y0 - glyph->y; yy < glyph->h; ++yy, ++y1) {
-	  for (xx = 0, x1 = x0 - glyph->x; xx < glyph->w; xx += 8) {
-	    alpha0 = *p++;
-	    for (xx1 = 0; xx1 < 8 && xx + xx1 < glyph->w; ++xx1, ++x1) {
-	      if (alpha0 & 0x80) {
-		if (noClip || state->clip->test(x1, y1)) {
-		  state->fillPattern->getColor(x1, y1, fg);
-		  switch (bitmap->mode) {
-		  case splashModeMono1:
-		    pix = &bitmap->data[y1 * bitmap->rowSize + (x1 >> 3)];
-		    if (fg[0]) {
-		      *pix |= 0x80 >> (x1 & 7);
-		    } else {
-		      *pix &= ~(0x80 >> (x1 & 7));
-		    }
-		    break;
-		  case splashModeMono8:
-		    pix = &bitmap->data[y1 * bitmap->rowSize + x1];
-		    pix[0] = fg[0];
-		    break;
-		  case splashModeAMono8:
-		    pix = &bitmap->data[y1 * bitmap->rowSize + 2 * x1];
-		    pix[0] = fg[0];
-		    pix[1] = fg[1];
-		    break;
-		  case splashModeRGB8:
-		  case splashModeBGR8:
-		    pix = &bitmap->data[y1 * bitmap->rowSize + 3 * x1];
-		    pix[0] = fg[0];
-		    pix[1] = fg[1];
-		    pix[2] = fg[2];
-		    break;
-		  case splashModeARGB8:
-		  case splashModeBGRA8:
-#if SPLASH_CMYK
-		  case splashModeCMYK8:
-#endif
-		    pix = &bitmap->data[y1 * bitmap->rowSize + 4 * x1];
-		    pix[0] = fg[0];
-		    pix[1] = fg[1];
-		    pix[2] = fg[2];
-		    pix[3] = fg[3];
-		    break;
-#if SPLASH_CMYK
-		  case splashModeACMYK8:
-		    pix = &bitmap->data[y1 * bitmap->rowSize + 5 * x1];
-		    pix[0] = fg[0];
-		    pix[1] = fg[1];
-		    pix[2] = fg[2];
-		    pix[3] = fg[3];
-		    pix[4] = fg[4];
-		    break;
-#endif
-		  }
-		  if (!noClip) {
-		    updateModX(x1);
-		    updateModY(y1);
-		  }
-		}
-	      }
-	      alpha0 <<= 1;
-	    }
+	  span.x0 = gx0 + xx;
+	  span.x1 = gx0 + xx1 - 1;
+	  if (noClip) {
+	    (this->*span.kernel)(&span);
+	  } else {
+	    drawSpanRuns(&span, gFalse);
 	  }
 	}
       }
+      p += glyph->aa ? glyph->w : (glyph->w + 7) >> 3;
     }
   }
   opClipRes = clipRes;
@@ -2335,6 +2429,7 @@ SplashError Splash::fillImageMask(SplashImageMaskSource src, void *srcData,
   int yp, yq, yt, yStep, lastYStep;
   int xp, xq, xt, xStep, xSrc;
   int k1, spanXMin, spanXMax, spanY;
+  SplashSpan fullSpan, partSpan;
   SplashColorPtr pixBuf, p;
   int pixAcc;
   SplashCoord alpha;
@@ -2451,6 +2546,17 @@ SplashError Splash::fillImageMask(SplashImageMaskSource src, void *srcData,
   // allocate pixel buffer
   pixBuf = (SplashColorPtr)gmalloc((yp + 1) * w);
 
+  // span kernels for fully and partially covered pixels
+  setSpanPattern(&fullSpan, state->fillPattern);
+  fullSpan.src = NULL;
+  fullSpan.alpha = state->fillAlpha;
+  fullSpan.srcAlpha = NULL;
+  fullSpan.coverage = NULL;
+  fullSpan.kernel = getSpanKernel(&fullSpan);
+  partSpan = fullSpan;
+  partSpan.alpha = 0;
+  partSpan.kernel = getSpanKernel(&partSpan);
+
   // init y scale Bresenham
   yt = 0;
   lastYStep = 1;
@@ -2553,12 +2659,12 @@ SplashError Splash::fillImageMask(SplashImageMaskSource src, void *srcData,
       // blend fill color with background
       if (pixAcc != 0) {
 	if (pixAcc == n * m) {
-	  drawPixel(tx + x2, ty + y2, state->fillPattern, state->fillAlpha,
+	  drawPixel(&fullSpan, tx + x2, ty + y2,
 		    clipRes2 == splashClipAllInside);
 	} else {
 	  alpha = (SplashCoord)pixAcc / (SplashCoord)(n * m);
-	  drawPixel(tx + x2, ty + y2, state->fillPattern,
-		    state->fillAlpha * alpha,
+	  partSpan.alpha = state->fillAlpha * alpha;
+	  drawPixel(&partSpan, tx + x2, ty + y2,
 		    clipRes2 == splashClipAllInside);
 	}
       }
@@ -2580,6 +2686,241 @@ SplashError Splash::fillImageMask(SplashImageMaskSource src, void *srcData,
   return splashOk;
 }
 
+SplashError Splash::fillImageMaskRuns(SplashImageMaskRunSource src,
+				      void *srcData, int w, int h,
+				      SplashCoord *mat) {
+  SplashCoord xScale, yScale, alpha;
+  int tx, tx2, ty, ty2, scaledWidth, scaledHeight, xSign, ySign;
+  int xMin, xMax, yMin, yMax;
+  SplashClipResult clipRes, clipRes2;
+  int yp, yq, yt, yStep, lastYStep;
+  int xp, xq, xt, xStep, xSrc;
+  int *runBuf, *nRuns, *runs;
+  int *colX0, *colX1, *firstCol, *lastCol, *pixAcc;
+  int accMin, accMax, spanX0, full, yd;
+  int x, y, x0, x1, n, i, j;
+  SplashSpan fullSpan, partSpan;
+
+  if (debugMode) {
+    printf("fillImageMaskRuns: w=%d h=%d mat=[%.2f %.2f %.2f %.2f %.2f %.2f]\n",
+	   w, h, (double)mat[0], (double)mat[1], (double)mat[2],
+	   (double)mat[3], (double)mat[4], (double)mat[5]);
+  }
+
+  // check for singular matrix
+  if (splashAbs(mat[0] * mat[3] - mat[1] * mat[2]) < 0.000001) {
+    return splashErrSingularMatrix;
+  }
+
+  // compute scale and translation parameters -- this matches
+  // fillImageMask with mat[1] = mat[2] = 0
+  xScale = mat[0];
+  yScale = mat[3];
+  if (xScale >= 0) {
+    tx = splashRound(mat[4] - 0.01);
+    tx2 = splashRound(mat[4] + xScale + 0.01) - 1;
+  } else {
+    tx = splashRound(mat[4] + 0.01) - 1;
+    tx2 = splashRound(mat[4] + xScale - 0.01);
+  }
+  scaledWidth = abs(tx2 - tx) + 1;
+  if (scaledWidth == 0) {
+    scaledWidth = 1;
+  }
+  if (yScale >= 0) {
+    ty = splashRound(mat[5] - 0.01);
+    ty2 = splashRound(mat[5] + yScale + 0.01) - 1;
+  } else {
+    ty = splashRound(mat[5] + 0.01) - 1;
+    ty2 = splashRound(mat[5] + yScale - 0.01);
+  }
+  scaledHeight = abs(ty2 - ty) + 1;
+  if (scaledHeight == 0) {
+    scaledHeight = 1;
+  }
+  xSign = (xScale < 0) ? -1 : 1;
+  ySign = (yScale < 0) ? -1 : 1;
+
+  // clipping
+  if (xSign > 0) {
+    xMin = tx;
+    xMax = tx + (scaledWidth - 1);
+  } else {
+    xMin = tx - (scaledWidth - 1);
+    xMax = tx;
+  }
+  if (ySign > 0) {
+    yMin = ty;
+    yMax = ty + (scaledHeight - 1);
+  } else {
+    yMin = ty - (scaledHeight - 1);
+    yMax = ty;
+  }
+  clipRes = state->clip->testRect(xMin, yMin, xMax, yMax);
+  opClipRes = clipRes;
+
+  // compute Bresenham parameters for x and y scaling
+  yp = h / scaledHeight;
+  yq = h % scaledHeight;
+  xp = w / scaledWidth;
+  xq = w % scaledWidth;
+
+  // the x scale Bresenham is the same for every row: column x covers
+  // source pixels colX0[x] .. colX1[x] - 1; source pixel i falls in
+  // columns firstCol[i] .. lastCol[i]
+  colX0 = (int *)gmallocn(scaledWidth, sizeof(int));
+  colX1 = (int *)gmallocn(scaledWidth, sizeof(int));
+  firstCol = (int *)gmallocn(w, sizeof(int));
+  lastCol = (int *)gmallocn(w, sizeof(int));
+  xt = 0;
+  xSrc = 0;
+  for (x = 0; x < scaledWidth; ++x) {
+    xStep = xp;
+    xt += xq;
+    if (xt >= scaledWidth) {
+      xt -= scaledWidth;
+      ++xStep;
+    }
+    colX0[x] = xSrc;
+    colX1[x] = xSrc + (xStep > 0 ? xStep : 1);
+    xSrc += xStep;
+  }
+  for (i = 0, x = 0; i < w; ++i) {
+    while (x < scaledWidth - 1 && colX1[x] <= i) {
+      ++x;
+    }
+    firstCol[i] = x;
+  }
+  for (i = w - 1, x = scaledWidth - 1; i >= 0; --i) {
+    while (x > 0 && colX0[x] > i) {
+      --x;
+    }
+    lastCol[i] = x;
+  }
+
+  // allocate run buffers (these play the part of fillImageMask's
+  // pixel buffer) and the coverage accumulator
+  runBuf = (int *)gmallocn(yp + 1, (w + 1) * sizeof(int));
+  nRuns = (int *)gmallocn(yp + 1, sizeof(int));
+  for (i = 0; i <= yp; ++i) {
+    nRuns[i] = 0;
+  }
+  pixAcc = (int *)gmallocn(scaledWidth, sizeof(int));
+  memset(pixAcc, 0, scaledWidth * sizeof(int));
+
+  // span kernels for fully and partially covered pixels
+  setSpanPattern(&fullSpan, state->fillPattern);
+  fullSpan.src = NULL;
+  fullSpan.alpha = state->fillAlpha;
+  fullSpan.srcAlpha = NULL;
+  fullSpan.coverage = NULL;
+  fullSpan.kernel = getSpanKernel(&fullSpan);
+  partSpan = fullSpan;
+  partSpan.alpha = 0;
+  partSpan.kernel = getSpanKernel(&partSpan);
+
+  // init y scale Bresenham
+  yt = 0;
+  lastYStep = 1;
+
+  for (y = 0; y < scaledHeight; ++y) {
+
+    // y scale Bresenham
+    yStep = yp;
+    yt += yq;
+    if (yt >= scaledHeight) {
+      yt -= scaledHeight;
+      ++yStep;
+    }
+
+    // read row(s) from image
+    n = (yp > 0) ? yStep : lastYStep;
+    for (i = 0; i < n; ++i) {
+      (*src)(srcData, runBuf + i * (w + 1), &nRuns[i]);
+    }
+    lastYStep = yStep;
+
+    // clipping test
+    yd = ty + ySign * y;
+    if (clipRes != splashClipAllInside) {
+      clipRes2 = state->clip->testSpan(xMin, xMax, yd);
+      if (clipRes2 == splashClipAllOutside) {
+	continue;
+      }
+    } else {
+      clipRes2 = clipRes;
+    }
+
+    // add up the coverage of each column
+    n = yStep > 0 ? yStep : 1;
+    accMin = scaledWidth;
+    accMax = -1;
+    for (i = 0; i < n; ++i) {
+      runs = runBuf + i * (w + 1);
+      for (j = 0; j < nRuns[i]; ++j) {
+	x0 = runs[2*j] < 0 ? 0 : runs[2*j];
+	x1 = runs[2*j+1] > w ? w : runs[2*j+1];
+	if (x0 >= x1) {
+	  continue;
+	}
+	if (firstCol[x0] < accMin) {
+	  accMin = firstCol[x0];
+	}
+	if (lastCol[x1 - 1] > accMax) {
+	  accMax = lastCol[x1 - 1];
+	}
+	for (x = firstCol[x0]; x <= lastCol[x1 - 1]; ++x) {
+	  pixAcc[x] += (colX1[x] < x1 ? colX1[x] : x1) -
+	               (colX0[x] > x0 ? colX0[x] : x0);
+	}
+      }
+    }
+
+    // fill fully covered columns as spans, and blend the partially
+    // covered ones
+    spanX0 = -1;
+    for (x = accMin; x <= accMax + 1; ++x) {
+      full = (x <= accMax) ? n * (colX1[x] - colX0[x]) : -1;
+      if (x <= accMax && pixAcc[x] == full) {
+	if (spanX0 < 0) {
+	  spanX0 = x;
+	}
+      } else {
+	if (spanX0 >= 0) {
+	  if (xSign > 0) {
+	    drawSpanRuns(&fullSpan, tx + spanX0, tx + x - 1, yd,
+			 clipRes2 == splashClipAllInside);
+	  } else {
+	    drawSpanRuns(&fullSpan, tx - (x - 1), tx - spanX0, yd,
+			 clipRes2 == splashClipAllInside);
+	  }
+	  spanX0 = -1;
+	}
+	if (x <= accMax && pixAcc[x] != 0) {
+	  alpha = (SplashCoord)pixAcc[x] / (SplashCoord)full;
+	  partSpan.alpha = state->fillAlpha * alpha;
+	  drawPixel(&partSpan, tx + xSign * x, yd,
+		    clipRes2 == splashClipAllInside);
+	}
+      }
+      if (x <= accMax) {
+	pixAcc[x] = 0;
+      }
+    }
+  }
+
+  // free memory
+  gfree(colX0);
+  gfree(colX1);
+  gfree(firstCol);
+  gfree(lastCol);
+  gfree(runBuf);
+  gfree(nRuns);
+  gfree(pixAcc);
+
+  return splashOk;
+}
+
 SplashError Splash::drawImage(SplashImageSource src, void *srcData,
 			      SplashColorMode srcMode,
 			      int w, int h, SplashCoord *mat) {
@@ -2593,8 +2934,11 @@ SplashError Splash::drawImage(SplashImageSource src, void *srcData,
   int yp, yq, yt, yStep, lastYStep;
   int xp, xq, xt, xStep, xSrc;
   int k1, spanXMin, spanXMax, spanY;
-  SplashColorPtr pixBuf, p;
+  SplashColorPtr pixBuf, p, rowBuf, pixPtr;
+  SplashCoord *alphaRow;
   SplashColor pix;
+  SplashSpan opaqueSpan, blendSpan, *pixSpan;
+  GBool rowMode;
 #if SPLASH_CMYK
   int pixAcc0, pixAcc1, pixAcc2, pixAcc3;
 #else
@@ -2604,7 +2948,7 @@ SplashError Splash::drawImage(SplashImageSource src, void *srcData,
   SplashCoord pixMul, alphaMul, alpha;
   int x, y, x1, x2, y2;
   SplashCoord y1;
-  int nComps, n, m, i, j;
+  int nComps, bmNComps, xRow, n, m, i, j;
 
   if (debugMode) {
     printf("drawImage: srcMode=%d w=%d h=%d mat=[%.2f %.2f %.2f %.2f %.2f %.2f]\n",
@@ -2772,6 +3116,30 @@ SplashError Splash::drawImage(SplashImageSource src, void *srcData,
   // allocate pixel buffer
   pixBuf = (SplashColorPtr)gmalloc((yp + 1) * w * nComps);
 
+  // unrotated, unsheared images are drawn a row at a time, through
+  // the span kernels; otherwise, a pixel at a time
+  rowMode = !rot && yShear == 0;
+  bmNComps = splashColorModeNComps[bitmap->mode];
+  rowBuf = NULL;
+  alphaRow = NULL;
+  if (rowMode) {
+    rowBuf = (SplashColorPtr)gmallocn(scaledWidth, bmNComps);
+    if (srcAlpha) {
+      alphaRow = (SplashCoord *)gmallocn(scaledWidth, sizeof(SplashCoord));
+    }
+  } else {
+    // span kernels for pixels with alpha 1, and for the rest
+    opaqueSpan.pattern = NULL;
+    opaqueSpan.src = NULL;
+    opaqueSpan.alpha = 1;
+    opaqueSpan.srcAlpha = NULL;
+    opaqueSpan.coverage = NULL;
+    opaqueSpan.kernel = getSpanKernel(&opaqueSpan);
+    blendSpan = opaqueSpan;
+    blendSpan.alpha = 0;
+    blendSpan.kernel = getSpanKernel(&blendSpan);
+  }
+
   pixAcc0 = pixAcc1 = pixAcc2 = 0; // make gcc happy
 #if SPLASH_CMYK
   pixAcc3 = 0; // make gcc happy
@@ -2869,6 +3237,12 @@ SplashError Splash::drawImage(SplashImageSource src, void *srcData,
 	// compute the filtered pixel at (x,y) after the x and y scaling
 	// operations
 	m = xStep > 0 ? xStep : 1;
+	if (rowMode) {
+	  xRow = xSign > 0 ? x : scaledWidth - 1 - x;
+	  pixPtr = rowBuf + xRow * bmNComps;
+	} else {
+	  pixPtr = pix;
+	}
 	alphaAcc = 0;
 	switch (srcMode) {
 	case splashModeAMono8:
@@ -2934,7 +3308,7 @@ SplashError Splash::drawImage(SplashImageSource src, void *srcData,
 	if (alpha > 0) {
 	  // mono8 -> mono1 conversion, with halftoning
 	  if (halftone) {
-	    pix[0] = state->screen->test(tx + x2, ty + y2,
+	    pixPtr[0] = state->screen->test(tx + x2, ty + y2,
 			    (SplashCoord)pixAcc0 * pixMul * (1.0 / 256.0));
 
 	  // no conversion, no halftoning
@@ -2942,17 +3316,17 @@ SplashError Splash::drawImage(SplashImageSource src, void *srcData,
 	    switch (bitmap->mode) {
 #if SPLASH_CMYK
 	    case splashModeCMYK8:
-	      pix[3] = (int)((SplashCoord)pixAcc3 * pixMul);
+	      pixPtr[3] = (int)((SplashCoord)pixAcc3 * pixMul);
 	      // fall through
 #endif
 	    case splashModeRGB8:
 	    case splashModeBGR8:
-	      pix[2] = (int)((SplashCoord)pixAcc2 * pixMul);
-	      pix[1] = (int)((SplashCoord)pixAcc1 * pixMul);
+	      pixPtr[2] = (int)((SplashCoord)pixAcc2 * pixMul);
+	      pixPtr[1] = (int)((SplashCoord)pixAcc1 * pixMul);
 	      // fall through
 	    case splashModeMono1:
 	    case splashModeMono8:
-	      pix[0] = (int)((SplashCoord)pixAcc0 * pixMul);
+	      pixPtr[0] = (int)((SplashCoord)pixAcc0 * pixMul);
 	      break;
 	    default: // make gcc happy
 	      break;
@@ -2960,8 +3334,19 @@ SplashError Splash::drawImage(SplashImageSource src, void *srcData,
 	  }
 
 	  // set pixel
-	  drawPixel(tx + x2, ty + y2, pix, alpha * state->fillAlpha,
-		    clipRes2 == splashClipAllInside);
+	  if (rowMode) {
+	    alphaRow[xRow] = alpha * state->fillAlpha;
+	  } else {
+	    pixSpan = alpha * state->fillAlpha == 1 ? &opaqueSpan
+						    : &blendSpan;
+	    pixSpan->alpha = alpha * state->fillAlpha;
+	    splashColorCopy(pixSpan->color, pix);
+	    drawPixel(pixSpan, tx + x2, ty + y2,
+		      clipRes2 == splashClipAllInside);
+	  }
+	} else if (rowMode) {
+	  // not drawn
+	  alphaRow[xRow] = -1;
 	}
 
 	// x scale Bresenham
@@ -2973,6 +3358,14 @@ SplashError Splash::drawImage(SplashImageSource src, void *srcData,
 	// y shear
 	y1 += yShear1;
       }
+
+      // draw the row
+      if (rowMode) {
+	drawImageRow(rowBuf, alphaRow,
+		     xSign > 0 ? tx + k1 : tx + k1 - (scaledWidth - 1),
+		     ty + ySign * y, scaledWidth,
+		     clipRes2 == splashClipAllInside);
+      }
     }
 
   } else {
@@ -3067,6 +3460,12 @@ SplashError Splash::drawImage(SplashImageSource src, void *srcData,
 	// compute the filtered pixel at (x,y) after the x and y scaling
 	// operations
 	m = xStep > 0 ? xStep : 1;
+	if (rowMode) {
+	  xRow = xSign > 0 ? x : scaledWidth - 1 - x;
+	  pixPtr = rowBuf + xRow * bmNComps;
+	} else {
+	  pixPtr = pix;
+	}
 	switch (srcMode) {
 	case splashModeMono1:
 	case splashModeMono8:
@@ -3114,7 +3513,7 @@ SplashError Splash::drawImage(SplashImageSource src, void *srcData,
 
 	// mono8 -> mono1 conversion, with halftoning
 	if (halftone) {
-	  pix[0] = state->screen->test(tx + x2, ty + y2,
+	  pixPtr[0] = state->screen->test(tx + x2, ty + y2,
 			  (SplashCoord)pixAcc0 * pixMul * (1.0 / 256.0));
 
 	// no conversion, no halftoning
@@ -3122,17 +3521,17 @@ SplashError Splash::drawImage(SplashImageSource src, void *srcData,
 	  switch (bitmap->mode) {
 #if SPLASH_CMYK
 	  case splashModeCMYK8:
-	    pix[3] = (int)((SplashCoord)pixAcc3 * pixMul);
+	    pixPtr[3] = (int)((SplashCoord)pixAcc3 * pixMul);
 	    // fall through
 #endif
 	  case splashModeRGB8:
 	  case splashModeBGR8:
-	    pix[2] = (int)((SplashCoord)pixAcc2 * pixMul);
-	    pix[1] = (int)((SplashCoord)pixAcc1 * pixMul);
+	    pixPtr[2] = (int)((SplashCoord)pixAcc2 * pixMul);
+	    pixPtr[1] = (int)((SplashCoord)pixAcc1 * pixMul);
 	    // fall through
 	  case splashModeMono1:
 	  case splashModeMono8:
-	    pix[0] = (int)((SplashCoord)pixAcc0 * pixMul);
+	    pixPtr[0] = (int)((SplashCoord)pixAcc0 * pixMul);
 	    break;
 	  default: // make gcc happy
 	    break;
@@ -3140,8 +3539,13 @@ SplashError Splash::drawImage(SplashImageSource src, void *srcData,
 	}
 
 	// set pixel
-	drawPixel(tx + x2, ty + y2, pix, state->fillAlpha,
-		  clipRes2 == splashClipAllInside);
+	if (!rowMode) {
+	  pixSpan = state->fillAlpha == 1 ? &opaqueSpan : &blendSpan;
+	  pixSpan->alpha = state->fillAlpha;
+	  splashColorCopy(pixSpan->color, pix);
+	  drawPixel(pixSpan, tx + x2, ty + y2,
+		    clipRes2 == splashClipAllInside);
+	}
 
 	// x scale Bresenham
 	xSrc += xStep;
@@ -3152,15 +3556,62 @@ SplashError Splash::drawImage(SplashImageSource src, void *srcData,
 	// y shear
 	y1 += yShear1;
       }
+
+      // draw the row
+      if (rowMode) {
+	drawImageRow(rowBuf, alphaRow,
+		     xSign > 0 ? tx + k1 : tx + k1 - (scaledWidth - 1),
+		     ty + ySign * y, scaledWidth,
+		     clipRes2 == splashClipAllInside);
+      }
     }
 
   }
 
   gfree(pixBuf);
+  gfree(rowBuf);
+  gfree(alphaRow);
 
   return splashOk;
 }
 
+// Draw <n> image pixels <colors> at (<x0>, <y>) through the span
+// kernels.  If <alphas> is non-NULL, it holds the alpha of each pixel
+// (already multiplied by the fill alpha); pixels with negative alpha
+// are not drawn.
+void Splash::drawImageRow(SplashColorPtr colors, SplashCoord *alphas,
+			  int x0, int y, int n, GBool noClip) {
+  SplashSpan span;
+  int nComps, i, j;
+
+  span.y = y;
+  span.pattern = NULL;
+  span.alpha = state->fillAlpha;
+  span.coverage = NULL;
+  span.src = colors;
+  span.srcAlpha = alphas;
+  span.kernel = getSpanKernel(&span);
+  if (!alphas) {
+    span.x0 = x0;
+    span.x1 = x0 + n - 1;
+    drawSpanRuns(&span, noClip);
+    return;
+  }
+  nComps = splashColorModeNComps[bitmap->mode];
+  for (i = 0; i < n; i = j) {
+    if (alphas[i] < 0) {
+      j = i + 1;
+      continue;
+    }
+    for (j = i + 1; j < n && alphas[j] >= 0; ++j) ;
+    span.x0 = x0 + i;
+    span.x1 = x0 + j - 1;
+    span.src = colors + i * nComps;
+    span.srcAlpha = alphas + i;
+    drawSpanRuns(&span, noClip);
+  }
+}
+
 void Splash::dumpPath(SplashPath *path) {
   int i;
 
@@ -23,7 +23,9 @@ class SplashPattern;
 class SplashScreen;
 class SplashPath;
 class SplashXPath;
+class SplashXPathScanner;
 class SplashFont;
+struct SplashSpan;
 
 //------------------------------------------------------------------------
 
@@ -32,6 +34,13 @@ class SplashFont;
 // exhausted, returns false.
 typedef GBool (*SplashImageMaskSource)(void *data, SplashColorPtr pixel);
 
+// Retrieves the next line of an image mask as runs of "1" pixels:
+// run i covers pixels <runs>[2*i] .. <runs>[2*i+1] - 1.  Normally,
+// fills in <runs> and *<nRuns> and returns true.  If the image stream
+// is exhausted, returns false.
+typedef GBool (*SplashImageMaskRunSource)(void *data, int *runs,
+					  int *nRuns);
+
 // Retrieves the next line of pixels in an image.  Normally, fills in
 // *<line> and returns true.  If the image stream is exhausted,
 // returns false.
@@ -44,8 +53,10 @@ typedef GBool (*SplashImageSource)(void *data, SplashColorPtr line);
 class Splash {
 public:
 
-  // Create a new rasterizer object.
-  Splash(SplashBitmap *bitmapA);
+  // Create a new rasterizer object.  If <vectorAntialiasA> is set,
+  // paths (fills, strokes, and clip paths) are anti-aliased; this is
+  // ignored for Mono1 bitmaps.
+  Splash(SplashBitmap *bitmapA, GBool vectorAntialiasA = gFalse);
 
   ~Splash();
 
@@ -112,6 +123,28 @@ public:
   // Fill a path, XORing with the current fill pattern.
   SplashError xorFill(SplashPath *path, GBool eo);
 
+  // Fill a triangle with Gouraud shading, i.e., linearly interpolating
+  // the colors <color0>, <color1>, <color2> (in the bitmap's color
+  // mode) given at the three vertices.  This uses the current fill
+  // alpha and blend function, and is subject to clipping.  Returns
+  // splashErrModeMismatch for Mono1 bitmaps.
+  SplashError gouraudTriangle(SplashCoord x0, SplashCoord y0,
+			      SplashColorPtr color0,
+			      SplashCoord x1, SplashCoord y1,
+			      SplashColorPtr color1,
+			      SplashCoord x2, SplashCoord y2,
+			      SplashColorPtr color2);
+
+  // Fill a triangle with parameterized Gouraud shading: the parameter
+  // values <t0>, <t1>, <t2> (in [0,1]) are interpolated across the
+  // triangle and mapped to colors through <lookup>, which has
+  // <lookupSize> entries, with entry 0 corresponding to t = 0 and
+  // entry <lookupSize>-1 to t = 1.
+  SplashError gouraudTriangle(SplashCoord x0, SplashCoord y0, SplashCoord t0,
+			      SplashCoord x1, SplashCoord y1, SplashCoord t1,
+			      SplashCoord x2, SplashCoord y2, SplashCoord t2,
+			      SplashColor *lookup, int lookupSize);
+
   // Draw a character, using the current fill pattern.
   SplashError fillChar(SplashCoord x, SplashCoord y, int c, SplashFont *font);
 
@@ -136,6 +169,13 @@ public:
   SplashError fillImageMask(SplashImageMaskSource src, void *srcData,
 			    int w, int h, SplashCoord *mat);
 
+  // Same as fillImageMask, for a mask whose lines are read as runs,
+  // and an axis-aligned matrix (mat[1] = mat[2] = 0).  Fully covered
+  // runs of destination pixels are filled as spans.  The <runs>
+  // buffer passed to <src> has room for <w> + 1 ints.
+  SplashError fillImageMaskRuns(SplashImageMaskRunSource src, void *srcData,
+				int w, int h, SplashCoord *mat);
+
   // Draw an image.  This will read <h> lines of <w> pixels from
   // <src>, starting with the top line.  These pixels are assumed to
   // be in the source mode, <srcMode>.  The following combinations of
@@ -171,6 +211,10 @@ public:
   // clipping.
   SplashClipResult getClipRes() { return opClipRes; }
 
+  // Get/set vector anti-aliasing.
+  GBool getVectorAntialias() { return vectorAntialias; }
+  void setVectorAntialias(GBool vectorAntialiasA);
+
   // Toggle debug mode on or off.
   void setDebugMode(GBool debugModeA) { debugMode = debugModeA; }
 
@@ -179,17 +223,45 @@ private:
   void updateModX(int x);
   void updateModY(int y);
   void strokeNarrow(SplashXPath *xPath);
+  SplashClipResult strokeNarrowSeg(SplashCoord sx0, SplashCoord sy0,
+				   SplashCoord sx1, SplashCoord sy1,
+				   SplashCoord dxdy, GBool solid,
+				   SplashColorPtr color);
+  SplashClipResult strokeNarrowAASeg(SplashCoord sx0, SplashCoord sy0,
+				     SplashCoord sx1, SplashCoord sy1,
+				     GBool solid, SplashColorPtr color);
+  void drawAAPixel(int x, int y, int cov, SplashSpan *span,
+		   GBool solid, GBool noClip);
   void strokeWide(SplashXPath *xPath);
   SplashXPath *makeDashedPath(SplashXPath *xPath);
   SplashError fillWithPattern(SplashPath *path, GBool eo,
 			      SplashPattern *pattern, SplashCoord alpha);
-  void drawPixel(int x, int y, SplashColorPtr color,
-		 SplashCoord alpha, GBool noClip);
-  void drawPixel(int x, int y, SplashPattern *pattern,
-		 SplashCoord alpha, GBool noClip);
-  void drawSpan(int x0, int x1, int y, SplashPattern *pattern,
-		SplashCoord alpha, GBool noClip);
+  SplashXPathScanner *getFillScanner(SplashXPath *xPath, GBool eo);
+  typedef void (Splash::*SpanKernel)(SplashSpan *span);
+  SpanKernel getSpanKernel(SplashSpan *span);
+  void drawSpanRuns(SplashSpan *span, GBool noClip);
+  void drawSpanRuns(SplashSpan *span, int x0, int x1, int y, GBool noClip);
+  void drawPixel(SplashSpan *span, int x, int y, GBool noClip);
+  void drawAALine(Guchar *line, int x0, int x1, int y,
+		  SplashPattern *pattern, SplashCoord alpha);
+  SplashColorPtr getSpanColors(SplashSpan *span, int x, int n,
+			       SplashColorPtr buf);
+  void getSpanAlpha(SplashSpan *span, int x, int n, Guchar *buf);
+  void spanSolidMono1(SplashSpan *span);
+  void spanSolid(SplashSpan *span);
+  void spanCopyMono1(SplashSpan *span);
+  void spanCopy(SplashSpan *span);
+  void spanCoverage(SplashSpan *span);
+  void spanBlendSolid(SplashSpan *span);
+  void spanBlend(SplashSpan *span);
+  void spanBlendFunc(SplashSpan *span);
+  void spanBlendMono1(SplashSpan *span);
   void xorSpan(int x0, int x1, int y, SplashPattern *pattern, GBool noClip);
+  void drawImageRow(SplashColorPtr colors, SplashCoord *alphas,
+		    int x0, int y, int n, GBool noClip);
+  SplashError gouraudFill(SplashCoord *vx, SplashCoord *vy,
+			  SplashCoord (*vc)[splashMaxColorComps], int nChannels,
+			  SplashColor *lookup, int lookupSize);
   void dumpPath(SplashPath *path);
   void dumpXPath(SplashXPath *path);
 
@@ -198,6 +270,18 @@ private:
   SplashBitmap *softMask;
   int modXMin, modYMin, modXMax, modYMax;
   SplashClipResult opClipRes;
+  GBool vectorAntialias;	// anti-alias paths (never set for Mono1)
+  Guchar *aaBuf;		// coverage for one row, if vectorAntialias
+
+  // buffers reused by every stroke and fill, so that painting a path
+  // doesn't allocate anything once they have grown large enough
+  SplashXPath *strokeXPath;	// flattened stroke path
+  SplashXPath *dashXPath;	// dashed stroke path
+  SplashPath *strokePiece;	// one segment, cap, or join of a wide stroke
+  SplashPath *strokeOutline;	// all pieces of an anti-aliased wide stroke
+  SplashXPath *fillXPath;	// flattened fill path
+  SplashXPathScanner *fillScanner; // scanner for fillXPath (created on
+				   //   first use)
   GBool debugMode;
 };
 
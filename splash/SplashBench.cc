@@ -0,0 +1,566 @@
+//========================================================================
+//
+// SplashBench.cc
+//
+// Rasterizer timings for Splash.  Build and run with:
+//
+//   make -C splash splashbench
+//   splash/splashbench [test ...]
+//
+// where each test is one of:
+//
+//   fills      fills of large paths (ms per fill)
+//   spans      span, glyph, and image drawing for each kind of span
+//              kernel (Mpixels/s)
+//   hairlines  zero-width strokes: solid, dashed, clipped,
+//              translucent, and anti-aliased (klines/s)
+//
+// With no arguments, all tests are run.  Each line ends with a
+// checksum of the bitmap, so the output of two builds can be compared
+// for changes in rendering as well as speed.
+//
+//========================================================================
+
+#include <aconf.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <sys/time.h>
+#include "gmem.h"
+#include "SplashBitmap.h"
+#include "SplashPath.h"
+#include "SplashPattern.h"
+#include "SplashGlyphBitmap.h"
+#include "Splash.h"
+
+//------------------------------------------------------------------------
+
+#define benchW 1000
+#define benchH 1000
+
+static double getTime() {
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+// Fixed pseudo-random sequence, so runs are repeatable across
+// platforms.
+static Guint randSeed = 1;
+
+static int benchRand(int n) {
+  randSeed = randSeed * 1103515245 + 12345;
+  return (int)((randSeed >> 16) % (Guint)n);
+}
+
+static Gulong checksum(SplashBitmap *bitmap) {
+  SplashColorPtr p;
+  Gulong sum;
+  int n, i;
+
+  p = bitmap->getDataPtr();
+  n = bitmap->getRowSize() * bitmap->getHeight();
+  sum = 0;
+  for (i = 0; i < n; ++i) {
+    sum = sum * 31 + p[i];
+  }
+  return sum;
+}
+
+//------------------------------------------------------------------------
+// fills
+//------------------------------------------------------------------------
+
+// 100k-segment paths: many small quads (with and without a frame
+// around the page, which keeps a long edge active on every scanline),
+// one long polyline, and many small closed contours.
+static void benchFills() {
+  static const char *names[4] = {
+    "25k small quads", "25k small quads + frame",
+    "1 x 100k-seg polyline", "1000 x 100-seg contours"
+  };
+  SplashColor white = {255, 255, 255, 255};
+  SplashColor black = {0, 0, 0, 255};
+  SplashBitmap *bitmap;
+  Splash *splash;
+  SplashPath *path;
+  double x, y, a, r, t;
+  int kind, nReps, rep, i, j;
+
+  for (kind = 0; kind < 4; ++kind) {
+    bitmap = new SplashBitmap(benchW, benchH, 1, splashModeRGB8);
+    splash = new Splash(bitmap);
+    splash->clear(white);
+    splash->setFillPattern(new SplashSolidColor(black));
+    path = new SplashPath();
+    randSeed = 1;
+    if (kind == 0 || kind == 1) {
+      if (kind == 1) {
+	path->moveTo(1, 1);
+	path->lineTo(benchW - 1, 1);
+	path->lineTo(benchW - 1, benchH - 1);
+	path->lineTo(1, benchH - 1);
+	path->close();
+	path->moveTo(3, 3);
+	path->lineTo(3, benchH - 3);
+	path->lineTo(benchW - 3, benchH - 3);
+	path->lineTo(benchW - 3, 3);
+	path->close();
+      }
+      for (i = 0; i < 25000; ++i) {
+	x = benchRand(benchW - 10);
+	y = benchRand(benchH - 10);
+	path->moveTo(x, y);
+	path->lineTo(x + 7.3, y + 1.1);
+	path->lineTo(x + 6.1, y + 8.7);
+	path->lineTo(x - 0.4, y + 5.2);
+	path->close();
+      }
+    } else if (kind == 2) {
+      for (i = 0; i < 100000; ++i) {
+	a = 2 * M_PI * i / 100000;
+	r = 450 + 40 * sin(a * 37);
+	if (i == 0) {
+	  path->moveTo(500 + r * cos(a), 500 + r * sin(a));
+	} else {
+	  path->lineTo(500 + r * cos(a), 500 + r * sin(a));
+	}
+      }
+      path->close();
+    } else {
+      for (i = 0; i < 1000; ++i) {
+	x = 20 + (i % 40) * 24;
+	y = 20 + (i / 40) * 38;
+	for (j = 0; j < 100; ++j) {
+	  a = 2 * M_PI * j / 100;
+	  r = 10 + 2 * sin(a * 5);
+	  if (j == 0) {
+	    path->moveTo(x + r * cos(a), y + r * sin(a) * 1.5);
+	  } else {
+	    path->lineTo(x + r * cos(a), y + r * sin(a) * 1.5);
+	  }
+	}
+	path->close();
+      }
+    }
+    nReps = 5;
+    t = getTime();
+    for (rep = 0; rep < nReps; ++rep) {
+      splash->fill(path, gFalse);
+    }
+    t = getTime() - t;
+    printf("fill  %-28s %8.1f ms/fill    %016lx\n",
+	   names[kind], t / nReps * 1000, checksum(bitmap));
+    delete path;
+    delete splash;
+    delete bitmap;
+  }
+}
+
+//------------------------------------------------------------------------
+// spans
+//------------------------------------------------------------------------
+
+// Non-static pattern.
+class BenchStripes: public SplashPattern {
+public:
+
+  virtual SplashPattern *copy() { return new BenchStripes(); }
+  virtual void getColor(int x, int y, SplashColorPtr c)
+    { c[0] = x * 7; c[1] = y * 3; c[2] = x ^ y; c[3] = 9; }
+  virtual GBool isStatic() { return gFalse; }
+};
+
+// Non-normal blend mode.
+static void benchBlendMultiply(SplashColorPtr src, SplashColorPtr dest,
+			       SplashColorPtr blend, SplashColorMode cm) {
+  int i;
+
+  for (i = 0; i < splashColorModeNComps[cm]; ++i) {
+    blend[i] = (dest[i] * src[i]) / 255;
+  }
+}
+
+// Image source: a gradient with an optional alpha channel in front.
+struct BenchImage {
+  int w, nComps, y;
+  GBool alpha;
+};
+
+static GBool benchImageSrc(void *data, SplashColorPtr line) {
+  BenchImage *img;
+  int x, i;
+
+  img = (BenchImage *)data;
+  for (x = 0; x < img->w; ++x) {
+    for (i = 0; i < img->nComps; ++i) {
+      if (img->alpha && i == 0) {
+	*line++ = (x + img->y) & 0x80 ? 255 : (x * 5) & 0xff;
+      } else {
+	*line++ = (x * (i + 1) + img->y * 3) & 0xff;
+      }
+    }
+  }
+  ++img->y;
+  return gTrue;
+}
+
+// Image mask source: diagonal stripes.
+static GBool benchImageMaskSrc(void *data, SplashColorPtr line) {
+  BenchImage *img;
+  int x;
+
+  img = (BenchImage *)data;
+  for (x = 0; x < img->w; ++x) {
+    *line++ = ((x + img->y) / 3) & 1;
+  }
+  ++img->y;
+  return gTrue;
+}
+
+enum BenchSpanKind {
+  benchSolid,
+  benchAlpha,
+  benchPattern,
+  benchPatternAlpha,
+  benchClip,
+  benchSoftMask,
+  benchSoftMaskAlpha,
+  benchBlend,
+  benchGlyphAA,
+  benchGlyphAAPattern,
+  benchGlyphAAAlpha,
+  benchGlyphMono,
+  benchGlyphMonoAlpha,
+  benchImage,
+  benchImageAlpha,
+  benchImageSrcAlpha,
+  benchImageClip,
+  benchImageSkew,
+  benchImageMask,
+  benchNSpanKinds
+};
+
+static const char *benchSpanKindNames[benchNSpanKinds] = {
+  "solid", "alpha.5", "pattern", "pattern alpha.5", "path clip",
+  "soft mask", "soft mask alpha.7", "blend multiply", "glyph aa",
+  "glyph aa pattern", "glyph aa alpha.5", "glyph mono", "glyph mono alpha.5",
+  "image", "image alpha.5", "image src alpha", "image path clip",
+  "image skew src alpha", "image mask"
+};
+
+// Draws 1000x1000 bitmaps with each kind of span in each color mode.
+// Fills are 1000-pixel spans; glyphs are 20x24.
+static void benchSpans() {
+  static SplashColorMode modes[4] = {
+    splashModeMono1, splashModeMono8, splashModeRGB8, splashModeARGB8
+  };
+  static const char *modeNames[4] = { "Mono1", "Mono8", "RGB8", "ARGB8" };
+  SplashColor white = {255, 255, 255, 255};
+  SplashColor color = {200, 40, 90, 255};
+  SplashBitmap *bitmap, *mask;
+  Splash *splash;
+  SplashPath *path;
+  SplashGlyphBitmap glyphAA, glyphMono;
+  Guchar glyphAAData[20 * 24], glyphMonoData[3 * 24];
+  BenchImage img;
+  SplashCoord mat[6];
+  SplashColorMode srcMode;
+  double t, nPixels;
+  int m, kind, rep, nReps, x, y, i;
+
+  for (i = 0; i < 20 * 24; ++i) {
+    glyphAAData[i] = (i * 37) % 5 == 0 ? 0 : (Guchar)(i * 53);
+  }
+  for (i = 0; i < 3 * 24; ++i) {
+    glyphMonoData[i] = (Guchar)(0x5a ^ (i * 29));
+  }
+  glyphAA.x = glyphAA.y = glyphMono.x = glyphMono.y = 0;
+  glyphAA.w = glyphMono.w = 20;
+  glyphAA.h = glyphMono.h = 24;
+  glyphAA.aa = gTrue;
+  glyphMono.aa = gFalse;
+  glyphAA.data = glyphAAData;
+  glyphMono.data = glyphMonoData;
+  glyphAA.freeData = glyphMono.freeData = gFalse;
+
+  for (m = 0; m < 4; ++m) {
+    for (kind = 0; kind < benchNSpanKinds; ++kind) {
+      // drawImage doesn't handle ARGB8 bitmaps
+      if (kind >= benchImage && kind <= benchImageSkew &&
+	  modes[m] == splashModeARGB8) {
+	continue;
+      }
+      bitmap = new SplashBitmap(benchW, benchH, 1, modes[m]);
+      splash = new Splash(bitmap);
+      splash->clear(white);
+      if (kind == benchPattern || kind == benchPatternAlpha ||
+	  kind == benchGlyphAAPattern) {
+	splash->setFillPattern(new BenchStripes());
+      } else {
+	splash->setFillPattern(new SplashSolidColor(color));
+      }
+      if (kind == benchAlpha || kind == benchPatternAlpha ||
+	  kind == benchGlyphAAAlpha || kind == benchGlyphMonoAlpha ||
+	  kind == benchImageAlpha) {
+	splash->setFillAlpha(0.5);
+      } else if (kind == benchSoftMaskAlpha) {
+	splash->setFillAlpha(0.7);
+      }
+      if (kind == benchSoftMask || kind == benchSoftMaskAlpha) {
+	mask = new SplashBitmap(benchW, benchH, 1, splashModeMono8);
+	for (y = 0; y < benchH; ++y) {
+	  for (x = 0; x < benchW; ++x) {
+	    mask->getDataPtr()[y * mask->getRowSize() + x] =
+	        (Guchar)(x * 3 + y);
+	  }
+	}
+	splash->setSoftMask(mask);
+      }
+      if (kind == benchBlend) {
+	splash->setBlendFunc(&benchBlendMultiply);
+      }
+      if (kind == benchClip || kind == benchImageClip) {
+	path = new SplashPath();
+	path->moveTo(0, 0);
+	path->lineTo(benchW, 100);
+	path->lineTo(500, benchH);
+	path->close();
+	splash->clipToPath(path, gFalse);
+	delete path;
+      }
+
+      nPixels = 0;
+      nReps = 10;
+      t = getTime();
+      for (rep = 0; rep < nReps; ++rep) {
+	if (kind >= benchGlyphAA && kind <= benchGlyphMonoAlpha) {
+	  for (y = 30; y < benchH - 30; y += 25) {
+	    for (x = 30; x < benchW - 30; x += 21) {
+	      splash->fillGlyph(x + rep % 3, y,
+				kind >= benchGlyphMono ? &glyphMono : &glyphAA);
+	      nPixels += 20 * 24;
+	    }
+	  }
+	} else if (kind == benchImageMask) {
+	  // scaled down 1.5x, so edge pixels are partly covered
+	  img.w = 1500 + rep;
+	  img.y = 0;
+	  mat[0] = benchW;
+	  mat[1] = 0;
+	  mat[2] = 0;
+	  mat[3] = -benchH;
+	  mat[4] = 0;
+	  mat[5] = benchH;
+	  splash->fillImageMask(&benchImageMaskSrc, &img, img.w, 1500, mat);
+	  nPixels += (double)benchW * benchH;
+	} else if (kind >= benchImage) {
+	  switch (modes[m]) {
+	  case splashModeMono1:
+	  case splashModeMono8:
+	    srcMode = (kind == benchImageSrcAlpha || kind == benchImageSkew)
+	                ? splashModeAMono8 : splashModeMono8;
+	    break;
+	  default:
+	    srcMode = (kind == benchImageSrcAlpha || kind == benchImageSkew)
+	                ? splashModeARGB8 : splashModeRGB8;
+	    break;
+	  }
+	  img.w = 400 + rep;
+	  img.nComps = splashColorModeNComps[srcMode];
+	  img.y = 0;
+	  img.alpha = kind == benchImageSrcAlpha || kind == benchImageSkew;
+	  if (kind == benchImageSkew) {
+	    // sheared, so it's drawn a pixel at a time
+	    mat[0] = 700;
+	    mat[1] = 200;
+	    mat[2] = 0;
+	    mat[3] = -700;
+	    mat[4] = 100;
+	    mat[5] = 750;
+	    nPixels += 700.0 * 700;
+	  } else {
+	    // scaled up 2.5x, flipped vertically, like a page image
+	    mat[0] = benchW;
+	    mat[1] = 0;
+	    mat[2] = 0;
+	    mat[3] = -benchH;
+	    mat[4] = 0;
+	    mat[5] = benchH;
+	    nPixels += (double)benchW * benchH;
+	  }
+	  splash->drawImage(&benchImageSrc, &img, srcMode, img.w, 400, mat);
+	} else {
+	  for (y = 0; y < benchH; y += 50) {
+	    path = new SplashPath();
+	    path->moveTo(rep % 7, y + 0.5);
+	    path->lineTo(benchW - rep % 5, y + 0.5);
+	    path->lineTo(benchW - rep % 5, y + 40.5);
+	    path->lineTo(rep % 7, y + 40.5);
+	    path->close();
+	    splash->fill(path, gFalse);
+	    delete path;
+	    nPixels += benchW * 41;
+	  }
+	}
+      }
+      t = getTime() - t;
+      printf("span  %-6s %-20s %8.1f Mpixels/s %016lx\n",
+	     modeNames[m], benchSpanKindNames[kind], nPixels / t / 1e6,
+	     checksum(bitmap));
+      delete splash;
+      delete bitmap;
+    }
+  }
+}
+
+//------------------------------------------------------------------------
+// hairlines
+//------------------------------------------------------------------------
+
+enum BenchHairlineKind {
+  benchHairSolid,
+  benchHairDashed,
+  benchHairClip,
+  benchHairAlpha,
+  benchHairWidth1,
+  benchHairAA,
+  benchHairAADashed,
+  benchNHairlineKinds
+};
+
+static const char *benchHairlineKindNames[benchNHairlineKinds] = {
+  "solid", "dashed", "path clip", "alpha.5", "width 1", "aa", "aa dashed"
+};
+
+#define benchNHairlines 200000
+
+// Strokes 200k random lines, 1 to 40 pixels long, some of them
+// partly off the page, in each color mode (anti-aliasing isn't
+// available in Mono1).  "width 1" is the same lines with a line width
+// of 1, which is drawn the same way.  Each time is the best of three
+// runs.
+static void benchHairlines() {
+  static SplashColorMode modes[4] = {
+    splashModeMono1, splashModeMono8, splashModeRGB8, splashModeARGB8
+  };
+  static const char *modeNames[4] = { "Mono1", "Mono8", "RGB8", "ARGB8" };
+  SplashColor white = {255, 255, 255, 255};
+  SplashColor color = {0, 40, 200, 255};
+  SplashCoord dash[2] = {4, 3};
+  SplashBitmap *bitmap;
+  Splash *splash;
+  SplashPath *path;
+  SplashCoord *lines;
+  double x, y, a, r, t, best;
+  Gulong sum;
+  int m, kind, rep, i;
+
+  lines = (SplashCoord *)gmallocn(4 * benchNHairlines, sizeof(SplashCoord));
+  randSeed = 1;
+  for (i = 0; i < benchNHairlines; ++i) {
+    x = benchRand(benchW + 40) - 20;
+    y = benchRand(benchH + 40) - 20;
+    a = 2 * M_PI * benchRand(3600) / 3600;
+    r = 1 + benchRand(390) / 10.0;
+    lines[4*i] = x;
+    lines[4*i+1] = y;
+    lines[4*i+2] = x + r * cos(a);
+    lines[4*i+3] = y + r * sin(a);
+  }
+
+  for (m = 0; m < 4; ++m) {
+    for (kind = 0; kind < benchNHairlineKinds; ++kind) {
+      if (kind >= benchHairAA && modes[m] == splashModeMono1) {
+	continue;
+      }
+      best = 0;
+      sum = 0;
+      for (rep = 0; rep < 3; ++rep) {
+	bitmap = new SplashBitmap(benchW, benchH, 1, modes[m]);
+	splash = new Splash(bitmap, kind >= benchHairAA);
+	splash->clear(white);
+	splash->setStrokePattern(new SplashSolidColor(color));
+	splash->setLineWidth(kind == benchHairWidth1 ? 1 : 0);
+	if (kind == benchHairAlpha) {
+	  splash->setStrokeAlpha(0.5);
+	}
+	if (kind == benchHairDashed || kind == benchHairAADashed) {
+	  splash->setLineDash(dash, 2, 1);
+	}
+	if (kind == benchHairClip) {
+	  path = new SplashPath();
+	  path->moveTo(500, 20);
+	  path->lineTo(980, 500);
+	  path->lineTo(500, 980);
+	  path->lineTo(20, 500);
+	  path->close();
+	  splash->clipToPath(path, gFalse);
+	  delete path;
+	}
+	t = getTime();
+	for (i = 0; i < benchNHairlines; ++i) {
+	  path = new SplashPath();
+	  path->moveTo(lines[4*i], lines[4*i+1]);
+	  path->lineTo(lines[4*i+2], lines[4*i+3]);
+	  splash->stroke(path);
+	  delete path;
+	}
+	t = getTime() - t;
+	if (rep == 0 || t < best) {
+	  best = t;
+	}
+	sum = checksum(bitmap);
+	delete splash;
+	delete bitmap;
+      }
+      printf("line  %-6s %-20s %8.0f klines/s  %016lx\n",
+	     modeNames[m], benchHairlineKindNames[kind],
+	     benchNHairlines / best / 1000, sum);
+    }
+  }
+  gfree(lines);
+}
+
+//------------------------------------------------------------------------
+
+struct BenchTest {
+  const char *name;
+  void (*func)();
+};
+
+static BenchTest benchTests[] = {
+  { "fills",     &benchFills },
+  { "spans",     &benchSpans },
+  { "hairlines", &benchHairlines },
+  { NULL,        NULL }
+};
+
+int main(int argc, char *argv[]) {
+  int i, j;
+
+  if (argc < 2) {
+    for (j = 0; benchTests[j].name; ++j) {
+      (*benchTests[j].func)();
+    }
+    return 0;
+  }
+  for (i = 1; i < argc; ++i) {
+    for (j = 0; benchTests[j].name; ++j) {
+      if (!strcmp(argv[i], benchTests[j].name)) {
+	break;
+      }
+    }
+    if (!benchTests[j].name) {
+      fprintf(stderr, "Usage: splashbench [test ...]\n  tests:");
+      for (j = 0; benchTests[j].name; ++j) {
+	fprintf(stderr, " %s", benchTests[j].name);
+      }
+      fprintf(stderr, "\n");
+      return 1;
+    }
+    (*benchTests[j].func)();
+  }
+  return 0;
+}
@@ -50,6 +50,12 @@ SplashClip::SplashClip(SplashCoord x0, SplashCoord y0,
   flags = NULL;
   scanners = NULL;
   length = size = 0;
+  spans = spansTmp = NULL;
+  nSpans = spansSize = 0;
+  spansY = 0;
+  spansValid = gFalse;
+  aaBuf = NULL;
+  aaBufSize = 0;
 }
 
 SplashClip::SplashClip(SplashClip *clip) {
@@ -70,6 +76,12 @@ SplashClip::SplashClip(SplashClip *clip) {
     flags[i] = clip->flags[i];
     scanners[i] = new SplashXPathScanner(paths[i], flags[i] & splashClipEO);
   }
+  spans = spansTmp = NULL;
+  nSpans = spansSize = 0;
+  spansY = 0;
+  spansValid = gFalse;
+  aaBuf = NULL;
+  aaBufSize = 0;
 }
 
 SplashClip::~SplashClip() {
@@ -82,6 +94,9 @@ SplashClip::~SplashClip() {
   gfree(paths);
   gfree(flags);
   gfree(scanners);
+  gfree(spans);
+  gfree(spansTmp);
+  gfree(aaBuf);
 }
 
 void SplashClip::grow(int nPaths) {
@@ -114,6 +129,7 @@ void SplashClip::resetToRect(SplashCoord x0, SplashCoord y0,
   flags = NULL;
   scanners = NULL;
   length = size = 0;
+  spansValid = gFalse;
 
   if (x0 < x1) {
     xMin = splashFloor(x0);
@@ -161,14 +177,22 @@ SplashError SplashClip::clipToRect(SplashCoord x0, SplashCoord y0,
   if (y1I < yMax) {
     yMax = y1I;
   }
+  spansValid = gFalse;
   return splashOk;
 }
 
 SplashError SplashClip::clipToPath(SplashPath *path, SplashCoord flatness,
 				   GBool eo) {
   SplashXPath *xPath;
+  SplashCoord x0, y0, x1, y1;
+
+  // check for a rectangle (e.g., "re W n") before expanding the path
+  if (path->getRect(&x0, &y0, &x1, &y1)) {
+    return clipToRect(x0, y0, x1, y1);
+  }
 
   xPath = new SplashXPath(path, flatness, gTrue);
+  spansValid = gFalse;
 
   // check for an empty path
   if (xPath->length == 0) {
@@ -225,15 +249,23 @@ GBool SplashClip::test(int x, int y) {
   if (x < xMin || x > xMax || y < yMin || y > yMax) {
     return gFalse;
   }
+  if (length == 0) {
+    return gTrue;
+  }
 
-  // check the paths
-  for (i = 0; i < length; ++i) {
-    if (!scanners[i]->test(x, y)) {
+  // check the paths, using the (cached) span list for this row
+  if (!spansValid || y != spansY) {
+    computeSpans(y);
+  }
+  for (i = 0; i < nSpans; ++i) {
+    if (x < spans[2*i]) {
       return gFalse;
     }
+    if (x <= spans[2*i+1]) {
+      return gTrue;
+    }
   }
-
-  return gTrue;
+  return gFalse;
 }
 
 SplashClipResult SplashClip::testRect(int rectXMin, int rectYMin,
@@ -268,3 +300,115 @@ SplashClipResult SplashClip::testSpan(int spanXMin, int spanXMax, int spanY) {
   }
   return splashClipAllInside;
 }
+
+int *SplashClip::getSpans(int y, int *nSpansA) {
+  if (!spansValid || y != spansY) {
+    computeSpans(y);
+  }
+  *nSpansA = nSpans;
+  return spans;
+}
+
+void SplashClip::clipAALine(Guchar *line, int x0, int x1, int y) {
+  Guchar *p;
+  int n, xx0, xx1, v, i, x;
+
+  n = x1 - x0 + 1;
+  if (n <= 0) {
+    return;
+  }
+  if (y < yMin || y > yMax || x1 < xMin || x0 > xMax) {
+    memset(line, 0, n);
+    return;
+  }
+  if (x0 < xMin) {
+    memset(line, 0, xMin - x0);
+  }
+  if (x1 > xMax) {
+    memset(line + (xMax + 1 - x0), 0, x1 - xMax);
+  }
+  if (length == 0) {
+    return;
+  }
+
+  if (n > aaBufSize) {
+    gfree(aaBuf);
+    aaBufSize = n;
+    aaBuf = (Guchar *)gmalloc(aaBufSize);
+  }
+  for (i = 0; i < length; ++i) {
+    scanners[i]->renderAALine(aaBuf, x0, x1, y, &xx0, &xx1);
+    if (xx0 > xx1) {
+      memset(line, 0, n);
+      return;
+    }
+    if (xx0 > x0) {
+      memset(line, 0, xx0 - x0);
+    }
+    if (xx1 < x1) {
+      memset(line + (xx1 + 1 - x0), 0, x1 - xx1);
+    }
+    for (x = xx0, p = line + (xx0 - x0); x <= xx1; ++x, ++p) {
+      if (*p) {
+	// div255(*p * coverage)
+	v = *p * aaBuf[x - x0] + 128;
+	*p = (Guchar)((v + (v >> 8)) >> 8);
+      }
+    }
+  }
+}
+
+// Start with the rectangle's span, then intersect the list with the
+// spans of each path in turn.  Both lists are sorted and disjoint, so
+// each intersection is a single merge pass.
+void SplashClip::computeSpans(int y) {
+  int *t;
+  int n, i, j, k, x0, x1, xx0, xx1;
+
+  spansY = y;
+  spansValid = gTrue;
+  nSpans = 0;
+  if (y < yMin || y > yMax || xMin > xMax) {
+    return;
+  }
+  growSpans(1);
+  spans[0] = xMin;
+  spans[1] = xMax;
+  nSpans = 1;
+
+  for (i = 0; i < length && nSpans > 0; ++i) {
+    n = 0;
+    j = 0;
+    scanners[i]->rewindSpans(y);
+    while (j < nSpans && scanners[i]->getNextSpan(y, &x0, &x1)) {
+      while (j < nSpans && spans[2*j+1] < x0) {
+	++j;
+      }
+      for (k = j; k < nSpans && spans[2*k] <= x1; ++k) {
+	xx0 = spans[2*k] > x0 ? spans[2*k] : x0;
+	xx1 = spans[2*k+1] < x1 ? spans[2*k+1] : x1;
+	growSpans(n + 1);
+	spansTmp[2*n] = xx0;
+	spansTmp[2*n+1] = xx1;
+	++n;
+      }
+    }
+    t = spans;
+    spans = spansTmp;
+    spansTmp = t;
+    nSpans = n;
+  }
+}
+
+void SplashClip::growSpans(int n) {
+  if (n > spansSize) {
+    if (spansSize == 0) {
+      spansSize = 8;
+    }
+    while (spansSize < n) {
+      spansSize *= 2;
+    }
+    spans = (int *)greallocn(spans, 2 * spansSize, sizeof(int));
+    spansTmp = (int *)greallocn(spansTmp, 2 * spansSize, sizeof(int));
+  }
+}
@@ -73,6 +73,21 @@ public:
   // Similar to testRect, but tests a horizontal span.
   SplashClipResult testSpan(int spanXMin, int spanXMax, int spanY);
 
+  // Returns the visible part of row <y> as a list of <*nSpansA>
+  // disjoint spans, sorted left to right: span i covers
+  // [spans[2*i], spans[2*i+1]].  This is the intersection of the
+  // rectangle with all of the paths.  The list for the most recent
+  // row is cached (until the clip region is changed), so drawing
+  // several spans on one row computes it once.  The returned array
+  // belongs to the SplashClip.
+  int *getSpans(int y, int *nSpansA);
+
+  // Scale the anti-aliased coverage values in <line>, which cover
+  // [<x0>,<x1>] on row <y>, by the clip region: pixels outside the
+  // rectangle are cleared, and each path multiplies in its own
+  // anti-aliased coverage.
+  void clipAALine(Guchar *line, int x0, int x1, int y);
+
   // Get the rectangle part of the clip region.
   int getXMin() { return xMin; }
   int getXMax() { return xMax; }
@@ -86,12 +101,24 @@ private:
 
   SplashClip(SplashClip *clip);
   void grow(int nPaths);
+  void computeSpans(int y);
+  void growSpans(int n);
 
   int xMin, yMin, xMax, yMax;
   SplashXPath **paths;
   Guchar *flags;
   SplashXPathScanner **scanners;
   int length, size;
+
+  int *spans;			// visible spans at row <spansY>
+  int *spansTmp;		// scratch list used by computeSpans
+  int nSpans;			// number of spans in <spans>
+  int spansSize;		// size of <spans> and <spansTmp>, in spans
+  int spansY;			// row for which <spans> is valid
+  GBool spansValid;		// false if <spans> needs to be recomputed
+
+  Guchar *aaBuf;		// path coverage - used by clipAALine
+  int aaBufSize;		// size of <aaBuf>
 };
 
 #endif
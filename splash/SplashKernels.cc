@@ -0,0 +1,632 @@
+//========================================================================
+//
+// SplashKernels.cc
+//
+//========================================================================
+
+#include <aconf.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include <string.h>
+#include "SplashKernels.h"
+
+// The SSE2 code is compiled with a per-function target attribute, so
+// it's available on 32-bit x86 builds that aren't compiled with
+// -msse2; whether it's actually used is decided at run time.  Other
+// CPUs (ARM) use the word versions.
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__)) && \
+    (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define SPLASH_SSE2 1
+#include <emmintrin.h>
+#define SSE2_FUNC __attribute__((target("sse2")))
+#else
+#define SPLASH_SSE2 0
+#endif
+
+//------------------------------------------------------------------------
+
+typedef void (*FillSpanFunc)(SplashColorPtr dest, SplashColorPtr color,
+			     int nComps, int n);
+typedef void (*BlendSpanFunc)(SplashColorPtr dest, SplashColorPtr color,
+			      int nComps, int alpha, int n);
+typedef void (*BlendSpanMaskFunc)(SplashColorPtr dest, SplashColorPtr color,
+				  int nComps, Guchar *alpha, GBool skipZero,
+				  int n);
+typedef void (*BlendSpanRowFunc)(SplashColorPtr dest, SplashColorPtr src,
+				 int nComps, Guchar *alpha, GBool skipZero,
+				 int n);
+typedef void (*MulAlphaSpanFunc)(Guchar *dest, Guchar *mask, double alpha,
+				 int n);
+
+static void fillSpanC(SplashColorPtr dest, SplashColorPtr color,
+		      int nComps, int n);
+static void blendSpanC(SplashColorPtr dest, SplashColorPtr color,
+		       int nComps, int alpha, int n);
+static void blendSpanMaskC(SplashColorPtr dest, SplashColorPtr color,
+			   int nComps, Guchar *alpha, GBool skipZero, int n);
+static void blendSpanRowC(SplashColorPtr dest, SplashColorPtr src,
+			  int nComps, Guchar *alpha, GBool skipZero, int n);
+static void mulAlphaSpanC(Guchar *dest, Guchar *mask, double alpha, int n);
+static void fillSpanWord(SplashColorPtr dest, SplashColorPtr color,
+			 int nComps, int n);
+static void blendSpanWord(SplashColorPtr dest, SplashColorPtr color,
+			  int nComps, int alpha, int n);
+static void blendSpanMaskWord(SplashColorPtr dest, SplashColorPtr color,
+			      int nComps, Guchar *alpha, GBool skipZero,
+			      int n);
+static void blendSpanRowWord(SplashColorPtr dest, SplashColorPtr src,
+			     int nComps, Guchar *alpha, GBool skipZero,
+			     int n);
+
+static GBool kernelsInited = gFalse;
+static SplashKernelsImpl kernelsImpl = splashKernelsC;
+static FillSpanFunc fillSpanFunc = &fillSpanC;
+static BlendSpanFunc blendSpanFunc = &blendSpanC;
+static BlendSpanMaskFunc blendSpanMaskFunc = &blendSpanMaskC;
+static BlendSpanRowFunc blendSpanRowFunc = &blendSpanRowC;
+static MulAlphaSpanFunc mulAlphaSpanFunc = &mulAlphaSpanC;
+
+//------------------------------------------------------------------------
+// portable versions
+//------------------------------------------------------------------------
+
+static void fillSpanC(SplashColorPtr dest, SplashColorPtr color,
+		      int nComps, int n) {
+  int i, j;
+
+  if (nComps == 1) {
+    memset(dest, color[0], n);
+    return;
+  }
+  for (i = 0; i < n; ++i) {
+    for (j = 0; j < nComps; ++j) {
+      *dest++ = color[j];
+    }
+  }
+}
+
+static void blendSpanC(SplashColorPtr dest, SplashColorPtr color,
+		       int nComps, int alpha, int n) {
+  int ialpha, i, j;
+
+  ialpha = 255 - alpha;
+  for (i = 0; i < n; ++i) {
+    for (j = 0; j < nComps; ++j) {
+      // note: floor(x / 255) = x >> 8 (for 16-bit x)
+      dest[j] = (alpha * color[j] + ialpha * dest[j]) >> 8;
+    }
+    dest += nComps;
+  }
+}
+
+static void blendSpanMaskC(SplashColorPtr dest, SplashColorPtr color,
+			   int nComps, Guchar *alpha, GBool skipZero, int n) {
+  int a, ia, i, j;
+
+  for (i = 0; i < n; ++i) {
+    a = alpha[i];
+    if (a || !skipZero) {
+      ia = 255 - a;
+      for (j = 0; j < nComps; ++j) {
+	dest[j] = (a * color[j] + ia * dest[j]) >> 8;
+      }
+    }
+    dest += nComps;
+  }
+}
+
+static void blendSpanRowC(SplashColorPtr dest, SplashColorPtr src,
+			  int nComps, Guchar *alpha, GBool skipZero, int n) {
+  int a, ia, i, j;
+
+  for (i = 0; i < n; ++i) {
+    a = alpha[i];
+    if (a || !skipZero) {
+      ia = 255 - a;
+      for (j = 0; j < nComps; ++j) {
+	dest[j] = (a * src[j] + ia * dest[j]) >> 8;
+      }
+    }
+    dest += nComps;
+    src += nComps;
+  }
+}
+
+static void mulAlphaSpanC(Guchar *dest, Guchar *mask, double alpha, int n) {
+  int i;
+
+  for (i = 0; i < n; ++i) {
+    dest[i] = (int)(alpha * mask[i]);
+  }
+}
+
+//------------------------------------------------------------------------
+// word versions
+//------------------------------------------------------------------------
+
+// These work on bytes packed into integers, with every other byte
+// moved into its own 16-bit lane: (a * c + (255 - a) * d) is at most
+// 255 * 255, so it never carries into the next lane.  Loads and stores
+// go through memcpy, so alignment and byte order don't matter.
+
+typedef unsigned long KWord;
+
+#define kWordSize ((int)sizeof(KWord))
+
+// 0x00ff00ff...
+#define kWordLanes (~(KWord)0 / 0xffff * 0xff)
+#define kGuintLanes 0x00ff00ffU
+
+// Repeat <color> across <buf>, which holds three words: that's a
+// whole number of pixels for 1, 2, 3, or 4 components.
+static void makeWordPattern(Guchar *buf, SplashColorPtr color, int nComps) {
+  int i;
+
+  for (i = 0; i < 3 * kWordSize; ++i) {
+    buf[i] = color[i % nComps];
+  }
+}
+
+static void fillSpanWord(SplashColorPtr dest, SplashColorPtr color,
+			 int nComps, int n) {
+  Guchar pat[3 * kWordSize];
+  int nBytes;
+
+  nBytes = n * nComps;
+  if (nComps == 1 || nComps > 4 || nBytes < 3 * kWordSize) {
+    fillSpanC(dest, color, nComps, n);
+    return;
+  }
+  makeWordPattern(pat, color, nComps);
+  for (; nBytes >= 3 * kWordSize; nBytes -= 3 * kWordSize) {
+    memcpy(dest, pat, 3 * kWordSize);
+    dest += 3 * kWordSize;
+  }
+  fillSpanC(dest, color, nComps, nBytes / nComps);
+}
+
+static void blendSpanWord(SplashColorPtr dest, SplashColorPtr color,
+			  int nComps, int alpha, int n) {
+  Guchar pat[3 * kWordSize];
+  KWord c, d, acLo[3], acHi[3];
+  int ialpha, nBytes, k;
+
+  nBytes = n * nComps;
+  if (nComps > 4 || nBytes < 3 * kWordSize) {
+    blendSpanC(dest, color, nComps, alpha, n);
+    return;
+  }
+  makeWordPattern(pat, color, nComps);
+  // alpha * color, for each word of the three-word period
+  for (k = 0; k < 3; ++k) {
+    memcpy(&c, pat + k * kWordSize, kWordSize);
+    acLo[k] = (c & kWordLanes) * alpha;
+    acHi[k] = ((c >> 8) & kWordLanes) * alpha;
+  }
+  ialpha = 255 - alpha;
+  for (; nBytes >= 3 * kWordSize; nBytes -= 3 * kWordSize) {
+    for (k = 0; k < 3; ++k, dest += kWordSize) {
+      memcpy(&d, dest, kWordSize);
+      d = (((acLo[k] + (d & kWordLanes) * ialpha) >> 8) & kWordLanes) |
+	  ((acHi[k] + ((d >> 8) & kWordLanes) * ialpha) & (kWordLanes << 8));
+      memcpy(dest, &d, kWordSize);
+    }
+  }
+  blendSpanC(dest, color, nComps, alpha, nBytes / nComps);
+}
+
+// Blend the 4-byte pixel at <dest> with color <c> and alpha <a>.
+static inline void blendPixelWord(SplashColorPtr dest, Guint c, int a) {
+  Guint d;
+  int ia;
+
+  memcpy(&d, dest, 4);
+  ia = 255 - a;
+  d = ((((c & kGuintLanes) * a + (d & kGuintLanes) * ia) >> 8) &
+       kGuintLanes) |
+      ((((c >> 8) & kGuintLanes) * a + ((d >> 8) & kGuintLanes) * ia) &
+       (kGuintLanes << 8));
+  memcpy(dest, &d, 4);
+}
+
+// Returns true if the word of alpha values at <alpha> is all zero.
+static inline GBool zeroAlphaWord(Guchar *alpha) {
+  KWord a;
+
+  memcpy(&a, alpha, kWordSize);
+  return a == 0;
+}
+
+// With per-pixel alpha, only 4-byte pixels gain from packing: they
+// are done a 32-bit word (two multiplies) per pixel, with runs of zero
+// alpha skipped a word at a time.  Smaller pixels go a byte at a time.
+// (A word per 3-byte pixel would overlap the previous pixel's store,
+// which is slower than bytes.)
+static void blendSpanMaskWord(SplashColorPtr dest, SplashColorPtr color,
+			      int nComps, Guchar *alpha, GBool skipZero,
+			      int n) {
+  Guint c;
+  int i, a;
+
+  if (nComps != 4) {
+    blendSpanMaskC(dest, color, nComps, alpha, skipZero, n);
+    return;
+  }
+  memcpy(&c, color, 4);
+  for (i = 0; i < n; ++i, dest += 4) {
+    if (skipZero && i + kWordSize <= n && zeroAlphaWord(alpha + i)) {
+      i += kWordSize - 1;
+      dest += 4 * (kWordSize - 1);
+      continue;
+    }
+    a = alpha[i];
+    if (a || !skipZero) {
+      blendPixelWord(dest, c, a);
+    }
+  }
+}
+
+static void blendSpanRowWord(SplashColorPtr dest, SplashColorPtr src,
+			     int nComps, Guchar *alpha, GBool skipZero,
+			     int n) {
+  Guint c;
+  int i, a;
+
+  if (nComps != 4) {
+    blendSpanRowC(dest, src, nComps, alpha, skipZero, n);
+    return;
+  }
+  for (i = 0; i < n; ++i, dest += 4, src += 4) {
+    if (skipZero && i + kWordSize <= n && zeroAlphaWord(alpha + i)) {
+      i += kWordSize - 1;
+      dest += 4 * (kWordSize - 1);
+      src += 4 * (kWordSize - 1);
+      continue;
+    }
+    a = alpha[i];
+    if (a || !skipZero) {
+      memcpy(&c, src, 4);
+      blendPixelWord(dest, c, a);
+    }
+  }
+}
+
+//------------------------------------------------------------------------
+// SSE2 versions
+//------------------------------------------------------------------------
+
+#if SPLASH_SSE2
+
+// Repeat <color> across four 16-byte vectors.  Any 16*k bytes
+// starting at a pixel boundary, k <= nComps, then match the first k
+// vectors.  (The SSE2 versions only handle 1 to 4 components.)
+SSE2_FUNC static void makePattern(__m128i *pat, SplashColorPtr color,
+				  int nComps) {
+  Guint w0, w1, w2;
+
+  switch (nComps) {
+  case 1:
+    pat[0] = pat[1] = pat[2] = pat[3] = _mm_set1_epi8((char)color[0]);
+    break;
+  case 2:
+    pat[0] = pat[1] = pat[2] = pat[3] =
+      _mm_set1_epi16((short)(color[0] | (color[1] << 8)));
+    break;
+  case 3:
+    // the 48-byte period is three copies of these three words
+    w0 = color[0] | (color[1] << 8) | (color[2] << 16) |
+	 ((Guint)color[0] << 24);
+    w1 = color[1] | (color[2] << 8) | (color[0] << 16) |
+	 ((Guint)color[1] << 24);
+    w2 = color[2] | (color[0] << 8) | (color[1] << 16) |
+	 ((Guint)color[2] << 24);
+    pat[0] = _mm_set_epi32((int)w0, (int)w2, (int)w1, (int)w0);
+    pat[1] = _mm_set_epi32((int)w1, (int)w0, (int)w2, (int)w1);
+    pat[2] = _mm_set_epi32((int)w2, (int)w1, (int)w0, (int)w2);
+    break;
+  case 4:
+    pat[0] = pat[1] = pat[2] = pat[3] =
+      _mm_set1_epi32((int)(color[0] | (color[1] << 8) |
+			   (color[2] << 16) | ((Guint)color[3] << 24)));
+    break;
+  }
+}
+
+SSE2_FUNC static void fillSpanSSE2(SplashColorPtr dest, SplashColorPtr color,
+				   int nComps, int n) {
+  __m128i pat[4];
+  int nBytes;
+
+  nBytes = n * nComps;
+  if (nComps == 1 || nComps > 4 || nBytes < 64) {
+    fillSpanC(dest, color, nComps, n);
+    return;
+  }
+  // 48 bytes is a whole number of pixels for 1, 2, 3, or 4 components
+  makePattern(pat, color, nComps);
+  for (; nBytes >= 48; nBytes -= 48, dest += 48) {
+    _mm_storeu_si128((__m128i *)dest, pat[0]);
+    _mm_storeu_si128((__m128i *)(dest + 16), pat[1]);
+    _mm_storeu_si128((__m128i *)(dest + 32), pat[2]);
+  }
+  fillSpanC(dest, color, nComps, nBytes / nComps);
+}
+
+SSE2_FUNC static void blendSpanSSE2(SplashColorPtr dest, SplashColorPtr color,
+				    int nComps, int alpha, int n) {
+  __m128i pat[4], zero, ia16, as16[6], d, dLo, dHi;
+  int ialpha, nBytes, k;
+
+  nBytes = n * nComps;
+  if (nComps > 4 || nBytes < 48) {
+    blendSpanC(dest, color, nComps, alpha, n);
+    return;
+  }
+  makePattern(pat, color, nComps);
+  zero = _mm_setzero_si128();
+  ialpha = 255 - alpha;
+  ia16 = _mm_set1_epi16((short)ialpha);
+  // alpha * color, for each 16-byte chunk of the 48-byte period
+  for (k = 0; k < 3; ++k) {
+    d = pat[k];
+    as16[2*k] = _mm_mullo_epi16(_mm_unpacklo_epi8(d, zero),
+				_mm_set1_epi16((short)alpha));
+    as16[2*k+1] = _mm_mullo_epi16(_mm_unpackhi_epi8(d, zero),
+				  _mm_set1_epi16((short)alpha));
+  }
+  for (; nBytes >= 48; nBytes -= 48) {
+    for (k = 0; k < 3; ++k, dest += 16) {
+      // max value is 255 * 255, which fits in an unsigned 16-bit lane
+      d = _mm_loadu_si128((__m128i *)dest);
+      dLo = _mm_add_epi16(as16[2*k],
+			  _mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), ia16));
+      dHi = _mm_add_epi16(as16[2*k+1],
+			  _mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), ia16));
+      d = _mm_packus_epi16(_mm_srli_epi16(dLo, 8), _mm_srli_epi16(dHi, 8));
+      _mm_storeu_si128((__m128i *)dest, d);
+    }
+  }
+  blendSpanC(dest, color, nComps, alpha, nBytes / nComps);
+}
+
+// Spread the 16 alpha values in <a> (which were loaded from <alpha>)
+// out to one per byte of 16 pixels of <nComps> bytes each.
+SSE2_FUNC static inline void spreadAlpha(__m128i *a8, __m128i a,
+					 Guchar *alpha, int nComps) {
+  Guchar aBuf[48];
+  __m128i t;
+  int j;
+
+  switch (nComps) {
+  case 1:
+    a8[0] = a;
+    break;
+  case 2:
+    a8[0] = _mm_unpacklo_epi8(a, a);
+    a8[1] = _mm_unpackhi_epi8(a, a);
+    break;
+  case 3:
+    for (j = 0; j < 16; ++j) {
+      aBuf[3*j] = aBuf[3*j+1] = aBuf[3*j+2] = alpha[j];
+    }
+    a8[0] = _mm_loadu_si128((__m128i *)aBuf);
+    a8[1] = _mm_loadu_si128((__m128i *)(aBuf + 16));
+    a8[2] = _mm_loadu_si128((__m128i *)(aBuf + 32));
+    break;
+  case 4:
+    t = _mm_unpacklo_epi8(a, a);
+    a8[0] = _mm_unpacklo_epi16(t, t);
+    a8[1] = _mm_unpackhi_epi16(t, t);
+    t = _mm_unpackhi_epi8(a, a);
+    a8[2] = _mm_unpacklo_epi16(t, t);
+    a8[3] = _mm_unpackhi_epi16(t, t);
+    break;
+  }
+}
+
+// (a * c + (255 - a) * d) >> 8, for 16 bytes.
+SSE2_FUNC static inline __m128i blend16(__m128i c, __m128i d, __m128i a) {
+  __m128i zero, ff16, aLo, aHi, rLo, rHi;
+
+  zero = _mm_setzero_si128();
+  ff16 = _mm_set1_epi16(255);
+  aLo = _mm_unpacklo_epi8(a, zero);
+  aHi = _mm_unpackhi_epi8(a, zero);
+  rLo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(c, zero), aLo),
+		      _mm_mullo_epi16(_mm_unpacklo_epi8(d, zero),
+				      _mm_sub_epi16(ff16, aLo)));
+  rHi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(c, zero), aHi),
+		      _mm_mullo_epi16(_mm_unpackhi_epi8(d, zero),
+				      _mm_sub_epi16(ff16, aHi)));
+  return _mm_packus_epi16(_mm_srli_epi16(rLo, 8), _mm_srli_epi16(rHi, 8));
+}
+
+SSE2_FUNC static void blendSpanMaskSSE2(SplashColorPtr dest,
+					SplashColorPtr color, int nComps,
+					Guchar *alpha, GBool skipZero,
+					int n) {
+  __m128i pat[4], zero, a, a8[4], d, m, r;
+  int i, k;
+
+  if (nComps > 4 || n < 16) {
+    blendSpanMaskC(dest, color, nComps, alpha, skipZero, n);
+    return;
+  }
+  makePattern(pat, color, nComps);
+  zero = _mm_setzero_si128();
+  for (i = 0; i + 16 <= n; i += 16, dest += 16 * nComps) {
+    a = _mm_loadu_si128((__m128i *)(alpha + i));
+    if (skipZero &&
+	_mm_movemask_epi8(_mm_cmpeq_epi8(a, zero)) == 0xffff) {
+      continue;
+    }
+    spreadAlpha(a8, a, alpha + i, nComps);
+    for (k = 0; k < nComps; ++k) {
+      d = _mm_loadu_si128((__m128i *)(dest + 16 * k));
+      r = blend16(pat[k], d, a8[k]);
+      if (skipZero) {
+	m = _mm_cmpeq_epi8(a8[k], zero);
+	r = _mm_or_si128(_mm_and_si128(m, d), _mm_andnot_si128(m, r));
+      }
+      _mm_storeu_si128((__m128i *)(dest + 16 * k), r);
+    }
+  }
+  blendSpanMaskC(dest, color, nComps, alpha + i, skipZero, n - i);
+}
+
+SSE2_FUNC static void blendSpanRowSSE2(SplashColorPtr dest,
+				       SplashColorPtr src, int nComps,
+				       Guchar *alpha, GBool skipZero, int n) {
+  __m128i zero, a, a8[4], c, d, m, r;
+  int i, k;
+
+  if (nComps > 4 || n < 16) {
+    blendSpanRowC(dest, src, nComps, alpha, skipZero, n);
+    return;
+  }
+  zero = _mm_setzero_si128();
+  for (i = 0; i + 16 <= n; i += 16, dest += 16 * nComps, src += 16 * nComps) {
+    a = _mm_loadu_si128((__m128i *)(alpha + i));
+    if (skipZero &&
+	_mm_movemask_epi8(_mm_cmpeq_epi8(a, zero)) == 0xffff) {
+      continue;
+    }
+    spreadAlpha(a8, a, alpha + i, nComps);
+    for (k = 0; k < nComps; ++k) {
+      c = _mm_loadu_si128((__m128i *)(src + 16 * k));
+      d = _mm_loadu_si128((__m128i *)(dest + 16 * k));
+      r = blend16(c, d, a8[k]);
+      if (skipZero) {
+	m = _mm_cmpeq_epi8(a8[k], zero);
+	r = _mm_or_si128(_mm_and_si128(m, d), _mm_andnot_si128(m, r));
+      }
+      _mm_storeu_si128((__m128i *)(dest + 16 * k), r);
+    }
+  }
+  blendSpanRowC(dest, src, nComps, alpha + i, skipZero, n - i);
+}
+
+SSE2_FUNC static void mulAlphaSpanSSE2(Guchar *dest, Guchar *mask,
+				       double alpha, int n) {
+  __m128d a;
+  __m128i zero, v, v16, v32[2], r[2];
+  int i, k;
+
+  a = _mm_set1_pd(alpha);
+  zero = _mm_setzero_si128();
+  for (i = 0; i + 8 <= n; i += 8) {
+    v = _mm_loadl_epi64((__m128i *)(mask + i));
+    v16 = _mm_unpacklo_epi8(v, zero);
+    v32[0] = _mm_unpacklo_epi16(v16, zero);
+    v32[1] = _mm_unpackhi_epi16(v16, zero);
+    // same double-precision multiply and truncation as the C version
+    for (k = 0; k < 2; ++k) {
+      r[k] = _mm_unpacklo_epi64(
+	       _mm_cvttpd_epi32(_mm_mul_pd(_mm_cvtepi32_pd(v32[k]), a)),
+	       _mm_cvttpd_epi32(_mm_mul_pd(
+		 _mm_cvtepi32_pd(_mm_srli_si128(v32[k], 8)), a)));
+    }
+    v16 = _mm_packs_epi32(r[0], r[1]);
+    _mm_storel_epi64((__m128i *)(dest + i), _mm_packus_epi16(v16, v16));
+  }
+  mulAlphaSpanC(dest + i, mask + i, alpha, n - i);
+}
+
+#endif // SPLASH_SSE2
+
+//------------------------------------------------------------------------
+// dispatch
+//------------------------------------------------------------------------
+
+static void initKernels() {
+  splashSetKernelsImpl(splashKernelsWord);
+#if SPLASH_SSE2
+  splashSetKernelsImpl(splashKernelsSSE2);
+#endif
+}
+
+GBool splashSetKernelsImpl(SplashKernelsImpl impl) {
+  switch (impl) {
+  case splashKernelsC:
+    fillSpanFunc = &fillSpanC;
+    blendSpanFunc = &blendSpanC;
+    blendSpanMaskFunc = &blendSpanMaskC;
+    blendSpanRowFunc = &blendSpanRowC;
+    mulAlphaSpanFunc = &mulAlphaSpanC;
+    break;
+  case splashKernelsWord:
+    fillSpanFunc = &fillSpanWord;
+    blendSpanFunc = &blendSpanWord;
+    blendSpanMaskFunc = &blendSpanMaskWord;
+    blendSpanRowFunc = &blendSpanRowWord;
+    mulAlphaSpanFunc = &mulAlphaSpanC;
+    break;
+  case splashKernelsSSE2:
+#if SPLASH_SSE2
+    __builtin_cpu_init();
+    if (!__builtin_cpu_supports("sse2")) {
+      return gFalse;
+    }
+    fillSpanFunc = &fillSpanSSE2;
+    blendSpanFunc = &blendSpanSSE2;
+    blendSpanMaskFunc = &blendSpanMaskSSE2;
+    blendSpanRowFunc = &blendSpanRowSSE2;
+    mulAlphaSpanFunc = &mulAlphaSpanSSE2;
+    break;
+#else
+    return gFalse;
+#endif
+  }
+  kernelsImpl = impl;
+  kernelsInited = gTrue;
+  return gTrue;
+}
+
+SplashKernelsImpl splashGetKernelsImpl() {
+  if (!kernelsInited) {
+    initKernels();
+  }
+  return kernelsImpl;
+}
+
+void splashFillSpan(SplashColorPtr dest, SplashColorPtr color,
+		    int nComps, int n) {
+  if (!kernelsInited) {
+    initKernels();
+  }
+  (*fillSpanFunc)(dest, color, nComps, n);
+}
+
+void splashBlendSpan(SplashColorPtr dest, SplashColorPtr color,
+		     int nComps, int alpha, int n) {
+  if (!kernelsInited) {
+    initKernels();
+  }
+  (*blendSpanFunc)(dest, color, nComps, alpha, n);
+}
+
+void splashBlendSpanMask(SplashColorPtr dest, SplashColorPtr color,
+			 int nComps, Guchar *alpha, GBool skipZero, int n) {
+  if (!kernelsInited) {
+    initKernels();
+  }
+  (*blendSpanMaskFunc)(dest, color, nComps, alpha, skipZero, n);
+}
+
+void splashBlendSpanRow(SplashColorPtr dest, SplashColorPtr src,
+			int nComps, Guchar *alpha, GBool skipZero, int n) {
+  if (!kernelsInited) {
+    initKernels();
+  }
+  (*blendSpanRowFunc)(dest, src, nComps, alpha, skipZero, n);
+}
+
+void splashMulAlphaSpan(Guchar *dest, Guchar *mask, double alpha, int n) {
+  if (!kernelsInited) {
+    initKernels();
+  }
+  (*mulAlphaSpanFunc)(dest, mask, alpha, n);
+}
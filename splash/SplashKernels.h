@@ -0,0 +1,65 @@
+//========================================================================
+//
+// SplashKernels.h
+//
+// Pixel loops shared by the span and glyph drawing code.  Each one has
+// a byte-at-a-time C version (the reference), a portable version which
+// works a machine word at a time, and, on x86 CPUs which support it,
+// an SSE2 version.  The fastest available one is chosen the first time
+// a kernel is called.  All versions produce identical results; see
+// SplashKernelsTest.
+//
+//========================================================================
+
+#ifndef SPLASHKERNELS_H
+#define SPLASHKERNELS_H
+
+#include <aconf.h>
+
+#include "gtypes.h"
+#include "SplashTypes.h"
+
+// Fill <n> pixels of <nComps> bytes each with <color>.
+extern void splashFillSpan(SplashColorPtr dest, SplashColorPtr color,
+			   int nComps, int n);
+
+// Blend <color> into <n> pixels of <nComps> bytes each with a
+// constant <alpha> (0 to 255):
+//   dest = (alpha * color + (255 - alpha) * dest) >> 8
+extern void splashBlendSpan(SplashColorPtr dest, SplashColorPtr color,
+			    int nComps, int alpha, int n);
+
+// Same, with a separate alpha value for each pixel.  If <skipZero> is
+// set, pixels with zero alpha are left unchanged (glyph coverage);
+// otherwise the formula above is applied to every pixel (soft masks).
+extern void splashBlendSpanMask(SplashColorPtr dest, SplashColorPtr color,
+				int nComps, Guchar *alpha, GBool skipZero,
+				int n);
+
+// Blend a row of <n> source pixels <src> into <dest>, with a separate
+// alpha value for each pixel:
+//   dest = (alpha * src + (255 - alpha) * dest) >> 8
+// <skipZero> is as in splashBlendSpanMask.
+extern void splashBlendSpanRow(SplashColorPtr dest, SplashColorPtr src,
+			       int nComps, Guchar *alpha, GBool skipZero,
+			       int n);
+
+// Scale <n> soft mask values:
+//   dest[i] = (int)(alpha * mask[i])
+extern void splashMulAlphaSpan(Guchar *dest, Guchar *mask, double alpha,
+			       int n);
+
+enum SplashKernelsImpl {
+  splashKernelsC,		// byte at a time
+  splashKernelsWord,		// word at a time (portable)
+  splashKernelsSSE2		// x86 SSE2
+};
+
+// Use the <impl> versions of the kernels.  Returns false (and changes
+// nothing) if they aren't available in this build or on this CPU.
+extern GBool splashSetKernelsImpl(SplashKernelsImpl impl);
+
+// Returns the versions in use.
+extern SplashKernelsImpl splashGetKernelsImpl();
+
+#endif
@@ -0,0 +1,154 @@
+//========================================================================
+//
+// SplashKernelsTest.cc
+//
+// Checks that each version of the SplashKernels pixel loops gives
+// exactly the same results as the byte-at-a-time C versions, over
+// random pixels, alpha values, span lengths, and alignments.  Run by
+// 'make check'; exits with status 1 on the first mismatch.
+//
+//========================================================================
+
+#include <aconf.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gtypes.h"
+#include "SplashTypes.h"
+#include "SplashKernels.h"
+
+// largest span tested, in pixels
+#define testMaxPixels 1100
+
+// bytes before and after each span, which must not be touched
+#define testGuard 24
+
+#define testBufSize (testMaxPixels * splashMaxColorComps + 2 * testGuard + 8)
+
+static unsigned long testRandState = 1;
+
+static int testRand() {
+  testRandState = testRandState * 1103515245 + 12345;
+  return (int)((testRandState >> 16) & 0x7fff);
+}
+
+// A random alpha value, biased toward 0 and 255, with runs of zeros.
+static int testAlpha(int *zeroRun) {
+  int r;
+
+  if (*zeroRun > 0) {
+    --*zeroRun;
+    return 0;
+  }
+  r = testRand() % 8;
+  if (r == 0) {
+    *zeroRun = testRand() % 40;
+    return 0;
+  }
+  if (r == 1) {
+    return 255;
+  }
+  return testRand() & 0xff;
+}
+
+static void fillRandom(Guchar *buf, int n) {
+  int i;
+
+  for (i = 0; i < n; ++i) {
+    buf[i] = (Guchar)testRand();
+  }
+}
+
+static const char *kernelNames[5] = {
+  "fillSpan", "blendSpan", "blendSpanMask", "blendSpanRow", "mulAlphaSpan"
+};
+
+// Run kernel <k> on one random case with the current versions and
+// with the C versions, and compare.  Returns false on a mismatch.
+static GBool testCase(SplashKernelsImpl impl, int k) {
+  static Guchar dest0[testBufSize], dest1[testBufSize];
+  static Guchar src[testBufSize], alpha[testBufSize];
+  SplashColor color;
+  Guchar *d;
+  double a;
+  GBool skipZero;
+  int nComps, n, off, ca, zeroRun, i;
+
+  nComps = 1 + testRand() % 4;
+  switch (testRand() % 4) {
+  case 0:
+    n = testRand() % 40;
+    break;
+  case 1:
+    n = testRand() % 300;
+    break;
+  default:
+    n = testRand() % testMaxPixels;
+    break;
+  }
+  off = testRand() % 8;
+  fillRandom(color, splashMaxColorComps);
+  fillRandom(dest0, testBufSize);
+  memcpy(dest1, dest0, testBufSize);
+  fillRandom(src, testBufSize);
+  zeroRun = 0;
+  for (i = 0; i < testBufSize; ++i) {
+    alpha[i] = (Guchar)testAlpha(&zeroRun);
+  }
+  ca = testAlpha(&zeroRun);
+  skipZero = testRand() & 1;
+  a = (testRand() % 5 == 0) ? 1 : (testRand() % 1001) / 1000.0;
+
+  for (i = 0; i < 2; ++i) {
+    splashSetKernelsImpl(i ? splashKernelsC : impl);
+    d = (i ? dest1 : dest0) + testGuard + off;
+    switch (k) {
+    case 0:
+      splashFillSpan(d, color, nComps, n);
+      break;
+    case 1:
+      splashBlendSpan(d, color, nComps, ca, n);
+      break;
+    case 2:
+      splashBlendSpanMask(d, color, nComps, alpha + off, skipZero, n);
+      break;
+    case 3:
+      splashBlendSpanRow(d, src + off, nComps, alpha + off, skipZero, n);
+      break;
+    case 4:
+      splashMulAlphaSpan(d, alpha + off, a, n);
+      break;
+    }
+  }
+
+  if (memcmp(dest0, dest1, testBufSize)) {
+    for (i = 0; i < testBufSize && dest0[i] == dest1[i]; ++i) ;
+    printf("FAIL %s: nComps=%d n=%d offset=%d: byte %d is %d, not %d\n",
+	   kernelNames[k], nComps, n, off, i - testGuard - off,
+	   dest0[i], dest1[i]);
+    return gFalse;
+  }
+  return gTrue;
+}
+
+int main() {
+  static SplashKernelsImpl impls[2] = { splashKernelsWord, splashKernelsSSE2 };
+  static const char *implNames[2] = { "word", "SSE2" };
+  int i, k, rep;
+
+  for (i = 0; i < 2; ++i) {
+    if (!splashSetKernelsImpl(impls[i])) {
+      printf("%-5s not available\n", implNames[i]);
+      continue;
+    }
+    for (k = 0; k < 5; ++k) {
+      for (rep = 0; rep < 2000; ++rep) {
+	if (!testCase(impls[i], k)) {
+	  return 1;
+	}
+      }
+    }
+    printf("%-5s ok\n", implNames[i]);
+  }
+  return 0;
+}
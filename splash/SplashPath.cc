@@ -168,6 +168,52 @@ void SplashPath::offset(SplashCoord dx, SplashCoord dy) {
   }
 }
 
+GBool SplashPath::getRect(SplashCoord *xMin, SplashCoord *yMin,
+			  SplashCoord *xMax, SplashCoord *yMax) {
+  SplashPathPoint *p;
+  int i;
+
+  // a single subpath with four corners, optionally followed by a
+  // copy of the first corner
+  if (!(length == 4 ||
+	(length == 5 && pts[4].x == pts[0].x && pts[4].y == pts[0].y))) {
+    return gFalse;
+  }
+  if (!(flags[0] & splashPathFirst) || !(flags[length - 1] & splashPathLast)) {
+    return gFalse;
+  }
+  for (i = 1; i < length; ++i) {
+    if (flags[i] & (splashPathFirst | splashPathCurve | splashPathArcCW)) {
+      return gFalse;
+    }
+  }
+
+  // the sides must alternate between vertical and horizontal
+  p = pts;
+  if (!((p[0].x == p[1].x && p[1].y == p[2].y &&
+	 p[2].x == p[3].x && p[3].y == p[0].y) ||
+	(p[0].y == p[1].y && p[1].x == p[2].x &&
+	 p[2].y == p[3].y && p[3].x == p[0].x))) {
+    return gFalse;
+  }
+
+  if (p[0].x < p[2].x) {
+    *xMin = p[0].x;
+    *xMax = p[2].x;
+  } else {
+    *xMin = p[2].x;
+    *xMax = p[0].x;
+  }
+  if (p[0].y < p[2].y) {
+    *yMin = p[0].y;
+    *yMax = p[2].y;
+  } else {
+    *yMin = p[2].y;
+    *yMax = p[0].y;
+  }
+  return gTrue;
+}
+
 GBool SplashPath::getCurPt(SplashCoord *x, SplashCoord *y) {
   if (noCurrentPoint()) {
     return gFalse;
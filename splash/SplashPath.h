@@ -58,6 +58,9 @@ public:
 
   ~SplashPath();
 
+  // Remove all points, keeping the allocated space for reuse.
+  void reset() { length = curSubpath = 0; }
+
   // Append <path> to <this>.
   void append(SplashPath *path);
 
@@ -92,6 +95,11 @@ public:
   // Get the current point.
   GBool getCurPt(SplashCoord *x, SplashCoord *y);
 
+  // If this path is a single axis-aligned rectangle (closed or not),
+  // set its corners and return true.
+  GBool getRect(SplashCoord *xMin, SplashCoord *yMin,
+		SplashCoord *xMax, SplashCoord *yMax);
+
 private:
 
   SplashPath(SplashPath *path);
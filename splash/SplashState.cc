@@ -21,6 +21,8 @@
 // SplashState
 //------------------------------------------------------------------------
 
+OBJECT_POOL_ALLOCATION_SUPPORT_COMPACT(SplashState);
+
 // number of components in each color mode
 int splashColorModeNComps[] = {
   1, 1, 2, 3, 3, 4, 4
@@ -46,12 +48,11 @@ SplashState::SplashState(int width, int height) {
   lineDashPhase = 0;
   clip = new SplashClip(0, 0, width - 1, height - 1);
   next = NULL;
+  ownStrokePattern = ownFillPattern = ownScreen = gTrue;
+  ownLineDash = ownClip = gTrue;
 }
 
-SplashState::SplashState(SplashState *state) {
-  strokePattern = state->strokePattern->copy();
-  fillPattern = state->fillPattern->copy();
-  screen = state->screen->copy();
+SplashState::SplashState(SplashState *state, GBool share) {
   blendFunc = state->blendFunc;
   strokeAlpha = state->strokeAlpha;
   fillAlpha = state->fillAlpha;
@@ -60,6 +61,22 @@ SplashState::SplashState(SplashState *state) {
   lineJoin = state->lineJoin;
   miterLimit = state->miterLimit;
   flatness = state->flatness;
+  lineDashPhase = state->lineDashPhase;
+  next = NULL;
+  if (share) {
+    strokePattern = state->strokePattern;
+    fillPattern = state->fillPattern;
+    screen = state->screen;
+    lineDash = state->lineDash;
+    lineDashLength = state->lineDashLength;
+    clip = state->clip;
+    ownStrokePattern = ownFillPattern = ownScreen = gFalse;
+    ownLineDash = ownClip = gFalse;
+    return;
+  }
+  strokePattern = state->strokePattern->copy();
+  fillPattern = state->fillPattern->copy();
+  screen = state->screen->copy();
   if (state->lineDash) {
     lineDashLength = state->lineDashLength;
     lineDash = (SplashCoord *)gmallocn(lineDashLength, sizeof(SplashCoord));
@@ -68,37 +85,66 @@ SplashState::SplashState(SplashState *state) {
     lineDash = NULL;
     lineDashLength = 0;
   }
-  lineDashPhase = state->lineDashPhase;
   clip = state->clip->copy();
-  next = NULL;
+  ownStrokePattern = ownFillPattern = ownScreen = gTrue;
+  ownLineDash = ownClip = gTrue;
 }
 
 SplashState::~SplashState() {
-  delete strokePattern;
-  delete fillPattern;
-  delete screen;
-  gfree(lineDash);
-  delete clip;
+  if (ownStrokePattern) {
+    delete strokePattern;
+  }
+  if (ownFillPattern) {
+    delete fillPattern;
+  }
+  if (ownScreen) {
+    delete screen;
+  }
+  if (ownLineDash) {
+    gfree(lineDash);
+  }
+  if (ownClip) {
+    delete clip;
+  }
 }
 
 void SplashState::setStrokePattern(SplashPattern *strokePatternA) {
-  delete strokePattern;
+  if (ownStrokePattern) {
+    delete strokePattern;
+  }
   strokePattern = strokePatternA;
+  ownStrokePattern = gTrue;
 }
 
 void SplashState::setFillPattern(SplashPattern *fillPatternA) {
-  delete fillPattern;
+  if (ownFillPattern) {
+    delete fillPattern;
+  }
   fillPattern = fillPatternA;
+  ownFillPattern = gTrue;
 }
 
 void SplashState::setScreen(SplashScreen *screenA) {
-  delete screen;
+  if (ownScreen) {
+    delete screen;
+  }
   screen = screenA;
+  ownScreen = gTrue;
 }
 
 void SplashState::setLineDash(SplashCoord *lineDashA, int lineDashLengthA,
 			      SplashCoord lineDashPhaseA) {
-  gfree(lineDash);
+  // this is called on every CTM change, and usually nothing changes
+  if (lineDashLengthA == lineDashLength &&
+      lineDashPhaseA == lineDashPhase &&
+      (lineDashLength == 0 ||
+       !memcmp(lineDashA, lineDash, lineDashLength * sizeof(SplashCoord)))) {
+    return;
+  }
+  if (ownLineDash) {
+    gfree(lineDash);
+  }
+  ownLineDash = gTrue;
   lineDashLength = lineDashLengthA;
   if (lineDashLength > 0) {
     lineDash = (SplashCoord *)gmallocn(lineDashLength, sizeof(SplashCoord));
@@ -108,3 +154,10 @@ void SplashState::setLineDash(SplashCoord *lineDashA, int lineDashLengthA,
   }
   lineDashPhase = lineDashPhaseA;
 }
+
+void SplashState::unshareClip() {
+  if (!ownClip) {
+    clip = clip->copy();
+    ownClip = gTrue;
+  }
+}
@@ -14,6 +14,7 @@
 #endif
 
 #include "SplashTypes.h"
+#include "allocatable.h"
 
 class SplashPattern;
 class SplashScreen;
@@ -40,13 +41,16 @@ class SplashClip;
 //------------------------------------------------------------------------
 
 class SplashState {
+
+  OBJECT_POOL_ALLOCATION();
+
 public:
 
   // Create a new state object, initialized with default settings.
   SplashState(int width, int height);
 
   // Copy a state object.
-  SplashState *copy() { return new SplashState(this); }
+  SplashState *copy() { return new SplashState(this, gFalse); }
 
   ~SplashState();
 
@@ -59,13 +63,20 @@ public:
   // Set the screen.  This does not copy <screenA>.
   void setScreen(SplashScreen *screenA);
 
-  // Set the line dash pattern.  This copies the <lineDashA> array.
+  // Set the line dash pattern.  This copies the <lineDashA> array,
+  // unless it is equal to the current one.
   void setLineDash(SplashCoord *lineDashA, int lineDashLengthA,
 		   SplashCoord lineDashPhaseA);
 
 private:
 
-  SplashState(SplashState *state);
+  // If <share> is set, the patterns, screen, line dash and clip are
+  // shared with <state>, which must outlive the new state (as it does
+  // on the Splash save stack).
+  SplashState(SplashState *state, GBool share);
+
+  // Make a private copy of the clip before it is changed.
+  void unshareClip();
 
   SplashPattern *strokePattern;
   SplashPattern *fillPattern;
@@ -83,6 +94,11 @@ private:
   SplashCoord lineDashPhase;
   SplashClip *clip;
 
+  // set if the patterns, screen, line dash and clip belong to this
+  // state
+  GBool ownStrokePattern, ownFillPattern, ownScreen;
+  GBool ownLineDash, ownClip;
+
   SplashState *next;		// used by Splash class
 
   friend class Splash;
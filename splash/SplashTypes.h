@@ -21,6 +21,14 @@ typedef FixedPoint SplashCoord;
 typedef double SplashCoord;
 #endif
 
+//------------------------------------------------------------------------
+// anti-aliasing
+//------------------------------------------------------------------------
+
+// number of sub-scanlines sampled per pixel row by the anti-aliased
+// vector rasterizer
+#define splashAASize 4
+
 //------------------------------------------------------------------------
 // colors
 //------------------------------------------------------------------------
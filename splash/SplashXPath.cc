@@ -21,6 +21,11 @@
 
 #define maxCurveSplits (1 << 10)
 
+// max distance between a flattened Bezier curve and the real curve,
+// as a fraction of the flatness (which is in device pixels and is at
+// least 1)
+#define splashCurveTolerance 0.5
+
 //------------------------------------------------------------------------
 // SplashXPath
 //------------------------------------------------------------------------
@@ -32,12 +37,18 @@ SplashXPath::SplashXPath() {
 
 SplashXPath::SplashXPath(SplashPath *path, SplashCoord flatness,
 			 GBool closeSubpaths) {
+  segs = NULL;
+  length = size = 0;
+  reset(path, flatness, closeSubpaths);
+}
+
+void SplashXPath::reset(SplashPath *path, SplashCoord flatness,
+			GBool closeSubpaths) {
   SplashCoord xc, yc, dx, dy, r, x0, y0, x1, y1;
   int quad0, quad1, quad;
   int curSubpath, n, i, j;
 
-  segs = NULL;
-  length = size = 0;
+  length = 0;
 
   i = 0;
   curSubpath = 0;
@@ -190,87 +201,80 @@ void SplashXPath::grow(int nSegs) {
   }
 }
 
+// The number of segments comes from the curve's actual shape (Wang's
+// formula): if a cubic Bezier is split into <n> pieces of equal
+// parameter length, each chord stays within
+//    (3/4) * max(|p0 - 2*p1 + p2|, |p1 - 2*p2 + p3|) / n^2
+// of the curve.  So <n> grows with the square root of the curve's
+// size in device space, straight "curves" become a single segment,
+// and no recursion or distance tests are needed.  The points are then
+// generated by forward differencing.
 void SplashXPath::addCurve(SplashCoord x0, SplashCoord y0,
 			   SplashCoord x1, SplashCoord y1,
 			   SplashCoord x2, SplashCoord y2,
 			   SplashCoord x3, SplashCoord y3,
 			   SplashCoord flatness,
 			   GBool first, GBool last, GBool end0, GBool end1) {
-  SplashCoord cx[maxCurveSplits + 1][3];
-  SplashCoord cy[maxCurveSplits + 1][3];
-  int cNext[maxCurveSplits + 1];
-  SplashCoord xl0, xl1, xl2, xr0, xr1, xr2, xr3, xx1, xx2, xh;
-  SplashCoord yl0, yl1, yl2, yr0, yr1, yr2, yr3, yy1, yy2, yh;
-  SplashCoord dx, dy, mx, my, d1, d2, flatness2;
-  int p1, p2, p3;
-
-  flatness2 = flatness * flatness;
-
-  // initial segment
-  p1 = 0;
-  p2 = maxCurveSplits;
-  cx[p1][0] = x0;  cy[p1][0] = y0;
-  cx[p1][1] = x1;  cy[p1][1] = y1;
-  cx[p1][2] = x2;  cy[p1][2] = y2;
-  cx[p2][0] = x3;  cy[p2][0] = y3;
-  cNext[p1] = p2;
-
-  while (p1 < maxCurveSplits) {
-
-    // get the next segment
-    xl0 = cx[p1][0];  yl0 = cy[p1][0];
-    xx1 = cx[p1][1];  yy1 = cy[p1][1];
-    xx2 = cx[p1][2];  yy2 = cy[p1][2];
-    p2 = cNext[p1];
-    xr3 = cx[p2][0];  yr3 = cy[p2][0];
-
-    // compute the distances from the control points to the
-    // midpoint of the straight line (this is a bit of a hack, but
-    // it's much faster than computing the actual distances to the
-    // line)
-    mx = (xl0 + xr3) * 0.5;
-    my = (yl0 + yr3) * 0.5;
-    dx = xx1 - mx;
-    dy = yy1 - my;
-    d1 = dx*dx + dy*dy;
-    dx = xx2 - mx;
-    dy = yy2 - my;
-    d2 = dx*dx + dy*dy;
-
-    // if the curve is flat enough, or no more subdivisions are
-    // allowed, add the straight line segment
-    if (p2 - p1 == 1 || (d1 <= flatness2 && d2 <= flatness2)) {
-      addSegment(xl0, yl0, xr3, yr3,
-		 p1 == 0 && first,
-		 p2 == maxCurveSplits && last,
-		 p1 == 0 && end0,
-		 p2 == maxCurveSplits && end1);
-      p1 = p2;
+  SplashCoord ddx, ddy, dd0, dd1, d, h;
+  SplashCoord ax, ay, bx, by, cx, cy;
+  SplashCoord fx1, fy1, fx2, fy2, fx3, fy3;
+  SplashCoord xx0, yy0, xx1, yy1;
+  int n, i;
+
+  // pick the number of segments
+  ddx = x0 - 2 * x1 + x2;
+  ddy = y0 - 2 * y1 + y2;
+  dd0 = ddx * ddx + ddy * ddy;
+  ddx = x1 - 2 * x2 + x3;
+  ddy = y1 - 2 * y2 + y3;
+  dd1 = ddx * ddx + ddy * ddy;
+  d = (SplashCoord)0.75 * splashSqrt(dd0 > dd1 ? dd0 : dd1) /
+      (splashCurveTolerance * flatness);
+  if (!(d > 1)) {
+    n = 1;
+  } else if (d >= (SplashCoord)maxCurveSplits * maxCurveSplits) {
+    n = maxCurveSplits;
+  } else {
+    n = (int)splashCeil(splashSqrt(d));
+  }
 
-    // otherwise, subdivide the curve
+  // polynomial coefficients: p(t) = a*t^3 + b*t^2 + c*t + p0
+  ax = -x0 + 3 * (x1 - x2) + x3;
+  ay = -y0 + 3 * (y1 - y2) + y3;
+  bx = 3 * (x0 - 2 * x1 + x2);
+  by = 3 * (y0 - 2 * y1 + y2);
+  cx = 3 * (x1 - x0);
+  cy = 3 * (y1 - y0);
+
+  // forward differences for a step of h = 1/n
+  h = (SplashCoord)1 / n;
+  fx1 = ((ax * h + bx) * h + cx) * h;
+  fy1 = ((ay * h + by) * h + cy) * h;
+  fx3 = 6 * ax * h * h * h;
+  fy3 = 6 * ay * h * h * h;
+  fx2 = fx3 + 2 * bx * h * h;
+  fy2 = fy3 + 2 * by * h * h;
+
+  xx0 = x0;
+  yy0 = y0;
+  for (i = 1; i <= n; ++i) {
+    if (i == n) {
+      // land exactly on the end point
+      xx1 = x3;
+      yy1 = y3;
     } else {
-      xl1 = (xl0 + xx1) * 0.5;
-      yl1 = (yl0 + yy1) * 0.5;
-      xh = (xx1 + xx2) * 0.5;
-      yh = (yy1 + yy2) * 0.5;
-      xl2 = (xl1 + xh) * 0.5;
-      yl2 = (yl1 + yh) * 0.5;
-      xr2 = (xx2 + xr3) * 0.5;
-      yr2 = (yy2 + yr3) * 0.5;
-      xr1 = (xh + xr2) * 0.5;
-      yr1 = (yh + yr2) * 0.5;
-      xr0 = (xl2 + xr1) * 0.5;
-      yr0 = (yl2 + yr1) * 0.5;
-      // add the new subdivision points
-      p3 = (p1 + p2) / 2;
-      cx[p1][1] = xl1;  cy[p1][1] = yl1;
-      cx[p1][2] = xl2;  cy[p1][2] = yl2;
-      cNext[p1] = p3;
-      cx[p3][0] = xr0;  cy[p3][0] = yr0;
-      cx[p3][1] = xr1;  cy[p3][1] = yr1;
-      cx[p3][2] = xr2;  cy[p3][2] = yr2;
-      cNext[p3] = p2;
+      xx1 = xx0 + fx1;
+      yy1 = yy0 + fy1;
+      fx1 += fx2;
+      fy1 += fy2;
+      fx2 += fx3;
+      fy2 += fy3;
     }
+    addSegment(xx0, yy0, xx1, yy1,
+	       i == 1 && first, i == n && last,
+	       i == 1 && end0, i == n && end1);
+    xx0 = xx1;
+    yy0 = yy1;
   }
 }
 
@@ -52,6 +52,11 @@ public:
   SplashXPath(SplashPath *path, SplashCoord flatness,
 	      GBool closeSubpaths);
 
+  // Replace the contents of this object with the expansion of <path>,
+  // like the constructor does, but reusing the allocated segment array.
+  void reset(SplashPath *path, SplashCoord flatness,
+	     GBool closeSubpaths);
+
   // Copy an expanded path.
   SplashXPath *copy() { return new SplashXPath(this); }
 
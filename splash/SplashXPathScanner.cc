@@ -10,7 +10,7 @@
 #pragma implementation
 #endif
 
-#include <stdlib.h>
+#include <string.h>
 #include "gmem.h"
 #include "SplashMath.h"
 #include "SplashXPath.h"
@@ -18,20 +18,39 @@
 
 //------------------------------------------------------------------------
 
+// One entry in the active edge table, i.e., a segment which
+// intersects the current scanline.
 struct SplashIntersect {
   int x0, x1;			// intersection of segment with [y, y+1)
   int count;			// EO/NZWN counter increment
+  SplashXPathSeg *seg;		// the segment
+  SplashCoord ySegMin, ySegMax;	// y range of the segment
+  SplashCoord xBottom;		// x coord of the segment at y+1 (sloped
+				//   segments crossing y+1 only)
 };
 
-static int cmpIntersect(const void *p0, const void *p1) {
-  return ((SplashIntersect *)p0)->x0 - ((SplashIntersect *)p1)->x0;
-}
+// A point where a segment crosses one of the sub-scanlines sampled by
+// renderAALine.
+struct SplashAACross {
+  SplashCoord x;		// x coord of the crossing
+  int count;			// EO/NZWN counter increment
+};
 
 //------------------------------------------------------------------------
 // SplashXPathScanner
 //------------------------------------------------------------------------
 
 SplashXPathScanner::SplashXPathScanner(SplashXPath *xPathA, GBool eoA) {
+  inter = NULL;
+  interSize = 0;
+  aaAcc = NULL;
+  aaAccSize = 0;
+  aaCross = NULL;
+  aaCrossSize = 0;
+  reset(xPathA, eoA);
+}
+
+void SplashXPathScanner::reset(SplashXPath *xPathA, GBool eoA) {
   SplashXPathSeg *seg;
   SplashCoord xMinFP, yMinFP, xMaxFP, yMaxFP;
   int i;
@@ -89,12 +108,13 @@ SplashXPathScanner::SplashXPathScanner(SplashXPath *xPathA, GBool eoA) {
 
   interY = yMin - 1;
   xPathIdx = 0;
-  inter = NULL;
-  interLen = interSize = 0;
+  interLen = 0;
 }
 
 SplashXPathScanner::~SplashXPathScanner() {
   gfree(inter);
+  gfree(aaAcc);
+  gfree(aaCross);
 }
 
 void SplashXPathScanner::getSpanBounds(int y, int *spanXMin, int *spanXMax) {
@@ -185,24 +205,170 @@ GBool SplashXPathScanner::getNextSpan(int y, int *x0, int *x1) {
   return gTrue;
 }
 
+void SplashXPathScanner::rewindSpans(int y) {
+  if (interY != y) {
+    computeIntersections(y);
+  }
+  interIdx = 0;
+  interCount = 0;
+}
+
+// Each inside interval [xa,xb) of a sub-scanline is converted to 24.8
+// fixed point and added to <aaAcc> as a difference array: the first
+// and last pixels get their fractional coverage, and everything in
+// between gets a full 256.  A running sum over the touched range then
+// gives each pixel's coverage, out of 256 * splashAASize.
+void SplashXPathScanner::renderAALine(Guchar *line, int x0, int x1, int y,
+				      int *xMinA, int *xMaxA) {
+  SplashXPathSeg *seg;
+  SplashIntersect *p;
+  SplashAACross t;
+  SplashCoord ys, xa, xb, w;
+  int n, nCross, count, a, b, ia, ib, xMinAA, xMaxAA, v, sub, i, j;
+
+  *xMinA = x1 + 1;
+  *xMaxA = x1;
+  if (y < yMin || y > yMax || x0 > x1) {
+    return;
+  }
+  if (interY != y) {
+    computeIntersections(y);
+  }
+  if (interLen == 0) {
+    return;
+  }
+
+  n = x1 - x0 + 1;
+  if (n + 2 > aaAccSize) {
+    gfree(aaAcc);
+    aaAccSize = n + 2;
+    aaAcc = (int *)gmallocn(aaAccSize, sizeof(int));
+    memset(aaAcc, 0, aaAccSize * sizeof(int));
+  }
+  if (interLen > aaCrossSize) {
+    gfree(aaCross);
+    aaCrossSize = interLen;
+    aaCross = (SplashAACross *)gmallocn(aaCrossSize, sizeof(SplashAACross));
+  }
+  w = n;
+
+  xMinAA = n + 1;
+  xMaxAA = -1;
+  for (sub = 0; sub < splashAASize; ++sub) {
+    ys = (SplashCoord)y + ((SplashCoord)sub + 0.5) / splashAASize;
+
+    // collect the crossings, sorted by x
+    nCross = 0;
+    for (i = 0, p = inter; i < interLen; ++i, ++p) {
+      seg = p->seg;
+      if ((seg->flags & splashXPathHoriz) ||
+	  ys < p->ySegMin || ys >= p->ySegMax) {
+	continue;
+      }
+      if (seg->flags & splashXPathVert) {
+	t.x = seg->x0;
+      } else {
+	t.x = seg->x0 + (ys - seg->y0) * seg->dxdy;
+      }
+      t.count = eo ? 1 : (seg->flags & splashXPathFlip) ? 1 : -1;
+      for (j = nCross; j > 0 && aaCross[j-1].x > t.x; --j) {
+	aaCross[j] = aaCross[j-1];
+      }
+      aaCross[j] = t;
+      ++nCross;
+    }
+
+    // accumulate the inside intervals
+    count = 0;
+    for (i = 0; i + 1 < nCross; ++i) {
+      count += aaCross[i].count;
+      if (!(eo ? (count & 1) : (count != 0))) {
+	continue;
+      }
+      xa = aaCross[i].x - x0;
+      xb = aaCross[i+1].x - x0;
+      if (xa < 0) {
+	xa = 0;
+      }
+      if (xb > w) {
+	xb = w;
+      }
+      if (xa >= xb) {
+	continue;
+      }
+      a = (int)(xa * 256);
+      b = (int)(xb * 256);
+      ia = a >> 8;
+      ib = b >> 8;
+      aaAcc[ia] += 256 - (a & 255);
+      aaAcc[ia + 1] += a & 255;
+      aaAcc[ib] -= 256 - (b & 255);
+      aaAcc[ib + 1] -= b & 255;
+      if (ia < xMinAA) {
+	xMinAA = ia;
+      }
+      if (ib > xMaxAA) {
+	xMaxAA = ib;
+      }
+    }
+  }
+  if (xMinAA > xMaxAA) {
+    return;
+  }
+
+  // convert the deltas to coverage values, clearing the accumulator
+  // on the way
+  v = 0;
+  for (i = xMinAA; i <= xMaxAA + 1; ++i) {
+    v += aaAcc[i];
+    aaAcc[i] = 0;
+    if (i < n) {
+      line[i] = (Guchar)((v * 255) / (256 * splashAASize));
+    }
+  }
+  if (xMaxAA >= n) {
+    xMaxAA = n - 1;
+  }
+  *xMinA = x0 + xMinAA;
+  *xMaxA = x0 + xMaxAA;
+}
+
+// This maintains an active edge table: <inter> holds all segments
+// which intersect the current scanline, kept sorted by x0.  Moving
+// down to the next scanline drops the segments which have ended, adds
+// the ones which start there (<xPath> is sorted by upper y
+// coordinate), and re-sorts -- the order rarely changes much from one
+// scanline to the next, so an insertion sort is nearly linear.
 void SplashXPathScanner::computeIntersections(int y) {
   SplashCoord ySegMin, ySegMax, xx0, xx1;
   SplashXPathSeg *seg;
-  int i, j;
+  SplashIntersect *p;
+  SplashIntersect t;
+  GBool step;
+  int nOld, i, j;
 
-  // find the first segment that intersects [y, y+1)
-  i = (y >= interY) ? xPathIdx : 0;
-  while (i < xPath->length &&
-	 xPath->segs[i].y0 < y && xPath->segs[i].y1 < y) {
-    ++i;
+  // the table can only move down the path -- going back up means
+  // starting over from the first segment
+  if (y < interY) {
+    xPathIdx = 0;
+    interLen = 0;
   }
-  xPathIdx = i;
+  step = y == interY + 1;
 
-  // find all of the segments that intersect [y, y+1) and create an
-  // Intersect element for each one
-  interLen = 0;
-  for (j = i; j < xPath->length; ++j) {
-    seg = &xPath->segs[j];
+  // drop the segments which end above this scanline
+  for (i = j = 0; i < interLen; ++i) {
+    if (inter[i].ySegMax >= y) {
+      if (j < i) {
+	inter[j] = inter[i];
+      }
+      ++j;
+    }
+  }
+  interLen = nOld = j;
+
+  // add the segments which start above the bottom of this scanline
+  for (; xPathIdx < xPath->length; ++xPathIdx) {
+    seg = &xPath->segs[xPathIdx];
     if (seg->flags & splashXPathFlip) {
       ySegMin = seg->y1;
       ySegMax = seg->y0;
@@ -229,47 +395,69 @@ void SplashXPathScanner::computeIntersections(int y) {
       inter = (SplashIntersect *)greallocn(inter, interSize,
 					   sizeof(SplashIntersect));
     }
+    inter[interLen].seg = seg;
+    inter[interLen].ySegMin = ySegMin;
+    inter[interLen].ySegMax = ySegMax;
+    ++interLen;
+  }
 
+  // compute the intersection of each active segment with [y, y+1)
+  for (i = 0, p = inter; i < interLen; ++i, ++p) {
+    seg = p->seg;
     if (seg->flags & splashXPathHoriz) {
       xx0 = seg->x0;
       xx1 = seg->x1;
     } else if (seg->flags & splashXPathVert) {
       xx0 = xx1 = seg->x0;
     } else {
-      if (ySegMin <= y) {
-	// intersection with top edge
-	xx0 = seg->x0 + ((SplashCoord)y - seg->y0) * seg->dxdy;
+      if (p->ySegMin <= y) {
+	// intersection with top edge -- when stepping down from the
+	// previous scanline, this is the bottom edge intersection
+	// computed there
+	if (step && i < nOld) {
+	  xx0 = p->xBottom;
+	} else {
+	  xx0 = seg->x0 + ((SplashCoord)y - seg->y0) * seg->dxdy;
+	}
       } else {
 	// x coord of segment endpoint with min y coord
 	xx0 = (seg->flags & splashXPathFlip) ? seg->x1 : seg->x0;
       }
-      if (ySegMax >= y + 1) {
+      if (p->ySegMax >= y + 1) {
 	// intersection with bottom edge
 	xx1 = seg->x0 + ((SplashCoord)y + 1 - seg->y0) * seg->dxdy;
+	p->xBottom = xx1;
       } else {
 	// x coord of segment endpoint with max y coord
 	xx1 = (seg->flags & splashXPathFlip) ? seg->x0 : seg->x1;
       }
     }
     if (xx0 < xx1) {
-      inter[interLen].x0 = splashFloor(xx0);
-      inter[interLen].x1 = splashFloor(xx1);
+      p->x0 = splashFloor(xx0);
+      p->x1 = splashFloor(xx1);
     } else {
-      inter[interLen].x0 = splashFloor(xx1);
-      inter[interLen].x1 = splashFloor(xx0);
+      p->x0 = splashFloor(xx1);
+      p->x1 = splashFloor(xx0);
     }
-    if (ySegMin <= y &&
-	(SplashCoord)y < ySegMax &&
+    if (p->ySegMin <= y &&
+	(SplashCoord)y < p->ySegMax &&
 	!(seg->flags & splashXPathHoriz)) {
-      inter[interLen].count = eo ? 1
-	                         : (seg->flags & splashXPathFlip) ? 1 : -1;
+      p->count = eo ? 1 : (seg->flags & splashXPathFlip) ? 1 : -1;
     } else {
-      inter[interLen].count = 0;
+      p->count = 0;
     }
-    ++interLen;
   }
 
-  qsort(inter, interLen, sizeof(SplashIntersect), &cmpIntersect);
+  // sort by x0
+  for (i = 1; i < interLen; ++i) {
+    if (inter[i].x0 < inter[i-1].x0) {
+      t = inter[i];
+      for (j = i; j > 0 && inter[j-1].x0 > t.x0; --j) {
+	inter[j] = inter[j-1];
+      }
+      inter[j] = t;
+    }
+  }
 
   interY = y;
   interIdx = 0;
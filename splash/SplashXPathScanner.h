@@ -17,6 +17,7 @@
 
 class SplashXPath;
 struct SplashIntersect;
+struct SplashAACross;
 
 //------------------------------------------------------------------------
 // SplashXPathScanner
@@ -30,6 +31,10 @@ public:
 
   ~SplashXPathScanner();
 
+  // Start over with <xPathA> (which must be sorted), keeping the
+  // allocated buffers.
+  void reset(SplashXPath *xPathA, GBool eoA);
+
   // Return the path's bounding box.
   void getBBox(int *xMinA, int *yMinA, int *xMaxA, int *yMaxA)
     { *xMinA = xMin; *yMinA = yMin; *xMaxA = xMax; *yMaxA = yMax; }
@@ -51,6 +56,20 @@ public:
   // no more spans at <y>.
   GBool getNextSpan(int y, int *x0, int *x1);
 
+  // Restart getNextSpan at the first span at <y>, even if it was
+  // already called for <y>.
+  void rewindSpans(int y);
+
+  // Compute the anti-aliased coverage of row <y> over [<x0>,<x1>]:
+  // the row is sampled at splashAASize sub-scanlines, and each
+  // sub-scanline's spans are accumulated with 1/256 pixel horizontal
+  // precision.  Sets line[x - <x0>] to the coverage (0 to 255) of
+  // pixel x, for all x in [<*xMinA>,<*xMaxA>]; the rest of <line> is
+  // not touched, and is implicitly zero.  Sets <*xMinA> > <*xMaxA> if
+  // the row is empty.
+  void renderAALine(Guchar *line, int x0, int x1, int y,
+		    int *xMinA, int *xMaxA);
+
 private:
 
   void computeIntersections(int y);
@@ -64,11 +83,19 @@ private:
 				//   getNextSpan 
   int interCount;		// current EO/NZWN counter - used by
 				//   getNextSpan
-  int xPathIdx;			// current index into <xPath> - used by
+  int xPathIdx;			// next segment to be added to the active
+				//   edge table - used by
 				//   computeIntersections
-  SplashIntersect *inter;	// intersections array for <interY>
+  SplashIntersect *inter;	// active edge table / intersections
+				//   array for <interY>
   int interLen;			// number of intersections in <inter>
   int interSize;		// size of the <inter> array
+
+  int *aaAcc;			// coverage deltas - used by renderAALine
+  int aaAccSize;		// size of the <aaAcc> array
+  SplashAACross *aaCross;	// sub-scanline crossings - used by
+				//   renderAALine
+  int aaCrossSize;		// size of the <aaCross> array
 };
 
 #endif
@@ -149,6 +149,10 @@ typedef enum {
 #define TEMP_DIR_PATH      "/var/tmp"
 #define URI_FILE_PREFIX   "file://"
 
+/* enviromental variable, number of threads used to decode JPEG 2000
+ * images; unset means one (no threads) */
+#define JPX_THREADS_ENV "PDF_JPX_THREADS"
+
 /* temporary file name when opening via bluetooth from gateway device */
 #define GATEWAY_TMP_FILE "/var/tmp/.__gateway.pdf"
 
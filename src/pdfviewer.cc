@@ -40,6 +40,7 @@
 #include "SplashPattern.h"
 #include "SplashTypes.h"
 #include "ErrorCodes.h"
+#include "gmem.h"
 #include "GlobalParams.h"
 #include "PDFDoc.h"
 #include "Object.h"
@@ -200,10 +201,19 @@ static gint64 get_free_space(void);
 static void
 display_page()
 {
+#if GOO_MEMORY_STATS
+    GMemStats mem_stats;
+#endif
+
     g_assert(priv->pdf_doc);
 
     TDB( "%s start",  __FUNCTION__ );
 
+#if GOO_MEMORY_STATS
+    gMemResetStats();
+    DCTStream::resetPeakMemory();
+#endif
+
     PDF_FLAGS_SET(priv->app_ui_data->flags, PDF_FLAGS_RENDERING);
 
     /* partial rendering */
@@ -275,6 +285,16 @@ display_page()
     }
     PDF_FLAGS_UNSET(priv->app_ui_data->flags, PDF_FLAGS_RENDERING);
 
+#if GOO_MEMORY_STATS
+    gMemGetStats(&mem_stats);
+    TDB("page %d: %lu mallocs, %lu reallocs, %lu frees, %lu bytes, %lu us\n",
+        priv->current_page, mem_stats.mallocs, mem_stats.reallocs,
+        mem_stats.frees, mem_stats.bytes, mem_stats.usecs);
+    ObjectPool::report(stderr);
+    TDB("page %d: JPEG decoder peak %d bytes\n",
+        priv->current_page, DCTStream::getPeakMemory());
+#endif
+
     TDB( "%s end",  __FUNCTION__ );
 }
 
@@ -1154,6 +1174,8 @@ init_thread_func(gpointer data)
     AppUIData *app_ui_data;
     SplashColor paperColor;
     const gchar *mmc_env = NULL;
+    const gchar *jpx_threads_env = NULL;
+    gint jpx_threads = 0;
 
     /* check input */
     app_ui_data = (AppUIData *) data;
@@ -1168,6 +1190,17 @@ init_thread_func(gpointer data)
         globalParams = new GlobalParams((char *)"");
         globalParams->setEnableFreeType((char *)"yes");
         globalParams->setAntialias((char *)"yes");
+        /* JPEG 2000 decode threads are opt-in until the speedup has
+         * been measured on the device */
+        jpx_threads_env = g_getenv(JPX_THREADS_ENV);
+        if (jpx_threads_env)
+        {
+            jpx_threads = (gint) g_ascii_strtoll(jpx_threads_env, NULL, 10);
+            if (jpx_threads > 1)
+            {
+                globalParams->setJPXThreads(jpx_threads);
+            }
+        }
     }
 
     /* paper color = white */
@@ -0,0 +1,1143 @@
+//========================================================================
+//
+// DCTKernels.cc
+//
+//========================================================================
+
+#include <aconf.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include <string.h>
+#include "DCTKernels.h"
+
+// See SplashKernels.cc: the SSE2 code is compiled with a per-function
+// target attribute and selected at run time.  The NEON code is only
+// compiled when the compiler targets NEON (always true on AArch64, and
+// with -mfpu=neon on 32-bit ARM), so it needs no run-time check.
+// Other CPUs use the fast portable versions.
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__)) && \
+    (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define DCT_SSE2 1
+#include <emmintrin.h>
+#define SSE2_FUNC __attribute__((target("sse2")))
+#define SSE2_INLINE __attribute__((target("sse2"), always_inline)) inline
+#else
+#define DCT_SSE2 0
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define DCT_NEON 1
+#include <arm_neon.h>
+#else
+#define DCT_NEON 0
+#endif
+
+// the 1-D IDCT helpers must be inlined, so that their shifts and
+// strides are constants
+#ifdef __GNUC__
+#define DCT_INLINE __attribute__((always_inline)) inline
+#else
+#define DCT_INLINE inline
+#endif
+
+// IDCT constants (20.12 fixed point format)
+#define dctCos1    4017		// cos(pi/16)
+#define dctSin1     799		// sin(pi/16)
+#define dctCos3    3406		// cos(3*pi/16)
+#define dctSin3    2276		// sin(3*pi/16)
+#define dctCos6    1567		// cos(6*pi/16)
+#define dctSin6    3784		// sin(6*pi/16)
+#define dctSqrt2   5793		// sqrt(2)
+#define dctSqrt1d2 2896		// sqrt(2) / 2
+
+// color conversion parameters (16.16 fixed point format)
+#define dctCrToR   91881	//  1.4020
+#define dctCbToG  -22553	// -0.3441363
+#define dctCrToG  -46802	// -0.71413636
+#define dctCbToB  116130	//  1.772
+
+//------------------------------------------------------------------------
+
+typedef void (*TransformDataUnitFunc)(Gushort *quantTable, int dataIn[64],
+				      Guchar dataOut[64]);
+typedef void (*ConvertYCbCrFunc)(Guchar *p0, Guchar *p1, Guchar *p2, int n,
+				 GBool invert);
+typedef void (*UpsampleH2V2Func)(Guchar dataIn[64], Guchar **rows, int x);
+
+static void transformDataUnitC(Gushort *quantTable, int dataIn[64],
+			       Guchar dataOut[64]);
+static void convertYCbCrC(Guchar *p0, Guchar *p1, Guchar *p2, int n,
+			  GBool invert);
+static void upsampleH2V2C(Guchar dataIn[64], Guchar **rows, int x);
+
+static GBool kernelsInited = gFalse;
+static DCTKernelsImpl kernelsImpl = dctKernelsC;
+static TransformDataUnitFunc transformDataUnitFunc = &transformDataUnitC;
+static ConvertYCbCrFunc convertYCbCrFunc = &convertYCbCrC;
+static UpsampleH2V2Func upsampleH2V2Func = &upsampleH2V2C;
+
+//------------------------------------------------------------------------
+// reference versions
+//------------------------------------------------------------------------
+
+static inline Guchar clip8(int x) {
+  return x < 0 ? 0 : x > 255 ? 255 : (Guchar)x;
+}
+
+// This IDCT algorithm is taken from:
+//   Christoph Loeffler, Adriaan Ligtenberg, George S. Moschytz,
+//   "Practical Fast 1-D DCT Algorithms with 11 Multiplications",
+//   IEEE Intl. Conf. on Acoustics, Speech & Signal Processing, 1989,
+//   988-991.
+// The stage numbers mentioned in the comments refer to Figure 1 in this
+// paper.
+static void transformDataUnitC(Gushort *quantTable, int dataIn[64],
+			       Guchar dataOut[64]) {
+  int v0, v1, v2, v3, v4, v5, v6, v7, t;
+  int *p;
+  int i;
+
+  // dequant
+  for (i = 0; i < 64; ++i) {
+    dataIn[i] *= quantTable[i];
+  }
+
+  // inverse DCT on rows
+  for (i = 0; i < 64; i += 8) {
+    p = dataIn + i;
+
+    // check for all-zero AC coefficients
+    if (p[1] == 0 && p[2] == 0 && p[3] == 0 &&
+	p[4] == 0 && p[5] == 0 && p[6] == 0 && p[7] == 0) {
+      t = (dctSqrt2 * p[0] + 512) >> 10;
+      p[0] = t;
+      p[1] = t;
+      p[2] = t;
+      p[3] = t;
+      p[4] = t;
+      p[5] = t;
+      p[6] = t;
+      p[7] = t;
+      continue;
+    }
+
+    // stage 4
+    v0 = (dctSqrt2 * p[0] + 128) >> 8;
+    v1 = (dctSqrt2 * p[4] + 128) >> 8;
+    v2 = p[2];
+    v3 = p[6];
+    v4 = (dctSqrt1d2 * (p[1] - p[7]) + 128) >> 8;
+    v7 = (dctSqrt1d2 * (p[1] + p[7]) + 128) >> 8;
+    v5 = p[3] << 4;
+    v6 = p[5] << 4;
+
+    // stage 3
+    t = (v0 - v1+ 1) >> 1;
+    v0 = (v0 + v1 + 1) >> 1;
+    v1 = t;
+    t = (v2 * dctSin6 + v3 * dctCos6 + 128) >> 8;
+    v2 = (v2 * dctCos6 - v3 * dctSin6 + 128) >> 8;
+    v3 = t;
+    t = (v4 - v6 + 1) >> 1;
+    v4 = (v4 + v6 + 1) >> 1;
+    v6 = t;
+    t = (v7 + v5 + 1) >> 1;
+    v5 = (v7 - v5 + 1) >> 1;
+    v7 = t;
+
+    // stage 2
+    t = (v0 - v3 + 1) >> 1;
+    v0 = (v0 + v3 + 1) >> 1;
+    v3 = t;
+    t = (v1 - v2 + 1) >> 1;
+    v1 = (v1 + v2 + 1) >> 1;
+    v2 = t;
+    t = (v4 * dctSin3 + v7 * dctCos3 + 2048) >> 12;
+    v4 = (v4 * dctCos3 - v7 * dctSin3 + 2048) >> 12;
+    v7 = t;
+    t = (v5 * dctSin1 + v6 * dctCos1 + 2048) >> 12;
+    v5 = (v5 * dctCos1 - v6 * dctSin1 + 2048) >> 12;
+    v6 = t;
+
+    // stage 1
+    p[0] = v0 + v7;
+    p[7] = v0 - v7;
+    p[1] = v1 + v6;
+    p[6] = v1 - v6;
+    p[2] = v2 + v5;
+    p[5] = v2 - v5;
+    p[3] = v3 + v4;
+    p[4] = v3 - v4;
+  }
+
+  // inverse DCT on columns
+  for (i = 0; i < 8; ++i) {
+    p = dataIn + i;
+
+    // check for all-zero AC coefficients
+    if (p[1*8] == 0 && p[2*8] == 0 && p[3*8] == 0 &&
+	p[4*8] == 0 && p[5*8] == 0 && p[6*8] == 0 && p[7*8] == 0) {
+      t = (dctSqrt2 * dataIn[i+0] + 8192) >> 14;
+      p[0*8] = t;
+      p[1*8] = t;
+      p[2*8] = t;
+      p[3*8] = t;
+      p[4*8] = t;
+      p[5*8] = t;
+      p[6*8] = t;
+      p[7*8] = t;
+      continue;
+    }
+
+    // stage 4
+    v0 = (dctSqrt2 * p[0*8] + 2048) >> 12;
+    v1 = (dctSqrt2 * p[4*8] + 2048) >> 12;
+    v2 = p[2*8];
+    v3 = p[6*8];
+    v4 = (dctSqrt1d2 * (p[1*8] - p[7*8]) + 2048) >> 12;
+    v7 = (dctSqrt1d2 * (p[1*8] + p[7*8]) + 2048) >> 12;
+    v5 = p[3*8];
+    v6 = p[5*8];
+
+    // stage 3
+    t = (v0 - v1 + 1) >> 1;
+    v0 = (v0 + v1 + 1) >> 1;
+    v1 = t;
+    t = (v2 * dctSin6 + v3 * dctCos6 + 2048) >> 12;
+    v2 = (v2 * dctCos6 - v3 * dctSin6 + 2048) >> 12;
+    v3 = t;
+    t = (v4 - v6 + 1) >> 1;
+    v4 = (v4 + v6 + 1) >> 1;
+    v6 = t;
+    t = (v7 + v5 + 1) >> 1;
+    v5 = (v7 - v5 + 1) >> 1;
+    v7 = t;
+
+    // stage 2
+    t = (v0 - v3 + 1) >> 1;
+    v0 = (v0 + v3 + 1) >> 1;
+    v3 = t;
+    t = (v1 - v2 + 1) >> 1;
+    v1 = (v1 + v2 + 1) >> 1;
+    v2 = t;
+    t = (v4 * dctSin3 + v7 * dctCos3 + 2048) >> 12;
+    v4 = (v4 * dctCos3 - v7 * dctSin3 + 2048) >> 12;
+    v7 = t;
+    t = (v5 * dctSin1 + v6 * dctCos1 + 2048) >> 12;
+    v5 = (v5 * dctCos1 - v6 * dctSin1 + 2048) >> 12;
+    v6 = t;
+
+    // stage 1
+    p[0*8] = v0 + v7;
+    p[7*8] = v0 - v7;
+    p[1*8] = v1 + v6;
+    p[6*8] = v1 - v6;
+    p[2*8] = v2 + v5;
+    p[5*8] = v2 - v5;
+    p[3*8] = v3 + v4;
+    p[4*8] = v3 - v4;
+  }
+
+  // convert to 8-bit integers
+  for (i = 0; i < 64; ++i) {
+    dataOut[i] = clip8(128 + ((dataIn[i] + 8) >> 4));
+  }
+}
+
+static void convertYCbCrC(Guchar *p0, Guchar *p1, Guchar *p2, int n,
+			  GBool invert) {
+  int pY, pCb, pCr, pR, pG, pB, inv, i;
+
+  inv = invert ? 0xff : 0;
+  for (i = 0; i < n; ++i) {
+    pY = p0[i];
+    pCb = p1[i] - 128;
+    pCr = p2[i] - 128;
+    pR = ((pY << 16) + dctCrToR * pCr + 32768) >> 16;
+    p0[i] = clip8(pR) ^ inv;
+    pG = ((pY << 16) + dctCbToG * pCb + dctCrToG * pCr + 32768) >> 16;
+    p1[i] = clip8(pG) ^ inv;
+    pB = ((pY << 16) + dctCbToB * pCb + 32768) >> 16;
+    p2[i] = clip8(pB) ^ inv;
+  }
+}
+
+static void upsampleH2V2C(Guchar dataIn[64], Guchar **rows, int x) {
+  Guchar *p1, *p2;
+  int y, i;
+
+  for (y = 0, i = 0; y < 16; y += 2, i += 8) {
+    p1 = rows[y] + x;
+    p2 = rows[y+1] + x;
+    p1[0] = p1[1] = p2[0] = p2[1] = dataIn[i];
+    p1[2] = p1[3] = p2[2] = p2[3] = dataIn[i+1];
+    p1[4] = p1[5] = p2[4] = p2[5] = dataIn[i+2];
+    p1[6] = p1[7] = p2[6] = p2[7] = dataIn[i+3];
+    p1[8] = p1[9] = p2[8] = p2[9] = dataIn[i+4];
+    p1[10] = p1[11] = p2[10] = p2[11] = dataIn[i+5];
+    p1[12] = p1[13] = p2[12] = p2[13] = dataIn[i+6];
+    p1[14] = p1[15] = p2[14] = p2[15] = dataIn[i+7];
+  }
+}
+
+//------------------------------------------------------------------------
+// fast portable versions
+//------------------------------------------------------------------------
+
+// One 1-D pass of the C version's IDCT, on the eight values p[0],
+// p[stride], ..., p[7*stride].  <shift> is the shift after the stage 4
+// and 3 multiplies (8 for rows, 12 for columns), and <shift35> the
+// shift applied to coefficients 3 and 5.
+static DCT_INLINE void idct1D(int *p, int stride, int shift, int shift35,
+			      Guchar *out) {
+  int v0, v1, v2, v3, v4, v5, v6, v7, t, round;
+
+  round = 1 << (shift - 1);
+
+  // stage 4
+  v0 = (dctSqrt2 * p[0] + round) >> shift;
+  v1 = (dctSqrt2 * p[4*stride] + round) >> shift;
+  v2 = p[2*stride];
+  v3 = p[6*stride];
+  v4 = (dctSqrt1d2 * (p[stride] - p[7*stride]) + round) >> shift;
+  v7 = (dctSqrt1d2 * (p[stride] + p[7*stride]) + round) >> shift;
+  v5 = p[3*stride] << shift35;
+  v6 = p[5*stride] << shift35;
+
+  // stage 3
+  t = (v0 - v1 + 1) >> 1;
+  v0 = (v0 + v1 + 1) >> 1;
+  v1 = t;
+  t = (v2 * dctSin6 + v3 * dctCos6 + round) >> shift;
+  v2 = (v2 * dctCos6 - v3 * dctSin6 + round) >> shift;
+  v3 = t;
+  t = (v4 - v6 + 1) >> 1;
+  v4 = (v4 + v6 + 1) >> 1;
+  v6 = t;
+  t = (v7 + v5 + 1) >> 1;
+  v5 = (v7 - v5 + 1) >> 1;
+  v7 = t;
+
+  // stage 2
+  t = (v0 - v3 + 1) >> 1;
+  v0 = (v0 + v3 + 1) >> 1;
+  v3 = t;
+  t = (v1 - v2 + 1) >> 1;
+  v1 = (v1 + v2 + 1) >> 1;
+  v2 = t;
+  t = (v4 * dctSin3 + v7 * dctCos3 + 2048) >> 12;
+  v4 = (v4 * dctCos3 - v7 * dctSin3 + 2048) >> 12;
+  v7 = t;
+  t = (v5 * dctSin1 + v6 * dctCos1 + 2048) >> 12;
+  v5 = (v5 * dctCos1 - v6 * dctSin1 + 2048) >> 12;
+  v6 = t;
+
+  // stage 1
+  if (out) {
+    out[0] = clip8(128 + ((v0 + v7 + 8) >> 4));
+    out[7*8] = clip8(128 + ((v0 - v7 + 8) >> 4));
+    out[1*8] = clip8(128 + ((v1 + v6 + 8) >> 4));
+    out[6*8] = clip8(128 + ((v1 - v6 + 8) >> 4));
+    out[2*8] = clip8(128 + ((v2 + v5 + 8) >> 4));
+    out[5*8] = clip8(128 + ((v2 - v5 + 8) >> 4));
+    out[3*8] = clip8(128 + ((v3 + v4 + 8) >> 4));
+    out[4*8] = clip8(128 + ((v3 - v4 + 8) >> 4));
+  } else {
+    p[0] = v0 + v7;
+    p[7*stride] = v0 - v7;
+    p[stride] = v1 + v6;
+    p[6*stride] = v1 - v6;
+    p[2*stride] = v2 + v5;
+    p[5*stride] = v2 - v5;
+    p[3*stride] = v3 + v4;
+    p[4*stride] = v3 - v4;
+  }
+}
+
+// Same as idct1D on a column (with <out>), for rows 4..7 all zero,
+// which drops four of the multiplies: v1, v3, and v6 are zero, and
+// v4 = v7.
+static DCT_INLINE void idctColumnHalf(int *p, Guchar *out) {
+  int v0, v1, v2, v3, v4, v5, v6, v7, t;
+
+  // stage 4
+  v0 = (dctSqrt2 * p[0] + 2048) >> 12;
+  v2 = p[2*8];
+  v4 = (dctSqrt1d2 * p[1*8] + 2048) >> 12;
+  v5 = p[3*8];
+
+  // stage 3
+  v0 = v1 = (v0 + 1) >> 1;
+  v3 = (v2 * dctSin6 + 2048) >> 12;
+  v2 = (v2 * dctCos6 + 2048) >> 12;
+  t = (v4 + 1) >> 1;
+  v7 = (v4 + v5 + 1) >> 1;
+  v5 = (v4 - v5 + 1) >> 1;
+  v4 = v6 = t;
+
+  // stage 2
+  t = (v0 - v3 + 1) >> 1;
+  v0 = (v0 + v3 + 1) >> 1;
+  v3 = t;
+  t = (v1 - v2 + 1) >> 1;
+  v1 = (v1 + v2 + 1) >> 1;
+  v2 = t;
+  t = (v4 * dctSin3 + v7 * dctCos3 + 2048) >> 12;
+  v4 = (v4 * dctCos3 - v7 * dctSin3 + 2048) >> 12;
+  v7 = t;
+  t = (v5 * dctSin1 + v6 * dctCos1 + 2048) >> 12;
+  v5 = (v5 * dctCos1 - v6 * dctSin1 + 2048) >> 12;
+  v6 = t;
+
+  // stage 1
+  out[0] = clip8(128 + ((v0 + v7 + 8) >> 4));
+  out[7*8] = clip8(128 + ((v0 - v7 + 8) >> 4));
+  out[1*8] = clip8(128 + ((v1 + v6 + 8) >> 4));
+  out[6*8] = clip8(128 + ((v1 - v6 + 8) >> 4));
+  out[2*8] = clip8(128 + ((v2 + v5 + 8) >> 4));
+  out[5*8] = clip8(128 + ((v2 - v5 + 8) >> 4));
+  out[3*8] = clip8(128 + ((v3 + v4 + 8) >> 4));
+  out[4*8] = clip8(128 + ((v3 - v4 + 8) >> 4));
+}
+
+// The C version's IDCT, skipping work for the zero coefficients that
+// make up most of a typical data unit: the dequant notes which rows
+// are all zero and which have only a DC coefficient, and the passes
+// use the cheapest code that gives the same result.  The column pass
+// also does the conversion to 8-bit samples.
+static void transformDataUnitFast(Gushort *quantTable, int dataIn[64],
+				  Guchar dataOut[64]) {
+  Gushort *q;
+  int *p;
+  Guchar *q8;
+  int nzRows, acRows, ac, t, i;
+
+  // dequant
+  nzRows = acRows = 0;
+  for (i = 0; i < 8; ++i) {
+    p = dataIn + 8 * i;
+    q = quantTable + 8 * i;
+    p[0] *= q[0];
+    p[1] *= q[1];
+    p[2] *= q[2];
+    p[3] *= q[3];
+    p[4] *= q[4];
+    p[5] *= q[5];
+    p[6] *= q[6];
+    p[7] *= q[7];
+    ac = p[1] | p[2] | p[3] | p[4] | p[5] | p[6] | p[7];
+    if (ac) {
+      acRows |= 1 << i;
+    }
+    if (ac | p[0]) {
+      nzRows |= 1 << i;
+    }
+  }
+
+  // a block with only a DC coefficient takes the all-zero AC shortcut
+  // in both passes
+  if (nzRows <= 1 && !acRows) {
+    t = (dctSqrt2 * dataIn[0] + 512) >> 10;
+    t = (dctSqrt2 * t + 8192) >> 14;
+    memset(dataOut, clip8(128 + ((t + 8) >> 4)), 64);
+    return;
+  }
+
+  // inverse DCT on rows -- all-zero rows stay that way
+  for (i = 0; i < 8; ++i) {
+    p = dataIn + 8 * i;
+    if (!(nzRows & (1 << i))) {
+      continue;
+    }
+    if (!(acRows & (1 << i))) {
+      t = (dctSqrt2 * p[0] + 512) >> 10;
+      p[0] = p[1] = p[2] = p[3] = p[4] = p[5] = p[6] = p[7] = t;
+    } else {
+      idct1D(p, 1, 8, 4, NULL);
+    }
+  }
+
+  // if only the first row is nonzero, every column takes the all-zero
+  // AC shortcut, so each column of the result is a single value
+  if (nzRows == 1) {
+    for (i = 0; i < 8; ++i) {
+      t = (dctSqrt2 * dataIn[i] + 8192) >> 14;
+      dataOut[i] = clip8(128 + ((t + 8) >> 4));
+    }
+    for (i = 8; i < 64; i += 8) {
+      memcpy(dataOut + i, dataOut, 8);
+    }
+    return;
+  }
+
+  // inverse DCT on columns, and convert to 8-bit integers
+  for (i = 0; i < 8; ++i) {
+    p = dataIn + i;
+    q8 = dataOut + i;
+    if (p[1*8] == 0 && p[2*8] == 0 && p[3*8] == 0 &&
+	p[4*8] == 0 && p[5*8] == 0 && p[6*8] == 0 && p[7*8] == 0) {
+      t = (dctSqrt2 * p[0] + 8192) >> 14;
+      q8[0*8] = q8[1*8] = q8[2*8] = q8[3*8] =
+	q8[4*8] = q8[5*8] = q8[6*8] = q8[7*8] = clip8(128 + ((t + 8) >> 4));
+    } else if (!(nzRows & 0xf0)) {
+      idctColumnHalf(p, q8);
+    } else {
+      idct1D(p, 8, 12, 0, q8);
+    }
+  }
+}
+
+// The first and second pairs of samples (in memory order) in a word.
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define dctLoPair(w) ((w) >> 16)
+#define dctHiPair(w) ((w) & 0xffff)
+#else
+#define dctLoPair(w) ((w) & 0xffff)
+#define dctHiPair(w) ((w) >> 16)
+#endif
+
+// Doubles each of the two low bytes of <x>: 0xaabb -> 0xaaaabbbb.
+static inline Guint spread2(Guint x) {
+  x = (x | (x << 8)) & 0x00ff00ff;
+  return x | (x << 8);
+}
+
+// Four samples are loaded as a 32-bit word, and stored as two words on
+// each of the two output rows.
+static void upsampleH2V2Fast(Guchar dataIn[64], Guchar **rows, int x) {
+  Guint w, out[2];
+  int i, j;
+
+  for (i = 0; i < 8; ++i) {
+    for (j = 0; j < 8; j += 4) {
+      memcpy(&w, dataIn + 8 * i + j, 4);
+      out[0] = spread2(dctLoPair(w));
+      out[1] = spread2(dctHiPair(w));
+      memcpy(rows[2 * i] + x + 2 * j, out, 8);
+      memcpy(rows[2 * i + 1] + x + 2 * j, out, 8);
+    }
+  }
+}
+
+//------------------------------------------------------------------------
+// SSE2 versions
+//------------------------------------------------------------------------
+
+#if DCT_SSE2
+
+// Low 32 bits of the products of four 32-bit ints <a> and four
+// unsigned 16-bit values <b> (each repeated in both halves of its
+// 32-bit lane), which is what the C code's int multiplies produce.
+// SSE2 has no pmulld, but with a = ah * 65536 + al:
+//   a * b = (al * b) + ((ah * b) << 16)   (mod 2^32)
+SSE2_INLINE static __m128i mul32(__m128i a, __m128i b) {
+  return _mm_add_epi32(_mm_mullo_epi16(a, b),
+		       _mm_slli_epi32(_mm_mulhi_epu16(a, b), 16));
+}
+
+SSE2_INLINE static __m128i mulC(__m128i a, int c) {
+  return mul32(a, _mm_set1_epi16((short)c));
+}
+
+// (a + round) >> shift
+SSE2_INLINE static __m128i descale(__m128i a, int round, int shift) {
+  return _mm_sra_epi32(_mm_add_epi32(a, _mm_set1_epi32(round)),
+		       _mm_cvtsi32_si128(shift));
+}
+
+// (a + b + 1) >> 1
+SSE2_INLINE static __m128i avg(__m128i a, __m128i b) {
+  return _mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(a, b),
+				      _mm_set1_epi32(1)), 1);
+}
+
+SSE2_INLINE static void transpose4(__m128i *r0, __m128i *r1,
+					__m128i *r2, __m128i *r3) {
+  __m128i t0, t1, t2, t3;
+
+  t0 = _mm_unpacklo_epi32(*r0, *r1);
+  t1 = _mm_unpacklo_epi32(*r2, *r3);
+  t2 = _mm_unpackhi_epi32(*r0, *r1);
+  t3 = _mm_unpackhi_epi32(*r2, *r3);
+  *r0 = _mm_unpacklo_epi64(t0, t1);
+  *r1 = _mm_unpackhi_epi64(t0, t1);
+  *r2 = _mm_unpacklo_epi64(t2, t3);
+  *r3 = _mm_unpackhi_epi64(t2, t3);
+}
+
+// One 1-D pass of the C version's IDCT, on four rows (or columns) at
+// once: v[k] holds coefficient k of each of them.  The row and column
+// passes differ only in their fixed point scaling: <s4> is the shift
+// after the stage 4 and 3 multiplies, <s35> the shift applied to
+// coefficients 3 and 5, and <sDC> the shift for DC-only rows.
+SSE2_INLINE static void idct1DSSE2(__m128i *v, int s4, int s35,
+					int sDC) {
+  __m128i v0, v1, v2, v3, v4, v5, v6, v7, t, dc, zero, ac;
+
+  // check for all-zero AC coefficients
+  zero = _mm_setzero_si128();
+  ac = _mm_or_si128(_mm_or_si128(_mm_or_si128(v[1], v[2]),
+				 _mm_or_si128(v[3], v[4])),
+		    _mm_or_si128(_mm_or_si128(v[5], v[6]), v[7]));
+  ac = _mm_cmpeq_epi32(ac, zero);
+  dc = descale(mulC(v[0], dctSqrt2), 1 << (sDC - 1), sDC);
+
+  // stage 4
+  v0 = descale(mulC(v[0], dctSqrt2), 1 << (s4 - 1), s4);
+  v1 = descale(mulC(v[4], dctSqrt2), 1 << (s4 - 1), s4);
+  v2 = v[2];
+  v3 = v[6];
+  v4 = descale(mulC(_mm_sub_epi32(v[1], v[7]), dctSqrt1d2),
+	       1 << (s4 - 1), s4);
+  v7 = descale(mulC(_mm_add_epi32(v[1], v[7]), dctSqrt1d2),
+	       1 << (s4 - 1), s4);
+  v5 = _mm_sll_epi32(v[3], _mm_cvtsi32_si128(s35));
+  v6 = _mm_sll_epi32(v[5], _mm_cvtsi32_si128(s35));
+
+  // stage 3
+  t = avg(v0, _mm_sub_epi32(zero, v1));
+  v0 = avg(v0, v1);
+  v1 = t;
+  t = descale(_mm_add_epi32(mulC(v2, dctSin6), mulC(v3, dctCos6)),
+	      1 << (s4 - 1), s4);
+  v2 = descale(_mm_sub_epi32(mulC(v2, dctCos6), mulC(v3, dctSin6)),
+	       1 << (s4 - 1), s4);
+  v3 = t;
+  t = avg(v4, _mm_sub_epi32(zero, v6));
+  v4 = avg(v4, v6);
+  v6 = t;
+  t = avg(v7, v5);
+  v5 = avg(v7, _mm_sub_epi32(zero, v5));
+  v7 = t;
+
+  // stage 2
+  t = avg(v0, _mm_sub_epi32(zero, v3));
+  v0 = avg(v0, v3);
+  v3 = t;
+  t = avg(v1, _mm_sub_epi32(zero, v2));
+  v1 = avg(v1, v2);
+  v2 = t;
+  t = descale(_mm_add_epi32(mulC(v4, dctSin3), mulC(v7, dctCos3)),
+	      2048, 12);
+  v4 = descale(_mm_sub_epi32(mulC(v4, dctCos3), mulC(v7, dctSin3)),
+	       2048, 12);
+  v7 = t;
+  t = descale(_mm_add_epi32(mulC(v5, dctSin1), mulC(v6, dctCos1)),
+	      2048, 12);
+  v5 = descale(_mm_sub_epi32(mulC(v5, dctCos1), mulC(v6, dctSin1)),
+	       2048, 12);
+  v6 = t;
+
+  // stage 1, or the DC value
+#define dctSelect(x) _mm_or_si128(_mm_and_si128(ac, dc), \
+				  _mm_andnot_si128(ac, (x)))
+  v[0] = dctSelect(_mm_add_epi32(v0, v7));
+  v[7] = dctSelect(_mm_sub_epi32(v0, v7));
+  v[1] = dctSelect(_mm_add_epi32(v1, v6));
+  v[6] = dctSelect(_mm_sub_epi32(v1, v6));
+  v[2] = dctSelect(_mm_add_epi32(v2, v5));
+  v[5] = dctSelect(_mm_sub_epi32(v2, v5));
+  v[3] = dctSelect(_mm_add_epi32(v3, v4));
+  v[4] = dctSelect(_mm_sub_epi32(v3, v4));
+#undef dctSelect
+}
+
+SSE2_FUNC static void transformDataUnitSSE2(Gushort *quantTable,
+					    int dataIn[64],
+					    Guchar dataOut[64]) {
+  __m128i rows[8][2], v[8], zero, q, r, ac[2];
+  int g, h, i, t;
+
+  // dequant: rows[i][h] = row i, columns 4h .. 4h+3
+  zero = _mm_setzero_si128();
+  ac[0] = ac[1] = zero;
+  for (i = 0; i < 8; ++i) {
+    q = _mm_loadu_si128((__m128i *)(quantTable + 8 * i));
+    rows[i][0] = mul32(_mm_loadu_si128((__m128i *)(dataIn + 8 * i)),
+		       _mm_unpacklo_epi16(q, q));
+    rows[i][1] = mul32(_mm_loadu_si128((__m128i *)(dataIn + 8 * i + 4)),
+		       _mm_unpackhi_epi16(q, q));
+    ac[i >> 2] = _mm_or_si128(ac[i >> 2],
+			      _mm_or_si128(rows[i][0], rows[i][1]));
+  }
+
+  // a block with only a DC coefficient, which is very common, takes
+  // the C version's all-zero AC shortcuts in both passes
+  t = _mm_cvtsi128_si32(rows[0][0]);
+  if (_mm_movemask_epi8(_mm_cmpeq_epi32(
+	  _mm_or_si128(ac[1], _mm_or_si128(
+	    _mm_slli_si128(_mm_srli_si128(rows[0][0], 4), 4),
+	    _mm_or_si128(rows[0][1], _mm_or_si128(
+	      _mm_or_si128(rows[1][0], rows[1][1]),
+	      _mm_or_si128(_mm_or_si128(rows[2][0], rows[2][1]),
+			   _mm_or_si128(rows[3][0], rows[3][1])))))),
+	  zero)) == 0xffff) {
+    t = (dctSqrt2 * t + 512) >> 10;
+    t = (dctSqrt2 * t + 8192) >> 14;
+    memset(dataOut, clip8(128 + ((t + 8) >> 4)), 64);
+    return;
+  }
+
+  // inverse DCT on rows, four at a time (transposed so that each
+  // vector holds one coefficient of four rows) -- if the last four
+  // rows are all zero, they stay that way
+  for (g = 0; g < 8; g += 4) {
+    if (g == 4 &&
+	_mm_movemask_epi8(_mm_cmpeq_epi32(ac[1], zero)) == 0xffff) {
+      break;
+    }
+    for (h = 0; h < 2; ++h) {
+      for (i = 0; i < 4; ++i) {
+	v[4 * h + i] = rows[g + i][h];
+      }
+      transpose4(&v[4 * h], &v[4 * h + 1], &v[4 * h + 2], &v[4 * h + 3]);
+    }
+    idct1DSSE2(v, 8, 4, 10);
+    for (h = 0; h < 2; ++h) {
+      transpose4(&v[4 * h], &v[4 * h + 1], &v[4 * h + 2], &v[4 * h + 3]);
+      for (i = 0; i < 4; ++i) {
+	rows[g + i][h] = v[4 * h + i];
+      }
+    }
+  }
+
+  // inverse DCT on columns, four at a time
+  for (h = 0; h < 2; ++h) {
+    for (i = 0; i < 8; ++i) {
+      v[i] = rows[i][h];
+    }
+    idct1DSSE2(v, 12, 0, 14);
+    for (i = 0; i < 8; ++i) {
+      rows[i][h] = v[i];
+    }
+  }
+
+  // convert to 8-bit integers (the saturating packs do the clipping)
+  for (i = 0; i < 8; ++i) {
+    r = _mm_packs_epi32(
+	  _mm_add_epi32(descale(rows[i][0], 8, 4), _mm_set1_epi32(128)),
+	  _mm_add_epi32(descale(rows[i][1], 8, 4), _mm_set1_epi32(128)));
+    _mm_storel_epi64((__m128i *)(dataOut + 8 * i), _mm_packus_epi16(r, r));
+  }
+}
+
+// Convert eight pixels, given as 16-bit Y, Cb - 128, and Cr - 128
+// values; the results are 16-bit, not yet clipped.  The 16.16
+// constants don't fit in 16 bits, so they are split into a multiple
+// of 65536 (applied with a shift) plus a 16-bit part (applied with
+// pmaddwd):
+//   R = Y + Cr + 26345/65536 Cr
+//   G = Y - Cr - 22553/65536 Cb + 18734/65536 Cr
+//   B = Y + 2 Cb - 14942/65536 Cb
+SSE2_INLINE static void convert8SSE2(__m128i y, __m128i cb, __m128i cr,
+					  __m128i *r, __m128i *g,
+					  __m128i *b) {
+  __m128i zero, round, kR, kG, kB, lo, hi, sLo, sHi, s;
+
+  zero = _mm_setzero_si128();
+  round = _mm_set1_epi32(32768);
+  // pmaddwd pairs are (Cb, Cr)
+  kR = _mm_set1_epi32(26345 << 16);
+  kG = _mm_set1_epi32((18734 << 16) | (-22553 & 0xffff));
+  kB = _mm_set1_epi32(-14942 & 0xffff);
+  lo = _mm_unpacklo_epi16(cb, cr);
+  hi = _mm_unpackhi_epi16(cb, cr);
+
+  s = _mm_add_epi16(y, cr);
+  sLo = _mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(lo, kR), round),
+		      _mm_unpacklo_epi16(zero, s));
+  sHi = _mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(hi, kR), round),
+		      _mm_unpackhi_epi16(zero, s));
+  *r = _mm_packs_epi32(_mm_srai_epi32(sLo, 16), _mm_srai_epi32(sHi, 16));
+
+  s = _mm_sub_epi16(y, cr);
+  sLo = _mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(lo, kG), round),
+		      _mm_unpacklo_epi16(zero, s));
+  sHi = _mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(hi, kG), round),
+		      _mm_unpackhi_epi16(zero, s));
+  *g = _mm_packs_epi32(_mm_srai_epi32(sLo, 16), _mm_srai_epi32(sHi, 16));
+
+  s = _mm_add_epi16(y, _mm_add_epi16(cb, cb));
+  sLo = _mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(lo, kB), round),
+		      _mm_unpacklo_epi16(zero, s));
+  sHi = _mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(hi, kB), round),
+		      _mm_unpackhi_epi16(zero, s));
+  *b = _mm_packs_epi32(_mm_srai_epi32(sLo, 16), _mm_srai_epi32(sHi, 16));
+}
+
+SSE2_FUNC static void convertYCbCrSSE2(Guchar *p0, Guchar *p1, Guchar *p2,
+				       int n, GBool invert) {
+  __m128i zero, k128, inv, y, cb, cr, r, g, b;
+  int i;
+
+  zero = _mm_setzero_si128();
+  k128 = _mm_set1_epi16(128);
+  inv = invert ? _mm_set1_epi8((char)0xff) : zero;
+  for (i = 0; i + 8 <= n; i += 8) {
+    y = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i *)(p0 + i)), zero);
+    cb = _mm_sub_epi16(
+	   _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i *)(p1 + i)), zero),
+	   k128);
+    cr = _mm_sub_epi16(
+	   _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i *)(p2 + i)), zero),
+	   k128);
+    convert8SSE2(y, cb, cr, &r, &g, &b);
+    _mm_storel_epi64((__m128i *)(p0 + i),
+		     _mm_xor_si128(_mm_packus_epi16(r, r), inv));
+    _mm_storel_epi64((__m128i *)(p1 + i),
+		     _mm_xor_si128(_mm_packus_epi16(g, g), inv));
+    _mm_storel_epi64((__m128i *)(p2 + i),
+		     _mm_xor_si128(_mm_packus_epi16(b, b), inv));
+  }
+  convertYCbCrC(p0 + i, p1 + i, p2 + i, n - i, invert);
+}
+
+SSE2_FUNC static void upsampleH2V2SSE2(Guchar dataIn[64], Guchar **rows,
+				       int x) {
+  __m128i v;
+  int i;
+
+  for (i = 0; i < 8; ++i) {
+    v = _mm_loadl_epi64((__m128i *)(dataIn + 8 * i));
+    v = _mm_unpacklo_epi8(v, v);
+    _mm_storeu_si128((__m128i *)(rows[2 * i] + x), v);
+    _mm_storeu_si128((__m128i *)(rows[2 * i + 1] + x), v);
+  }
+}
+
+#endif // DCT_SSE2
+
+//------------------------------------------------------------------------
+// NEON versions
+//------------------------------------------------------------------------
+
+#if DCT_NEON
+
+// (a + round) >> shift -- vshlq with a negative count is an arithmetic
+// right shift, and (unlike vshrq_n) doesn't need a constant
+static DCT_INLINE int32x4_t descaleNEON(int32x4_t a, int round, int shift) {
+  return vshlq_s32(vaddq_s32(a, vdupq_n_s32(round)), vdupq_n_s32(-shift));
+}
+
+// (a + 1) >> 1
+static DCT_INLINE int32x4_t halfNEON(int32x4_t a) {
+  return vshrq_n_s32(vaddq_s32(a, vdupq_n_s32(1)), 1);
+}
+
+static DCT_INLINE GBool isZeroNEON(int32x4_t a) {
+  uint32x2_t t;
+
+  t = vorr_u32(vget_low_u32(vreinterpretq_u32_s32(a)),
+	       vget_high_u32(vreinterpretq_u32_s32(a)));
+  return (vget_lane_u32(t, 0) | vget_lane_u32(t, 1)) == 0;
+}
+
+static DCT_INLINE void transpose4NEON(int32x4_t *r0, int32x4_t *r1,
+				      int32x4_t *r2, int32x4_t *r3) {
+  int32x4x2_t t01, t23;
+
+  t01 = vtrnq_s32(*r0, *r1);
+  t23 = vtrnq_s32(*r2, *r3);
+  *r0 = vcombine_s32(vget_low_s32(t01.val[0]), vget_low_s32(t23.val[0]));
+  *r1 = vcombine_s32(vget_low_s32(t01.val[1]), vget_low_s32(t23.val[1]));
+  *r2 = vcombine_s32(vget_high_s32(t01.val[0]), vget_high_s32(t23.val[0]));
+  *r3 = vcombine_s32(vget_high_s32(t01.val[1]), vget_high_s32(t23.val[1]));
+}
+
+// Same as idct1DSSE2.  NEON has a 32-bit multiply, so the products
+// are the C code's directly.
+static DCT_INLINE void idct1DNEON(int32x4_t *v, int s4, int s35, int sDC) {
+  int32x4_t v0, v1, v2, v3, v4, v5, v6, v7, t, dc;
+  uint32x4_t ac;
+
+  // check for all-zero AC coefficients
+  ac = vceqq_s32(vorrq_s32(vorrq_s32(vorrq_s32(v[1], v[2]),
+				     vorrq_s32(v[3], v[4])),
+			   vorrq_s32(vorrq_s32(v[5], v[6]), v[7])),
+		 vdupq_n_s32(0));
+  dc = descaleNEON(vmulq_n_s32(v[0], dctSqrt2), 1 << (sDC - 1), sDC);
+
+  // stage 4
+  v0 = descaleNEON(vmulq_n_s32(v[0], dctSqrt2), 1 << (s4 - 1), s4);
+  v1 = descaleNEON(vmulq_n_s32(v[4], dctSqrt2), 1 << (s4 - 1), s4);
+  v2 = v[2];
+  v3 = v[6];
+  v4 = descaleNEON(vmulq_n_s32(vsubq_s32(v[1], v[7]), dctSqrt1d2),
+		   1 << (s4 - 1), s4);
+  v7 = descaleNEON(vmulq_n_s32(vaddq_s32(v[1], v[7]), dctSqrt1d2),
+		   1 << (s4 - 1), s4);
+  v5 = vshlq_s32(v[3], vdupq_n_s32(s35));
+  v6 = vshlq_s32(v[5], vdupq_n_s32(s35));
+
+  // stage 3
+  t = halfNEON(vsubq_s32(v0, v1));
+  v0 = halfNEON(vaddq_s32(v0, v1));
+  v1 = t;
+  t = descaleNEON(vmlaq_n_s32(vmulq_n_s32(v2, dctSin6), v3, dctCos6),
+		  1 << (s4 - 1), s4);
+  v2 = descaleNEON(vmlsq_n_s32(vmulq_n_s32(v2, dctCos6), v3, dctSin6),
+		   1 << (s4 - 1), s4);
+  v3 = t;
+  t = halfNEON(vsubq_s32(v4, v6));
+  v4 = halfNEON(vaddq_s32(v4, v6));
+  v6 = t;
+  t = halfNEON(vaddq_s32(v7, v5));
+  v5 = halfNEON(vsubq_s32(v7, v5));
+  v7 = t;
+
+  // stage 2
+  t = halfNEON(vsubq_s32(v0, v3));
+  v0 = halfNEON(vaddq_s32(v0, v3));
+  v3 = t;
+  t = halfNEON(vsubq_s32(v1, v2));
+  v1 = halfNEON(vaddq_s32(v1, v2));
+  v2 = t;
+  t = descaleNEON(vmlaq_n_s32(vmulq_n_s32(v4, dctSin3), v7, dctCos3),
+		  2048, 12);
+  v4 = descaleNEON(vmlsq_n_s32(vmulq_n_s32(v4, dctCos3), v7, dctSin3),
+		   2048, 12);
+  v7 = t;
+  t = descaleNEON(vmlaq_n_s32(vmulq_n_s32(v5, dctSin1), v6, dctCos1),
+		  2048, 12);
+  v5 = descaleNEON(vmlsq_n_s32(vmulq_n_s32(v5, dctCos1), v6, dctSin1),
+		   2048, 12);
+  v6 = t;
+
+  // stage 1, or the DC value
+  v[0] = vbslq_s32(ac, dc, vaddq_s32(v0, v7));
+  v[7] = vbslq_s32(ac, dc, vsubq_s32(v0, v7));
+  v[1] = vbslq_s32(ac, dc, vaddq_s32(v1, v6));
+  v[6] = vbslq_s32(ac, dc, vsubq_s32(v1, v6));
+  v[2] = vbslq_s32(ac, dc, vaddq_s32(v2, v5));
+  v[5] = vbslq_s32(ac, dc, vsubq_s32(v2, v5));
+  v[3] = vbslq_s32(ac, dc, vaddq_s32(v3, v4));
+  v[4] = vbslq_s32(ac, dc, vsubq_s32(v3, v4));
+}
+
+// Same as transformDataUnitSSE2.
+static void transformDataUnitNEON(Gushort *quantTable, int dataIn[64],
+				  Guchar dataOut[64]) {
+  int32x4_t rows[8][2], v[8], ac[2], k128;
+  uint16x8_t q;
+  int16x8_t r;
+  int g, h, i, t;
+
+  // dequant: rows[i][h] = row i, columns 4h .. 4h+3
+  ac[0] = ac[1] = vdupq_n_s32(0);
+  for (i = 0; i < 8; ++i) {
+    q = vld1q_u16(quantTable + 8 * i);
+    rows[i][0] = vmulq_s32(vld1q_s32(dataIn + 8 * i),
+			   vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(q))));
+    rows[i][1] = vmulq_s32(vld1q_s32(dataIn + 8 * i + 4),
+			   vreinterpretq_s32_u32(vmovl_u16(vget_high_u16(q))));
+    ac[i >> 2] = vorrq_s32(ac[i >> 2], vorrq_s32(rows[i][0], rows[i][1]));
+  }
+
+  // a block with only a DC coefficient takes the C version's all-zero
+  // AC shortcuts in both passes
+  t = vgetq_lane_s32(rows[0][0], 0);
+  if (isZeroNEON(vorrq_s32(
+	  vorrq_s32(ac[1], vsetq_lane_s32(0, rows[0][0], 0)),
+	  vorrq_s32(vorrq_s32(rows[0][1], vorrq_s32(rows[1][0], rows[1][1])),
+		    vorrq_s32(vorrq_s32(rows[2][0], rows[2][1]),
+			      vorrq_s32(rows[3][0], rows[3][1])))))) {
+    t = (dctSqrt2 * t + 512) >> 10;
+    t = (dctSqrt2 * t + 8192) >> 14;
+    memset(dataOut, clip8(128 + ((t + 8) >> 4)), 64);
+    return;
+  }
+
+  // inverse DCT on rows, four at a time -- if the last four rows are
+  // all zero, they stay that way
+  for (g = 0; g < 8; g += 4) {
+    if (g == 4 && isZeroNEON(ac[1])) {
+      break;
+    }
+    for (h = 0; h < 2; ++h) {
+      for (i = 0; i < 4; ++i) {
+	v[4 * h + i] = rows[g + i][h];
+      }
+      transpose4NEON(&v[4 * h], &v[4 * h + 1], &v[4 * h + 2], &v[4 * h + 3]);
+    }
+    idct1DNEON(v, 8, 4, 10);
+    for (h = 0; h < 2; ++h) {
+      transpose4NEON(&v[4 * h], &v[4 * h + 1], &v[4 * h + 2], &v[4 * h + 3]);
+      for (i = 0; i < 4; ++i) {
+	rows[g + i][h] = v[4 * h + i];
+      }
+    }
+  }
+
+  // inverse DCT on columns, four at a time
+  for (h = 0; h < 2; ++h) {
+    for (i = 0; i < 8; ++i) {
+      v[i] = rows[i][h];
+    }
+    idct1DNEON(v, 12, 0, 14);
+    for (i = 0; i < 8; ++i) {
+      rows[i][h] = v[i];
+    }
+  }
+
+  // convert to 8-bit integers (the saturating narrows do the clipping)
+  k128 = vdupq_n_s32(128);
+  for (i = 0; i < 8; ++i) {
+    r = vcombine_s16(
+	  vqmovn_s32(vaddq_s32(descaleNEON(rows[i][0], 8, 4), k128)),
+	  vqmovn_s32(vaddq_s32(descaleNEON(rows[i][1], 8, 4), k128)));
+    vst1_u8(dataOut + 8 * i, vqmovun_s16(r));
+  }
+}
+
+// R, G, or B for four pixels: ((Y << 16) + k1 * c1 + k2 * c2 + 32768)
+// >> 16, exactly as in the C version, clipped to 16 bits.
+static DCT_INLINE int16x4_t convert4NEON(int32x4_t y, int32x4_t c1, int k1,
+					 int32x4_t c2, int k2) {
+  return vqmovn_s32(vshrq_n_s32(
+	   vmlaq_n_s32(vmlaq_n_s32(vaddq_s32(vshlq_n_s32(y, 16),
+					     vdupq_n_s32(32768)),
+				   c1, k1),
+		       c2, k2),
+	   16));
+}
+
+static void convertYCbCrNEON(Guchar *p0, Guchar *p1, Guchar *p2, int n,
+			     GBool invert) {
+  uint16x8_t y16, cb16, cr16;
+  int32x4_t y[2], cb[2], cr[2], k128;
+  int16x4_t c[2];
+  uint8x8_t inv;
+  int i, h;
+
+  k128 = vdupq_n_s32(128);
+  inv = vdup_n_u8(invert ? 0xff : 0);
+  for (i = 0; i + 8 <= n; i += 8) {
+    y16 = vmovl_u8(vld1_u8(p0 + i));
+    cb16 = vmovl_u8(vld1_u8(p1 + i));
+    cr16 = vmovl_u8(vld1_u8(p2 + i));
+    y[0] = vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(y16)));
+    y[1] = vreinterpretq_s32_u32(vmovl_u16(vget_high_u16(y16)));
+    cb[0] = vsubq_s32(vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(cb16))),
+		      k128);
+    cb[1] = vsubq_s32(vreinterpretq_s32_u32(vmovl_u16(vget_high_u16(cb16))),
+		      k128);
+    cr[0] = vsubq_s32(vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(cr16))),
+		      k128);
+    cr[1] = vsubq_s32(vreinterpretq_s32_u32(vmovl_u16(vget_high_u16(cr16))),
+		      k128);
+    for (h = 0; h < 2; ++h) {
+      c[h] = convert4NEON(y[h], cr[h], dctCrToR, cb[h], 0);
+    }
+    vst1_u8(p0 + i, veor_u8(vqmovun_s16(vcombine_s16(c[0], c[1])), inv));
+    for (h = 0; h < 2; ++h) {
+      c[h] = convert4NEON(y[h], cb[h], dctCbToG, cr[h], dctCrToG);
+    }
+    vst1_u8(p1 + i, veor_u8(vqmovun_s16(vcombine_s16(c[0], c[1])), inv));
+    for (h = 0; h < 2; ++h) {
+      c[h] = convert4NEON(y[h], cb[h], dctCbToB, cr[h], 0);
+    }
+    vst1_u8(p2 + i, veor_u8(vqmovun_s16(vcombine_s16(c[0], c[1])), inv));
+  }
+  convertYCbCrC(p0 + i, p1 + i, p2 + i, n - i, invert);
+}
+
+static void upsampleH2V2NEON(Guchar dataIn[64], Guchar **rows, int x) {
+  uint8x8x2_t z;
+  uint8x16_t v;
+  int i;
+
+  for (i = 0; i < 8; ++i) {
+    z = vzip_u8(vld1_u8(dataIn + 8 * i), vld1_u8(dataIn + 8 * i));
+    v = vcombine_u8(z.val[0], z.val[1]);
+    vst1q_u8(rows[2 * i] + x, v);
+    vst1q_u8(rows[2 * i + 1] + x, v);
+  }
+}
+
+#endif // DCT_NEON
+
+//------------------------------------------------------------------------
+// dispatch
+//------------------------------------------------------------------------
+
+static void initKernels() {
+  dctSetKernelsImpl(dctKernelsFast);
+#if DCT_SSE2
+  dctSetKernelsImpl(dctKernelsSSE2);
+#endif
+#if DCT_NEON
+  dctSetKernelsImpl(dctKernelsNEON);
+#endif
+}
+
+GBool dctSetKernelsImpl(DCTKernelsImpl impl) {
+  switch (impl) {
+  case dctKernelsC:
+    transformDataUnitFunc = &transformDataUnitC;
+    convertYCbCrFunc = &convertYCbCrC;
+    upsampleH2V2Func = &upsampleH2V2C;
+    break;
+  case dctKernelsFast:
+    transformDataUnitFunc = &transformDataUnitFast;
+    convertYCbCrFunc = &convertYCbCrC;
+    upsampleH2V2Func = &upsampleH2V2Fast;
+    break;
+  case dctKernelsSSE2:
+#if DCT_SSE2
+    __builtin_cpu_init();
+    if (!__builtin_cpu_supports("sse2")) {
+      return gFalse;
+    }
+    transformDataUnitFunc = &transformDataUnitSSE2;
+    convertYCbCrFunc = &convertYCbCrSSE2;
+    upsampleH2V2Func = &upsampleH2V2SSE2;
+    break;
+#else
+    return gFalse;
+#endif
+  case dctKernelsNEON:
+#if DCT_NEON
+    transformDataUnitFunc = &transformDataUnitNEON;
+    convertYCbCrFunc = &convertYCbCrNEON;
+    upsampleH2V2Func = &upsampleH2V2NEON;
+    break;
+#else
+    return gFalse;
+#endif
+  }
+  kernelsImpl = impl;
+  kernelsInited = gTrue;
+  return gTrue;
+}
+
+DCTKernelsImpl dctGetKernelsImpl() {
+  if (!kernelsInited) {
+    initKernels();
+  }
+  return kernelsImpl;
+}
+
+void dctTransformDataUnit(Gushort *quantTable, int dataIn[64],
+			  Guchar dataOut[64]) {
+  if (!kernelsInited) {
+    initKernels();
+  }
+  (*transformDataUnitFunc)(quantTable, dataIn, dataOut);
+}
+
+void dctConvertYCbCr(Guchar *p0, Guchar *p1, Guchar *p2, int n,
+		     GBool invert) {
+  if (!kernelsInited) {
+    initKernels();
+  }
+  (*convertYCbCrFunc)(p0, p1, p2, n, invert);
+}
+
+void dctUpsampleH2V2(Guchar dataIn[64], Guchar **rows, int x) {
+  if (!kernelsInited) {
+    initKernels();
+  }
+  (*upsampleH2V2Func)(dataIn, rows, x);
+}
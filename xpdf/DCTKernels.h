@@ -0,0 +1,52 @@
+//========================================================================
+//
+// DCTKernels.h
+//
+// Inner loops of the DCT (JPEG) decoder.  As with the Splash kernels,
+// each one has a reference C version (the code DCTStream used to
+// have) and, where the CPU supports it, an SSE2 or NEON version,
+// chosen the first time a kernel is called.  The IDCT and the
+// upsampler also have faster portable versions, used when neither is
+// available.  All of them produce identical results.
+//
+//========================================================================
+
+#ifndef DCTKERNELS_H
+#define DCTKERNELS_H
+
+#include <aconf.h>
+
+#include "gtypes.h"
+
+// Dequantize and inverse-transform one 8x8 data unit (in natural,
+// not zig-zag, order), and convert it to 8-bit samples.  <dataIn>
+// may be overwritten.
+extern void dctTransformDataUnit(Gushort *quantTable, int dataIn[64],
+				 Guchar dataOut[64]);
+
+// Convert <n> YCbCr pixels, stored in three planes, to RGB in place.
+// If <invert> is set, the results are inverted (for YCbCrK -> CMYK;
+// the K plane is left alone).
+extern void dctConvertYCbCr(Guchar *p0, Guchar *p1, Guchar *p2, int n,
+			    GBool invert);
+
+// Store an 8x8 data unit of a component subsampled by 2 in both
+// directions, replicating each sample into a 2x2 block: the 16x16
+// result goes to rows[0..15][x..x+15].
+extern void dctUpsampleH2V2(Guchar dataIn[64], Guchar **rows, int x);
+
+enum DCTKernelsImpl {
+  dctKernelsC,			// reference versions
+  dctKernelsFast,		// skip zero coefficients, use words (portable)
+  dctKernelsSSE2,		// x86 SSE2
+  dctKernelsNEON		// ARM NEON
+};
+
+// Use the <impl> versions of the kernels.  Returns false (and changes
+// nothing) if they aren't available in this build or on this CPU.
+extern GBool dctSetKernelsImpl(DCTKernelsImpl impl);
+
+// Returns the versions in use.
+extern DCTKernelsImpl dctGetKernelsImpl();
+
+#endif
@@ -0,0 +1,182 @@
+//========================================================================
+//
+// DCTKernelsTest.cc
+//
+// Checks that each version of the DCT decoder kernels gives exactly
+// the same results as the reference C versions, over random data
+// units (with the patterns of zero coefficients that the fast paths
+// look for), every Y/Cb/Cr triple, and random upsampled blocks.  Run
+// by 'make check'; exits with status 1 on the first mismatch.
+//
+//========================================================================
+
+#include <aconf.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gtypes.h"
+#include "DCTKernels.h"
+
+// bytes before and after each output row, which must not be touched
+#define testGuard 16
+
+#define testRowSize (16 + 2 * testGuard + 8)
+
+static unsigned long testRandState = 1;
+
+static int testRand() {
+  testRandState = testRandState * 1103515245 + 12345;
+  return (int)((testRandState >> 16) & 0x7fff);
+}
+
+// Make a random data unit and quantization table.  Most coefficients
+// are zero, as in real images; some cases have only a DC coefficient,
+// nonzero values in only the first row or the first four columns, or
+// large quantizers.
+static void makeDataUnit(Gushort *quantTable, int *data) {
+  int kind, density, i;
+
+  kind = testRand() % 6;
+  density = (kind == 0) ? 2 : (kind == 1) ? 12 : 48;
+  for (i = 0; i < 64; ++i) {
+    if (kind == 5) {
+      quantTable[i] = (Gushort)(1 + testRand() * 2 % 65535);
+    } else {
+      quantTable[i] = (Gushort)(1 + testRand() % 255);
+    }
+    data[i] = 0;
+    if (i == 0 || testRand() % 64 < density) {
+      data[i] = testRand() % 2047 - 1023;
+      if (kind == 5) {
+	data[i] = testRand() % 65 - 32;
+      } else if (kind == 1 && testRand() % 3) {
+	data[i] /= 32;
+      }
+    }
+  }
+  switch (kind) {
+  case 2:			// DC only
+    memset(data + 1, 0, 63 * sizeof(int));
+    break;
+  case 3:			// first row only
+    memset(data + 8, 0, 56 * sizeof(int));
+    break;
+  case 4:			// first four columns of each row only
+    for (i = 0; i < 64; i += 8) {
+      memset(data + i + 4, 0, 4 * sizeof(int));
+    }
+    if (testRand() & 1) {
+      memset(data + 32, 0, 32 * sizeof(int));
+    }
+    break;
+  }
+}
+
+static GBool testTransform(DCTKernelsImpl impl) {
+  Gushort quantTable[64];
+  int data[64], data0[64], data1[64];
+  Guchar out0[64], out1[64];
+  int rep, i;
+
+  for (rep = 0; rep < 200000; ++rep) {
+    makeDataUnit(quantTable, data);
+    memcpy(data0, data, sizeof(data));
+    memcpy(data1, data, sizeof(data));
+    dctSetKernelsImpl(impl);
+    dctTransformDataUnit(quantTable, data0, out0);
+    dctSetKernelsImpl(dctKernelsC);
+    dctTransformDataUnit(quantTable, data1, out1);
+    if (memcmp(out0, out1, 64)) {
+      for (i = 0; i < 64 && out0[i] == out1[i]; ++i) ;
+      printf("FAIL transformDataUnit: case %d: sample %d is %d, not %d\n",
+	     rep, i, out0[i], out1[i]);
+      return gFalse;
+    }
+  }
+  return gTrue;
+}
+
+// All 65536 Cb/Cr pairs, for a few Y values, starting at a random
+// offset (to test the tails of the SIMD loops).
+static GBool testConvert(DCTKernelsImpl impl) {
+  static Guchar y0[65536 + 8], cb0[65536 + 8], cr0[65536 + 8];
+  static Guchar y1[65536 + 8], cb1[65536 + 8], cr1[65536 + 8];
+  GBool invert;
+  int y, off, n, i;
+
+  for (y = 0; y < 256; y += 15) {
+    invert = (y / 15) & 1;
+    off = testRand() % 8;
+    n = 65536 - testRand() % 8;
+    for (i = 0; i < 65536; ++i) {
+      y0[off + i] = y1[off + i] = (Guchar)y;
+      cb0[off + i] = cb1[off + i] = (Guchar)(i >> 8);
+      cr0[off + i] = cr1[off + i] = (Guchar)i;
+    }
+    dctSetKernelsImpl(impl);
+    dctConvertYCbCr(y0 + off, cb0 + off, cr0 + off, n, invert);
+    dctSetKernelsImpl(dctKernelsC);
+    dctConvertYCbCr(y1 + off, cb1 + off, cr1 + off, n, invert);
+    if (memcmp(y0, y1, sizeof(y0)) || memcmp(cb0, cb1, sizeof(cb0)) ||
+	memcmp(cr0, cr1, sizeof(cr0))) {
+      for (i = 0; i < 65536 + 8 && y0[i] == y1[i] &&
+	     cb0[i] == cb1[i] && cr0[i] == cr1[i]; ++i) ;
+      printf("FAIL convertYCbCr: Y=%d Cb=%d Cr=%d invert=%d\n",
+	     y, (i - off) >> 8, (i - off) & 0xff, invert);
+      return gFalse;
+    }
+  }
+  return gTrue;
+}
+
+static GBool testUpsample(DCTKernelsImpl impl) {
+  Guchar buf0[16][testRowSize], buf1[16][testRowSize];
+  Guchar *rows0[16], *rows1[16];
+  Guchar data[64];
+  int rep, x, i, j;
+
+  for (rep = 0; rep < 10000; ++rep) {
+    for (i = 0; i < 64; ++i) {
+      data[i] = (Guchar)testRand();
+    }
+    for (i = 0; i < 16; ++i) {
+      for (j = 0; j < testRowSize; ++j) {
+	buf0[i][j] = buf1[i][j] = (Guchar)testRand();
+      }
+      rows0[i] = buf0[i];
+      rows1[i] = buf1[i];
+    }
+    x = testGuard + testRand() % 8;
+    dctSetKernelsImpl(impl);
+    dctUpsampleH2V2(data, rows0, x);
+    dctSetKernelsImpl(dctKernelsC);
+    dctUpsampleH2V2(data, rows1, x);
+    if (memcmp(buf0, buf1, sizeof(buf0))) {
+      printf("FAIL upsampleH2V2: x=%d\n", x);
+      return gFalse;
+    }
+  }
+  return gTrue;
+}
+
+int main() {
+  static DCTKernelsImpl impls[3] = {
+    dctKernelsFast, dctKernelsSSE2, dctKernelsNEON
+  };
+  static const char *implNames[3] = { "fast", "SSE2", "NEON" };
+  int i;
+
+  for (i = 0; i < 3; ++i) {
+    if (!dctSetKernelsImpl(impls[i])) {
+      printf("%-5s not available\n", implNames[i]);
+      continue;
+    }
+    if (!testTransform(impls[i]) ||
+	!testConvert(impls[i]) ||
+	!testUpsample(impls[i])) {
+      return 1;
+    }
+    printf("%-5s ok\n", implNames[i]);
+  }
+  return 0;
+}
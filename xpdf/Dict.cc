@@ -25,6 +25,14 @@
 
 OBJECT_POOL_ALLOCATION_SUPPORT_COMPACT(Dict);
 
+// initial size of the entries array; most dictionaries are small, so
+// arrays of this size are allocated from a pool
+#define dictInitSize 8
+
+static ObjectPool::Pool<ObjectPool::LockPolicy>
+  dictEntriesPool(dictInitSize * sizeof(DictEntry), OP_DEF_CHUNK_SIZE,
+		  "DictEntry arrays");
+
 Dict::Dict(XRef *xrefA) {
   xref = xrefA;
   entries = NULL;
@@ -39,17 +47,31 @@ Dict::~Dict() {
     gfree(entries[i].key);
     entries[i].val.free();
   }
-  gfree(entries);
+  if (size == dictInitSize) {
+    dictEntriesPool.release(entries, dictInitSize * sizeof(DictEntry));
+  } else {
+    gfree(entries);
+  }
 }
 
 void Dict::add(char *key, Object *val) {
+  DictEntry *entries1;
+
   if (length == size) {
     if (length == 0) {
-      size = 8;
+      size = dictInitSize;
+      entries = (DictEntry *)
+	  dictEntriesPool.allocate(dictInitSize * sizeof(DictEntry));
+    } else if (size == dictInitSize) {
+      size *= 2;
+      entries1 = (DictEntry *)gmallocn(size, sizeof(DictEntry));
+      memcpy(entries1, entries, length * sizeof(DictEntry));
+      dictEntriesPool.release(entries, dictInitSize * sizeof(DictEntry));
+      entries = entries1;
     } else {
       size *= 2;
+      entries = (DictEntry *)greallocn(entries, size, sizeof(DictEntry));
     }
-    entries = (DictEntry *)greallocn(entries, size, sizeof(DictEntry));
   }
   entries[length].key = key;
   entries[length].val = *val;
@@ -71,6 +71,7 @@ public:
   // trailer dictionary, which is read before the xref table is
   // parsed.
   void setXRef(XRef *xrefA) { xref = xrefA; }
+  XRef *getXRef() { return xref; }
 
 private:
 
@@ -0,0 +1,159 @@
+//========================================================================
+//
+// FlateBench.cc
+//
+// Inflate timings.  Build and run with:
+//
+//   make -C xpdf flatebench
+//   xpdf/flatebench file.pdf ...
+//
+// Every stream in each file whose only filter is FlateDecode (with
+// or without a predictor) is decoded, once reading a byte at a time
+// with getChar(), and once reading 4 KB at a time with getBlock().
+// Each line gives the best of 5 runs, in MB of decoded data per
+// second, and a checksum of the data, which must be the same for the
+// two reads and can be compared between builds.
+//
+//========================================================================
+
+#include <aconf.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include "gmem.h"
+#include "GString.h"
+#include "GlobalParams.h"
+#include "Object.h"
+#include "Stream.h"
+#include "XRef.h"
+#include "PDFDoc.h"
+
+//------------------------------------------------------------------------
+
+#define benchReps 5
+#define benchBlockSize 4096
+
+static double getTime() {
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+// Returns true if <str>'s only filter is FlateDecode.
+static GBool isFlateOnly(Stream *str) {
+  Object filter, obj;
+  GBool flate;
+
+  str->getDict()->lookup("Filter", &filter);
+  if (filter.isArray() && filter.arrayGetLength() == 1) {
+    filter.arrayGet(0, &obj);
+    flate = obj.isName("FlateDecode");
+    obj.free();
+  } else {
+    flate = filter.isName("FlateDecode");
+  }
+  filter.free();
+  return flate;
+}
+
+// Decode <str> with getChar() or getBlock(), adding the number of
+// bytes to <*n> and updating the checksum <*sum>.
+static void decode(Stream *str, GBool block, int *n, Gulong *sum) {
+  char buf[benchBlockSize];
+  int c, len, i;
+
+  str->reset();
+  if (block) {
+    while ((len = str->getBlock(buf, benchBlockSize)) > 0) {
+      for (i = 0; i < len; ++i) {
+	*sum = *sum * 31 + (Guchar)buf[i];
+      }
+      *n += len;
+    }
+  } else {
+    while ((c = str->getChar()) != EOF) {
+      *sum = *sum * 31 + c;
+      ++*n;
+    }
+  }
+  str->close();
+}
+
+static void benchFile(char *fileName) {
+  static const char *readNames[2] = { "getChar", "getBlock" };
+  PDFDoc *doc;
+  XRef *xref;
+  XRefEntry *entry;
+  Object *objs;
+  Gulong sum;
+  double t, best;
+  int nObjs, n, num, block, rep, i;
+
+  doc = new PDFDoc(new GString(fileName));
+  if (!doc->isOk()) {
+    fprintf(stderr, "Couldn't open '%s'\n", fileName);
+    delete doc;
+    return;
+  }
+  xref = doc->getXRef();
+
+  // fetch the streams once, so that the timings don't include parsing
+  objs = (Object *)gmallocn(xref->getNumObjects(), sizeof(Object));
+  nObjs = 0;
+  for (num = 0; num < xref->getNumObjects(); ++num) {
+    entry = xref->getEntry(num);
+    if (entry->type == xrefEntryFree) {
+      continue;
+    }
+    xref->fetch(num, entry->type == xrefEntryUncompressed ? entry->gen : 0,
+		&objs[nObjs]);
+    if (objs[nObjs].isStream() && isFlateOnly(objs[nObjs].getStream())) {
+      ++nObjs;
+    } else {
+      objs[nObjs].free();
+    }
+  }
+
+  for (block = 0; block < 2; ++block) {
+    best = 0;
+    n = 0;
+    sum = 0;
+    for (rep = 0; rep < benchReps; ++rep) {
+      n = 0;
+      sum = 0;
+      t = getTime();
+      for (i = 0; i < nObjs; ++i) {
+	decode(objs[i].getStream(), block, &n, &sum);
+      }
+      t = getTime() - t;
+      if (rep == 0 || t < best) {
+	best = t;
+      }
+    }
+    printf("flate %-8s %5d streams %8.2f MB %8.1f MB/s  %016lx  %s\n",
+	   readNames[block], nObjs, n / 1e6,
+	   best > 0 ? n / 1e6 / best : 0.0, sum, fileName);
+  }
+
+  for (i = 0; i < nObjs; ++i) {
+    objs[i].free();
+  }
+  gfree(objs);
+  delete doc;
+}
+
+int main(int argc, char *argv[]) {
+  int i;
+
+  if (argc < 2) {
+    fprintf(stderr, "Usage: flatebench file.pdf ...\n");
+    return 1;
+  }
+  globalParams = new GlobalParams(NULL);
+  for (i = 1; i < argc; ++i) {
+    benchFile(argv[i]);
+  }
+  delete globalParams;
+  return 0;
+}
@@ -28,9 +28,12 @@
 //------------------------------------------------------------------------
 
 Function::Function() {
+  lut = NULL;
+  lutCalls = 0;
 }
 
 Function::~Function() {
+  gfree(lut);
 }
 
 Function *Function::parse(Object *funcObj) {
@@ -150,6 +153,89 @@ GBool Function::init(Dict *dict) {
   return gFalse;
 }
 
+GBool Function::lookup(double *in, double *out) {
+  double x, f;
+  double *p;
+  int i, j;
+
+  if (!lut) {
+    if (lutCalls < 0 || ++lutCalls < funcLUTMinCalls) {
+      return gFalse;
+    }
+    lutCalls = -1;
+    if (!buildLookup()) {
+      return gFalse;
+    }
+  }
+  x = (in[0] - domain[0][0]) * lutMul;
+  if (x <= 0) {
+    i = 0;
+    f = 0;
+  } else if (x >= funcLUTSize - 1) {
+    i = funcLUTSize - 2;
+    f = 1;
+  } else {
+    i = (int)x;
+    f = x - i;
+  }
+  p = &lut[i * n];
+  for (j = 0; j < n; ++j) {
+    out[j] = p[j] + f * (p[n + j] - p[j]);
+  }
+  return gTrue;
+}
+
+// Sample the function at funcLUTSize evenly spaced points across its
+// domain, and check the interpolated values halfway between samples
+// (where the interpolation error of a smooth function peaks) against
+// the function.  Functions with jumps or sharp features fail this
+// check and are always evaluated directly.
+GBool Function::buildLookup() {
+  double *tab;
+  double out[funcMaxOutputs];
+  double x, step, err;
+  int i, j;
+
+  if (m != 1 || n < 1 || n > funcMaxOutputs ||
+      !(domain[0][1] > domain[0][0])) {
+    return gFalse;
+  }
+  step = (domain[0][1] - domain[0][0]) / (funcLUTSize - 1);
+  tab = (double *)gmallocn(funcLUTSize * n, sizeof(double));
+  for (i = 0; i < funcLUTSize; ++i) {
+    x = (i == funcLUTSize - 1) ? domain[0][1] : domain[0][0] + i * step;
+    transform(&x, &tab[i * n]);
+  }
+  for (i = 0; i < funcLUTSize - 1; ++i) {
+    x = domain[0][0] + (i + 0.5) * step;
+    transform(&x, out);
+    for (j = 0; j < n; ++j) {
+      err = fabs(0.5 * (tab[i * n + j] + tab[(i + 1) * n + j]) - out[j]);
+      if (err > funcLUTMaxError *
+	          (hasRange ? range[j][1] - range[j][0] : 1)) {
+	gfree(tab);
+	return gFalse;
+      }
+    }
+  }
+  lut = tab;
+  lutMul = (funcLUTSize - 1) / (domain[0][1] - domain[0][0]);
+  return gTrue;
+}
+
+// Used by subclass copy constructors after copying the object, to
+// duplicate (rather than share) the lookup table.
+void Function::copyLookup(Function *func) {
+  if (func->lut) {
+    lut = (double *)gmallocn(funcLUTSize * n, sizeof(double));
+    memcpy(lut, func->lut, funcLUTSize * n * sizeof(double));
+  } else {
+    lut = NULL;
+  }
+  lutMul = func->lutMul;
+  lutCalls = func->lutCalls;
+}
+
 //------------------------------------------------------------------------
 // IdentityFunction
 //------------------------------------------------------------------------
@@ -351,6 +437,7 @@ SampledFunction::~SampledFunction() {
 
 SampledFunction::SampledFunction(SampledFunction *func) {
   memcpy(this, func, sizeof(SampledFunction));
+  copyLookup(func);
   samples = (double *)gmallocn(nSamples, sizeof(double));
   memcpy(samples, func->samples, nSamples * sizeof(double));
 }
@@ -502,12 +589,16 @@ ExponentialFunction::~ExponentialFunction() {
 
 ExponentialFunction::ExponentialFunction(ExponentialFunction *func) {
   memcpy(this, func, sizeof(ExponentialFunction));
+  copyLookup(func);
 }
 
 void ExponentialFunction::transform(double *in, double *out) {
   double x;
   int i;
 
+  if (lookup(in, out)) {
+    return;
+  }
   if (in[0] < domain[0][0]) {
     x = domain[0][0];
   } else if (in[0] > domain[0][1]) {
@@ -574,6 +665,9 @@ StitchingFunction::StitchingFunction(Object *funcObj, Dict *dict) {
     obj2.free();
   }
   obj1.free();
+  if (!hasRange && k > 0) {
+    n = funcs[0]->getOutputSize();
+  }
 
   //----- Bounds
   if (!dict->lookup("Bounds", &obj1)->isArray() ||
@@ -621,6 +715,12 @@ StitchingFunction::StitchingFunction(Object *funcObj, Dict *dict) {
 StitchingFunction::StitchingFunction(StitchingFunction *func) {
   int i;
 
+  m = func->m;
+  n = func->n;
+  memcpy(domain, func->domain, sizeof(domain));
+  memcpy(range, func->range, sizeof(range));
+  hasRange = func->hasRange;
+  copyLookup(func);
   k = func->k;
   funcs = (Function **)gmallocn(k, sizeof(Function *));
   for (i = 0; i < k; ++i) {
@@ -652,6 +752,9 @@ void StitchingFunction::transform(double *in, double *out) {
   double x;
   int i;
 
+  if (lookup(in, out)) {
+    return;
+  }
   if (in[0] < domain[0][0]) {
     x = domain[0][0];
   } else if (in[0] > domain[0][1]) {
@@ -978,6 +1081,7 @@ PostScriptFunction::PostScriptFunction(Object *funcObj, Dict *dict) {
 
   code = NULL;
   codeSize = 0;
+  cacheLen = cacheNext = 0;
   ok = gFalse;
 
   //----- initialize the generic stuff
@@ -1023,6 +1127,7 @@ PostScriptFunction::PostScriptFunction(Object *funcObj, Dict *dict) {
 
 PostScriptFunction::PostScriptFunction(PostScriptFunction *func) {
   memcpy(this, func, sizeof(PostScriptFunction));
+  copyLookup(func);
   code = (PSObject *)gmallocn(codeSize, sizeof(PSObject));
   memcpy(code, func->code, codeSize * sizeof(PSObject));
   codeString = func->codeString->copy();
@@ -1034,27 +1139,56 @@ PostScriptFunction::~PostScriptFunction() {
 }
 
 void PostScriptFunction::transform(double *in, double *out) {
-  PSStack *stack;
-  int i;
+  PSStack stack;
+  int i, j;
+
+  if (lookup(in, out)) {
+    return;
+  }
+
+  // check the cache of recent inputs
+  for (j = 0; j < cacheLen; ++j) {
+    for (i = 0; i < m; ++i) {
+      if (in[i] != cacheIn[j][i]) {
+	break;
+      }
+    }
+    if (i == m) {
+      for (i = 0; i < n; ++i) {
+	out[i] = cacheOut[j][i];
+      }
+      return;
+    }
+  }
 
-  stack = new PSStack();
   for (i = 0; i < m; ++i) {
     //~ may need to check for integers here
-    stack->pushReal(in[i]);
+    stack.pushReal(in[i]);
   }
-  exec(stack, 0);
+  exec(&stack, 0);
   for (i = n - 1; i >= 0; --i) {
-    out[i] = stack->popNum();
+    out[i] = stack.popNum();
     if (out[i] < range[i][0]) {
       out[i] = range[i][0];
     } else if (out[i] > range[i][1]) {
       out[i] = range[i][1];
     }
   }
-  // if (!stack->empty()) {
+  // if (!stack.empty()) {
   //   error(-1, "Extra values on stack at end of PostScript function");
   // }
-  delete stack;
+
+  // save the result in the cache
+  for (i = 0; i < m; ++i) {
+    cacheIn[cacheNext][i] = in[i];
+  }
+  for (i = 0; i < n; ++i) {
+    cacheOut[cacheNext][i] = out[i];
+  }
+  if (cacheLen < psFuncCacheSize) {
+    ++cacheLen;
+  }
+  cacheNext = (cacheNext + 1) % psFuncCacheSize;
 }
 
 GBool PostScriptFunction::parseCode(Stream *str, int *codePtr) {
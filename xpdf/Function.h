@@ -30,6 +30,13 @@ class PSStack;
 #define funcMaxInputs   8
 #define funcMaxOutputs 32
 
+// Lookup tables for 1-input functions: number of samples, number of
+// calls before the table is built, and max interpolation error
+// (relative to the output range).
+#define funcLUTSize      256
+#define funcLUTMinCalls   64
+#define funcLUTMaxError  (0.5 / 255)
+
 class Function {
 public:
 
@@ -70,12 +77,28 @@ public:
 
 protected:
 
+  // Once a 1-input function has been called often enough, it is
+  // sampled into a lookup table, and later calls interpolate in the
+  // table -- provided that this reproduces the function to within
+  // funcLUTMaxError.  Subclasses with costly transforms call lookup()
+  // first, and are done if it returns true.
+  GBool lookup(double *in, double *out);
+  void copyLookup(Function *func);
+
   int m, n;			// size of input and output tuples
   double			// min and max values for function domain
     domain[funcMaxInputs][2];
   double			// min and max values for function range
     range[funcMaxOutputs][2];
   GBool hasRange;		// set if range is defined
+
+private:
+
+  GBool buildLookup();
+
+  double *lut;			// sampled function (funcLUTSize x n)
+  double lutMul;		// maps the domain to lut indexes
+  int lutCalls;			// calls so far; -1 if lut won't be built
 };
 
 //------------------------------------------------------------------------
@@ -196,6 +219,9 @@ private:
 // PostScriptFunction
 //------------------------------------------------------------------------
 
+// number of input/output tuples cached by each PostScriptFunction
+#define psFuncCacheSize 4
+
 class PostScriptFunction: public Function {
 public:
 
@@ -220,6 +246,12 @@ private:
   PSObject *code;
   int codeSize;
   GBool ok;
+
+  // recently seen inputs and the corresponding outputs
+  double cacheIn[psFuncCacheSize][funcMaxInputs];
+  double cacheOut[psFuncCacheSize][funcMaxOutputs];
+  int cacheLen;			// number of valid cache entries
+  int cacheNext;		// next entry to replace
 };
 
 #endif
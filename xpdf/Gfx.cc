@@ -2520,6 +2520,11 @@ void Gfx::doGouraudTriangleShFill(GfxGouraudTriangleShading *shading) {
   GfxColor color0, color1, color2;
   int i;
 
+  if (out->useMeshShadedFills()) {
+    out->gouraudTriangleShadedFill(state, shading);
+    return;
+  }
+
   for (i = 0; i < shading->getNTriangles(); ++i) {
     shading->getTriangle(i, &x0, &y0, &color0,
 			 &x1, &y1, &color1,
@@ -2580,6 +2585,11 @@ void Gfx::gouraudFillTriangle(double x0, double y0, GfxColor *color0,
 void Gfx::doPatchMeshShFill(GfxPatchMeshShading *shading) {
   int start, i;
 
+  if (out->useMeshShadedFills()) {
+    out->patchMeshShadedFill(state, shading);
+    return;
+  }
+
   if (shading->getNPatches() > 128) {
     start = 3;
   } else if (shading->getNPatches() > 64) {
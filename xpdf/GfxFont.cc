@@ -336,7 +336,8 @@ CharCodeToUnicode *GfxFont::readToUnicodeCMap(Dict *fontDict, int nBits,
 					      CharCodeToUnicode *ctu) {
   GString *buf;
   Object obj1;
-  int c;
+  char blk[4096];
+  int n;
 
   if (!fontDict->lookup("ToUnicode", &obj1)->isStream()) {
     obj1.free();
@@ -344,8 +345,8 @@ CharCodeToUnicode *GfxFont::readToUnicodeCMap(Dict *fontDict, int nBits,
   }
   buf = new GString();
   obj1.streamReset();
-  while ((c = obj1.streamGetChar()) != EOF) {
-    buf->append(c);
+  while ((n = obj1.streamGetBlock(blk, sizeof(blk))) > 0) {
+    buf->append(blk, n);
   }
   obj1.streamClose();
   obj1.free();
@@ -395,8 +396,7 @@ char *GfxFont::readEmbFontFile(XRef *xref, int *len) {
   char *buf;
   Object obj1, obj2;
   Stream *str;
-  int c;
-  int size, i;
+  int size, i, n;
 
   obj1.initRef(embFontID.num, embFontID.gen);
   obj1.fetch(xref, &obj2);
@@ -412,13 +412,14 @@ char *GfxFont::readEmbFontFile(XRef *xref, int *len) {
   buf = NULL;
   i = size = 0;
   str->reset();
-  while ((c = str->getChar()) != EOF) {
+  do {
     if (i == size) {
       size += 4096;
       buf = (char *)grealloc(buf, size);
     }
-    buf[i++] = c;
-  }
+    n = str->getBlock(buf + i, size - i);
+    i += n;
+  } while (i == size);
   *len = i;
   str->close();
 
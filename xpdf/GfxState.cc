@@ -151,6 +151,38 @@ void GfxColorSpace::getDefaultRanges(double *decodeLow, double *decodeRange,
   }
 }
 
+void GfxColorSpace::getGrayLine(GfxColorComp *in, Guchar *out, int length) {
+  GfxColor color;
+  GfxGray gray;
+  int nComps, i, j;
+
+  nComps = getNComps();
+  for (i = 0; i < length; ++i) {
+    for (j = 0; j < nComps; ++j) {
+      color.c[j] = *in++;
+    }
+    getGray(&color, &gray);
+    *out++ = colToByte(gray);
+  }
+}
+
+void GfxColorSpace::getRGBLine(GfxColorComp *in, Guchar *out, int length) {
+  GfxColor color;
+  GfxRGB rgb;
+  int nComps, i, j;
+
+  nComps = getNComps();
+  for (i = 0; i < length; ++i) {
+    for (j = 0; j < nComps; ++j) {
+      color.c[j] = *in++;
+    }
+    getRGB(&color, &rgb);
+    *out++ = colToByte(rgb.r);
+    *out++ = colToByte(rgb.g);
+    *out++ = colToByte(rgb.b);
+  }
+}
+
 int GfxColorSpace::getNumColorSpaceModes() {
   return nGfxColorSpaceModes;
 }
@@ -186,6 +218,25 @@ void GfxDeviceGrayColorSpace::getCMYK(GfxColor *color, GfxCMYK *cmyk) {
   cmyk->k = clip01(gfxColorComp1 - color->c[0]);
 }
 
+void GfxDeviceGrayColorSpace::getGrayLine(GfxColorComp *in, Guchar *out,
+					  int length) {
+  int i;
+
+  for (i = 0; i < length; ++i) {
+    out[i] = colToByte(clip01(in[i]));
+  }
+}
+
+void GfxDeviceGrayColorSpace::getRGBLine(GfxColorComp *in, Guchar *out,
+					 int length) {
+  int i;
+
+  for (i = 0; i < length; ++i) {
+    out[0] = out[1] = out[2] = colToByte(clip01(in[i]));
+    out += 3;
+  }
+}
+
 //------------------------------------------------------------------------
 // GfxCalGrayColorSpace
 //------------------------------------------------------------------------
@@ -271,6 +322,25 @@ void GfxCalGrayColorSpace::getCMYK(GfxColor *color, GfxCMYK *cmyk) {
   cmyk->k = clip01(gfxColorComp1 - color->c[0]);
 }
 
+void GfxCalGrayColorSpace::getGrayLine(GfxColorComp *in, Guchar *out,
+				       int length) {
+  int i;
+
+  for (i = 0; i < length; ++i) {
+    out[i] = colToByte(clip01(in[i]));
+  }
+}
+
+void GfxCalGrayColorSpace::getRGBLine(GfxColorComp *in, Guchar *out,
+				      int length) {
+  int i;
+
+  for (i = 0; i < length; ++i) {
+    out[0] = out[1] = out[2] = colToByte(clip01(in[i]));
+    out += 3;
+  }
+}
+
 //------------------------------------------------------------------------
 // GfxDeviceRGBColorSpace
 //------------------------------------------------------------------------
@@ -316,6 +386,27 @@ void GfxDeviceRGBColorSpace::getCMYK(GfxColor *color, GfxCMYK *cmyk) {
   cmyk->k = k;
 }
 
+void GfxDeviceRGBColorSpace::getGrayLine(GfxColorComp *in, Guchar *out,
+					 int length) {
+  int i;
+
+  for (i = 0; i < length; ++i) {
+    out[i] = colToByte(clip01((GfxColorComp)(0.3  * in[0] +
+					     0.59 * in[1] +
+					     0.11 * in[2] + 0.5)));
+    in += 3;
+  }
+}
+
+void GfxDeviceRGBColorSpace::getRGBLine(GfxColorComp *in, Guchar *out,
+					int length) {
+  int i;
+
+  for (i = 0; i < 3 * length; ++i) {
+    out[i] = colToByte(clip01(in[i]));
+  }
+}
+
 //------------------------------------------------------------------------
 // GfxCalRGBColorSpace
 //------------------------------------------------------------------------
@@ -447,6 +538,27 @@ void GfxCalRGBColorSpace::getCMYK(GfxColor *color, GfxCMYK *cmyk) {
   cmyk->k = k;
 }
 
+void GfxCalRGBColorSpace::getGrayLine(GfxColorComp *in, Guchar *out,
+				      int length) {
+  int i;
+
+  for (i = 0; i < length; ++i) {
+    out[i] = colToByte(clip01((GfxColorComp)(0.299 * in[0] +
+					     0.587 * in[1] +
+					     0.114 * in[2] + 0.5)));
+    in += 3;
+  }
+}
+
+void GfxCalRGBColorSpace::getRGBLine(GfxColorComp *in, Guchar *out,
+				     int length) {
+  int i;
+
+  for (i = 0; i < 3 * length; ++i) {
+    out[i] = colToByte(clip01(in[i]));
+  }
+}
+
 //------------------------------------------------------------------------
 // GfxDeviceCMYKColorSpace
 //------------------------------------------------------------------------
@@ -537,6 +649,50 @@ void GfxDeviceCMYKColorSpace::getCMYK(GfxColor *color, GfxCMYK *cmyk) {
   cmyk->k = clip01(color->c[3]);
 }
 
+void GfxDeviceCMYKColorSpace::getGrayLine(GfxColorComp *in, Guchar *out,
+					  int length) {
+  int i;
+
+  for (i = 0; i < length; ++i) {
+    out[i] = colToByte(clip01((GfxColorComp)(gfxColorComp1 - in[3]
+					     - 0.3  * in[0]
+					     - 0.59 * in[1]
+					     - 0.11 * in[2] + 0.5)));
+    in += 4;
+  }
+}
+
+void GfxDeviceCMYKColorSpace::getRGBLine(GfxColorComp *in, Guchar *out,
+					 int length) {
+  GfxColor color;
+  GfxRGB rgb;
+  int i;
+
+  for (i = 0; i < length; ++i) {
+    // scanned pages are mostly runs of identical pixels (paper, solid
+    // fills), so reuse the previous result where possible
+    if (i > 0 &&
+	in[0] == in[-4] && in[1] == in[-3] &&
+	in[2] == in[-2] && in[3] == in[-1]) {
+      out[0] = out[-3];
+      out[1] = out[-2];
+      out[2] = out[-1];
+    } else {
+      color.c[0] = in[0];
+      color.c[1] = in[1];
+      color.c[2] = in[2];
+      color.c[3] = in[3];
+      // non-virtual call, so the compiler can inline the conversion
+      GfxDeviceCMYKColorSpace::getRGB(&color, &rgb);
+      out[0] = colToByte(rgb.r);
+      out[1] = colToByte(rgb.g);
+      out[2] = colToByte(rgb.b);
+    }
+    in += 4;
+    out += 3;
+  }
+}
+
 //------------------------------------------------------------------------
 // GfxLabColorSpace
 //------------------------------------------------------------------------
@@ -839,6 +995,16 @@ void GfxICCBasedColorSpace::getCMYK(GfxColor *color, GfxCMYK *cmyk) {
   alt->getCMYK(color, cmyk);
 }
 
+void GfxICCBasedColorSpace::getGrayLine(GfxColorComp *in, Guchar *out,
+					int length) {
+  alt->getGrayLine(in, out, length);
+}
+
+void GfxICCBasedColorSpace::getRGBLine(GfxColorComp *in, Guchar *out,
+				       int length) {
+  alt->getRGBLine(in, out, length);
+}
+
 void GfxICCBasedColorSpace::getDefaultRanges(double *decodeLow,
 					     double *decodeRange,
 					     int maxImgPixel) {
@@ -2532,6 +2698,42 @@ void GfxGouraudTriangleShading::getTriangle(
   }
 }
 
+void GfxGouraudTriangleShading::getTriangle(int i,
+					    double *x0, double *y0, double *t0,
+					    double *x1, double *y1, double *t1,
+					    double *x2, double *y2, double *t2) {
+  int v;
+
+  v = triangles[i][0];
+  *x0 = vertices[v].x;
+  *y0 = vertices[v].y;
+  *t0 = colToDbl(vertices[v].color.c[0]);
+  v = triangles[i][1];
+  *x1 = vertices[v].x;
+  *y1 = vertices[v].y;
+  *t1 = colToDbl(vertices[v].color.c[0]);
+  v = triangles[i][2];
+  *x2 = vertices[v].x;
+  *y2 = vertices[v].y;
+  *t2 = colToDbl(vertices[v].color.c[0]);
+}
+
+void GfxGouraudTriangleShading::getParameterizedColor(double t,
+						      GfxColor *color) {
+  double out[gfxColorMaxComps];
+  int j;
+
+  for (j = 0; j < gfxColorMaxComps; ++j) {
+    out[j] = 0;
+  }
+  for (j = 0; j < nFuncs; ++j) {
+    funcs[j]->transform(&t, &out[j]);
+  }
+  for (j = 0; j < gfxColorMaxComps; ++j) {
+    color->c[j] = dblToCol(out[j]);
+  }
+}
+
 //------------------------------------------------------------------------
 // GfxPatchMeshShading
 //------------------------------------------------------------------------
@@ -3090,6 +3292,21 @@ GfxShading *GfxPatchMeshShading::copy() {
   return new GfxPatchMeshShading(this);
 }
 
+void GfxPatchMeshShading::getParameterizedColor(double t, GfxColor *color) {
+  double out[gfxColorMaxComps];
+  int j;
+
+  for (j = 0; j < gfxColorMaxComps; ++j) {
+    out[j] = 0;
+  }
+  for (j = 0; j < nFuncs; ++j) {
+    funcs[j]->transform(&t, &out[j]);
+  }
+  for (j = 0; j < gfxColorMaxComps; ++j) {
+    color->c[j] = dblToCol(out[j]);
+  }
+}
+
 //------------------------------------------------------------------------
 // GfxImageColorMap
 //------------------------------------------------------------------------
@@ -3107,6 +3324,7 @@ GfxImageColorMap::GfxImageColorMap(int bitsA, Object *decode,
   int i, j, k;
 
   ok = gTrue;
+  initLineLookups();
 
   // bits per component and color space
   bits = bitsA;
@@ -3243,6 +3461,7 @@ GfxImageColorMap::GfxImageColorMap(GfxImageColorMap *colorMap) {
     decodeLow[i] = colorMap->decodeLow[i];
     decodeRange[i] = colorMap->decodeRange[i];
   }
+  initLineLookups();
   ok = gTrue;
 }
 
@@ -3252,7 +3471,26 @@ GfxImageColorMap::~GfxImageColorMap() {
   delete colorSpace;
   for (i = 0; i < gfxColorMaxComps; ++i) {
     gfree(lookup[i]);
+    gfree(compByteLookup[i]);
+  }
+  gfree(grayByteLookup);
+  gfree(rgbByteLookup);
+  gfree(compLine);
+}
+
+// The byte lookup tables used by getGrayLine/getRGBLine are built on
+// first use, so color maps which are never drawn line-at-a-time
+// (PostScript output, text extraction, ...) don't pay for them.
+void GfxImageColorMap::initLineLookups() {
+  int k;
+
+  grayByteLookup = NULL;
+  rgbByteLookup = NULL;
+  for (k = 0; k < gfxColorMaxComps; ++k) {
+    compByteLookup[k] = NULL;
   }
+  compLine = NULL;
+  compLineSize = 0;
 }
 
 void GfxImageColorMap::getGray(Guchar *x, GfxGray *gray) {
@@ -3315,6 +3553,107 @@ void GfxImageColorMap::getColor(Guchar *x, GfxColor *color) {
   }
 }
 
+void GfxImageColorMap::getGrayLine(Guchar *in, Guchar *out, int length) {
+  GfxGray gray;
+  Guchar pix;
+  int n, i;
+
+  if (colorSpace2 || nComps == 1) {
+    if (!grayByteLookup) {
+      n = 1 << bits;
+      grayByteLookup = (Guchar *)gmalloc(n);
+      for (i = 0; i < n; ++i) {
+	pix = (Guchar)i;
+	getGray(&pix, &gray);
+	grayByteLookup[i] = colToByte(gray);
+      }
+    }
+    for (i = 0; i < length; ++i) {
+      out[i] = grayByteLookup[in[i]];
+    }
+  } else {
+    colorSpace->getGrayLine(getCompLine(in, length), out, length);
+  }
+}
+
+void GfxImageColorMap::getRGBLine(Guchar *in, Guchar *out, int length) {
+  GfxColorSpace *cs;
+  GfxRGB rgb;
+  Guchar *p;
+  Guchar pix;
+  int n, i, k;
+
+  // single-component maps (including Indexed and Separation): one
+  // table lookup per pixel
+  if (colorSpace2 || nComps == 1) {
+    if (!rgbByteLookup) {
+      n = 1 << bits;
+      rgbByteLookup = (Guchar *)gmallocn(n, 3);
+      for (i = 0, p = rgbByteLookup; i < n; ++i, p += 3) {
+	pix = (Guchar)i;
+	getRGB(&pix, &rgb);
+	p[0] = colToByte(rgb.r);
+	p[1] = colToByte(rgb.g);
+	p[2] = colToByte(rgb.b);
+      }
+    }
+    for (i = 0; i < length; ++i, out += 3) {
+      p = &rgbByteLookup[3 * in[i]];
+      out[0] = p[0];
+      out[1] = p[1];
+      out[2] = p[2];
+    }
+    return;
+  }
+
+  // RGB color spaces convert each component independently, so the
+  // decode and color conversion steps collapse into one table per
+  // component
+  cs = colorSpace;
+  if (cs->getMode() == csICCBased) {
+    cs = ((GfxICCBasedColorSpace *)cs)->getAlt();
+  }
+  if (cs->getMode() == csDeviceRGB || cs->getMode() == csCalRGB) {
+    if (!compByteLookup[0]) {
+      n = 1 << bits;
+      for (k = 0; k < 3; ++k) {
+	compByteLookup[k] = (Guchar *)gmalloc(n);
+	for (i = 0; i < n; ++i) {
+	  compByteLookup[k][i] = colToByte(clip01(lookup[k][i]));
+	}
+      }
+    }
+    for (i = 0; i < length; ++i, in += 3, out += 3) {
+      out[0] = compByteLookup[0][in[0]];
+      out[1] = compByteLookup[1][in[1]];
+      out[2] = compByteLookup[2][in[2]];
+    }
+    return;
+  }
+
+  // everything else: decode the line, then hand it to the color space
+  colorSpace->getRGBLine(getCompLine(in, length), out, length);
+}
+
+// Decode a line of (multi-component) image pixels.  The returned
+// buffer is owned by the color map and reused on the next call.
+GfxColorComp *GfxImageColorMap::getCompLine(Guchar *in, int length) {
+  GfxColorComp *q;
+  int i, k;
+
+  if (length > compLineSize) {
+    compLineSize = length;
+    compLine = (GfxColorComp *)greallocn(compLine, compLineSize * nComps,
+					 sizeof(GfxColorComp));
+  }
+  for (i = 0, q = compLine; i < length; ++i) {
+    for (k = 0; k < nComps; ++k) {
+      *q++ = lookup[k][*in++];
+    }
+  }
+  return compLine;
+}
+
 //------------------------------------------------------------------------
 // GfxSubpath and GfxPath
 //------------------------------------------------------------------------
@@ -3337,6 +3676,14 @@ GfxSubpath::~GfxSubpath() {
   gfree(curve);
 }
 
+void GfxSubpath::reset(double x1, double y1) {
+  n = 1;
+  x[0] = x1;
+  y[0] = y1;
+  curve[0] = gFalse;
+  closed = gFalse;
+}
+
 // Used for copy().
 GfxSubpath::GfxSubpath(GfxSubpath *subpath) {
   size = subpath->size;
@@ -3401,7 +3748,7 @@ void GfxSubpath::offset(double dx, double dy) {
 GfxPath::GfxPath() {
   justMoved = gFalse;
   size = 16;
-  n = 0;
+  n = nAlloc = 0;
   firstX = firstY = 0;
   subpaths = (GfxSubpath **)gmallocn(size, sizeof(GfxSubpath *));
 }
@@ -3409,7 +3756,7 @@ GfxPath::GfxPath() {
 GfxPath::~GfxPath() {
   int i;
 
-  for (i = 0; i < n; ++i)
+  for (i = 0; i < nAlloc; ++i)
     delete subpaths[i];
   gfree(subpaths);
 }
@@ -3423,28 +3770,45 @@ GfxPath::GfxPath(GBool justMoved1, double firstX1, double firstY1,
   firstX = firstX1;
   firstY = firstY1;
   size = size1;
-  n = n1;
+  n = nAlloc = n1;
   subpaths = (GfxSubpath **)gmallocn(size, sizeof(GfxSubpath *));
   for (i = 0; i < n; ++i)
     subpaths[i] = subpaths1[i]->copy();
 }
 
-void GfxPath::moveTo(double x, double y) {
-  justMoved = gTrue;
-  firstX = x;
-  firstY = y;
+void GfxPath::reset() {
+  justMoved = gFalse;
+  firstX = firstY = 0;
+  n = 0;
 }
 
-void GfxPath::lineTo(double x, double y) {
-  if (justMoved) {
+// Start a new subpath at (firstX, firstY), reusing a subpath left
+// over from before the last reset if there is one.
+void GfxPath::startSubpath() {
+  if (n < nAlloc) {
+    subpaths[n]->reset(firstX, firstY);
+  } else {
     if (n >= size) {
       size += 16;
       subpaths = (GfxSubpath **)
 	           greallocn(subpaths, size, sizeof(GfxSubpath *));
     }
     subpaths[n] = new GfxSubpath(firstX, firstY);
-    ++n;
-    justMoved = gFalse;
+    ++nAlloc;
+  }
+  ++n;
+  justMoved = gFalse;
+}
+
+void GfxPath::moveTo(double x, double y) {
+  justMoved = gTrue;
+  firstX = x;
+  firstY = y;
+}
+
+void GfxPath::lineTo(double x, double y) {
+  if (justMoved) {
+    startSubpath();
   }
   subpaths[n-1]->lineTo(x, y);
 }
@@ -3452,14 +3816,7 @@ void GfxPath::lineTo(double x, double y) {
 void GfxPath::curveTo(double x1, double y1, double x2, double y2,
 	     double x3, double y3) {
   if (justMoved) {
-    if (n >= size) {
-      size += 16;
-      subpaths = (GfxSubpath **)
-	           greallocn(subpaths, size, sizeof(GfxSubpath *));
-    }
-    subpaths[n] = new GfxSubpath(firstX, firstY);
-    ++n;
-    justMoved = gFalse;
+    startSubpath();
   }
   subpaths[n-1]->curveTo(x1, y1, x2, y2, x3, y3);
 }
@@ -3468,14 +3825,7 @@ void GfxPath::close() {
   // this is necessary to handle the pathological case of
   // moveto/closepath/clip, which defines an empty clipping region
   if (justMoved) {
-    if (n >= size) {
-      size += 16;
-      subpaths = (GfxSubpath **)
-	           greallocn(subpaths, size, sizeof(GfxSubpath *));
-    }
-    subpaths[n] = new GfxSubpath(firstX, firstY);
-    ++n;
-    justMoved = gFalse;
+    startSubpath();
   }
   subpaths[n-1]->close();
 }
@@ -3489,8 +3839,14 @@ void GfxPath::append(GfxPath *path) {
                  greallocn(subpaths, size, sizeof(GfxSubpath *));
   }
   for (i = 0; i < path->n; ++i) {
+    if (n < nAlloc) {
+      delete subpaths[n];
+    }
     subpaths[n++] = path->subpaths[i]->copy();
   }
+  if (n > nAlloc) {
+    nAlloc = n;
+  }
   justMoved = gFalse;
 }
 
@@ -3506,6 +3862,8 @@ void GfxPath::offset(double dx, double dy) {
 // GfxState
 //------------------------------------------------------------------------
 
+OBJECT_POOL_ALLOCATION_SUPPORT_DEFAULT(GfxState);
+
 GfxState::GfxState(double hDPI, double vDPI, PDFRectangle *pageBox,
 		   int rotateA, GBool upsideDown) {
   double kx, ky;
@@ -3598,22 +3956,28 @@ GfxState::GfxState(double hDPI, double vDPI, PDFRectangle *pageBox,
   clipYMax = pageHeight;
 
   saved = NULL;
+
+  ownFillColorSpace = ownStrokeColorSpace = gTrue;
+  ownFillPattern = ownStrokePattern = gTrue;
+  ownLineDash = gTrue;
 }
 
 GfxState::~GfxState() {
-  if (fillColorSpace) {
+  if (fillColorSpace && ownFillColorSpace) {
     delete fillColorSpace;
   }
-  if (strokeColorSpace) {
+  if (strokeColorSpace && ownStrokeColorSpace) {
     delete strokeColorSpace;
   }
-  if (fillPattern) {
+  if (fillPattern && ownFillPattern) {
     delete fillPattern;
   }
-  if (strokePattern) {
+  if (strokePattern && ownStrokePattern) {
     delete strokePattern;
   }
-  gfree(lineDash);
+  if (ownLineDash) {
+    gfree(lineDash);
+  }
   if (path) {
     // this gets set to NULL by restore()
     delete path;
@@ -3623,24 +3987,35 @@ GfxState::~GfxState() {
   }
 }
 
-// Used for copy();
-GfxState::GfxState(GfxState *state) {
+// Used for copy() and save().  If <share> is set, the color spaces,
+// patterns and line dash are not copied: <state> is the saved state,
+// which is deleted after this one.
+GfxState::GfxState(GfxState *state, GBool share) {
   memcpy(this, state, sizeof(GfxState));
-  if (fillColorSpace) {
-    fillColorSpace = state->fillColorSpace->copy();
-  }
-  if (strokeColorSpace) {
-    strokeColorSpace = state->strokeColorSpace->copy();
-  }
-  if (fillPattern) {
-    fillPattern = state->fillPattern->copy();
-  }
-  if (strokePattern) {
-    strokePattern = state->strokePattern->copy();
-  }
-  if (lineDashLength > 0) {
-    lineDash = (double *)gmallocn(lineDashLength, sizeof(double));
-    memcpy(lineDash, state->lineDash, lineDashLength * sizeof(double));
+  if (share) {
+    ownFillColorSpace = ownStrokeColorSpace = gFalse;
+    ownFillPattern = ownStrokePattern = gFalse;
+    ownLineDash = gFalse;
+  } else {
+    if (fillColorSpace) {
+      fillColorSpace = state->fillColorSpace->copy();
+    }
+    if (strokeColorSpace) {
+      strokeColorSpace = state->strokeColorSpace->copy();
+    }
+    if (fillPattern) {
+      fillPattern = state->fillPattern->copy();
+    }
+    if (strokePattern) {
+      strokePattern = state->strokePattern->copy();
+    }
+    if (lineDashLength > 0) {
+      lineDash = (double *)gmallocn(lineDashLength, sizeof(double));
+      memcpy(lineDash, state->lineDash, lineDashLength * sizeof(double));
+    }
+    ownFillColorSpace = ownStrokeColorSpace = gTrue;
+    ownFillPattern = ownStrokePattern = gTrue;
+    ownLineDash = gTrue;
   }
   saved = NULL;
 }
@@ -3784,44 +4159,48 @@ void GfxState::concatCTM(double a, double b, double c,
 }
 
 void GfxState::setFillColorSpace(GfxColorSpace *colorSpace) {
-  if (fillColorSpace) {
+  if (fillColorSpace && ownFillColorSpace) {
     delete fillColorSpace;
   }
   fillColorSpace = colorSpace;
+  ownFillColorSpace = gTrue;
 }
 
 void GfxState::setStrokeColorSpace(GfxColorSpace *colorSpace) {
-  if (strokeColorSpace) {
+  if (strokeColorSpace && ownStrokeColorSpace) {
     delete strokeColorSpace;
   }
   strokeColorSpace = colorSpace;
+  ownStrokeColorSpace = gTrue;
 }
 
 void GfxState::setFillPattern(GfxPattern *pattern) {
-  if (fillPattern) {
+  if (fillPattern && ownFillPattern) {
     delete fillPattern;
   }
   fillPattern = pattern;
+  ownFillPattern = gTrue;
 }
 
 void GfxState::setStrokePattern(GfxPattern *pattern) {
-  if (strokePattern) {
+  if (strokePattern && ownStrokePattern) {
     delete strokePattern;
   }
   strokePattern = pattern;
+  ownStrokePattern = gTrue;
 }
 
 void GfxState::setLineDash(double *dash, int length, double start) {
-  if (lineDash)
+  if (lineDash && ownLineDash)
     gfree(lineDash);
   lineDash = dash;
+  ownLineDash = gTrue;
   lineDashLength = length;
   lineDashStart = start;
 }
 
 void GfxState::clearPath() {
-  delete path;
-  path = new GfxPath();
+  path->reset();
 }
 
 void GfxState::clip() {
@@ -3881,7 +4260,7 @@ void GfxState::shift(double dx, double dy) {
 GfxState *GfxState::save() {
   GfxState *newState;
 
-  newState = copy();
+  newState = new GfxState(this, gTrue);
   newState->saved = this;
   return newState;
 }
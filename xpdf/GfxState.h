@@ -18,6 +18,7 @@
 #include "gtypes.h"
 #include "Object.h"
 #include "Function.h"
+#include "allocatable.h"
 
 class Array;
 class GfxFont;
@@ -145,6 +146,13 @@ public:
   virtual void getRGB(GfxColor *color, GfxRGB *rgb) = 0;
   virtual void getCMYK(GfxColor *color, GfxCMYK *cmyk) = 0;
 
+  // Convert a line of <length> pixels to gray (one byte per pixel) or
+  // RGB (three bytes per pixel).  <in> holds getNComps() components
+  // per pixel.  The default versions call getGray/getRGB on each
+  // pixel.
+  virtual void getGrayLine(GfxColorComp *in, Guchar *out, int length);
+  virtual void getRGBLine(GfxColorComp *in, Guchar *out, int length);
+
   // Return the number of color components.
   virtual int getNComps() = 0;
 
@@ -177,6 +185,8 @@ public:
   virtual void getGray(GfxColor *color, GfxGray *gray);
   virtual void getRGB(GfxColor *color, GfxRGB *rgb);
   virtual void getCMYK(GfxColor *color, GfxCMYK *cmyk);
+  virtual void getGrayLine(GfxColorComp *in, Guchar *out, int length);
+  virtual void getRGBLine(GfxColorComp *in, Guchar *out, int length);
 
   virtual int getNComps() { return 1; }
 
@@ -201,6 +211,8 @@ public:
   virtual void getGray(GfxColor *color, GfxGray *gray);
   virtual void getRGB(GfxColor *color, GfxRGB *rgb);
   virtual void getCMYK(GfxColor *color, GfxCMYK *cmyk);
+  virtual void getGrayLine(GfxColorComp *in, Guchar *out, int length);
+  virtual void getRGBLine(GfxColorComp *in, Guchar *out, int length);
 
   virtual int getNComps() { return 1; }
 
@@ -235,6 +247,8 @@ public:
   virtual void getGray(GfxColor *color, GfxGray *gray);
   virtual void getRGB(GfxColor *color, GfxRGB *rgb);
   virtual void getCMYK(GfxColor *color, GfxCMYK *cmyk);
+  virtual void getGrayLine(GfxColorComp *in, Guchar *out, int length);
+  virtual void getRGBLine(GfxColorComp *in, Guchar *out, int length);
 
   virtual int getNComps() { return 3; }
 
@@ -259,6 +273,8 @@ public:
   virtual void getGray(GfxColor *color, GfxGray *gray);
   virtual void getRGB(GfxColor *color, GfxRGB *rgb);
   virtual void getCMYK(GfxColor *color, GfxCMYK *cmyk);
+  virtual void getGrayLine(GfxColorComp *in, Guchar *out, int length);
+  virtual void getRGBLine(GfxColorComp *in, Guchar *out, int length);
 
   virtual int getNComps() { return 3; }
 
@@ -297,6 +313,8 @@ public:
   virtual void getGray(GfxColor *color, GfxGray *gray);
   virtual void getRGB(GfxColor *color, GfxRGB *rgb);
   virtual void getCMYK(GfxColor *color, GfxCMYK *cmyk);
+  virtual void getGrayLine(GfxColorComp *in, Guchar *out, int length);
+  virtual void getRGBLine(GfxColorComp *in, Guchar *out, int length);
 
   virtual int getNComps() { return 4; }
 
@@ -366,6 +384,8 @@ public:
   virtual void getGray(GfxColor *color, GfxGray *gray);
   virtual void getRGB(GfxColor *color, GfxRGB *rgb);
   virtual void getCMYK(GfxColor *color, GfxCMYK *cmyk);
+  virtual void getGrayLine(GfxColorComp *in, Guchar *out, int length);
+  virtual void getRGBLine(GfxColorComp *in, Guchar *out, int length);
 
   virtual int getNComps() { return nComps; }
 
@@ -775,6 +795,16 @@ public:
 		   double *x1, double *y1, GfxColor *color1,
 		   double *x2, double *y2, GfxColor *color2);
 
+  // Parameterized shadings (i.e., those with a Function) store a
+  // single parameter value at each vertex.  This variant of
+  // getTriangle returns the parameter values instead of the colors,
+  // and getParameterizedColor maps a parameter value to a color.
+  GBool isParameterized() { return nFuncs > 0; }
+  void getTriangle(int i, double *x0, double *y0, double *t0,
+		   double *x1, double *y1, double *t1,
+		   double *x2, double *y2, double *t2);
+  void getParameterizedColor(double t, GfxColor *color);
+
 private:
 
   GfxGouraudVertex *vertices;
@@ -810,6 +840,11 @@ public:
   int getNPatches() { return nPatches; }
   GfxPatch *getPatch(int i) { return &patches[i]; }
 
+  // For parameterized shadings, color[][].c[0] in each patch holds a
+  // parameter value, which getParameterizedColor maps to a color.
+  GBool isParameterized() { return nFuncs > 0; }
+  void getParameterizedColor(double t, GfxColor *color);
+
 private:
 
   GfxPatch *patches;
@@ -854,9 +889,17 @@ public:
   void getCMYK(Guchar *x, GfxCMYK *cmyk);
   void getColor(Guchar *x, GfxColor *color);
 
+  // Convert a line of <length> image pixels, as returned by
+  // ImageStream::getLine, to gray (one byte per pixel) or RGB (three
+  // bytes per pixel).
+  void getGrayLine(Guchar *in, Guchar *out, int length);
+  void getRGBLine(Guchar *in, Guchar *out, int length);
+
 private:
 
   GfxImageColorMap(GfxImageColorMap *colorMap);
+  void initLineLookups();
+  GfxColorComp *getCompLine(Guchar *in, int length);
 
   GfxColorSpace *colorSpace;	// the image color space
   int bits;			// bits per component
@@ -869,6 +912,12 @@ private:
     decodeLow[gfxColorMaxComps];
   double			// max - min value for each component
     decodeRange[gfxColorMaxComps];
+  Guchar *grayByteLookup;	// gray/RGB bytes for each pixel value
+  Guchar *rgbByteLookup;	//   (single-component maps only)
+  Guchar *			// RGB byte for each component value
+    compByteLookup[gfxColorMaxComps]; //   (DeviceRGB/CalRGB only)
+  GfxColorComp *compLine;	// decoded components for one line
+  int compLineSize;		// size of compLine, in pixels
   GBool ok;
 };
 
@@ -888,6 +937,10 @@ public:
   // Copy.
   GfxSubpath *copy() { return new GfxSubpath(this); }
 
+  // Restart as a new subpath at (<x1>, <y1>), keeping the allocated
+  // point arrays.
+  void reset(double x1, double y1);
+
   // Get points.
   int getNumPoints() { return n; }
   double getX(int i) { return x[i]; }
@@ -937,6 +990,10 @@ public:
   GfxPath *copy()
     { return new GfxPath(justMoved, firstX, firstY, subpaths, n, size); }
 
+  // Make this an empty path.  The subpaths are kept, and reused by
+  // later path construction operators.
+  void reset();
+
   // Is there a current point?
   GBool isCurPt() { return n > 0 || justMoved; }
 
@@ -976,10 +1033,13 @@ private:
   double firstX, firstY;	// first point in new subpath
   GfxSubpath **subpaths;	// subpaths
   int n;			// number of subpaths
+  int nAlloc;			// number of allocated subpaths (the ones
+				//   past <n> are unused, see reset)
   int size;			// size of subpaths array
 
   GfxPath(GBool justMoved1, double firstX1, double firstY1,
 	  GfxSubpath **subpaths1, int n1, int size1);
+  void startSubpath();
 };
 
 //------------------------------------------------------------------------
@@ -987,6 +1047,9 @@ private:
 //------------------------------------------------------------------------
 
 class GfxState {
+
+  OBJECT_POOL_ALLOCATION();
+
 public:
 
   // Construct a default GfxState, for a device with resolution <hDPI>
@@ -999,7 +1062,7 @@ public:
   ~GfxState();
 
   // Copy.
-  GfxState *copy() { return new GfxState(this); }
+  GfxState *copy() { return new GfxState(this, gFalse); }
 
   // Accessors.
   double *getCTM() { return ctm; }
@@ -1145,7 +1208,9 @@ public:
   void textShift(double tx, double ty);
   void shift(double dx, double dy);
 
-  // Push/pop GfxState on/off stack.
+  // Push/pop GfxState on/off stack.  The pushed state shares the color
+  // spaces, patterns and line dash with the saved one until they are
+  // set.
   GfxState *save();
   GfxState *restore();
   GBool hasSaves() { return saved != NULL; }
@@ -1200,7 +1265,13 @@ private:
 
   GfxState *saved;		// next GfxState on stack
 
-  GfxState(GfxState *state);
+  // set if the color spaces, patterns and line dash belong to this
+  // state; otherwise they are shared with <saved>
+  GBool ownFillColorSpace, ownStrokeColorSpace;
+  GBool ownFillPattern, ownStrokePattern;
+  GBool ownLineDash;
+
+  GfxState(GfxState *state, GBool share);
 };
 
 #endif
@@ -44,6 +44,7 @@
 #endif
 #include "GlobalParams.h"
 #include "GfxFont.h"
+#include "JPXStream.h"
 
 #if MULTITHREADED
 #  define lockGlobalParams            gLockMutex(&mutex)
@@ -424,6 +425,7 @@ GlobalParams::GlobalParams(char *cfgFileName) {
   enableT1lib = gTrue;
   enableFreeType = gTrue;
   antialias = gTrue;
+  jpxThreads = 1;
   urlCommand = NULL;
   movieCommand = NULL;
   mapNumericCharNames = gTrue;
@@ -644,6 +646,8 @@ void GlobalParams::parseFile(GString *fileName, FILE *f) {
 	parseYesNo("enableFreeType", &enableFreeType, tokens, fileName, line);
       } else if (!cmd->cmp("antialias")) {
 	parseYesNo("antialias", &antialias, tokens, fileName, line);
+      } else if (!cmd->cmp("jpxThreads")) {
+	parseInteger("jpxThreads", &jpxThreads, tokens, fileName, line);
       } else if (!cmd->cmp("urlCommand")) {
 	parseCommand("urlCommand", &urlCommand, tokens, fileName, line);
       } else if (!cmd->cmp("movieCommand")) {
@@ -1037,6 +1041,32 @@ GBool GlobalParams::parseYesNo2(char *token, GBool *flag) {
   return gTrue;
 }
 
+void GlobalParams::parseInteger(const char *cmdName, int *val,
+				GList *tokens, GString *fileName, int line) {
+  GString *tok;
+  int i;
+
+  if (tokens->getLength() != 2) {
+    goto err;
+  }
+  tok = (GString *)tokens->get(1);
+  if (tok->getLength() == 0) {
+    goto err;
+  }
+  i = tok->getChar(0) == '-' ? 1 : 0;
+  for (; i < tok->getLength(); ++i) {
+    if (tok->getChar(i) < '0' || tok->getChar(i) > '9') {
+      goto err;
+    }
+  }
+  *val = atoi(tok->getCString());
+  return;
+
+ err:
+  error(-1, "Bad '%s' config file command (%s:%d)",
+	cmdName, fileName->getCString(), line);
+}
+
 GlobalParams::~GlobalParams() {
   GHashIter *iter;
   GString *key;
@@ -1089,6 +1119,8 @@ GlobalParams::~GlobalParams() {
   deleteGList(plugins, Plugin);
 #endif
 
+  JPXStream::shutdownPool();
+
 #if MULTITHREADED
   gDestroyMutex(&mutex);
   gDestroyMutex(&unicodeMapCacheMutex);
@@ -1831,6 +1863,15 @@ GBool GlobalParams::getAntialias() {
   return f;
 }
 
+int GlobalParams::getJPXThreads() {
+  int n;
+
+  lockGlobalParams;
+  n = jpxThreads;
+  unlockGlobalParams;
+  return n;
+}
+
 GBool GlobalParams::getMapNumericCharNames() {
   GBool map;
 
@@ -2154,6 +2195,12 @@ GBool GlobalParams::setAntialias(char *s) {
   return ok;
 }
 
+void GlobalParams::setJPXThreads(int jpxThreadsA) {
+  lockGlobalParams;
+  jpxThreads = jpxThreadsA;
+  unlockGlobalParams;
+}
+
 void GlobalParams::setMapNumericCharNames(GBool map) {
   lockGlobalParams;
   mapNumericCharNames = map;
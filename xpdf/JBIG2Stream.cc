@@ -13,9 +13,11 @@
 #endif
 
 #include <stdlib.h>
+#include <string.h>
 #include "GList.h"
 #include "Error.h"
 #include "JArithmeticDecoder.h"
+#include "XRef.h"
 #include "JBIG2Stream.h"
 
 //~ share these tables
@@ -556,7 +558,9 @@ int JBIG2MMRDecoder::getBlackCode() {
 	code = buf >> (bufLen - 13);
       }
       p = &blackTab1[code & 0x7f];
-    } else if (bufLen >= 4 && ((buf >> (bufLen - 4)) & 0x0f) == 0) {
+    } else if (bufLen >= 6 && ((buf >> (bufLen - 4)) & 0x0f) == 0) {
+      // with fewer than six bits, the code may be below blackTab2's
+      // range -- wait for more
       if (bufLen <= 12) {
 	code = buf << (12 - bufLen);
       } else {
@@ -660,12 +664,14 @@ public:
     { data[y * line + (x >> 3)] |= 1 << (7 - (x & 7)); }
   void clearPixel(int x, int y)
     { data[y * line + (x >> 3)] &= 0x7f7f >> (x & 7); }
+  void setRun(int x0, int x1, int y);
   void getPixelPtr(int x, int y, JBIG2BitmapPtr *ptr);
   int nextPixel(JBIG2BitmapPtr *ptr);
   void duplicateRow(int yDest, int ySrc);
   void combine(JBIG2Bitmap *bitmap, int x, int y, Guint combOp);
   Guchar *getDataPtr() { return data; }
   int getDataSize() { return h * line; }
+  int getLineSize() { return line; }
 
 private:
 
@@ -702,19 +708,36 @@ JBIG2Bitmap::~JBIG2Bitmap() {
   gfree(data);
 }
 
-//~ optimize this
 JBIG2Bitmap *JBIG2Bitmap::getSlice(Guint x, Guint y, Guint wA, Guint hA) {
   JBIG2Bitmap *slice;
-  Guint xx, yy;
+  Guchar *src, *dest;
+  Guint yy, cw, nBytes, s, i;
 
   slice = new JBIG2Bitmap(0, wA, hA);
   slice->clearToZero();
-  for (yy = 0; yy < hA; ++yy) {
-    for (xx = 0; xx < wA; ++xx) {
-      if (getPixel(x + xx, y + yy)) {
-	slice->setPixel(xx, yy);
+  if (x >= (Guint)w || y >= (Guint)h) {
+    return slice;
+  }
+
+  // pixels outside this bitmap are zero
+  cw = (Guint)w - x < wA ? (Guint)w - x : wA;
+  nBytes = (cw + 7) >> 3;
+  s = x & 7;
+  for (yy = 0; yy < hA && y + yy < (Guint)h; ++yy) {
+    src = data + (y + yy) * line + (x >> 3);
+    dest = slice->data + yy * slice->line;
+    if (s == 0) {
+      memcpy(dest, src, nBytes);
+    } else {
+      // src[nBytes] may be past the end of the row, but not past the
+      // guard byte, and its bits are masked off below
+      for (i = 0; i < nBytes; ++i) {
+	dest[i] = (Guchar)((src[i] << s) | (src[i + 1] >> (8 - s)));
       }
     }
+    if (cw & 7) {
+      dest[nBytes - 1] &= (Guchar)(0xff << (8 - (cw & 7)));
+    }
   }
   return slice;
 }
@@ -778,13 +801,99 @@ inline int JBIG2Bitmap::nextPixel(JBIG2BitmapPtr *ptr) {
   return pix;
 }
 
+// Set pixels <x0> .. <x1> - 1 in row <y>.
+void JBIG2Bitmap::setRun(int x0, int x1, int y) {
+  Guchar *p;
+  int i0, i1;
+
+  if (x0 < 0) {
+    x0 = 0;
+  }
+  if (x1 > w) {
+    x1 = w;
+  }
+  if (x0 >= x1) {
+    return;
+  }
+  p = data + y * line;
+  i0 = x0 >> 3;
+  i1 = (x1 - 1) >> 3;
+  if (i0 == i1) {
+    p[i0] |= (Guchar)((0xff >> (x0 & 7)) & (0xff << (7 - ((x1 - 1) & 7))));
+  } else {
+    p[i0] |= (Guchar)(0xff >> (x0 & 7));
+    if (i1 > i0 + 1) {
+      memset(p + i0 + 1, 0xff, i1 - i0 - 1);
+    }
+    p[i1] |= (Guchar)(0xff << (7 - ((x1 - 1) & 7)));
+  }
+}
+
 void JBIG2Bitmap::duplicateRow(int yDest, int ySrc) {
   memcpy(data + yDest * line, data + ySrc * line, line);
 }
 
+// Combine <n> bytes of <src> into <dest>.  The operators work bit by
+// bit, so this is done a word at a time (in either byte order).
+static void combineAligned(Guchar *dest, Guchar *src, int n, Guint combOp) {
+  Guint d, t;
+  int i;
+
+  i = 0;
+  switch (combOp) {
+  case 0: // or
+    for (; i + (int)sizeof(Guint) <= n; i += sizeof(Guint)) {
+      memcpy(&d, dest + i, sizeof(Guint));
+      memcpy(&t, src + i, sizeof(Guint));
+      d |= t;
+      memcpy(dest + i, &d, sizeof(Guint));
+    }
+    for (; i < n; ++i) {
+      dest[i] |= src[i];
+    }
+    break;
+  case 1: // and
+    for (; i + (int)sizeof(Guint) <= n; i += sizeof(Guint)) {
+      memcpy(&d, dest + i, sizeof(Guint));
+      memcpy(&t, src + i, sizeof(Guint));
+      d &= t;
+      memcpy(dest + i, &d, sizeof(Guint));
+    }
+    for (; i < n; ++i) {
+      dest[i] &= src[i];
+    }
+    break;
+  case 2: // xor
+    for (; i + (int)sizeof(Guint) <= n; i += sizeof(Guint)) {
+      memcpy(&d, dest + i, sizeof(Guint));
+      memcpy(&t, src + i, sizeof(Guint));
+      d ^= t;
+      memcpy(dest + i, &d, sizeof(Guint));
+    }
+    for (; i < n; ++i) {
+      dest[i] ^= src[i];
+    }
+    break;
+  case 3: // xnor
+    for (; i + (int)sizeof(Guint) <= n; i += sizeof(Guint)) {
+      memcpy(&d, dest + i, sizeof(Guint));
+      memcpy(&t, src + i, sizeof(Guint));
+      d ^= ~t;
+      memcpy(dest + i, &d, sizeof(Guint));
+    }
+    for (; i < n; ++i) {
+      dest[i] ^= (Guchar)~src[i];
+    }
+    break;
+  case 4: // replace
+    memcpy(dest, src, n);
+    break;
+  }
+}
+
 void JBIG2Bitmap::combine(JBIG2Bitmap *bitmap, int x, int y,
 			  Guint combOp) {
-  int x0, x1, y0, y1, xx, yy;
+  int x0, x1, y0, y1, xx, yy, n, i;
   Guchar *srcPtr, *destPtr;
   Guint src0, src1, src, dest, s1, s2, m1, m2, m3;
   GBool oneByte;
@@ -912,30 +1021,44 @@ void JBIG2Bitmap::combine(JBIG2Bitmap *bitmap, int x, int y,
 	xx = x0;
       }
 
-      // middle bytes
-      for (; xx < x1 - 8; xx += 8) {
-	dest = *destPtr;
-	src0 = src1;
-	src1 = *srcPtr++;
-	src = (((src0 << 8) | src1) >> s1) & 0xff;
-	switch (combOp) {
-	case 0: // or
-	  dest |= src;
-	  break;
-	case 1: // and
-	  dest &= src;
-	  break;
-	case 2: // xor
-	  dest ^= src;
-	  break;
-	case 3: // xnor
-	  dest ^= src ^ 0xff;
-	  break;
-	case 4: // replace
-	  dest = src;
-	  break;
+      // middle bytes -- dest byte i comes from source bytes i-1 and i
+      // (srcPtr[-1] is the byte in src1)
+      if (xx < x1 - 8) {
+	n = (x1 - 1 - xx) >> 3;
+	if (s1 == 0) {
+	  combineAligned(destPtr, srcPtr, n, combOp);
+	} else {
+	  switch (combOp) {
+	  case 0: // or
+	    for (i = 0; i < n; ++i) {
+	      destPtr[i] |= (Guchar)(((srcPtr[i-1] << 8) | srcPtr[i]) >> s1);
+	    }
+	    break;
+	  case 1: // and
+	    for (i = 0; i < n; ++i) {
+	      destPtr[i] &= (Guchar)(((srcPtr[i-1] << 8) | srcPtr[i]) >> s1);
+	    }
+	    break;
+	  case 2: // xor
+	    for (i = 0; i < n; ++i) {
+	      destPtr[i] ^= (Guchar)(((srcPtr[i-1] << 8) | srcPtr[i]) >> s1);
+	    }
+	    break;
+	  case 3: // xnor
+	    for (i = 0; i < n; ++i) {
+	      destPtr[i] ^= (Guchar)~(((srcPtr[i-1] << 8) | srcPtr[i]) >> s1);
+	    }
+	    break;
+	  case 4: // replace
+	    for (i = 0; i < n; ++i) {
+	      destPtr[i] = (Guchar)(((srcPtr[i-1] << 8) | srcPtr[i]) >> s1);
+	    }
+	    break;
+	  }
 	}
-	*destPtr++ = dest;
+	src1 = srcPtr[n - 1];
+	srcPtr += n;
+	destPtr += n;
       }
 
       // right-most byte
@@ -1086,13 +1209,166 @@ JBIG2CodeTable::~JBIG2CodeTable() {
   gfree(table);
 }
 
+//------------------------------------------------------------------------
+// JBIG2Globals
+//------------------------------------------------------------------------
+
+// The segments of a decoded JBIG2Globals stream.  Once decoded, these
+// are never modified, so one copy can be used by any number of
+// JBIG2Streams.
+class JBIG2Globals {
+public:
+
+  JBIG2Globals(Ref refA, GList *segmentsA);
+  ~JBIG2Globals();
+  Ref getRef() { return ref; }
+  GBool match(Ref refA)
+    { return refA.num == ref.num && refA.gen == ref.gen; }
+  GList *getSegments() { return segments; }
+  void incRefCnt();
+  void decRefCnt();
+
+private:
+
+  Ref ref;
+  GList *segments;		// [JBIG2Segment]
+  int refCnt;
+#if MULTITHREADED
+  G_Mutex mutex;
+#endif
+};
+
+JBIG2Globals::JBIG2Globals(Ref refA, GList *segmentsA) {
+  ref = refA;
+  segments = segmentsA;
+  refCnt = 1;
+#if MULTITHREADED
+  gInitMutex(&mutex);
+#endif
+}
+
+JBIG2Globals::~JBIG2Globals() {
+  deleteGList(segments, JBIG2Segment);
+#if MULTITHREADED
+  gDestroyMutex(&mutex);
+#endif
+}
+
+void JBIG2Globals::incRefCnt() {
+#if MULTITHREADED
+  gLockMutex(&mutex);
+#endif
+  ++refCnt;
+#if MULTITHREADED
+  gUnlockMutex(&mutex);
+#endif
+}
+
+void JBIG2Globals::decRefCnt() {
+  GBool done;
+
+#if MULTITHREADED
+  gLockMutex(&mutex);
+#endif
+  done = --refCnt == 0;
+#if MULTITHREADED
+  gUnlockMutex(&mutex);
+#endif
+  if (done) {
+    delete this;
+  }
+}
+
+//------------------------------------------------------------------------
+// JBIG2GlobalsCache
+//------------------------------------------------------------------------
+
+JBIG2GlobalsCache::JBIG2GlobalsCache() {
+  int i;
+
+  for (i = 0; i < jbig2GlobalsCacheSize; ++i) {
+    cache[i] = NULL;
+  }
+#if MULTITHREADED
+  gInitMutex(&mutex);
+#endif
+}
+
+JBIG2GlobalsCache::~JBIG2GlobalsCache() {
+  int i;
+
+  for (i = 0; i < jbig2GlobalsCacheSize; ++i) {
+    if (cache[i]) {
+      cache[i]->decRefCnt();
+    }
+  }
+#if MULTITHREADED
+  gDestroyMutex(&mutex);
+#endif
+}
+
+JBIG2Globals *JBIG2GlobalsCache::getGlobals(Ref ref) {
+  JBIG2Globals *globals;
+  int i, j;
+
+#if MULTITHREADED
+  gLockMutex(&mutex);
+#endif
+  globals = NULL;
+  for (i = 0; i < jbig2GlobalsCacheSize; ++i) {
+    if (cache[i] && cache[i]->match(ref)) {
+      globals = cache[i];
+      for (j = i; j >= 1; --j) {
+	cache[j] = cache[j - 1];
+      }
+      cache[0] = globals;
+      globals->incRefCnt();
+      break;
+    }
+  }
+#if MULTITHREADED
+  gUnlockMutex(&mutex);
+#endif
+  return globals;
+}
+
+void JBIG2GlobalsCache::add(JBIG2Globals *globals) {
+  int i;
+
+#if MULTITHREADED
+  gLockMutex(&mutex);
+#endif
+  for (i = 0; i < jbig2GlobalsCacheSize; ++i) {
+    if (cache[i] && cache[i]->match(globals->getRef())) {
+      break;
+    }
+  }
+  if (i == jbig2GlobalsCacheSize) {
+    if (cache[jbig2GlobalsCacheSize - 1]) {
+      cache[jbig2GlobalsCacheSize - 1]->decRefCnt();
+    }
+    for (i = jbig2GlobalsCacheSize - 1; i >= 1; --i) {
+      cache[i] = cache[i - 1];
+    }
+    cache[0] = globals;
+    globals->incRefCnt();
+  }
+#if MULTITHREADED
+  gUnlockMutex(&mutex);
+#endif
+}
+
 //------------------------------------------------------------------------
 // JBIG2Stream
 //------------------------------------------------------------------------
 
-JBIG2Stream::JBIG2Stream(Stream *strA, Object *globalsStream):
+JBIG2Stream::JBIG2Stream(Stream *strA, Object *globalsStream,
+			 Object *globalsStreamRef, XRef *xref):
   FilterStream(strA)
 {
+  JBIG2GlobalsCache *globalsCache;
+  Ref ref;
+
   pageBitmap = NULL;
 
   arithDecoder = new JArithmeticDecoder();
@@ -1115,15 +1391,33 @@ JBIG2Stream::JBIG2Stream(Stream *strA, Object *globalsStream):
   huffDecoder = new JBIG2HuffmanDecoder();
   mmrDecoder = new JBIG2MMRDecoder();
 
-  segments = globalSegments = new GList();
-  if (globalsStream->isStream()) {
-    curStr = globalsStream->getStream();
-    curStr->reset();
-    arithDecoder->setStream(curStr);
-    huffDecoder->setStream(curStr);
-    mmrDecoder->setStream(curStr);
-    readSegments();
-  }
+  // globals that come from an indirect object are decoded once per
+  // file, and shared
+  globals = NULL;
+  globalsCache = NULL;
+  ref.num = ref.gen = -1;
+  if (globalsStream->isStream() && globalsStreamRef &&
+      globalsStreamRef->isRef() && xref) {
+    globalsCache = xref->getJBIG2GlobalsCache();
+    ref = globalsStreamRef->getRef();
+    globals = globalsCache->getGlobals(ref);
+  }
+  if (!globals) {
+    segments = globalSegments = new GList();
+    if (globalsStream->isStream()) {
+      curStr = globalsStream->getStream();
+      curStr->reset();
+      arithDecoder->setStream(curStr);
+      huffDecoder->setStream(curStr);
+      mmrDecoder->setStream(curStr);
+      readSegments();
+    }
+    globals = new JBIG2Globals(ref, segments);
+    if (globalsCache) {
+      globalsCache->add(globals);
+    }
+  }
+  globalSegments = globals->getSegments();
 
   segments = NULL;
   curStr = NULL;
@@ -1156,9 +1450,7 @@ JBIG2Stream::~JBIG2Stream() {
   if (segments) {
     deleteGList(segments, JBIG2Segment);
   }
-  if (globalSegments) {
-    deleteGList(globalSegments, JBIG2Segment);
-  }
+  globals->decRefCnt();
   delete str;
 }
 
@@ -1201,6 +1493,62 @@ int JBIG2Stream::lookChar() {
   return EOF;
 }
 
+GBool JBIG2Stream::hasRuns(int width) {
+  int line;
+
+  if (!pageBitmap || pageBitmap->getWidth() != width) {
+    return gFalse;
+  }
+  line = (width + 7) >> 3;
+  return (dataPtr - pageBitmap->getDataPtr()) % line == 0;
+}
+
+// The page bitmap has 1 for black, and the stream data is inverted,
+// so the runs of 1 bits are the runs of 0 bits in the bitmap.  Whole
+// bytes of 0x00 and 0xff are skipped without looking at their bits.
+int JBIG2Stream::getRuns(int *runs) {
+  int w, line, n, x, xEnd, x0, i;
+  Guchar *p;
+  Guint c;
+
+  if (!dataPtr || dataPtr >= dataEnd) {
+    return -1;
+  }
+  w = pageBitmap->getWidth();
+  line = (w + 7) >> 3;
+  n = 0;
+  x0 = -1;
+  for (i = 0, p = dataPtr; i < line; ++i, ++p) {
+    c = *p ^ 0xff;
+    if (c == (x0 >= 0 ? 0xff : 0x00)) {
+      continue;
+    }
+    xEnd = (i << 3) + 8;
+    if (xEnd > w) {
+      xEnd = w;
+    }
+    for (x = i << 3; x < xEnd; ++x) {
+      if (c & (0x80 >> (x & 7))) {
+	if (x0 < 0) {
+	  x0 = x;
+	}
+      } else if (x0 >= 0) {
+	runs[2*n] = x0;
+	runs[2*n+1] = x;
+	++n;
+	x0 = -1;
+      }
+    }
+  }
+  if (x0 >= 0) {
+    runs[2*n] = x0;
+    runs[2*n+1] = w;
+    ++n;
+  }
+  dataPtr += line;
+  return n;
+}
+
 GString *JBIG2Stream::getPSFilter(int psLevel, char *indent) {
   return NULL;
 }
@@ -2487,7 +2835,7 @@ JBIG2Bitmap *JBIG2Stream::readGenericBitmap(GBool mmr, int w, int h,
 					    int *atx, int *aty,
 					    int mmrDataLength) {
   JBIG2Bitmap *bitmap;
-  GBool ltp;
+  GBool ltp, fast;
   Guint ltpCX, cx, cx0, cx1, cx2;
   JBIG2BitmapPtr cxPtr0, cxPtr1;
   JBIG2BitmapPtr atPtr0, atPtr1, atPtr2, atPtr3;
@@ -2640,9 +2988,7 @@ JBIG2Bitmap *JBIG2Stream::readGenericBitmap(GBool mmr, int w, int h,
       // convert the run lengths to a bitmap line
       i = 0;
       while (codingLine[i] < w) {
-	for (x = codingLine[i]; x < codingLine[i+1]; ++x) {
-	  bitmap->setPixel(x, y);
-	}
+	bitmap->setRun(codingLine[i], codingLine[i+1], y);
 	i += 2;
       }
     }
@@ -2680,21 +3026,39 @@ JBIG2Bitmap *JBIG2Stream::readGenericBitmap(GBool mmr, int w, int h,
       }
     }
 
+    // if all of the AT pixels are in the two rows above, and no more
+    // than 8 pixels left or right, the context can be built from whole
+    // bytes of those rows
+    fast = !useSkip;
+    for (i = 0; i < (templ == 0 ? 4 : 1); ++i) {
+      if ((aty[i] != -1 && aty[i] != -2) || atx[i] < -8 || atx[i] > 8) {
+	fast = gFalse;
+      }
+    }
+
     ltp = 0;
     cx = cx0 = cx1 = cx2 = 0; // make gcc happy
     for (y = 0; y < h; ++y) {
 
-      // check for a "typical" (duplicate) row
+      // check for a "typical" (duplicate) row -- the row above the
+      // first one is all zero, and the bitmap starts out cleared
       if (tpgdOn) {
 	if (arithDecoder->decodeBit(ltpCX, genericRegionStats)) {
 	  ltp = !ltp;
 	}
 	if (ltp) {
-	  bitmap->duplicateRow(y, y-1);
+	  if (y > 0) {
+	    bitmap->duplicateRow(y, y-1);
+	  }
 	  continue;
 	}
       }
 
+      if (fast) {
+	readGenericBitmapRow(bitmap, y, templ, atx, aty);
+	continue;
+      }
+
       switch (templ) {
       case 0:
 
@@ -2847,6 +3211,99 @@ JBIG2Bitmap *JBIG2Stream::readGenericBitmap(GBool mmr, int w, int h,
   return bitmap;
 }
 
+// Decode row <y> of a generic region bitmap.  The rows above are kept
+// in 24-bit registers, refilled a byte at a time: while decoding byte
+// <i> of the row, <buf1> and <buf2> hold bytes <i>-1 .. <i>+1 of rows
+// <y>-1 and <y>-2, so pixel <x> = 8*<i> + <k> is bit 15 - <k>, and its
+// neighbors (up to 8 pixels away) are found with a shift.  The context
+// bits for the current row are shifted in as they are decoded.
+void JBIG2Stream::readGenericBitmapRow(JBIG2Bitmap *bitmap, int y,
+				       int templ, int *atx, int *aty) {
+  Guchar *p0, *p1, *p2;
+  Guint buf1, buf2, at0, at1, at2, at3, cx, cx2, pix, out;
+  int w, nBytes, i, k, kEnd, s;
+
+  w = bitmap->getWidth();
+  nBytes = bitmap->getLineSize();
+  p0 = bitmap->getDataPtr() + y * nBytes;
+  p1 = y >= 1 ? p0 - nBytes : (Guchar *)NULL;
+  p2 = y >= 2 ? p0 - 2 * nBytes : (Guchar *)NULL;
+
+  buf1 = p1 ? p1[0] : 0;
+  buf2 = p2 ? p2[0] : 0;
+  at1 = at2 = at3 = 0;
+  cx2 = 0;
+  for (i = 0; i < nBytes; ++i) {
+
+    // shift in the next byte of the rows above
+    buf1 = ((buf1 << 8) | (p1 && i + 1 < nBytes ? p1[i + 1] : 0)) & 0xffffff;
+    buf2 = ((buf2 << 8) | (p2 && i + 1 < nBytes ? p2[i + 1] : 0)) & 0xffffff;
+    at0 = aty[0] == -1 ? buf1 : buf2;
+    kEnd = w - (i << 3);
+    if (kEnd > 8) {
+      kEnd = 8;
+    }
+    out = 0;
+
+    switch (templ) {
+    case 0:
+      at1 = aty[1] == -1 ? buf1 : buf2;
+      at2 = aty[2] == -1 ? buf1 : buf2;
+      at3 = aty[3] == -1 ? buf1 : buf2;
+      for (k = 0, s = 15; k < kEnd; ++k, --s) {
+	cx = (((buf2 >> (s - 1)) & 0x07) << 13) |
+	     (((buf1 >> (s - 2)) & 0x1f) << 8) |
+	     (cx2 << 4) |
+	     (((at0 >> (s - atx[0])) & 1) << 3) |
+	     (((at1 >> (s - atx[1])) & 1) << 2) |
+	     (((at2 >> (s - atx[2])) & 1) << 1) |
+	     ((at3 >> (s - atx[3])) & 1);
+	pix = arithDecoder->decodeBit(cx, genericRegionStats);
+	cx2 = ((cx2 << 1) | pix) & 0x0f;
+	out = (out << 1) | pix;
+      }
+      break;
+
+    case 1:
+      for (k = 0, s = 15; k < kEnd; ++k, --s) {
+	cx = (((buf2 >> (s - 2)) & 0x0f) << 9) |
+	     (((buf1 >> (s - 2)) & 0x1f) << 4) |
+	     (cx2 << 1) |
+	     ((at0 >> (s - atx[0])) & 1);
+	pix = arithDecoder->decodeBit(cx, genericRegionStats);
+	cx2 = ((cx2 << 1) | pix) & 0x07;
+	out = (out << 1) | pix;
+      }
+      break;
+
+    case 2:
+      for (k = 0, s = 15; k < kEnd; ++k, --s) {
+	cx = (((buf2 >> (s - 1)) & 0x07) << 7) |
+	     (((buf1 >> (s - 1)) & 0x0f) << 3) |
+	     (cx2 << 1) |
+	     ((at0 >> (s - atx[0])) & 1);
+	pix = arithDecoder->decodeBit(cx, genericRegionStats);
+	cx2 = ((cx2 << 1) | pix) & 0x03;
+	out = (out << 1) | pix;
+      }
+      break;
+
+    case 3:
+      for (k = 0, s = 15; k < kEnd; ++k, --s) {
+	cx = (((buf1 >> (s - 1)) & 0x1f) << 5) |
+	     (cx2 << 1) |
+	     ((at0 >> (s - atx[0])) & 1);
+	pix = arithDecoder->decodeBit(cx, genericRegionStats);
+	cx2 = ((cx2 << 1) | pix) & 0x0f;
+	out = (out << 1) | pix;
+      }
+      break;
+    }
+
+    p0[i] = (Guchar)(out << (8 - kEnd));
+  }
+}
+
 void JBIG2Stream::readGenericRefinementRegionSeg(Guint segNum, GBool imm,
 						 GBool lossless, Guint length,
 						 Guint *refSegs,
@@ -3264,10 +3721,11 @@ void JBIG2Stream::discardSegment(Guint segNum) {
   JBIG2Segment *seg;
   int i;
 
+  // the global segments are shared with other streams, and are left
+  // alone
   for (i = 0; i < globalSegments->getLength(); ++i) {
     seg = (JBIG2Segment *)globalSegments->get(i);
     if (seg->getSegNum() == segNum) {
-      globalSegments->del(i);
       return;
     }
   }
@@ -18,8 +18,13 @@
 #include "gtypes.h"
 #include "Object.h"
 #include "Stream.h"
+#if MULTITHREADED
+#include "GMutex.h"
+#endif
 
 class GList;
+class XRef;
+class JBIG2Globals;
 class JBIG2Segment;
 class JBIG2Bitmap;
 class JArithmeticDecoder;
@@ -30,15 +35,63 @@ class JBIG2MMRDecoder;
 
 //------------------------------------------------------------------------
 
+// number of decoded JBIG2Globals streams cached per PDF file
+#define jbig2GlobalsCacheSize 4
+
+//------------------------------------------------------------------------
+// JBIG2GlobalsCache
+//------------------------------------------------------------------------
+
+// Decoded JBIG2Globals streams, keyed by object reference.  Each XRef
+// has one of these, so the globals shared by the images of a scanned
+// document are only decoded once.  The segments are shared, read-only,
+// by all of the JBIG2Streams that use them.  In multithreaded builds,
+// lookups and inserts (including the reordering of the cache) are
+// done under one mutex.
+class JBIG2GlobalsCache {
+public:
+
+  JBIG2GlobalsCache();
+  ~JBIG2GlobalsCache();
+
+  // Get the decoded globals for <ref>.  Increments the reference
+  // count; there will be one reference for the cache plus one for the
+  // caller of this function.  Returns NULL if <ref> isn't cached.
+  JBIG2Globals *getGlobals(Ref ref);
+
+  // Insert <globals> into the cache, in the most-recently-used
+  // position.  If another thread has already added globals for the
+  // same reference, the cache is left unchanged.
+  void add(JBIG2Globals *globals);
+
+private:
+
+  JBIG2Globals *cache[jbig2GlobalsCacheSize];
+#if MULTITHREADED
+  G_Mutex mutex;
+#endif
+};
+
+//------------------------------------------------------------------------
+// JBIG2Stream
+//------------------------------------------------------------------------
+
 class JBIG2Stream: public FilterStream {
 public:
 
-  JBIG2Stream(Stream *strA, Object *globalsStream);
+  // If <globalsStream> comes from an indirect object,
+  // <globalsStreamRef> is the reference and <xref> is the file's
+  // xref table; the decoded globals are then shared through the
+  // xref's JBIG2GlobalsCache.
+  JBIG2Stream(Stream *strA, Object *globalsStream,
+	      Object *globalsStreamRef = NULL, XRef *xref = NULL);
   virtual ~JBIG2Stream();
   virtual StreamKind getKind() { return strJBIG2; }
   virtual void reset();
   virtual int getChar();
   virtual int lookChar();
+  virtual GBool hasRuns(int width);
+  virtual int getRuns(int *runs);
   virtual GString *getPSFilter(int psLevel, char *indent);
   virtual GBool isBinary(GBool last = gTrue);
 
@@ -82,6 +135,8 @@ private:
 				 GBool useSkip, JBIG2Bitmap *skip,
 				 int *atx, int *aty,
 				 int mmrDataLength);
+  void readGenericBitmapRow(JBIG2Bitmap *bitmap, int y, int templ,
+			    int *atx, int *aty);
   void readGenericRefinementRegionSeg(Guint segNum, GBool imm,
 				      GBool lossless, Guint length,
 				      Guint *refSegs,
@@ -114,7 +169,8 @@ private:
   JBIG2Bitmap *pageBitmap;
   Guint defCombOp;
   GList *segments;		// [JBIG2Segment]
-  GList *globalSegments;	// [JBIG2Segment]
+  JBIG2Globals *globals;	// decoded JBIG2Globals stream (shared)
+  GList *globalSegments;	// [JBIG2Segment] - globals' segments
   Stream *curStr;
   Guchar *dataPtr;
   Guchar *dataEnd;
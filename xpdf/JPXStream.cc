@@ -13,7 +13,11 @@
 #endif
 
 #include "gmem.h"
+#if MULTITHREADED
+#include "GMutex.h"
+#endif
 #include "Error.h"
+#include "GlobalParams.h"
 #include "JArithmeticDecoder.h"
 #include "JPXStream.h"
 
@@ -188,6 +192,10 @@ JPXStream::JPXStream(Stream *strA):
   haveChannelDefn = gFalse;
 
   img.tiles = NULL;
+  img.reduction = 0;
+  img.regionX0 = img.regionY0 = 0;
+  img.regionX1 = img.regionY1 = 0xffffffff;
+  cbJobs = NULL;
   bitBuf = 0;
   bitBufLen = 0;
   bitBufSkip = gFalse;
@@ -243,12 +251,8 @@ JPXStream::~JPXStream() {
 			for (k = 0; k < subband->nXCBs * subband->nYCBs; ++k) {
 			  cb = &subband->cbs[k];
 			  gfree(cb->coeffs);
-			  if (cb->arithDecoder) {
-			    delete cb->arithDecoder;
-			  }
-			  if (cb->stats) {
-			    delete cb->stats;
-			  }
+			  gfree(cb->segData);
+			  gfree(cb->segs);
 			}
 			gfree(subband->cbs);
 		      }
@@ -283,6 +287,19 @@ void JPXStream::reset() {
   readBufLen = 0;
 }
 
+void JPXStream::setReduction(int reductionA) {
+  for (img.reduction = 0;
+       img.reduction < 16 && (2 << img.reduction) <= reductionA;
+       ++img.reduction) ;
+}
+
+void JPXStream::setRegion(int x0, int y0, int x1, int y1) {
+  img.regionX0 = x0 < 0 ? 0 : x0;
+  img.regionY0 = y0 < 0 ? 0 : y0;
+  img.regionX1 = x1 < 0 ? 0 : x1;
+  img.regionY1 = y1 < 0 ? 0 : y1;
+}
+
 int JPXStream::getChar() {
   int c;
 
@@ -323,9 +340,10 @@ int JPXStream::lookChar() {
 }
 
 void JPXStream::fillReadBuf() {
+  JPXTile *tile;
   JPXTileComp *tileComp;
-  Guint tileIdx, tx, ty;
-  int pix, pixBits;
+  Guint tileIdx;
+  int tx, ty, pix, pixBits;
 
   do {
     if (curY >= img.ySize) {
@@ -333,14 +351,33 @@ void JPXStream::fillReadBuf() {
     }
     tileIdx = ((curY - img.yTileOffset) / img.yTileSize) * img.nXTiles
               + (curX - img.xTileOffset) / img.xTileSize;
+    tile = &img.tiles[tileIdx];
 #if 1 //~ ignore the palette, assume the PDF ColorSpace object is valid
-    tileComp = &img.tiles[tileIdx].tileComps[curComp];
+    tileComp = &tile->tileComps[curComp];
 #else
-    tileComp = &img.tiles[tileIdx].tileComps[havePalette ? 0 : curComp];
+    tileComp = &tile->tileComps[havePalette ? 0 : curComp];
 #endif
-    tx = jpxCeilDiv((curX - img.xTileOffset) % img.xTileSize, tileComp->hSep);
-    ty = jpxCeilDiv((curY - img.yTileOffset) % img.yTileSize, tileComp->vSep);
-    pix = (int)tileComp->data[ty * (tileComp->x1 - tileComp->x0) + tx];
+    if (tileComp->data) {
+      // position of the sample in the (reduced) tile-comp data --
+      // this is clipped to the data array at the edges of the tile
+      tx = (int)((curX / tileComp->hSep) >> tile->reduction) -
+	   (int)jpxCeilDivPow2(tileComp->x0, tile->reduction);
+      ty = (int)((curY / tileComp->vSep) >> tile->reduction) -
+	   (int)jpxCeilDivPow2(tileComp->y0, tile->reduction);
+      if (tx < 0) {
+	tx = 0;
+      } else if (tx >= (int)tileComp->w) {
+	tx = tileComp->w - 1;
+      }
+      if (ty < 0) {
+	ty = 0;
+      } else if (ty >= (int)tileComp->h) {
+	ty = tileComp->h - 1;
+      }
+      pix = tileComp->data[ty * tileComp->w + tx];
+    } else {
+      pix = 0;
+    }
     pixBits = tileComp->prec;
 #if 1 //~ ignore the palette, assume the PDF ColorSpace object is valid
     if (++curComp == img.nComps) {
@@ -355,9 +392,10 @@ void JPXStream::fillReadBuf() {
     if (++curComp == (Guint)(havePalette ? palette.nComps : img.nComps)) {
 #endif
       curComp = 0;
-      if (++curX == img.xSize) {
+      curX += 1 << img.reduction;
+      if (curX >= img.xSize) {
 	curX = img.xOffset;
-	++curY;
+	curY += 1 << img.reduction;
       }
     }
     if (pixBits == 8) {
@@ -778,8 +816,6 @@ GBool JPXStream::readColorSpecBox(Guint dataLen) {
 }
 
 GBool JPXStream::readCodestream(Guint len) {
-  JPXTile *tile;
-  JPXTileComp *tileComp;
   int segType;
   GBool haveSIZ, haveCOD, haveQCD, haveSOT;
   Guint precinctSize, style;
@@ -821,6 +857,8 @@ GBool JPXStream::readCodestream(Guint len) {
       img.tiles = (JPXTile *)gmallocn(img.nXTiles * img.nYTiles,
 				      sizeof(JPXTile));
       for (i = 0; i < img.nXTiles * img.nYTiles; ++i) {
+	img.tiles[i].visible = gFalse;
+	img.tiles[i].reduction = 0;
 	img.tiles[i].tileComps = (JPXTileComp *)gmallocn(img.nComps,
 							 sizeof(JPXTileComp));
 	for (comp = 0; comp < img.nComps; ++comp) {
@@ -1261,20 +1299,7 @@ GBool JPXStream::readCodestream(Guint len) {
   }
 
   //----- finish decoding the image
-  for (i = 0; i < img.nXTiles * img.nYTiles; ++i) {
-    tile = &img.tiles[i];
-    for (comp = 0; comp < img.nComps; ++comp) {
-      tileComp = &tile->tileComps[comp];
-      inverseTransform(tileComp);
-    }
-    if (!inverseMultiCompAndDC(tile)) {
-      return gFalse;
-    }
-  }
-
-  //~ can free memory below tileComps here, and also tileComp.buf
-
-  return gTrue;
+  return decodeImage();
 }
 
 GBool JPXStream::readTilePart() {
@@ -1647,26 +1672,40 @@ GBool JPXStream::readTilePart() {
     tile->precinct = 0;
     tile->layer = 0;
     tile->maxNDecompLevels = 0;
+    tile->visible = tile->x1 - img.xOffset > img.regionX0 &&
+                    tile->x0 - img.xOffset < img.regionX1 &&
+                    tile->y1 - img.yOffset > img.regionY0 &&
+                    tile->y0 - img.yOffset < img.regionY1;
+    // the same number of levels is skipped in every component, so the
+    // multiple component transform still lines up
+    tile->reduction = img.reduction;
     for (comp = 0; comp < img.nComps; ++comp) {
       tileComp = &tile->tileComps[comp];
       if (tileComp->nDecompLevels > tile->maxNDecompLevels) {
 	tile->maxNDecompLevels = tileComp->nDecompLevels;
       }
+      if (tileComp->nDecompLevels < tile->reduction) {
+	tile->reduction = tileComp->nDecompLevels;
+      }
+    }
+    for (comp = 0; comp < img.nComps; ++comp) {
+      tileComp = &tile->tileComps[comp];
       tileComp->x0 = jpxCeilDiv(tile->x0, tileComp->hSep);
-      tileComp->y0 = jpxCeilDiv(tile->y0, tileComp->hSep);
+      tileComp->y0 = jpxCeilDiv(tile->y0, tileComp->vSep);
       tileComp->x1 = jpxCeilDiv(tile->x1, tileComp->hSep);
-      tileComp->y1 = jpxCeilDiv(tile->y1, tileComp->hSep);
+      tileComp->y1 = jpxCeilDiv(tile->y1, tileComp->vSep);
+      tileComp->w = jpxCeilDivPow2(tileComp->x1, tile->reduction) -
+	            jpxCeilDivPow2(tileComp->x0, tile->reduction);
+      tileComp->h = jpxCeilDivPow2(tileComp->y1, tile->reduction) -
+	            jpxCeilDivPow2(tileComp->y0, tile->reduction);
       tileComp->cbW = 1 << tileComp->codeBlockW;
       tileComp->cbH = 1 << tileComp->codeBlockH;
-      tileComp->data = (int *)gmallocn((tileComp->x1 - tileComp->x0) *
-				       (tileComp->y1 - tileComp->y0),
-				       sizeof(int));
-      if (tileComp->x1 - tileComp->x0 > tileComp->y1 - tileComp->y0) {
-	n = tileComp->x1 - tileComp->x0;
-      } else {
-	n = tileComp->y1 - tileComp->y0;
+      if (tile->visible) {
+	tileComp->data = (int *)gmallocn(tileComp->w * tileComp->h,
+					 sizeof(int));
+	n = tileComp->w > tileComp->h ? tileComp->w : tileComp->h;
+	tileComp->buf = (int *)gmallocn(n + 8, sizeof(int));
       }
-      tileComp->buf = (int *)gmallocn(n + 8, sizeof(int));
       for (r = 0; r <= tileComp->nDecompLevels; ++r) {
 	resLevel = &tileComp->resLevels[r];
 	k = r == 0 ? tileComp->nDecompLevels
@@ -1767,20 +1806,29 @@ GBool JPXStream::readTilePart() {
 		cb->lBlock = 3;
 		cb->nextPass = jpxPassCleanup;
 		cb->nZeroBitPlanes = 0;
-		cb->coeffs =
-		    (JPXCoeff *)gmallocn((1 << (tileComp->codeBlockW
-						+ tileComp->codeBlockH)),
-					 sizeof(JPXCoeff));
-		for (cbi = 0;
-		     cbi < (Guint)(1 << (tileComp->codeBlockW
-					 + tileComp->codeBlockH));
-		     ++cbi) {
-		  cb->coeffs[cbi].flags = 0;
-		  cb->coeffs[cbi].len = 0;
-		  cb->coeffs[cbi].mag = 0;
+		// code-blocks which won't be decoded don't need
+		// coefficients
+		if (tile->visible &&
+		    r + tile->reduction <= tileComp->nDecompLevels) {
+		  cb->coeffs =
+		      (JPXCoeff *)gmallocn((1 << (tileComp->codeBlockW
+						  + tileComp->codeBlockH)),
+					   sizeof(JPXCoeff));
+		  for (cbi = 0;
+		       cbi < (Guint)(1 << (tileComp->codeBlockW
+					   + tileComp->codeBlockH));
+		       ++cbi) {
+		    cb->coeffs[cbi].flags = 0;
+		    cb->coeffs[cbi].len = 0;
+		    cb->coeffs[cbi].mag = 0;
+		  }
+		} else {
+		  cb->coeffs = NULL;
 		}
-		cb->arithDecoder = NULL;
-		cb->stats = NULL;
+		cb->segData = NULL;
+		cb->segDataLen = cb->segDataSize = 0;
+		cb->segs = NULL;
+		cb->nSegs = cb->segsSize = 0;
 		++cb;
 	      }
 	    }
@@ -1989,9 +2037,17 @@ GBool JPXStream::readTilePartData(Guint tileIdx,
 	for (cbX = 0; cbX < subband->nXCBs; ++cbX) {
 	  cb = &subband->cbs[cbY * subband->nXCBs + cbX];
 	  if (cb->included) {
-	    if (!readCodeBlockData(tileComp, resLevel, precinct, subband,
-				   tile->res, sb, cb)) {
-	      return gFalse;
+	    if (cb->coeffs) {
+	      if (!readCodeBlockData(cb)) {
+		goto err;
+	      }
+	    } else {
+	      // the code-block is in a skipped tile or resolution level
+	      for (i = 0; i < cb->dataLen; ++i) {
+		if (str->getChar() == EOF) {
+		  goto err;
+		}
+	      }
 	    }
 	    tilePartLen -= cb->dataLen;
 	    cb->seen = gTrue;
@@ -2071,320 +2127,628 @@ GBool JPXStream::readTilePartData(Guint tileIdx,
   return gFalse;
 }
 
-GBool JPXStream::readCodeBlockData(JPXTileComp *tileComp,
-				   JPXResLevel *resLevel,
-				   JPXPrecinct *precinct,
-				   JPXSubband *subband,
-				   Guint res, Guint sb,
-				   JPXCodeBlock *cb) {
-  JPXCoeff *coeff0, *coeff1, *coeff;
-  Guint horiz, vert, diag, all, cx, xorBit;
-  int horizSign, vertSign;
-  Guint i, x, y0, y1, y2;
-
-  if (cb->arithDecoder) {
-    cb->arithDecoder->restart(cb->dataLen);
-  } else {
-    cb->arithDecoder = new JArithmeticDecoder();
-    cb->arithDecoder->setStream(str, cb->dataLen);
-    cb->arithDecoder->start();
-    cb->stats = new JArithmeticDecoderStats(jpxNContexts);
-    cb->stats->setEntry(jpxContextSigProp, 4, 0);
-    cb->stats->setEntry(jpxContextRunLength, 3, 0);
-    cb->stats->setEntry(jpxContextUniform, 46, 0);
+// Read the data for code-block <cb> from the current packet.  It is
+// decoded later, by decodeCodeBlock.
+GBool JPXStream::readCodeBlockData(JPXCodeBlock *cb) {
+  if (cb->nSegs == cb->segsSize) {
+    cb->segsSize = cb->segsSize ? 2 * cb->segsSize : 4;
+    cb->segs = (JPXCodeBlockSeg *)greallocn(cb->segs, cb->segsSize,
+					    sizeof(JPXCodeBlockSeg));
+  }
+  if (cb->segDataLen + cb->dataLen > cb->segDataSize) {
+    cb->segDataSize = 2 * cb->segDataSize;
+    if (cb->segDataLen + cb->dataLen > cb->segDataSize) {
+      cb->segDataSize = cb->segDataLen + cb->dataLen;
+    }
+    cb->segData = (Guchar *)grealloc(cb->segData, cb->segDataSize);
+  }
+  if (cb->dataLen > 0 &&
+      str->getBlock((char *)cb->segData + cb->segDataLen, cb->dataLen)
+        != (int)cb->dataLen) {
+    return gFalse;
   }
+  cb->segs[cb->nSegs].dataLen = cb->dataLen;
+  cb->segs[cb->nSegs].nCodingPasses = cb->nCodingPasses;
+  ++cb->nSegs;
+  cb->segDataLen += cb->dataLen;
+  return gTrue;
+}
 
-  for (i = 0; i < cb->nCodingPasses; ++i) {
-    switch (cb->nextPass) {
-
-    //----- significance propagation pass
-    case jpxPassSigProp:
-      for (y0 = cb->y0, coeff0 = cb->coeffs;
-	   y0 < cb->y1;
-	   y0 += 4, coeff0 += 4 << tileComp->codeBlockW) {
-	for (x = cb->x0, coeff1 = coeff0;
-	     x < cb->x1;
-	     ++x, ++coeff1) {
-	  for (y1 = 0, coeff = coeff1;
-	       y1 < 4 && y0+y1 < cb->y1;
-	       ++y1, coeff += tileComp->cbW) {
-	    if (!(coeff->flags & jpxCoeffSignificant)) {
-	      horiz = vert = diag = 0;
-	      horizSign = vertSign = 2;
-	      if (x > cb->x0) {
-		if (coeff[-1].flags & jpxCoeffSignificant) {
-		  ++horiz;
-		  horizSign += (coeff[-1].flags & jpxCoeffSign) ? -1 : 1;
-		}
-		if (y0+y1 > cb->y0) {
-		  diag += (coeff[-(int)tileComp->cbW - 1].flags
-			   >> jpxCoeffSignificantB) & 1;
-		}
-		if (y0+y1 < cb->y1 - 1) {
-		  diag += (coeff[tileComp->cbW - 1].flags
-			   >> jpxCoeffSignificantB) & 1;
-		}
-	      }
-	      if (x < cb->x1 - 1) {
-		if (coeff[1].flags & jpxCoeffSignificant) {
-		  ++horiz;
-		  horizSign += (coeff[1].flags & jpxCoeffSign) ? -1 : 1;
-		}
-		if (y0+y1 > cb->y0) {
-		  diag += (coeff[-(int)tileComp->cbW + 1].flags
-			   >> jpxCoeffSignificantB) & 1;
-		}
-		if (y0+y1 < cb->y1 - 1) {
-		  diag += (coeff[tileComp->cbW + 1].flags
-			   >> jpxCoeffSignificantB) & 1;
-		}
-	      }
-	      if (y0+y1 > cb->y0) {
-		if (coeff[-(int)tileComp->cbW].flags & jpxCoeffSignificant) {
-		  ++vert;
-		  vertSign += (coeff[-(int)tileComp->cbW].flags & jpxCoeffSign)
-		              ? -1 : 1;
-		}
-	      }
-	      if (y0+y1 < cb->y1 - 1) {
-		if (coeff[tileComp->cbW].flags & jpxCoeffSignificant) {
-		  ++vert;
-		  vertSign += (coeff[tileComp->cbW].flags & jpxCoeffSign)
-		              ? -1 : 1;
-		}
-	      }
-	      cx = sigPropContext[horiz][vert][diag][res == 0 ? 1 : sb];
-	      if (cx != 0) {
-		if (cb->arithDecoder->decodeBit(cx, cb->stats)) {
-		  coeff->flags |= jpxCoeffSignificant | jpxCoeffFirstMagRef;
-		  coeff->mag = (coeff->mag << 1) | 1;
-		  cx = signContext[horizSign][vertSign][0];
-		  xorBit = signContext[horizSign][vertSign][1];
-		  if (cb->arithDecoder->decodeBit(cx, cb->stats) ^ xorBit) {
-		    coeff->flags |= jpxCoeffSign;
-		  }
-		}
-		++coeff->len;
-		coeff->flags |= jpxCoeffTouched;
-	      }
+//------------------------------------------------------------------------
+
+// jobs run by the worker threads in decodeImage
+#define jpxPhaseCodeBlocks  0	// one code-block (cbJobs[job])
+#define jpxPhaseTileComps   1	// IDWT of one tile-comp
+				//   (tile = job / nComps, comp = job % nComps)
+#define jpxPhaseTiles       2	// inverse MCT and DC shift of one tile
+
+struct JPXWorkQueue {
+  JPXStream *jpx;
+  int phase;
+  int nJobs;
+  int nextJob;			// next job to hand out
+  int nHelpers;			// number of workers which may still join
+  int nActive;			// number of workers running jobs
+  GBool ok;			// cleared if any job fails
+};
+
+#if JPX_POOL
+// The worker threads are started the first time a decode needs them,
+// and then wait for work until shutdownPool() is called or jpxThreads
+// is lowered.  One queue at a time is posted; everything below is
+// protected by jpxPoolMutex.
+static G_Mutex jpxPoolMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t jpxPoolWorkCond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t jpxPoolDoneCond = PTHREAD_COND_INITIALIZER;
+static JPXWorkQueue *jpxPoolQueue = NULL;	// posted queue, if any
+static pthread_t *jpxPoolThreads = NULL;	// worker threads
+static int jpxPoolThreadsSize = 0;		// size of jpxPoolThreads
+static int jpxPoolNWorkers = 0;			// workers 0 .. n-1 keep running
+static GBool jpxPoolStopping = gFalse;		// set while workers are joined
+#endif
+
+// Decode the code-blocks, and then do the inverse transforms.  Each
+// job only writes its own code-block, tile-comp, or tile, so the
+// result doesn't depend on the number of threads.
+GBool JPXStream::decodeImage() {
+  JPXTile *tile;
+  JPXTileComp *tileComp;
+  JPXResLevel *resLevel;
+  JPXPrecinct *precinct;
+  JPXSubband *subband;
+  JPXCodeBlock *cb;
+  Guint i, comp, r, sb;
+  int nCBJobs, cbJobsSize;
+  GBool ok;
+
+  // gather the code-blocks which have data
+  nCBJobs = cbJobsSize = 0;
+  for (i = 0; i < img.nXTiles * img.nYTiles; ++i) {
+    tile = &img.tiles[i];
+    if (!tile->visible) {
+      continue;
+    }
+    for (comp = 0; comp < img.nComps; ++comp) {
+      tileComp = &tile->tileComps[comp];
+      for (r = 0; r <= tileComp->nDecompLevels; ++r) {
+	resLevel = &tileComp->resLevels[r];
+	precinct = &resLevel->precincts[0];
+	for (sb = 0; sb < (r == 0 ? 1 : 3); ++sb) {
+	  subband = &precinct->subbands[sb];
+	  for (cb = subband->cbs;
+	       cb < subband->cbs + subband->nXCBs * subband->nYCBs;
+	       ++cb) {
+	    if (!cb->coeffs || cb->nSegs == 0) {
+	      continue;
+	    }
+	    if (nCBJobs == cbJobsSize) {
+	      cbJobsSize = cbJobsSize ? 2 * cbJobsSize : 256;
+	      cbJobs = (JPXCodeBlockJob *)greallocn(cbJobs, cbJobsSize,
+						    sizeof(JPXCodeBlockJob));
 	    }
+	    cbJobs[nCBJobs].tileComp = tileComp;
+	    cbJobs[nCBJobs].res = r;
+	    cbJobs[nCBJobs].sb = sb;
+	    cbJobs[nCBJobs].cb = cb;
+	    ++nCBJobs;
 	  }
 	}
       }
-      ++cb->nextPass;
-      break;
+    }
+  }
+
+  ok = runJobs(jpxPhaseCodeBlocks, nCBJobs) &&
+       runJobs(jpxPhaseTileComps, img.nXTiles * img.nYTiles * img.nComps) &&
+       runJobs(jpxPhaseTiles, img.nXTiles * img.nYTiles);
+  gfree(cbJobs);
+  cbJobs = NULL;
+
+  //~ can free memory below tileComps here, and also tileComp.buf
+
+  return ok;
+}
+
+// Run jobs 0 .. <nJobs>-1 of <phase>.  With more than one thread, the
+// queue is posted to the worker pool, and the jobs are handed out in
+// order to this thread and to the workers; this returns once they have
+// all finished.  If another stream is using the pool, the jobs just run
+// on this thread.
+GBool JPXStream::runJobs(int phase, int nJobs) {
+  JPXWorkQueue queue;
+#if JPX_POOL
+  int nThreads;
+#endif
+
+  queue.jpx = this;
+  queue.phase = phase;
+  queue.nJobs = nJobs;
+  queue.nextJob = 0;
+  queue.nHelpers = 0;
+  queue.nActive = 0;
+  queue.ok = gTrue;
+#if JPX_POOL
+  nThreads = globalParams->getJPXThreads();
+  gLockMutex(&jpxPoolMutex);
+  if (!jpxPoolQueue && !jpxPoolStopping) {
+    // jpxThreads may have been lowered since the workers were started
+    if (jpxPoolNWorkers > 0 && jpxPoolNWorkers >= nThreads) {
+      stopWorkers(nThreads > 1 ? nThreads - 1 : 0);
+    }
+    if (nThreads > nJobs) {
+      nThreads = nJobs;
+    }
+    if (nThreads > 1) {
+      while (jpxPoolNWorkers < nThreads - 1) {
+	if (jpxPoolNWorkers == jpxPoolThreadsSize) {
+	  jpxPoolThreadsSize += 4;
+	  jpxPoolThreads = (pthread_t *)greallocn(jpxPoolThreads,
+						  jpxPoolThreadsSize,
+						  sizeof(pthread_t));
+	}
+	if (pthread_create(&jpxPoolThreads[jpxPoolNWorkers], NULL,
+			   &JPXStream::workerThread,
+			   (void *)(long)jpxPoolNWorkers)) {
+	  break;
+	}
+	++jpxPoolNWorkers;
+      }
+      queue.nHelpers = nThreads - 1;
+      jpxPoolQueue = &queue;
+      pthread_cond_broadcast(&jpxPoolWorkCond);
+      runQueue(&queue);
+      jpxPoolQueue = NULL;
+      while (queue.nActive > 0) {
+	pthread_cond_wait(&jpxPoolDoneCond, &jpxPoolMutex);
+      }
+      gUnlockMutex(&jpxPoolMutex);
+      return queue.ok;
+    }
+  }
+  gUnlockMutex(&jpxPoolMutex);
+#endif
+  for (; queue.nextJob < nJobs; ++queue.nextJob) {
+    if (!runJob(phase, queue.nextJob)) {
+      queue.ok = gFalse;
+    }
+  }
+  return queue.ok;
+}
 
-    //----- magnitude refinement pass
-    case jpxPassMagRef:
-      for (y0 = cb->y0, coeff0 = cb->coeffs;
-	   y0 < cb->y1;
-	   y0 += 4, coeff0 += 4 << tileComp->codeBlockW) {
-	for (x = cb->x0, coeff1 = coeff0;
-	     x < cb->x1;
-	     ++x, ++coeff1) {
-	  for (y1 = 0, coeff = coeff1;
-	       y1 < 4 && y0+y1 < cb->y1;
-	       ++y1, coeff += tileComp->cbW) {
-	    if ((coeff->flags & jpxCoeffSignificant) &&
-		!(coeff->flags & jpxCoeffTouched)) {
-	      if (coeff->flags & jpxCoeffFirstMagRef) {
-		all = 0;
+void JPXStream::shutdownPool() {
+#if JPX_POOL
+  gLockMutex(&jpxPoolMutex);
+  if (!jpxPoolQueue && !jpxPoolStopping && jpxPoolNWorkers > 0) {
+    stopWorkers(0);
+  }
+  gUnlockMutex(&jpxPoolMutex);
+#endif
+}
+
+#if JPX_POOL
+// Stop and join workers <nWorkers> and up.  Called, and returns, with
+// jpxPoolMutex locked and no queue posted.  The mutex is released
+// while the threads are joined; jpxPoolStopping keeps other streams
+// from posting a queue or starting workers meanwhile.
+void JPXStream::stopWorkers(int nWorkers) {
+  int n, i;
+
+  n = jpxPoolNWorkers;
+  jpxPoolNWorkers = nWorkers;
+  jpxPoolStopping = gTrue;
+  pthread_cond_broadcast(&jpxPoolWorkCond);
+  gUnlockMutex(&jpxPoolMutex);
+  for (i = nWorkers; i < n; ++i) {
+    pthread_join(jpxPoolThreads[i], NULL);
+  }
+  gLockMutex(&jpxPoolMutex);
+  jpxPoolStopping = gFalse;
+  if (nWorkers == 0) {
+    gfree(jpxPoolThreads);
+    jpxPoolThreads = NULL;
+    jpxPoolThreadsSize = 0;
+  }
+}
+
+// Run jobs from <queue> until there are none left.  Called, and
+// returns, with jpxPoolMutex locked.
+void JPXStream::runQueue(JPXWorkQueue *queue) {
+  int job;
+  GBool ok;
+
+  while (queue->nextJob < queue->nJobs) {
+    job = queue->nextJob++;
+    gUnlockMutex(&jpxPoolMutex);
+    ok = queue->jpx->runJob(queue->phase, job);
+    gLockMutex(&jpxPoolMutex);
+    if (!ok) {
+      queue->ok = gFalse;
+    }
+  }
+}
+
+// <arg> is the worker's index; it exits once jpxPoolNWorkers drops to
+// that index or below.
+void *JPXStream::workerThread(void *arg) {
+  JPXWorkQueue *queue;
+  int index;
+
+  index = (int)(long)arg;
+  gLockMutex(&jpxPoolMutex);
+  while (index < jpxPoolNWorkers) {
+    queue = jpxPoolQueue;
+    if (!queue || queue->nHelpers == 0 ||
+	queue->nextJob >= queue->nJobs) {
+      pthread_cond_wait(&jpxPoolWorkCond, &jpxPoolMutex);
+      continue;
+    }
+    --queue->nHelpers;
+    ++queue->nActive;
+    runQueue(queue);
+    if (--queue->nActive == 0) {
+      pthread_cond_signal(&jpxPoolDoneCond);
+    }
+  }
+  gUnlockMutex(&jpxPoolMutex);
+  return NULL;
+}
+#endif
+
+GBool JPXStream::runJob(int phase, int job) {
+  JPXTile *tile;
+  JPXCodeBlockJob *cbJob;
+
+  switch (phase) {
+  case jpxPhaseCodeBlocks:
+    cbJob = &cbJobs[job];
+    decodeCodeBlock(cbJob->tileComp, cbJob->res, cbJob->sb, cbJob->cb);
+    break;
+  case jpxPhaseTileComps:
+    tile = &img.tiles[job / img.nComps];
+    if (tile->visible) {
+      inverseTransform(&tile->tileComps[job % img.nComps], tile->reduction);
+    }
+    break;
+  case jpxPhaseTiles:
+    tile = &img.tiles[job];
+    if (tile->visible) {
+      return inverseMultiCompAndDC(tile);
+    }
+    break;
+  }
+  return gTrue;
+}
+
+// Decode the coefficients of code-block <cb> from the data collected
+// by readCodeBlockData.  The pieces from each packet are decoded as if
+// they had been read straight from the stream, i.e., the arithmetic
+// decoder is restarted at the start of each one.
+void JPXStream::decodeCodeBlock(JPXTileComp *tileComp, Guint res, Guint sb,
+				JPXCodeBlock *cb) {
+  JArithmeticDecoder *arithDecoder;
+  JArithmeticDecoderStats *stats;
+  MemStream *segStr;
+  Object obj;
+  JPXCoeff *coeff0, *coeff1, *coeff;
+  Guint horiz, vert, diag, all, cx, xorBit;
+  int horizSign, vertSign;
+  Guint seg, i, x, y0, y1, y2;
+
+  obj.initNull();
+  segStr = new MemStream((char *)cb->segData, 0, cb->segDataLen, &obj);
+  arithDecoder = new JArithmeticDecoder();
+  stats = new JArithmeticDecoderStats(jpxNContexts);
+  stats->setEntry(jpxContextSigProp, 4, 0);
+  stats->setEntry(jpxContextRunLength, 3, 0);
+  stats->setEntry(jpxContextUniform, 46, 0);
+
+  for (seg = 0; seg < cb->nSegs; ++seg) {
+    if (seg == 0) {
+      arithDecoder->setStream(segStr, cb->segs[0].dataLen);
+      arithDecoder->start();
+    } else {
+      arithDecoder->restart(cb->segs[seg].dataLen);
+    }
+
+    for (i = 0; i < cb->segs[seg].nCodingPasses; ++i) {
+      switch (cb->nextPass) {
+
+      //----- significance propagation pass
+      case jpxPassSigProp:
+	for (y0 = cb->y0, coeff0 = cb->coeffs;
+	     y0 < cb->y1;
+	     y0 += 4, coeff0 += 4 << tileComp->codeBlockW) {
+	  for (x = cb->x0, coeff1 = coeff0;
+	       x < cb->x1;
+	       ++x, ++coeff1) {
+	    for (y1 = 0, coeff = coeff1;
+		 y1 < 4 && y0+y1 < cb->y1;
+		 ++y1, coeff += tileComp->cbW) {
+	      if (!(coeff->flags & jpxCoeffSignificant)) {
+		horiz = vert = diag = 0;
+		horizSign = vertSign = 2;
 		if (x > cb->x0) {
-		  all += (coeff[-1].flags >> jpxCoeffSignificantB) & 1;
+		  if (coeff[-1].flags & jpxCoeffSignificant) {
+		    ++horiz;
+		    horizSign += (coeff[-1].flags & jpxCoeffSign) ? -1 : 1;
+		  }
 		  if (y0+y1 > cb->y0) {
-		    all += (coeff[-(int)tileComp->cbW - 1].flags
-			    >> jpxCoeffSignificantB) & 1;
+		    diag += (coeff[-(int)tileComp->cbW - 1].flags
+			     >> jpxCoeffSignificantB) & 1;
 		  }
 		  if (y0+y1 < cb->y1 - 1) {
-		    all += (coeff[tileComp->cbW - 1].flags
-			    >> jpxCoeffSignificantB) & 1;
+		    diag += (coeff[tileComp->cbW - 1].flags
+			     >> jpxCoeffSignificantB) & 1;
 		  }
 		}
 		if (x < cb->x1 - 1) {
-		  all += (coeff[1].flags >> jpxCoeffSignificantB) & 1;
+		  if (coeff[1].flags & jpxCoeffSignificant) {
+		    ++horiz;
+		    horizSign += (coeff[1].flags & jpxCoeffSign) ? -1 : 1;
+		  }
 		  if (y0+y1 > cb->y0) {
-		    all += (coeff[-(int)tileComp->cbW + 1].flags
-			    >> jpxCoeffSignificantB) & 1;
+		    diag += (coeff[-(int)tileComp->cbW + 1].flags
+			     >> jpxCoeffSignificantB) & 1;
 		  }
 		  if (y0+y1 < cb->y1 - 1) {
-		    all += (coeff[tileComp->cbW + 1].flags
-			    >> jpxCoeffSignificantB) & 1;
+		    diag += (coeff[tileComp->cbW + 1].flags
+			     >> jpxCoeffSignificantB) & 1;
 		  }
 		}
 		if (y0+y1 > cb->y0) {
-		  all += (coeff[-(int)tileComp->cbW].flags
-			  >> jpxCoeffSignificantB) & 1;
+		  if (coeff[-(int)tileComp->cbW].flags & jpxCoeffSignificant) {
+		    ++vert;
+		    vertSign +=
+			(coeff[-(int)tileComp->cbW].flags & jpxCoeffSign)
+			? -1 : 1;
+		  }
 		}
 		if (y0+y1 < cb->y1 - 1) {
-		  all += (coeff[tileComp->cbW].flags
-			  >> jpxCoeffSignificantB) & 1;
+		  if (coeff[tileComp->cbW].flags & jpxCoeffSignificant) {
+		    ++vert;
+		    vertSign += (coeff[tileComp->cbW].flags & jpxCoeffSign)
+				? -1 : 1;
+		  }
+		}
+		cx = sigPropContext[horiz][vert][diag][res == 0 ? 1 : sb];
+		if (cx != 0) {
+		  if (arithDecoder->decodeBit(cx, stats)) {
+		    coeff->flags |= jpxCoeffSignificant | jpxCoeffFirstMagRef;
+		    coeff->mag = (coeff->mag << 1) | 1;
+		    cx = signContext[horizSign][vertSign][0];
+		    xorBit = signContext[horizSign][vertSign][1];
+		    if (arithDecoder->decodeBit(cx, stats) ^ xorBit) {
+		      coeff->flags |= jpxCoeffSign;
+		    }
+		  }
+		  ++coeff->len;
+		  coeff->flags |= jpxCoeffTouched;
 		}
-		cx = all ? 15 : 14;
-	      } else {
-		cx = 16;
 	      }
-	      coeff->mag = (coeff->mag << 1) |
-		           cb->arithDecoder->decodeBit(cx, cb->stats);
-	      ++coeff->len;
-	      coeff->flags |= jpxCoeffTouched;
-	      coeff->flags &= ~jpxCoeffFirstMagRef;
 	    }
 	  }
 	}
-      }
-      ++cb->nextPass;
-      break;
+	++cb->nextPass;
+	break;
 
-    //----- cleanup pass
-    case jpxPassCleanup:
-      for (y0 = cb->y0, coeff0 = cb->coeffs;
-	   y0 < cb->y1;
-	   y0 += 4, coeff0 += 4 << tileComp->codeBlockW) {
-	for (x = cb->x0, coeff1 = coeff0;
-	     x < cb->x1;
-	     ++x, ++coeff1) {
-	  y1 = 0;
-	  if (y0 + 3 < cb->y1 &&
-	      !(coeff1->flags & jpxCoeffTouched) &&
-	      !(coeff1[tileComp->cbW].flags & jpxCoeffTouched) &&
-	      !(coeff1[2 * tileComp->cbW].flags & jpxCoeffTouched) &&
-	      !(coeff1[3 * tileComp->cbW].flags & jpxCoeffTouched) &&
-	      (x == cb->x0 || y0 == cb->y0 ||
-	       !(coeff1[-(int)tileComp->cbW - 1].flags
-		 & jpxCoeffSignificant)) &&
-	      (y0 == cb->y0 ||
-	       !(coeff1[-(int)tileComp->cbW].flags
-		 & jpxCoeffSignificant)) &&
-	      (x == cb->x1 - 1 || y0 == cb->y0 ||
-	       !(coeff1[-(int)tileComp->cbW + 1].flags
-		 & jpxCoeffSignificant)) &&
-	      (x == cb->x0 ||
-	       (!(coeff1[-1].flags & jpxCoeffSignificant) &&
-		!(coeff1[tileComp->cbW - 1].flags
-		  & jpxCoeffSignificant) &&
-		!(coeff1[2 * tileComp->cbW - 1].flags
-		  & jpxCoeffSignificant) && 
-		!(coeff1[3 * tileComp->cbW - 1].flags
-		  & jpxCoeffSignificant))) &&
-	      (x == cb->x1 - 1 ||
-	       (!(coeff1[1].flags & jpxCoeffSignificant) &&
-		!(coeff1[tileComp->cbW + 1].flags
-		  & jpxCoeffSignificant) &&
-		!(coeff1[2 * tileComp->cbW + 1].flags
-		  & jpxCoeffSignificant) &&
-		!(coeff1[3 * tileComp->cbW + 1].flags
-		  & jpxCoeffSignificant))) &&
-	      (x == cb->x0 || y0+4 == cb->y1 ||
-	       !(coeff1[4 * tileComp->cbW - 1].flags & jpxCoeffSignificant)) &&
-	      (y0+4 == cb->y1 ||
-	       !(coeff1[4 * tileComp->cbW].flags & jpxCoeffSignificant)) &&
-	      (x == cb->x1 - 1 || y0+4 == cb->y1 ||
-	       !(coeff1[4 * tileComp->cbW + 1].flags
-		 & jpxCoeffSignificant))) {
-	    if (cb->arithDecoder->decodeBit(jpxContextRunLength, cb->stats)) {
-	      y1 = cb->arithDecoder->decodeBit(jpxContextUniform, cb->stats);
-	      y1 = (y1 << 1) |
-		   cb->arithDecoder->decodeBit(jpxContextUniform, cb->stats);
-	      for (y2 = 0, coeff = coeff1;
-		   y2 < y1;
-		   ++y2, coeff += tileComp->cbW) {
-		++coeff->len;
-	      }
-	      coeff->flags |= jpxCoeffSignificant | jpxCoeffFirstMagRef;
-	      coeff->mag = (coeff->mag << 1) | 1;
-	      ++coeff->len;
-	      cx = signContext[2][2][0];
-	      xorBit = signContext[2][2][1];
-	      if (cb->arithDecoder->decodeBit(cx, cb->stats) ^ xorBit) {
-		coeff->flags |= jpxCoeffSign;
-	      }
-	      ++y1;
-	    } else {
-	      for (y1 = 0, coeff = coeff1;
-		   y1 < 4;
-		   ++y1, coeff += tileComp->cbW) {
+      //----- magnitude refinement pass
+      case jpxPassMagRef:
+	for (y0 = cb->y0, coeff0 = cb->coeffs;
+	     y0 < cb->y1;
+	     y0 += 4, coeff0 += 4 << tileComp->codeBlockW) {
+	  for (x = cb->x0, coeff1 = coeff0;
+	       x < cb->x1;
+	       ++x, ++coeff1) {
+	    for (y1 = 0, coeff = coeff1;
+		 y1 < 4 && y0+y1 < cb->y1;
+		 ++y1, coeff += tileComp->cbW) {
+	      if ((coeff->flags & jpxCoeffSignificant) &&
+		  !(coeff->flags & jpxCoeffTouched)) {
+		if (coeff->flags & jpxCoeffFirstMagRef) {
+		  all = 0;
+		  if (x > cb->x0) {
+		    all += (coeff[-1].flags >> jpxCoeffSignificantB) & 1;
+		    if (y0+y1 > cb->y0) {
+		      all += (coeff[-(int)tileComp->cbW - 1].flags
+			      >> jpxCoeffSignificantB) & 1;
+		    }
+		    if (y0+y1 < cb->y1 - 1) {
+		      all += (coeff[tileComp->cbW - 1].flags
+			      >> jpxCoeffSignificantB) & 1;
+		    }
+		  }
+		  if (x < cb->x1 - 1) {
+		    all += (coeff[1].flags >> jpxCoeffSignificantB) & 1;
+		    if (y0+y1 > cb->y0) {
+		      all += (coeff[-(int)tileComp->cbW + 1].flags
+			      >> jpxCoeffSignificantB) & 1;
+		    }
+		    if (y0+y1 < cb->y1 - 1) {
+		      all += (coeff[tileComp->cbW + 1].flags
+			      >> jpxCoeffSignificantB) & 1;
+		    }
+		  }
+		  if (y0+y1 > cb->y0) {
+		    all += (coeff[-(int)tileComp->cbW].flags
+			    >> jpxCoeffSignificantB) & 1;
+		  }
+		  if (y0+y1 < cb->y1 - 1) {
+		    all += (coeff[tileComp->cbW].flags
+			    >> jpxCoeffSignificantB) & 1;
+		  }
+		  cx = all ? 15 : 14;
+		} else {
+		  cx = 16;
+		}
+		coeff->mag = (coeff->mag << 1) |
+			     arithDecoder->decodeBit(cx, stats);
 		++coeff->len;
+		coeff->flags |= jpxCoeffTouched;
+		coeff->flags &= ~jpxCoeffFirstMagRef;
 	      }
-	      y1 = 4;
 	    }
 	  }
-	  for (coeff = &coeff1[y1 << tileComp->codeBlockW];
-	       y1 < 4 && y0 + y1 < cb->y1;
-	       ++y1, coeff += tileComp->cbW) {
-	    if (!(coeff->flags & jpxCoeffTouched)) {
-	      horiz = vert = diag = 0;
-	      horizSign = vertSign = 2;
-	      if (x > cb->x0) {
-		if (coeff[-1].flags & jpxCoeffSignificant) {
-		  ++horiz;
-		  horizSign += (coeff[-1].flags & jpxCoeffSign) ? -1 : 1;
+	}
+	++cb->nextPass;
+	break;
+
+      //----- cleanup pass
+      case jpxPassCleanup:
+	for (y0 = cb->y0, coeff0 = cb->coeffs;
+	     y0 < cb->y1;
+	     y0 += 4, coeff0 += 4 << tileComp->codeBlockW) {
+	  for (x = cb->x0, coeff1 = coeff0;
+	       x < cb->x1;
+	       ++x, ++coeff1) {
+	    y1 = 0;
+	    if (y0 + 3 < cb->y1 &&
+		!(coeff1->flags & jpxCoeffTouched) &&
+		!(coeff1[tileComp->cbW].flags & jpxCoeffTouched) &&
+		!(coeff1[2 * tileComp->cbW].flags & jpxCoeffTouched) &&
+		!(coeff1[3 * tileComp->cbW].flags & jpxCoeffTouched) &&
+		(x == cb->x0 || y0 == cb->y0 ||
+		 !(coeff1[-(int)tileComp->cbW - 1].flags
+		   & jpxCoeffSignificant)) &&
+		(y0 == cb->y0 ||
+		 !(coeff1[-(int)tileComp->cbW].flags
+		   & jpxCoeffSignificant)) &&
+		(x == cb->x1 - 1 || y0 == cb->y0 ||
+		 !(coeff1[-(int)tileComp->cbW + 1].flags
+		   & jpxCoeffSignificant)) &&
+		(x == cb->x0 ||
+		 (!(coeff1[-1].flags & jpxCoeffSignificant) &&
+		  !(coeff1[tileComp->cbW - 1].flags
+		    & jpxCoeffSignificant) &&
+		  !(coeff1[2 * tileComp->cbW - 1].flags
+		    & jpxCoeffSignificant) && 
+		  !(coeff1[3 * tileComp->cbW - 1].flags
+		    & jpxCoeffSignificant))) &&
+		(x == cb->x1 - 1 ||
+		 (!(coeff1[1].flags & jpxCoeffSignificant) &&
+		  !(coeff1[tileComp->cbW + 1].flags
+		    & jpxCoeffSignificant) &&
+		  !(coeff1[2 * tileComp->cbW + 1].flags
+		    & jpxCoeffSignificant) &&
+		  !(coeff1[3 * tileComp->cbW + 1].flags
+		    & jpxCoeffSignificant))) &&
+		(x == cb->x0 || y0+4 == cb->y1 ||
+		 !(coeff1[4 * tileComp->cbW - 1].flags
+		   & jpxCoeffSignificant)) &&
+		(y0+4 == cb->y1 ||
+		 !(coeff1[4 * tileComp->cbW].flags & jpxCoeffSignificant)) &&
+		(x == cb->x1 - 1 || y0+4 == cb->y1 ||
+		 !(coeff1[4 * tileComp->cbW + 1].flags
+		   & jpxCoeffSignificant))) {
+	      if (arithDecoder->decodeBit(jpxContextRunLength, stats)) {
+		y1 = arithDecoder->decodeBit(jpxContextUniform, stats);
+		y1 = (y1 << 1) |
+		     arithDecoder->decodeBit(jpxContextUniform, stats);
+		for (y2 = 0, coeff = coeff1;
+		     y2 < y1;
+		     ++y2, coeff += tileComp->cbW) {
+		  ++coeff->len;
 		}
-		if (y0+y1 > cb->y0) {
-		  diag += (coeff[-(int)tileComp->cbW - 1].flags
-			   >> jpxCoeffSignificantB) & 1;
+		coeff->flags |= jpxCoeffSignificant | jpxCoeffFirstMagRef;
+		coeff->mag = (coeff->mag << 1) | 1;
+		++coeff->len;
+		cx = signContext[2][2][0];
+		xorBit = signContext[2][2][1];
+		if (arithDecoder->decodeBit(cx, stats) ^ xorBit) {
+		  coeff->flags |= jpxCoeffSign;
 		}
-		if (y0+y1 < cb->y1 - 1) {
-		  diag += (coeff[tileComp->cbW - 1].flags
-			   >> jpxCoeffSignificantB) & 1;
+		++y1;
+	      } else {
+		for (y1 = 0, coeff = coeff1;
+		     y1 < 4;
+		     ++y1, coeff += tileComp->cbW) {
+		  ++coeff->len;
 		}
+		y1 = 4;
 	      }
-	      if (x < cb->x1 - 1) {
-		if (coeff[1].flags & jpxCoeffSignificant) {
-		  ++horiz;
-		  horizSign += (coeff[1].flags & jpxCoeffSign) ? -1 : 1;
+	    }
+	    for (coeff = &coeff1[y1 << tileComp->codeBlockW];
+		 y1 < 4 && y0 + y1 < cb->y1;
+		 ++y1, coeff += tileComp->cbW) {
+	      if (!(coeff->flags & jpxCoeffTouched)) {
+		horiz = vert = diag = 0;
+		horizSign = vertSign = 2;
+		if (x > cb->x0) {
+		  if (coeff[-1].flags & jpxCoeffSignificant) {
+		    ++horiz;
+		    horizSign += (coeff[-1].flags & jpxCoeffSign) ? -1 : 1;
+		  }
+		  if (y0+y1 > cb->y0) {
+		    diag += (coeff[-(int)tileComp->cbW - 1].flags
+			     >> jpxCoeffSignificantB) & 1;
+		  }
+		  if (y0+y1 < cb->y1 - 1) {
+		    diag += (coeff[tileComp->cbW - 1].flags
+			     >> jpxCoeffSignificantB) & 1;
+		  }
+		}
+		if (x < cb->x1 - 1) {
+		  if (coeff[1].flags & jpxCoeffSignificant) {
+		    ++horiz;
+		    horizSign += (coeff[1].flags & jpxCoeffSign) ? -1 : 1;
+		  }
+		  if (y0+y1 > cb->y0) {
+		    diag += (coeff[-(int)tileComp->cbW + 1].flags
+			     >> jpxCoeffSignificantB) & 1;
+		  }
+		  if (y0+y1 < cb->y1 - 1) {
+		    diag += (coeff[tileComp->cbW + 1].flags
+			     >> jpxCoeffSignificantB) & 1;
+		  }
 		}
 		if (y0+y1 > cb->y0) {
-		  diag += (coeff[-(int)tileComp->cbW + 1].flags
-			   >> jpxCoeffSignificantB) & 1;
+		  if (coeff[-(int)tileComp->cbW].flags & jpxCoeffSignificant) {
+		    ++vert;
+		    vertSign +=
+			(coeff[-(int)tileComp->cbW].flags & jpxCoeffSign)
+			? -1 : 1;
+		  }
 		}
 		if (y0+y1 < cb->y1 - 1) {
-		  diag += (coeff[tileComp->cbW + 1].flags
-			   >> jpxCoeffSignificantB) & 1;
-		}
-	      }
-	      if (y0+y1 > cb->y0) {
-		if (coeff[-(int)tileComp->cbW].flags & jpxCoeffSignificant) {
-		  ++vert;
-		  vertSign += (coeff[-(int)tileComp->cbW].flags & jpxCoeffSign)
-		              ? -1 : 1;
-		}
-	      }
-	      if (y0+y1 < cb->y1 - 1) {
-		if (coeff[tileComp->cbW].flags & jpxCoeffSignificant) {
-		  ++vert;
-		  vertSign += (coeff[tileComp->cbW].flags & jpxCoeffSign)
-		              ? -1 : 1;
+		  if (coeff[tileComp->cbW].flags & jpxCoeffSignificant) {
+		    ++vert;
+		    vertSign += (coeff[tileComp->cbW].flags & jpxCoeffSign)
+				? -1 : 1;
+		  }
 		}
-	      }
-	      cx = sigPropContext[horiz][vert][diag][res == 0 ? 1 : sb];
-	      if (cb->arithDecoder->decodeBit(cx, cb->stats)) {
-		coeff->flags |= jpxCoeffSignificant | jpxCoeffFirstMagRef;
-		coeff->mag = (coeff->mag << 1) | 1;
-		cx = signContext[horizSign][vertSign][0];
-		xorBit = signContext[horizSign][vertSign][1];
-		if (cb->arithDecoder->decodeBit(cx, cb->stats) ^ xorBit) {
-		  coeff->flags |= jpxCoeffSign;
+		cx = sigPropContext[horiz][vert][diag][res == 0 ? 1 : sb];
+		if (arithDecoder->decodeBit(cx, stats)) {
+		  coeff->flags |= jpxCoeffSignificant | jpxCoeffFirstMagRef;
+		  coeff->mag = (coeff->mag << 1) | 1;
+		  cx = signContext[horizSign][vertSign][0];
+		  xorBit = signContext[horizSign][vertSign][1];
+		  if (arithDecoder->decodeBit(cx, stats) ^ xorBit) {
+		    coeff->flags |= jpxCoeffSign;
+		  }
 		}
+		++coeff->len;
+	      } else {
+		coeff->flags &= ~jpxCoeffTouched;
 	      }
-	      ++coeff->len;
-	    } else {
-	      coeff->flags &= ~jpxCoeffTouched;
 	    }
 	  }
 	}
+	cb->nextPass = jpxPassSigProp;
+	break;
       }
-      cb->nextPass = jpxPassSigProp;
-      break;
     }
+
+    arithDecoder->cleanup();
   }
 
-  cb->arithDecoder->cleanup();
-  return gTrue;
+  delete stats;
+  delete arithDecoder;
+  delete segStr;
 }
 
 // Inverse quantization, and wavelet transform (IDWT).  This also does
-// the initial shift to convert to fixed point format.
-void JPXStream::inverseTransform(JPXTileComp *tileComp) {
+// the initial shift to convert to fixed point format.  The last
+// <reduction> levels are skipped, leaving a reduced-resolution
+// image.
+void JPXStream::inverseTransform(JPXTileComp *tileComp, Guint reduction) {
   JPXResLevel *resLevel;
   JPXPrecinct *precinct;
   JPXSubband *subband;
@@ -2427,8 +2791,7 @@ void JPXStream::inverseTransform(JPXTileComp *tileComp) {
       for (y = cb->y0, coeff0 = cb->coeffs;
 	   y < cb->y1;
 	   ++y, coeff0 += tileComp->cbW) {
-	dataPtr = &tileComp->data[(y - subband->y0)
-				  * (tileComp->x1 - tileComp->x0)
+	dataPtr = &tileComp->data[(y - subband->y0) * tileComp->w
 				  + (cb->x0 - subband->x0)];
 	for (x = cb->x0, coeff = coeff0; x < cb->x1; ++x, ++coeff) {
 	  val = (int)coeff->mag;
@@ -2457,9 +2820,9 @@ void JPXStream::inverseTransform(JPXTileComp *tileComp) {
     }
   }
 
-  //----- IDWT for each level
+  //----- IDWT for each level (except for the skipped levels)
 
-  for (r = 1; r <= tileComp->nDecompLevels; ++r) {
+  for (r = 1; r <= tileComp->nDecompLevels - reduction; ++r) {
     resLevel = &tileComp->resLevels[r];
 
     // (n)LL is already in the upper-left corner of the
@@ -2507,9 +2870,8 @@ void JPXStream::inverseTransformLevel(JPXTileComp *tileComp,
   // spread out LL
   for (yy = resLevel->y1 - 1; yy >= (int)resLevel->y0; --yy) {
     for (xx = resLevel->x1 - 1; xx >= (int)resLevel->x0; --xx) {
-      tileComp->data[(2 * yy - ny0) * (tileComp->x1 - tileComp->x0)
-		     + (2 * xx - nx0)] =
-	  tileComp->data[(yy - resLevel->y0) * (tileComp->x1 - tileComp->x0)
+      tileComp->data[(2 * yy - ny0) * tileComp->w + (2 * xx - nx0)] =
+	  tileComp->data[(yy - resLevel->y0) * tileComp->w
 			 + (xx - resLevel->x0)];
     }
   }
@@ -2550,8 +2912,7 @@ void JPXStream::inverseTransformLevel(JPXTileComp *tileComp,
 	for (y = cb->y0, coeff0 = cb->coeffs;
 	     y < cb->y1;
 	     ++y, coeff0 += tileComp->cbW) {
-	  dataPtr = &tileComp->data[(2 * y + yo - ny0)
-				    * (tileComp->x1 - tileComp->x0)
+	  dataPtr = &tileComp->data[(2 * y + yo - ny0) * tileComp->w
 				    + (2 * cb->x0 + xo - nx0)];
 	  for (x = cb->x0, coeff = coeff0; x < cb->x1; ++x, ++coeff) {
 	    val = (int)coeff->mag;
@@ -2586,14 +2947,13 @@ void JPXStream::inverseTransformLevel(JPXTileComp *tileComp,
   dataPtr = tileComp->data;
   for (y = 0; y < ny1 - ny0; ++y) {
     inverseTransform1D(tileComp, dataPtr, 1, nx0, nx1);
-    dataPtr += tileComp->x1 - tileComp->x0;
+    dataPtr += tileComp->w;
   }
 
   //----- vertical (column) transforms
   dataPtr = tileComp->data;
   for (x = 0; x < nx1 - nx0; ++x) {
-    inverseTransform1D(tileComp, dataPtr,
-		       tileComp->x1 - tileComp->x0, ny0, ny1);
+    inverseTransform1D(tileComp, dataPtr, tileComp->w, ny0, ny1);
     ++dataPtr;
   }
 }
@@ -2722,8 +3082,8 @@ GBool JPXStream::inverseMultiCompAndDC(JPXTile *tile) {
     // inverse irreversible multiple component transform
     if (tile->tileComps[0].transform == 0) {
       j = 0;
-      for (y = 0; y < tile->tileComps[0].y1 - tile->tileComps[0].y0; ++y) {
-	for (x = 0; x < tile->tileComps[0].x1 - tile->tileComps[0].x0; ++x) {
+      for (y = 0; y < tile->tileComps[0].h; ++y) {
+	for (x = 0; x < tile->tileComps[0].w; ++x) {
 	  d0 = tile->tileComps[0].data[j];
 	  d1 = tile->tileComps[1].data[j];
 	  d2 = tile->tileComps[2].data[j];
@@ -2738,8 +3098,8 @@ GBool JPXStream::inverseMultiCompAndDC(JPXTile *tile) {
     // inverse reversible multiple component transform
     } else {
       j = 0;
-      for (y = 0; y < tile->tileComps[0].y1 - tile->tileComps[0].y0; ++y) {
-	for (x = 0; x < tile->tileComps[0].x1 - tile->tileComps[0].x0; ++x) {
+      for (y = 0; y < tile->tileComps[0].h; ++y) {
+	for (x = 0; x < tile->tileComps[0].w; ++x) {
 	  d0 = tile->tileComps[0].data[j];
 	  d1 = tile->tileComps[1].data[j];
 	  d2 = tile->tileComps[2].data[j];
@@ -2761,8 +3121,8 @@ GBool JPXStream::inverseMultiCompAndDC(JPXTile *tile) {
       minVal = -(1 << (tileComp->prec - 1));
       maxVal = (1 << (tileComp->prec - 1)) - 1;
       dataPtr = tileComp->data;
-      for (y = 0; y < tileComp->y1 - tileComp->y0; ++y) {
-	for (x = 0; x < tileComp->x1 - tileComp->x0; ++x) {
+      for (y = 0; y < tileComp->h; ++y) {
+	for (x = 0; x < tileComp->w; ++x) {
 	  coeff = *dataPtr;
 	  if (tileComp->transform == 0) {
 	    coeff >>= fracBits;
@@ -2781,8 +3141,8 @@ GBool JPXStream::inverseMultiCompAndDC(JPXTile *tile) {
       maxVal = (1 << tileComp->prec) - 1;
       zeroVal = 1 << (tileComp->prec - 1);
       dataPtr = tileComp->data;
-      for (y = 0; y < tileComp->y1 - tileComp->y0; ++y) {
-	for (x = 0; x < tileComp->x1 - tileComp->x0; ++x) {
+      for (y = 0; y < tileComp->h; ++y) {
+	for (x = 0; x < tileComp->w; ++x) {
 	  coeff = *dataPtr;
 	  if (tileComp->transform == 0) {
 	    coeff >>= fracBits;
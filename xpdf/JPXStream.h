@@ -19,8 +19,19 @@
 #include "Object.h"
 #include "Stream.h"
 
+class JArithmeticDecoder;
 class JArithmeticDecoderStats;
 
+// The JPX decode threads use pthreads directly (GMutex has no threads
+// or condition variables), so they are only built on non-Windows
+// multithreaded builds.  Elsewhere the jobs all run on the calling
+// thread.
+#if MULTITHREADED && !defined(WIN32)
+#define JPX_POOL 1
+#else
+#define JPX_POOL 0
+#endif
+
 //------------------------------------------------------------------------
 
 enum JPXColorSpaceType {
@@ -118,6 +129,14 @@ struct JPXCoeff {
 
 //------------------------------------------------------------------------
 
+// The coded data for a code-block can be split across several
+// packets (layers).  It is collected as the packets are read, and
+// decoded once the whole codestream has been read.
+struct JPXCodeBlockSeg {
+  Guint dataLen;		// length of the data from one packet
+  Guint nCodingPasses;		// number of coding passes in it
+};
+
 struct JPXCodeBlock {
   //----- size
   Guint x0, y0, x1, y1;		// bounds
@@ -137,12 +156,16 @@ struct JPXCodeBlock {
   Guint nCodingPasses;		// number of coding passes in this pkt
   Guint dataLen;		// pkt data length
 
+  //----- coded data, from all packets read so far
+  Guchar *segData;		// the coded data
+  Guint segDataLen;		// number of bytes in segData
+  Guint segDataSize;		// allocated size of segData
+  JPXCodeBlockSeg *segs;	// the pieces of segData from each packet
+  Guint nSegs;			// number of entries in segs
+  Guint segsSize;		// allocated size of segs
+
   //----- coefficient data
   JPXCoeff *coeffs;		// the coefficients
-  JArithmeticDecoder		// arithmetic decoder
-    *arithDecoder;
-  JArithmeticDecoderStats	// arithmetic decoder stats
-    *stats;
 };
 
 //------------------------------------------------------------------------
@@ -213,11 +236,14 @@ struct JPXTileComp {
 
   //----- computed
   Guint x0, y0, x1, y1;		// bounds of the tile-comp, in ref coords
+  Guint w, h;			// size of the data array (at the reduced
+				//   resolution)
   Guint cbW;			// code-block width
   Guint cbH;			// code-block height
 
   //----- image data
-  int *data;			// the decoded image data
+  int *data;			// the decoded image data (NULL if the
+				//   tile isn't decoded)
   int *buf;			// intermediate buffer for the inverse
 				//   transform
 
@@ -238,6 +264,9 @@ struct JPXTile {
   Guint x0, y0, x1, y1;		// bounds of the tile, in ref coords
   Guint maxNDecompLevels;	// max number of decomposition levels used
 				//   in any component in this tile
+  GBool visible;		// set if the tile intersects the region
+				//   being decoded
+  Guint reduction;		// number of resolution levels skipped
 
   //----- progression order loop counters
   Guint comp;			//   component
@@ -264,12 +293,28 @@ struct JPXImage {
   Guint nXTiles;		// number of tiles in x direction
   Guint nYTiles;		// number of tiles in y direction
 
+  //----- set by the caller
+  Guint reduction;		// log2(reduction in resolution)
+  Guint regionX0, regionY0,	// region to decode, in image pixels
+        regionX1, regionY1;	//   (relative to the image offset)
+
   //----- children
   JPXTile *tiles;		// the tiles (len = nXTiles * nYTiles)
 };
 
 //------------------------------------------------------------------------
 
+// A code-block to be decoded, with the context needed to decode it.
+struct JPXCodeBlockJob {
+  JPXTileComp *tileComp;
+  Guint res, sb;
+  JPXCodeBlock *cb;
+};
+
+struct JPXWorkQueue;
+
+//------------------------------------------------------------------------
+
 class JPXStream: public FilterStream {
 public:
 
@@ -284,6 +329,23 @@ public:
   virtual void getImageParams(int *bitsPerComponent,
 			      StreamColorSpaceMode *csMode);
 
+  // Decode the image at 1/<reductionA> of its size (a power of 2) by
+  // skipping the highest resolution levels.  Any reduction beyond the
+  // number of levels in the codestream is done by dropping samples.
+  // Must be called before reset().
+  void setReduction(int reductionA);
+
+  // Only decode the tiles which intersect the rectangle
+  // (<x0>,<y0>)-(<x1>,<y1>), in full-size image pixels.  Samples in
+  // the other tiles are returned as zero.  Must be called before
+  // reset().
+  void setRegion(int x0, int y0, int x1, int y1);
+
+  // Stop and join the decode threads, if the pool is idle.  Called by
+  // the GlobalParams destructor.  The next decode that needs threads
+  // starts them again.
+  static void shutdownPool();
+
 private:
 
   void fillReadBuf();
@@ -294,13 +356,18 @@ private:
   GBool readTilePart();
   GBool readTilePartData(Guint tileIdx,
 			 Guint tilePartLen, GBool tilePartToEOC);
-  GBool readCodeBlockData(JPXTileComp *tileComp,
-			  JPXResLevel *resLevel,
-			  JPXPrecinct *precinct,
-			  JPXSubband *subband,
-			  Guint res, Guint sb,
-			  JPXCodeBlock *cb);
-  void inverseTransform(JPXTileComp *tileComp);
+  GBool readCodeBlockData(JPXCodeBlock *cb);
+  GBool decodeImage();
+  GBool runJobs(int phase, int nJobs);
+#if JPX_POOL
+  static void stopWorkers(int nWorkers);
+  static void runQueue(JPXWorkQueue *queue);
+  static void *workerThread(void *arg);
+#endif
+  GBool runJob(int phase, int job);
+  void decodeCodeBlock(JPXTileComp *tileComp, Guint res, Guint sb,
+		       JPXCodeBlock *cb);
+  void inverseTransform(JPXTileComp *tileComp, Guint reduction);
   void inverseTransformLevel(JPXTileComp *tileComp,
 			     Guint r, JPXResLevel *resLevel,
 			     Guint nx0, Guint ny0,
@@ -334,6 +401,8 @@ private:
   GBool haveChannelDefn;	// set if a channel defn has been found
 
   JPXImage img;			// JPEG2000 decoder data
+  JPXCodeBlockJob *cbJobs;	// code-blocks to decode (set up by
+				//   decodeImage)
   Guint bitBuf;			// buffer for bit reads
   int bitBufLen;		// number of bits in bitBuf
   GBool bitBufSkip;		// true if next bit should be skipped
@@ -19,6 +19,32 @@
 #include "Error.h"
 #include "Stream.h"
 #include "XRef.h"
+#include "lock.h"
+#include "pool.h"
+
+//------------------------------------------------------------------------
+// name and command strings
+//------------------------------------------------------------------------
+
+// size of the pool slots, including the terminating null
+#define objStringSize 32
+
+static ObjectPool::Pool<ObjectPool::LockPolicy>
+  objStringPool(objStringSize, OP_DEF_CHUNK_SIZE, "Object strings");
+
+char *copyObjString(char *s) {
+  int n;
+  char *s1;
+
+  n = strlen(s) + 1;
+  s1 = (char *)objStringPool.allocate(n);
+  memcpy(s1, s, n);
+  return s1;
+}
+
+void freeObjString(char *s) {
+  objStringPool.release(s, strlen(s) + 1);
+}
 
 //------------------------------------------------------------------------
 // Object
@@ -78,7 +104,7 @@ Object *Object::copy(Object *obj) {
     obj->string = string->copy();
     break;
   case objName:
-    obj->name = copyString(name);
+    obj->name = copyObjString(name);
     break;
   case objArray:
     array->incRef();
@@ -90,7 +116,7 @@ Object *Object::copy(Object *obj) {
     stream->incRef();
     break;
   case objCmd:
-    obj->cmd = copyString(cmd);
+    obj->cmd = copyObjString(cmd);
     break;
   default:
     break;
@@ -112,7 +138,7 @@ void Object::free() {
     delete string;
     break;
   case objName:
-    gfree(name);
+    freeObjString(name);
     break;
   case objArray:
     if (!array->decRef()) {
@@ -130,7 +156,7 @@ void Object::free() {
     }
     break;
   case objCmd:
-    gfree(cmd);
+    freeObjString(cmd);
     break;
   default:
     break;
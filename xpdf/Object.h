@@ -35,6 +35,15 @@ struct Ref {
   int gen;			// generation number
 };
 
+//------------------------------------------------------------------------
+// name and command strings
+//------------------------------------------------------------------------
+
+// Names and commands are short and are parsed in large numbers, so they
+// are allocated from a pool; longer strings go to the heap.
+extern char *copyObjString(char *s);
+extern void freeObjString(char *s);
+
 //------------------------------------------------------------------------
 // object types
 //------------------------------------------------------------------------
@@ -90,7 +99,7 @@ public:
   Object *initString(GString *stringA)
     { initObj(objString); string = stringA; return this; }
   Object *initName(char *nameA)
-    { initObj(objName); name = copyString(nameA); return this; }
+    { initObj(objName); name = copyObjString(nameA); return this; }
   Object *initNull()
     { initObj(objNull); return this; }
   Object *initArray(XRef *xref);
@@ -100,7 +109,7 @@ public:
   Object *initRef(int numA, int genA)
     { initObj(objRef); ref.num = numA; ref.gen = genA; return this; }
   Object *initCmd(char *cmdA)
-    { initObj(objCmd); cmd = copyString(cmdA); return this; }
+    { initObj(objCmd); cmd = copyObjString(cmdA); return this; }
   Object *initError()
     { initObj(objError); return this; }
   Object *initEOF()
@@ -188,6 +197,7 @@ public:
   int streamGetChar();
   int streamLookChar();
   char *streamGetLine(char *buf, int size);
+  int streamGetBlock(char *blk, int size);
   Guint streamGetPos();
   void streamSetPos(Guint pos, int dir = 0);
   Dict *streamGetDict();
@@ -308,6 +318,9 @@ inline int Object::streamLookChar()
 inline char *Object::streamGetLine(char *buf, int size)
   { return stream->getLine(buf, size); }
 
+inline int Object::streamGetBlock(char *blk, int size)
+  { return stream->getBlock(blk, size); }
+
 inline Guint Object::streamGetPos()
   { return stream->getPos(); }
 
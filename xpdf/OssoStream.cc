@@ -25,6 +25,7 @@
 
 #include <aconf.h>
 
+#include <string.h>
 #include "OssoStream.h"
 #include "gtk-switch.h"
 #include <gtk/gtk.h>
@@ -131,6 +132,25 @@ GBool OssoStream::fillBuff() {
   return gTrue;
 }
 
+int OssoStream::getBlock(char *blk, int size) {
+  int n, m;
+
+  n = 0;
+  while (n < size) {
+    if (buffPtr >= buffEnd && !fillBuff()) {
+      break;
+    }
+    m = (int)(buffEnd - buffPtr);
+    if (m > size - n) {
+      m = size - n;
+    }
+    memcpy(blk + n, buffPtr, m);
+    buffPtr += m;
+    n += m;
+  }
+  return n;
+}
+
 void OssoStream::setPos(Guint pos, int dir) {
   GError *error = NULL;
   goffset offsetReturn;
@@ -48,6 +48,7 @@ public:
 	virtual void close();
 	virtual int getChar() { return (buffPtr >= buffEnd && !fillBuff()) ? EOF : (*buffPtr++ & 0xff); }
 	virtual int lookChar() { return (buffPtr >= buffEnd && !fillBuff()) ? EOF : (*buffPtr & 0xff); }
+	virtual int getBlock(char *blk, int size);
 	virtual int getPos() { return buffPos + (buffPtr - buff); }
 	virtual void setPos(Guint pos, int dir = 0);
 	virtual GBool isBinary(GBool last = gTrue) { return last; }
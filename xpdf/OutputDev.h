@@ -25,6 +25,8 @@ class GfxImageColorMap;
 class GfxFunctionShading;
 class GfxAxialShading;
 class GfxRadialShading;
+class GfxGouraudTriangleShading;
+class GfxPatchMeshShading;
 class Stream;
 class Link;
 class Catalog;
@@ -61,6 +63,11 @@ public:
   // will be reduced to a series of other drawing operations.
   virtual GBool useShadedFills() { return gFalse; }
 
+  // Does this device use gouraudTriangleShadedFill() and
+  // patchMeshShadedFill()?  If this returns false, mesh shadings will
+  // be reduced to a series of flat-colored fills.
+  virtual GBool useMeshShadedFills() { return gFalse; }
+
   // Does this device use beginType3Char/endType3Char?  Otherwise,
   // text in Type 3 fonts will be drawn with drawChar/drawString.
   virtual GBool interpretType3Chars() = 0;
@@ -142,6 +149,10 @@ public:
 				  GfxFunctionShading *shading) {}
   virtual void axialShadedFill(GfxState *state, GfxAxialShading *shading) {}
   virtual void radialShadedFill(GfxState *state, GfxRadialShading *shading) {}
+  virtual void gouraudTriangleShadedFill(GfxState *state,
+					 GfxGouraudTriangleShading *shading) {}
+  virtual void patchMeshShadedFill(GfxState *state,
+				   GfxPatchMeshShading *shading) {}
 
   //----- path clipping
   virtual void clip(GfxState *state) {}
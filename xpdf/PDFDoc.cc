@@ -21,6 +21,7 @@
 #  include <windows.h>
 #endif
 #include "GString.h"
+#include "pool.h"
 #include "config.h"
 #include "GlobalParams.h"
 #include "Page.h"
@@ -376,6 +377,9 @@ void PDFDoc::displayPageSlice(OutputDev *out, int page,
 		    sliceX, sliceY, sliceW, sliceH,
 		    NULL, catalog, abortCheckCbk, abortCheckCbkData);
   }
+
+  // return the chunks emptied by the page to the system
+  ObjectPool::trim();
 }
 
 Links *PDFDoc::takeLinks() {
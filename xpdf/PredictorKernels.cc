@@ -0,0 +1,587 @@
+//========================================================================
+//
+// PredictorKernels.cc
+//
+//========================================================================
+
+#include <aconf.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include <string.h>
+#include "PredictorKernels.h"
+
+// See SplashKernels.cc: the SSE2 code is compiled with a per-function
+// target attribute and selected at run time.  The NEON code is only
+// compiled when the compiler targets NEON (always true on AArch64, and
+// with -mfpu=neon on 32-bit ARM), so it needs no run-time check.
+// Other CPUs use the word versions.
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__)) && \
+    (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define PRED_SSE2 1
+#include <emmintrin.h>
+#define SSE2_FUNC __attribute__((target("sse2")))
+#define SSE2_INLINE __attribute__((target("sse2"), always_inline)) inline
+#else
+#define PRED_SSE2 0
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define PRED_NEON 1
+#include <arm_neon.h>
+#else
+#define PRED_NEON 0
+#endif
+
+//------------------------------------------------------------------------
+
+typedef void (*UndoSubFunc)(Guchar *line, int n, int pixBytes);
+typedef void (*UndoUpFunc)(Guchar *line, Guchar *prevLine, int n);
+typedef void (*UndoAverageFunc)(Guchar *line, Guchar *prevLine, int n,
+				int pixBytes);
+typedef void (*UndoPaethFunc)(Guchar *line, Guchar *prevLine, int n,
+			      int pixBytes);
+
+static void undoSubC(Guchar *line, int n, int pixBytes);
+static void undoUpC(Guchar *line, Guchar *prevLine, int n);
+static void undoAverageC(Guchar *line, Guchar *prevLine, int n,
+			 int pixBytes);
+static void undoPaethC(Guchar *line, Guchar *prevLine, int n,
+		       int pixBytes);
+
+static GBool kernelsInited = gFalse;
+static PredKernelsImpl kernelsImpl = predKernelsC;
+static UndoSubFunc undoSubFunc = &undoSubC;
+static UndoUpFunc undoUpFunc = &undoUpC;
+static UndoAverageFunc undoAverageFunc = &undoAverageC;
+static UndoPaethFunc undoPaethFunc = &undoPaethC;
+
+//------------------------------------------------------------------------
+// C versions
+//------------------------------------------------------------------------
+
+static void undoSubC(Guchar *line, int n, int pixBytes) {
+  int i;
+
+  for (i = 0; i < n; ++i) {
+    line[i] += line[i - pixBytes];
+  }
+}
+
+static void undoUpC(Guchar *line, Guchar *prevLine, int n) {
+  int i;
+
+  for (i = 0; i < n; ++i) {
+    line[i] += prevLine[i];
+  }
+}
+
+static void undoAverageC(Guchar *line, Guchar *prevLine, int n,
+			 int pixBytes) {
+  int i;
+
+  for (i = 0; i < n; ++i) {
+    line[i] += (line[i - pixBytes] + prevLine[i]) >> 1;
+  }
+}
+
+// With left = a, up = b, upLeft = c, and p = a + b - c, the distances
+// |p - a|, |p - b|, |p - c| are |b - c|, |a - c|, |a + b - 2c|.  They
+// are computed without branches; only the final choice is made with
+// conditional moves.
+static inline int paethPredictor(int a, int b, int c) {
+  int pa, pb, pc, m, pred;
+
+  pa = b - c;
+  pb = a - c;
+  pc = pa + pb;
+  m = pa >> 31;
+  pa = (pa ^ m) - m;
+  m = pb >> 31;
+  pb = (pb ^ m) - m;
+  m = pc >> 31;
+  pc = (pc ^ m) - m;
+  pred = (pb <= pc) ? b : c;
+  pred = (pa <= pb && pa <= pc) ? a : pred;
+  return pred;
+}
+
+static void undoPaethC(Guchar *line, Guchar *prevLine, int n,
+		       int pixBytes) {
+  int i;
+
+  for (i = 0; i < n; ++i) {
+    line[i] += (Guchar)paethPredictor(line[i - pixBytes], prevLine[i],
+				      prevLine[i - pixBytes]);
+  }
+}
+
+//------------------------------------------------------------------------
+// word versions
+//------------------------------------------------------------------------
+
+// Sub, Average, and Paeth add the decoded byte one pixel to the left,
+// which the C versions reload from the row, waiting each time for the
+// store just made.  These versions keep the left pixel in registers,
+// for the common pixel sizes.  Up, and Sub with 4-byte pixels, add
+// whole words, with the high bit of each byte added separately so that
+// no carries cross between bytes.  Loads and stores go through memcpy,
+// so alignment and byte order don't matter.
+
+typedef unsigned long KWord;
+
+#define kWordSize ((int)sizeof(KWord))
+
+// 0x7f7f7f...
+#define kWordLow7 (~(KWord)0 / 0xff * 0x7f)
+
+static inline KWord addBytesWord(KWord a, KWord b) {
+  return ((a & kWordLow7) + (b & kWordLow7)) ^ ((a ^ b) & ~kWordLow7);
+}
+
+static inline Guint addBytesGuint(Guint a, Guint b) {
+  return ((a & 0x7f7f7f7f) + (b & 0x7f7f7f7f)) ^ ((a ^ b) & 0x80808080);
+}
+
+static void undoSubWord(Guchar *line, int n, int pixBytes) {
+  Guint left, x;
+  int a0, a1, a2, i;
+
+  i = 0;
+  switch (pixBytes) {
+  case 1:
+    a0 = line[-1];
+    for (; i < n; ++i) {
+      a0 = (Guchar)(a0 + line[i]);
+      line[i] = (Guchar)a0;
+    }
+    break;
+  case 2:
+    a0 = line[-2];
+    a1 = line[-1];
+    for (; i + 2 <= n; i += 2) {
+      a0 = (Guchar)(a0 + line[i]);
+      a1 = (Guchar)(a1 + line[i+1]);
+      line[i] = (Guchar)a0;
+      line[i+1] = (Guchar)a1;
+    }
+    break;
+  case 3:
+    a0 = line[-3];
+    a1 = line[-2];
+    a2 = line[-1];
+    for (; i + 3 <= n; i += 3) {
+      a0 = (Guchar)(a0 + line[i]);
+      a1 = (Guchar)(a1 + line[i+1]);
+      a2 = (Guchar)(a2 + line[i+2]);
+      line[i] = (Guchar)a0;
+      line[i+1] = (Guchar)a1;
+      line[i+2] = (Guchar)a2;
+    }
+    break;
+  case 4:
+    memcpy(&left, line - 4, 4);
+    for (; i + 4 <= n; i += 4) {
+      memcpy(&x, line + i, 4);
+      left = addBytesGuint(left, x);
+      memcpy(line + i, &left, 4);
+    }
+    break;
+  }
+  undoSubC(line + i, n - i, pixBytes);
+}
+
+static void undoUpWord(Guchar *line, Guchar *prevLine, int n) {
+  KWord a, b;
+  int i;
+
+  for (i = 0; i + kWordSize <= n; i += kWordSize) {
+    memcpy(&a, line + i, kWordSize);
+    memcpy(&b, prevLine + i, kWordSize);
+    a = addBytesWord(a, b);
+    memcpy(line + i, &a, kWordSize);
+  }
+  undoUpC(line + i, prevLine + i, n - i);
+}
+
+static void undoAverageWord(Guchar *line, Guchar *prevLine, int n,
+			    int pixBytes) {
+  int a0, a1, a2, a3, i;
+
+  i = 0;
+  switch (pixBytes) {
+  case 1:
+    a0 = line[-1];
+    for (; i < n; ++i) {
+      a0 = (Guchar)(line[i] + ((a0 + prevLine[i]) >> 1));
+      line[i] = (Guchar)a0;
+    }
+    break;
+  case 3:
+    a0 = line[-3];
+    a1 = line[-2];
+    a2 = line[-1];
+    for (; i + 3 <= n; i += 3) {
+      a0 = (Guchar)(line[i] + ((a0 + prevLine[i]) >> 1));
+      a1 = (Guchar)(line[i+1] + ((a1 + prevLine[i+1]) >> 1));
+      a2 = (Guchar)(line[i+2] + ((a2 + prevLine[i+2]) >> 1));
+      line[i] = (Guchar)a0;
+      line[i+1] = (Guchar)a1;
+      line[i+2] = (Guchar)a2;
+    }
+    break;
+  case 4:
+    a0 = line[-4];
+    a1 = line[-3];
+    a2 = line[-2];
+    a3 = line[-1];
+    for (; i + 4 <= n; i += 4) {
+      a0 = (Guchar)(line[i] + ((a0 + prevLine[i]) >> 1));
+      a1 = (Guchar)(line[i+1] + ((a1 + prevLine[i+1]) >> 1));
+      a2 = (Guchar)(line[i+2] + ((a2 + prevLine[i+2]) >> 1));
+      a3 = (Guchar)(line[i+3] + ((a3 + prevLine[i+3]) >> 1));
+      line[i] = (Guchar)a0;
+      line[i+1] = (Guchar)a1;
+      line[i+2] = (Guchar)a2;
+      line[i+3] = (Guchar)a3;
+    }
+    break;
+  }
+  undoAverageC(line + i, prevLine + i, n - i, pixBytes);
+}
+
+// With 4-byte pixels, the twelve values carried from pixel to pixel
+// don't fit in the registers, so only 1- and 3-byte pixels are done
+// here.
+static void undoPaethWord(Guchar *line, Guchar *prevLine, int n,
+			  int pixBytes) {
+  int a0, a1, a2, b0, b1, b2, c0, c1, c2, i;
+
+  i = 0;
+  switch (pixBytes) {
+  case 1:
+    a0 = line[-1];
+    c0 = prevLine[-1];
+    for (; i < n; ++i) {
+      b0 = prevLine[i];
+      a0 = (Guchar)(line[i] + paethPredictor(a0, b0, c0));
+      line[i] = (Guchar)a0;
+      c0 = b0;
+    }
+    break;
+  case 3:
+    a0 = line[-3];
+    a1 = line[-2];
+    a2 = line[-1];
+    c0 = prevLine[-3];
+    c1 = prevLine[-2];
+    c2 = prevLine[-1];
+    for (; i + 3 <= n; i += 3) {
+      b0 = prevLine[i];
+      b1 = prevLine[i+1];
+      b2 = prevLine[i+2];
+      a0 = (Guchar)(line[i] + paethPredictor(a0, b0, c0));
+      a1 = (Guchar)(line[i+1] + paethPredictor(a1, b1, c1));
+      a2 = (Guchar)(line[i+2] + paethPredictor(a2, b2, c2));
+      line[i] = (Guchar)a0;
+      line[i+1] = (Guchar)a1;
+      line[i+2] = (Guchar)a2;
+      c0 = b0;
+      c1 = b1;
+      c2 = b2;
+    }
+    break;
+  }
+  undoPaethC(line + i, prevLine + i, n - i, pixBytes);
+}
+
+//------------------------------------------------------------------------
+// SSE2 versions
+//------------------------------------------------------------------------
+
+#if PRED_SSE2
+
+// Prefix sums of 16 bytes at a stride of <pixBytes> (1, 2, 4, or 8),
+// i.e., v[i] += v[i - pixBytes] + v[i - 2 * pixBytes] + ...
+SSE2_INLINE static __m128i prefixSum(__m128i v, int pixBytes) {
+  switch (pixBytes) {
+  case 1:
+    v = _mm_add_epi8(v, _mm_slli_si128(v, 1));
+    // fall through
+  case 2:
+    v = _mm_add_epi8(v, _mm_slli_si128(v, 2));
+    // fall through
+  case 4:
+    v = _mm_add_epi8(v, _mm_slli_si128(v, 4));
+    // fall through
+  default:
+    v = _mm_add_epi8(v, _mm_slli_si128(v, 8));
+  }
+  return v;
+}
+
+// The last pixel of <v> (<pixBytes> = 1, 2, 4, or 8 bytes), repeated
+// across all 16 bytes.
+SSE2_INLINE static __m128i lastPixel(__m128i v, int pixBytes) {
+  switch (pixBytes) {
+  case 1:
+    v = _mm_srli_si128(v, 15);
+    v = _mm_unpacklo_epi8(v, v);
+    v = _mm_shufflelo_epi16(v, 0x00);
+    return _mm_shuffle_epi32(v, 0x00);
+  case 2:
+    v = _mm_shufflehi_epi16(v, 0xff);
+    return _mm_shuffle_epi32(v, 0xff);
+  case 4:
+    return _mm_shuffle_epi32(v, 0xff);
+  default:
+    return _mm_shuffle_epi32(v, 0xee);
+  }
+}
+
+// Sub is a running sum along the row.  With pixBytes = 1, 2, 4, or 8,
+// each 16-byte block is prefix-summed in log steps, then the previous
+// block's last pixel is added.  With 3 or 6, 12-byte blocks are used
+// (so that they hold whole pixels), and the four bytes past the block
+// are written back unchanged.
+SSE2_FUNC static void undoSubSSE2(Guchar *line, int n, int pixBytes) {
+  __m128i v, carry, keep;
+  int i;
+
+  carry = _mm_setzero_si128();
+  i = 0;
+  if (pixBytes == 1 || pixBytes == 2 || pixBytes == 4 || pixBytes == 8) {
+    for (; i + 16 <= n; i += 16) {
+      v = _mm_loadu_si128((__m128i *)(line + i));
+      v = _mm_add_epi8(prefixSum(v, pixBytes), carry);
+      _mm_storeu_si128((__m128i *)(line + i), v);
+      carry = lastPixel(v, pixBytes);
+    }
+  } else if (pixBytes == 3 || pixBytes == 6) {
+    keep = _mm_set_epi32(-1, 0, 0, 0);
+    for (; i + 16 <= n; i += 12) {
+      v = _mm_loadu_si128((__m128i *)(line + i));
+      if (pixBytes == 3) {
+	v = _mm_add_epi8(v, _mm_slli_si128(v, 3));
+      }
+      v = _mm_add_epi8(v, _mm_slli_si128(v, 6));
+      v = _mm_add_epi8(v, carry);
+      _mm_storeu_si128((__m128i *)(line + i),
+		       _mm_or_si128(_mm_andnot_si128(keep, v),
+				    _mm_and_si128(keep,
+				      _mm_loadu_si128((__m128i *)
+						      (line + i)))));
+      // replicate the last pixel (bytes 12 - pixBytes .. 11) across
+      // bytes 0..11
+      if (pixBytes == 3) {
+	carry = _mm_srli_si128(v, 9);
+	carry = _mm_and_si128(carry, _mm_set_epi32(0, 0, 0, 0xffffff));
+	carry = _mm_or_si128(carry, _mm_slli_si128(carry, 3));
+      } else {
+	carry = _mm_srli_si128(v, 6);
+	carry = _mm_and_si128(carry, _mm_set_epi32(0, 0, 0xffff, -1));
+      }
+      carry = _mm_or_si128(carry, _mm_slli_si128(carry, 6));
+    }
+  }
+  undoSubC(line + i, n - i, pixBytes);
+}
+
+SSE2_FUNC static void undoUpSSE2(Guchar *line, Guchar *prevLine, int n) {
+  __m128i v;
+  int i;
+
+  for (i = 0; i + 16 <= n; i += 16) {
+    v = _mm_add_epi8(_mm_loadu_si128((__m128i *)(line + i)),
+		     _mm_loadu_si128((__m128i *)(prevLine + i)));
+    _mm_storeu_si128((__m128i *)(line + i), v);
+  }
+  undoUpC(line + i, prevLine + i, n - i);
+}
+
+#endif // PRED_SSE2
+
+//------------------------------------------------------------------------
+// NEON versions
+//------------------------------------------------------------------------
+
+#if PRED_NEON
+
+#ifdef __GNUC__
+#define NEON_INLINE __attribute__((always_inline)) inline
+#else
+#define NEON_INLINE inline
+#endif
+
+// Same as prefixSum in the SSE2 versions: prefix sums of 16 bytes at a
+// stride of <stride> (1, 2, 4, or 8).  vextq_u8(zero, v, 16 - k)
+// shifts v up by k bytes.
+static NEON_INLINE uint8x16_t prefixSumNEON(uint8x16_t v, int stride) {
+  uint8x16_t zero;
+
+  zero = vdupq_n_u8(0);
+  switch (stride) {
+  case 1:
+    v = vaddq_u8(v, vextq_u8(zero, v, 15));
+    // fall through
+  case 2:
+    v = vaddq_u8(v, vextq_u8(zero, v, 14));
+    // fall through
+  case 4:
+    v = vaddq_u8(v, vextq_u8(zero, v, 12));
+    // fall through
+  default:
+    v = vaddq_u8(v, vextq_u8(zero, v, 8));
+  }
+  return v;
+}
+
+// The last <stride> bytes of <v> (<stride> = 1, 2, 4, or 8), repeated
+// across all 16 bytes.
+static NEON_INLINE uint8x16_t lastPixelNEON(uint8x16_t v, int stride) {
+  switch (stride) {
+  case 1:
+    return vdupq_n_u8(vgetq_lane_u8(v, 15));
+  case 2:
+    return vreinterpretq_u8_u16(
+	     vdupq_n_u16(vgetq_lane_u16(vreinterpretq_u16_u8(v), 7)));
+  case 4:
+    return vreinterpretq_u8_u32(
+	     vdupq_n_u32(vgetq_lane_u32(vreinterpretq_u32_u8(v), 3)));
+  default:
+    return vcombine_u8(vget_high_u8(v), vget_high_u8(v));
+  }
+}
+
+// Sub with pixBytes = 1, 2, 4, or 8 is done as in the SSE2 version.
+// With 3 or 6, vld3q_u8 splits 48 bytes into three vectors of every
+// third byte, in which the byte one pixel to the left is 1 or 2 bytes
+// back, so each one is prefix-summed at that stride.
+static void undoSubNEON(Guchar *line, int n, int pixBytes) {
+  uint8x16x3_t v3;
+  uint8x16_t v, carry, carry3[3];
+  int stride, i, k;
+
+  i = 0;
+  if (pixBytes == 1 || pixBytes == 2 || pixBytes == 4 || pixBytes == 8) {
+    carry = vdupq_n_u8(0);
+    for (; i + 16 <= n; i += 16) {
+      v = vld1q_u8(line + i);
+      v = vaddq_u8(prefixSumNEON(v, pixBytes), carry);
+      vst1q_u8(line + i, v);
+      carry = lastPixelNEON(v, pixBytes);
+    }
+  } else if (pixBytes == 3 || pixBytes == 6) {
+    stride = pixBytes / 3;
+    carry3[0] = carry3[1] = carry3[2] = vdupq_n_u8(0);
+    for (; i + 48 <= n; i += 48) {
+      v3 = vld3q_u8(line + i);
+      for (k = 0; k < 3; ++k) {
+	v3.val[k] = vaddq_u8(prefixSumNEON(v3.val[k], stride), carry3[k]);
+	carry3[k] = lastPixelNEON(v3.val[k], stride);
+      }
+      vst3q_u8(line + i, v3);
+    }
+  }
+  undoSubC(line + i, n - i, pixBytes);
+}
+
+static void undoUpNEON(Guchar *line, Guchar *prevLine, int n) {
+  int i;
+
+  for (i = 0; i + 16 <= n; i += 16) {
+    vst1q_u8(line + i, vaddq_u8(vld1q_u8(line + i), vld1q_u8(prevLine + i)));
+  }
+  undoUpC(line + i, prevLine + i, n - i);
+}
+
+#endif // PRED_NEON
+
+//------------------------------------------------------------------------
+// dispatch
+//------------------------------------------------------------------------
+
+static void initKernels() {
+  predSetKernelsImpl(predKernelsWord);
+#if PRED_SSE2
+  predSetKernelsImpl(predKernelsSSE2);
+#endif
+#if PRED_NEON
+  predSetKernelsImpl(predKernelsNEON);
+#endif
+}
+
+GBool predSetKernelsImpl(PredKernelsImpl impl) {
+  switch (impl) {
+  case predKernelsC:
+    undoSubFunc = &undoSubC;
+    undoUpFunc = &undoUpC;
+    undoAverageFunc = &undoAverageC;
+    undoPaethFunc = &undoPaethC;
+    break;
+  case predKernelsWord:
+    undoSubFunc = &undoSubWord;
+    undoUpFunc = &undoUpWord;
+    undoAverageFunc = &undoAverageWord;
+    undoPaethFunc = &undoPaethWord;
+    break;
+  case predKernelsSSE2:
+#if PRED_SSE2
+    __builtin_cpu_init();
+    if (!__builtin_cpu_supports("sse2")) {
+      return gFalse;
+    }
+    undoSubFunc = &undoSubSSE2;
+    undoUpFunc = &undoUpSSE2;
+    undoAverageFunc = &undoAverageWord;
+    undoPaethFunc = &undoPaethWord;
+    break;
+#else
+    return gFalse;
+#endif
+  case predKernelsNEON:
+#if PRED_NEON
+    undoSubFunc = &undoSubNEON;
+    undoUpFunc = &undoUpNEON;
+    undoAverageFunc = &undoAverageWord;
+    undoPaethFunc = &undoPaethWord;
+    break;
+#else
+    return gFalse;
+#endif
+  }
+  kernelsImpl = impl;
+  kernelsInited = gTrue;
+  return gTrue;
+}
+
+PredKernelsImpl predGetKernelsImpl() {
+  if (!kernelsInited) {
+    initKernels();
+  }
+  return kernelsImpl;
+}
+
+void predUndoPNG(int filter, Guchar *line, Guchar *prevLine,
+		 int n, int pixBytes) {
+  if (!kernelsInited) {
+    initKernels();
+  }
+  switch (filter) {
+  case predPNGSub:
+    (*undoSubFunc)(line, n, pixBytes);
+    break;
+  case predPNGUp:
+    (*undoUpFunc)(line, prevLine, n);
+    break;
+  case predPNGAverage:
+    (*undoAverageFunc)(line, prevLine, n, pixBytes);
+    break;
+  case predPNGPaeth:
+    (*undoPaethFunc)(line, prevLine, n, pixBytes);
+    break;
+  default:
+    break;
+  }
+}
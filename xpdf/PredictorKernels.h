@@ -0,0 +1,46 @@
+//========================================================================
+//
+// PredictorKernels.h
+//
+// Row kernels for StreamPredictor.  As with the Splash kernels, each
+// one has a byte-at-a-time C version, a faster portable version, and,
+// where the CPU supports it, an SSE2 or NEON version, chosen the first
+// time a kernel is called.  All of them produce identical results.
+//
+//========================================================================
+
+#ifndef PREDICTORKERNELS_H
+#define PREDICTORKERNELS_H
+
+#include <aconf.h>
+
+#include "gtypes.h"
+
+// PNG filter types
+#define predPNGSub      1
+#define predPNGUp       2
+#define predPNGAverage  3
+#define predPNGPaeth    4
+
+// Undo PNG filter <filter> on a row of <n> bytes with <pixBytes> bytes
+// per pixel.  <line> holds the filtered row and is decoded in place;
+// <prevLine> is the previous (decoded) row.  Both are preceded by
+// <pixBytes> zero bytes.
+extern void predUndoPNG(int filter, Guchar *line, Guchar *prevLine,
+			int n, int pixBytes);
+
+enum PredKernelsImpl {
+  predKernelsC,			// byte at a time
+  predKernelsWord,		// word at a time, registers (portable)
+  predKernelsSSE2,		// x86 SSE2 (Sub and Up)
+  predKernelsNEON		// ARM NEON (Sub and Up)
+};
+
+// Use the <impl> versions of the kernels.  Returns false (and changes
+// nothing) if they aren't available in this build or on this CPU.
+extern GBool predSetKernelsImpl(PredKernelsImpl impl);
+
+// Returns the versions in use.
+extern PredKernelsImpl predGetKernelsImpl();
+
+#endif
@@ -0,0 +1,110 @@
+//========================================================================
+//
+// PredictorKernelsTest.cc
+//
+// Checks that each version of the PNG predictor kernels gives exactly
+// the same results as the byte-at-a-time C versions, for every filter
+// type and pixel size, over random rows, row lengths, and alignments.
+// Run by 'make check'; exits with status 1 on the first mismatch.
+//
+//========================================================================
+
+#include <aconf.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gtypes.h"
+#include "PredictorKernels.h"
+
+// longest row tested, in bytes
+#define testMaxBytes 700
+
+// largest pixel size (8 components, 8 bytes)
+#define testMaxPixBytes 8
+
+// bytes after each row, which must not be touched
+#define testGuard 24
+
+#define testBufSize (testMaxPixBytes + testMaxBytes + testGuard + 8)
+
+static unsigned long testRandState = 1;
+
+static int testRand() {
+  testRandState = testRandState * 1103515245 + 12345;
+  return (int)((testRandState >> 16) & 0x7fff);
+}
+
+static const char *filterNames[5] = {
+  "", "Sub", "Up", "Average", "Paeth"
+};
+
+// Run <filter> on one random row with the <impl> versions and with
+// the C versions, and compare.  Returns false on a mismatch.
+static GBool testCase(PredKernelsImpl impl, int filter, int pixBytes) {
+  static Guchar line0[testBufSize], line1[testBufSize];
+  static Guchar prev0[testBufSize], prev1[testBufSize];
+  Guchar *line, *prev;
+  int n, off, i;
+
+  switch (testRand() % 3) {
+  case 0:
+    n = testRand() % 40;
+    break;
+  default:
+    n = testRand() % testMaxBytes;
+    break;
+  }
+  off = testRand() % 8;
+  for (i = 0; i < testBufSize; ++i) {
+    line0[i] = line1[i] = (Guchar)testRand();
+    prev0[i] = prev1[i] = (Guchar)testRand();
+  }
+  // both rows are preceded by pixBytes zero bytes
+  memset(line0 + off, 0, pixBytes);
+  memset(line1 + off, 0, pixBytes);
+  memset(prev0 + off, 0, pixBytes);
+  memset(prev1 + off, 0, pixBytes);
+
+  for (i = 0; i < 2; ++i) {
+    predSetKernelsImpl(i ? predKernelsC : impl);
+    line = (i ? line1 : line0) + off + pixBytes;
+    prev = (i ? prev1 : prev0) + off + pixBytes;
+    predUndoPNG(filter, line, prev, n, pixBytes);
+  }
+
+  if (memcmp(line0, line1, testBufSize) ||
+      memcmp(prev0, prev1, testBufSize)) {
+    for (i = 0; i < testBufSize && line0[i] == line1[i]; ++i) ;
+    printf("FAIL %s: pixBytes=%d n=%d offset=%d: byte %d is %d, not %d\n",
+	   filterNames[filter], pixBytes, n, off, i - off - pixBytes,
+	   line0[i], line1[i]);
+    return gFalse;
+  }
+  return gTrue;
+}
+
+int main() {
+  static PredKernelsImpl impls[3] = {
+    predKernelsWord, predKernelsSSE2, predKernelsNEON
+  };
+  static const char *implNames[3] = { "word", "SSE2", "NEON" };
+  int i, filter, pixBytes, rep;
+
+  for (i = 0; i < 3; ++i) {
+    if (!predSetKernelsImpl(impls[i])) {
+      printf("%-5s not available\n", implNames[i]);
+      continue;
+    }
+    for (filter = predPNGSub; filter <= predPNGPaeth; ++filter) {
+      for (pixBytes = 1; pixBytes <= testMaxPixBytes; ++pixBytes) {
+	for (rep = 0; rep < 300; ++rep) {
+	  if (!testCase(impls[i], filter, pixBytes)) {
+	    return 1;
+	  }
+	}
+      }
+    }
+    printf("%-5s ok\n", implNames[i]);
+  }
+  return 0;
+}
@@ -18,16 +18,20 @@
 #include "GlobalParams.h"
 #include "Error.h"
 #include "Object.h"
+#include "Stream.h"
 #include "GfxFont.h"
 #include "Link.h"
 #include "CharCodeToUnicode.h"
 #include "FontEncodingTables.h"
 #include "FoFiTrueType.h"
+#include "JArithmeticDecoder.h"
+#include "JPXStream.h"
 #include "SplashBitmap.h"
 #include "SplashGlyphBitmap.h"
 #include "SplashPattern.h"
 #include "SplashScreen.h"
 #include "SplashPath.h"
+#include "SplashClip.h"
 #include "SplashState.h"
 #include "SplashErrorCodes.h"
 #include "SplashFontEngine.h"
@@ -37,6 +41,24 @@
 #include "Splash.h"
 #include "SplashOutputDev.h"
 
+//------------------------------------------------------------------------
+
+// Size of the color lookup table used for parameterized (i.e., with a
+// Function) mesh shadings.
+#define meshLookupSize 256
+
+// Max recursive depth and max device color error (in 0..255 units)
+// when subdividing Gouraud triangles in color spaces which don't map
+// linearly to device colors.
+#define gouraudMaxDepth 6
+#define gouraudMaxError 2
+
+// Max (binary) subdivision depth, max device space error (in pixels),
+// and max color delta when flattening patch mesh shadings.
+#define patchMaxDepth 14
+#define patchMaxError 0.5
+#define patchColorDelta (dblToCol(1 / 256.0))
+
 //------------------------------------------------------------------------
 // Blend functions
 //------------------------------------------------------------------------
@@ -563,6 +585,142 @@ struct T3GlyphStack {
   T3GlyphStack *next;		// next object on stack
 };
 
+//------------------------------------------------------------------------
+// SplashImageCache
+//------------------------------------------------------------------------
+
+// A decoded and color-converted image XObject, in the Splash source
+// format <mode>.  The pixels may be reduced by averaging <reduction> x
+// <reduction> blocks.
+struct SplashImageCacheEntry {
+  Ref ref;			// image XObject
+  SplashColorMode mode;		// pixel format
+  GfxColorSpaceMode csMode;	// color space of the image
+  int bits;			// bits per component of the image
+  int reduction;		// reduction factor, a power of two
+  int width, height;		// size, after reduction
+  SplashColorPtr data;		// pixels
+  int size;			// size of <data>, in bytes
+};
+
+// Decoded images, most recently used first.  Each image XObject is
+// kept once, at the highest resolution recently needed; the total size
+// is limited to <maxSize> bytes.
+class SplashImageCache {
+public:
+
+  SplashImageCache(int maxSizeA);
+  ~SplashImageCache();
+
+  // Find image <ref> reduced by <reduction> or less, and make it the
+  // most recently used one.
+  SplashImageCacheEntry *lookup(Ref ref, SplashColorMode mode,
+				GfxColorSpaceMode csMode, int bits,
+				int reduction);
+
+  // Add an image after a failed lookup, replacing the other copies of
+  // it (which have a bigger reduction).  Returns false (and does not
+  // take <entry>) if it is too big.
+  GBool add(SplashImageCacheEntry *entry);
+
+  // Remove all images.
+  void clear();
+
+private:
+
+  void remove(int i);
+
+  SplashImageCacheEntry **entries;
+  int nEntries;
+  int entriesSize;
+  int size;			// total size of the images, in bytes
+  int maxSize;
+};
+
+SplashImageCache::SplashImageCache(int maxSizeA) {
+  entries = NULL;
+  nEntries = entriesSize = 0;
+  size = 0;
+  maxSize = maxSizeA;
+}
+
+SplashImageCache::~SplashImageCache() {
+  clear();
+  gfree(entries);
+}
+
+SplashImageCacheEntry *SplashImageCache::lookup(Ref ref,
+						SplashColorMode mode,
+						GfxColorSpaceMode csMode,
+						int bits, int reduction) {
+  SplashImageCacheEntry *entry;
+  int i;
+
+  for (i = 0; i < nEntries; ++i) {
+    entry = entries[i];
+    if (entry->ref.num == ref.num && entry->ref.gen == ref.gen &&
+	entry->mode == mode && entry->csMode == csMode &&
+	entry->bits == bits && entry->reduction <= reduction) {
+      memmove(&entries[1], &entries[0], i * sizeof(SplashImageCacheEntry *));
+      entries[0] = entry;
+      return entry;
+    }
+  }
+  return NULL;
+}
+
+GBool SplashImageCache::add(SplashImageCacheEntry *entry) {
+  SplashImageCacheEntry *entry2;
+  int i;
+
+  if (entry->size > maxSize) {
+    return gFalse;
+  }
+
+  // drop the copies which are superseded by this one
+  for (i = nEntries - 1; i >= 0; --i) {
+    entry2 = entries[i];
+    if (entry2->ref.num == entry->ref.num &&
+	entry2->ref.gen == entry->ref.gen &&
+	entry2->mode == entry->mode) {
+      remove(i);
+    }
+  }
+
+  // drop the least recently used images
+  while (nEntries > 0 && size + entry->size > maxSize) {
+    remove(nEntries - 1);
+  }
+
+  if (nEntries == entriesSize) {
+    entriesSize = entriesSize ? 2 * entriesSize : 16;
+    entries = (SplashImageCacheEntry **)
+                greallocn(entries, entriesSize,
+			  sizeof(SplashImageCacheEntry *));
+  }
+  memmove(&entries[1], &entries[0],
+	  nEntries * sizeof(SplashImageCacheEntry *));
+  entries[0] = entry;
+  ++nEntries;
+  size += entry->size;
+  return gTrue;
+}
+
+void SplashImageCache::remove(int i) {
+  size -= entries[i]->size;
+  gfree(entries[i]->data);
+  delete entries[i];
+  --nEntries;
+  memmove(&entries[i], &entries[i + 1],
+	  (nEntries - i) * sizeof(SplashImageCacheEntry *));
+}
+
+void SplashImageCache::clear() {
+  while (nEntries > 0) {
+    remove(nEntries - 1);
+  }
+}
+
 //------------------------------------------------------------------------
 // SplashOutputDev
 //------------------------------------------------------------------------
@@ -577,6 +735,7 @@ SplashOutputDev::SplashOutputDev(SplashColorMode colorModeA,
   bitmapRowPad = bitmapRowPadA;
   bitmapTopDown = bitmapTopDownA;
   allowAntialias = allowAntialiasA;
+  vectorAntialias = gFalse;
   reverseVideo = reverseVideoA;
   splashColorCopy(paperColor, paperColorA);
 
@@ -591,9 +750,12 @@ SplashOutputDev::SplashOutputDev(SplashColorMode colorModeA,
   nT3Fonts = 0;
   t3GlyphStack = NULL;
 
+  imageCache = new SplashImageCache(splashOutImageCacheSize);
+
   font = NULL;
   needFontUpdate = gFalse;
   textClipPath = NULL;
+  convPath = new SplashPath();
 }
 
 SplashOutputDev::~SplashOutputDev() {
@@ -602,6 +764,7 @@ SplashOutputDev::~SplashOutputDev() {
   for (i = 0; i < nT3Fonts; ++i) {
     delete t3FontCache[i];
   }
+  delete imageCache;
   if (fontEngine) {
     delete fontEngine;
   }
@@ -611,12 +774,16 @@ SplashOutputDev::~SplashOutputDev() {
   if (bitmap) {
     delete bitmap;
   }
+  delete convPath;
 }
 
 void SplashOutputDev::startDoc(XRef *xrefA) {
   int i;
 
   xref = xrefA;
+  vectorAntialias = allowAntialias &&
+		      globalParams->getAntialias() &&
+		      colorMode != splashModeMono1;
   if (fontEngine) {
     delete fontEngine;
   }
@@ -627,13 +794,12 @@ void SplashOutputDev::startDoc(XRef *xrefA) {
 #if HAVE_FREETYPE_FREETYPE_H || HAVE_FREETYPE_H
 				    globalParams->getEnableFreeType(),
 #endif
-				    allowAntialias &&
-				      globalParams->getAntialias() &&
-				      colorMode != splashModeMono1);
+				    vectorAntialias);
   for (i = 0; i < nT3Fonts; ++i) {
     delete t3FontCache[i];
   }
   nT3Fonts = 0;
+  imageCache->clear();
 }
 
 void SplashOutputDev::startPage(int pageNum, GfxState *state) {
@@ -658,7 +824,7 @@ void SplashOutputDev::startPage(int pageNum, GfxState *state) {
     	throw 0;
     }
   }
-  splash = new Splash(bitmap);
+  splash = new Splash(bitmap, vectorAntialias);
   switch (colorMode) {
   case splashModeMono1:
   case splashModeMono8:
@@ -993,6 +1159,7 @@ void SplashOutputDev::updateFont(GfxState *state) {
   SplashCoord mat[4];
   char *name;
   Unicode uBuf[8];
+  char blk[4096];
   int c, substIdx, n, code, cmap;
 
   needFontUpdate = gFalse;
@@ -1026,8 +1193,8 @@ void SplashOutputDev::updateFont(GfxState *state) {
       refObj.fetch(xref, &strObj);
       refObj.free();
       strObj.streamReset();
-      while ((c = strObj.streamGetChar()) != EOF) {
-	fputc(c, tmpFile);
+      while ((c = strObj.streamGetBlock(blk, sizeof(blk))) > 0) {
+	fwrite(blk, 1, c, tmpFile);
       }
       strObj.streamClose();
       strObj.free();
@@ -1271,7 +1438,6 @@ void SplashOutputDev::stroke(GfxState *state) {
 
   path = convertPath(state, state->getPath());
   splash->stroke(path);
-  delete path;
 }
 
 void SplashOutputDev::fill(GfxState *state) {
@@ -1279,7 +1445,6 @@ void SplashOutputDev::fill(GfxState *state) {
 
   path = convertPath(state, state->getPath());
   splash->fill(path, gFalse);
-  delete path;
 }
 
 void SplashOutputDev::eoFill(GfxState *state) {
@@ -1287,7 +1452,502 @@ void SplashOutputDev::eoFill(GfxState *state) {
 
   path = convertPath(state, state->getPath());
   splash->fill(path, gTrue);
-  delete path;
+}
+
+// Returns true if device colors are a linear function of the color
+// components in <colorSpace>, i.e., if Gouraud shading can be done by
+// interpolating device colors.
+static GBool isLinearColorSpace(GfxColorSpace *colorSpace) {
+  switch (colorSpace->getMode()) {
+  case csDeviceGray:
+  case csCalGray:
+  case csDeviceRGB:
+  case csCalRGB:
+    return gTrue;
+  case csICCBased:
+    return isLinearColorSpace(((GfxICCBasedColorSpace *)colorSpace)->getAlt());
+  default:
+    return gFalse;
+  }
+}
+
+void SplashOutputDev::gouraudTriangleShadedFill(
+				      GfxState *state,
+				      GfxGouraudTriangleShading *shading) {
+  GfxColorSpace *colorSpace;
+  SplashColor lookup[meshLookupSize];
+  GfxColor color0, color1, color2;
+  double x0, y0, x1, y1, x2, y2, t0, t1, t2, tMin, tMax, tMul;
+  double xd0, yd0, xd1, yd1, xd2, yd2;
+  int i;
+
+  colorSpace = shading->getColorSpace();
+
+  if (shading->isParameterized()) {
+    // the parameter is interpolated across each triangle, and mapped
+    // to a color through a lookup table covering the parameter range
+    tMin = tMax = 0; // make gcc happy
+    for (i = 0; i < shading->getNTriangles(); ++i) {
+      shading->getTriangle(i, &x0, &y0, &t0, &x1, &y1, &t1, &x2, &y2, &t2);
+      if (i == 0) {
+	tMin = tMax = t0;
+      }
+      if (t0 < tMin) tMin = t0; else if (t0 > tMax) tMax = t0;
+      if (t1 < tMin) tMin = t1; else if (t1 > tMax) tMax = t1;
+      if (t2 < tMin) tMin = t2; else if (t2 > tMax) tMax = t2;
+    }
+    for (i = 0; i < meshLookupSize; ++i) {
+      shading->getParameterizedColor(
+		   tMin + (tMax - tMin) * i / (double)(meshLookupSize - 1),
+		   &color0);
+      getShadingColor(colorSpace, &color0, lookup[i]);
+    }
+    tMul = (tMax > tMin) ? 1 / (tMax - tMin) : 0;
+    for (i = 0; i < shading->getNTriangles(); ++i) {
+      shading->getTriangle(i, &x0, &y0, &t0, &x1, &y1, &t1, &x2, &y2, &t2);
+      state->transform(x0, y0, &xd0, &yd0);
+      state->transform(x1, y1, &xd1, &yd1);
+      state->transform(x2, y2, &xd2, &yd2);
+      splash->gouraudTriangle((SplashCoord)xd0, (SplashCoord)yd0,
+			      (SplashCoord)((t0 - tMin) * tMul),
+			      (SplashCoord)xd1, (SplashCoord)yd1,
+			      (SplashCoord)((t1 - tMin) * tMul),
+			      (SplashCoord)xd2, (SplashCoord)yd2,
+			      (SplashCoord)((t2 - tMin) * tMul),
+			      lookup, meshLookupSize);
+    }
+
+  } else {
+    for (i = 0; i < shading->getNTriangles(); ++i) {
+      shading->getTriangle(i, &x0, &y0, &color0, &x1, &y1, &color1,
+			   &x2, &y2, &color2);
+      state->transform(x0, y0, &xd0, &yd0);
+      state->transform(x1, y1, &xd1, &yd1);
+      state->transform(x2, y2, &xd2, &yd2);
+      gouraudFillTriangle(xd0, yd0, &color0, xd1, yd1, &color1,
+			  xd2, yd2, &color2, colorSpace, 0);
+    }
+  }
+}
+
+// Colors are interpolated in device space, which is only exact if the
+// color space maps linearly to device colors.  Triangles in other
+// color spaces are subdivided until the device color at the midpoint
+// of each edge is within gouraudMaxError of the interpolated color.
+void SplashOutputDev::gouraudFillTriangle(double x0, double y0,
+					  GfxColor *color0,
+					  double x1, double y1,
+					  GfxColor *color1,
+					  double x2, double y2,
+					  GfxColor *color2,
+					  GfxColorSpace *colorSpace,
+					  int depth) {
+  SplashColor dColor0, dColor1, dColor2;
+
+  getShadingColor(colorSpace, color0, dColor0);
+  getShadingColor(colorSpace, color1, dColor1);
+  getShadingColor(colorSpace, color2, dColor2);
+  if (isLinearColorSpace(colorSpace)) {
+    splash->gouraudTriangle((SplashCoord)x0, (SplashCoord)y0, dColor0,
+			    (SplashCoord)x1, (SplashCoord)y1, dColor1,
+			    (SplashCoord)x2, (SplashCoord)y2, dColor2);
+  } else {
+    gouraudFillTriangle(x0, y0, color0, dColor0, x1, y1, color1, dColor1,
+			x2, y2, color2, dColor2, colorSpace, depth);
+  }
+}
+
+void SplashOutputDev::gouraudFillTriangle(double x0, double y0,
+					  GfxColor *color0,
+					  SplashColorPtr dColor0,
+					  double x1, double y1,
+					  GfxColor *color1,
+					  SplashColorPtr dColor1,
+					  double x2, double y2,
+					  GfxColor *color2,
+					  SplashColorPtr dColor2,
+					  GfxColorSpace *colorSpace,
+					  int depth) {
+  double x01, y01, x12, y12, x20, y20;
+  GfxColor color01, color12, color20;
+  SplashColor dColor01, dColor12, dColor20;
+  int nComps, err, i;
+
+  if (depth < gouraudMaxDepth &&
+      (fabs(x1 - x0) > 1 || fabs(y1 - y0) > 1 ||
+       fabs(x2 - x0) > 1 || fabs(y2 - y0) > 1)) {
+    nComps = colorSpace->getNComps();
+    for (i = 0; i < nComps; ++i) {
+      color01.c[i] = (color0->c[i] + color1->c[i]) / 2;
+      color12.c[i] = (color1->c[i] + color2->c[i]) / 2;
+      color20.c[i] = (color2->c[i] + color0->c[i]) / 2;
+    }
+    getShadingColor(colorSpace, &color01, dColor01);
+    getShadingColor(colorSpace, &color12, dColor12);
+    getShadingColor(colorSpace, &color20, dColor20);
+    err = 0;
+    for (i = 0; i < splashColorModeNComps[colorMode]; ++i) {
+      err |= abs(2 * dColor01[i] - dColor0[i] - dColor1[i])
+	       > 2 * gouraudMaxError;
+      err |= abs(2 * dColor12[i] - dColor1[i] - dColor2[i])
+	       > 2 * gouraudMaxError;
+      err |= abs(2 * dColor20[i] - dColor2[i] - dColor0[i])
+	       > 2 * gouraudMaxError;
+    }
+    if (err) {
+      x01 = 0.5 * (x0 + x1);
+      y01 = 0.5 * (y0 + y1);
+      x12 = 0.5 * (x1 + x2);
+      y12 = 0.5 * (y1 + y2);
+      x20 = 0.5 * (x2 + x0);
+      y20 = 0.5 * (y2 + y0);
+      gouraudFillTriangle(x0, y0, color0, dColor0,
+			  x01, y01, &color01, dColor01,
+			  x20, y20, &color20, dColor20, colorSpace, depth + 1);
+      gouraudFillTriangle(x01, y01, &color01, dColor01,
+			  x1, y1, color1, dColor1,
+			  x12, y12, &color12, dColor12, colorSpace, depth + 1);
+      gouraudFillTriangle(x01, y01, &color01, dColor01,
+			  x12, y12, &color12, dColor12,
+			  x20, y20, &color20, dColor20, colorSpace, depth + 1);
+      gouraudFillTriangle(x20, y20, &color20, dColor20,
+			  x12, y12, &color12, dColor12,
+			  x2, y2, color2, dColor2, colorSpace, depth + 1);
+      return;
+    }
+  }
+  splash->gouraudTriangle((SplashCoord)x0, (SplashCoord)y0, dColor0,
+			  (SplashCoord)x1, (SplashCoord)y1, dColor1,
+			  (SplashCoord)x2, (SplashCoord)y2, dColor2);
+}
+
+void SplashOutputDev::patchMeshShadedFill(GfxState *state,
+					  GfxPatchMeshShading *shading) {
+  GfxColorSpace *colorSpace;
+  SplashColor lookup[meshLookupSize];
+  GfxPatch *patch, patch1;
+  GfxColor color;
+  double t, tMin, tMax, tMul;
+  int i, j, k;
+
+  colorSpace = shading->getColorSpace();
+
+  tMin = tMax = tMul = 0;
+  if (shading->isParameterized()) {
+    for (i = 0; i < shading->getNPatches(); ++i) {
+      patch = shading->getPatch(i);
+      for (j = 0; j < 4; ++j) {
+	t = colToDbl(patch->color[j >> 1][j & 1].c[0]);
+	if ((i == 0 && j == 0) || t < tMin) {
+	  tMin = t;
+	}
+	if ((i == 0 && j == 0) || t > tMax) {
+	  tMax = t;
+	}
+      }
+    }
+    for (i = 0; i < meshLookupSize; ++i) {
+      shading->getParameterizedColor(
+		   tMin + (tMax - tMin) * i / (double)(meshLookupSize - 1),
+		   &color);
+      getShadingColor(colorSpace, &color, lookup[i]);
+    }
+    tMul = (tMax > tMin) ? 1 / (tMax - tMin) : 0;
+  }
+
+  // subdivision is done in device space, so transform the control
+  // points up front
+  for (i = 0; i < shading->getNPatches(); ++i) {
+    patch = shading->getPatch(i);
+    for (j = 0; j < 4; ++j) {
+      for (k = 0; k < 4; ++k) {
+	state->transform(patch->x[j][k], patch->y[j][k],
+			 &patch1.x[j][k], &patch1.y[j][k]);
+      }
+    }
+    for (j = 0; j < 2; ++j) {
+      for (k = 0; k < 2; ++k) {
+	patch1.color[j][k] = patch->color[j][k];
+      }
+    }
+    fillPatch(&patch1, colorSpace,
+	      shading->isParameterized() ? lookup : (SplashColor *)NULL,
+	      tMin, tMul, 0);
+  }
+}
+
+// Split a cubic Bezier curve in half.  The control points are read
+// from <a>, and written to <l> and <r>, with a stride of <stride>.
+static void splitCubic(double *a, double *l, double *r, int stride) {
+  double a0, a1, a2, a3, b0, b1, b2, c0, c1, d;
+
+  a0 = a[0];
+  a1 = a[stride];
+  a2 = a[2 * stride];
+  a3 = a[3 * stride];
+  b0 = 0.5 * (a0 + a1);
+  b1 = 0.5 * (a1 + a2);
+  b2 = 0.5 * (a2 + a3);
+  c0 = 0.5 * (b0 + b1);
+  c1 = 0.5 * (b1 + b2);
+  d = 0.5 * (c0 + c1);
+  l[0] = a0;
+  l[stride] = b0;
+  l[2 * stride] = c0;
+  l[3 * stride] = d;
+  r[0] = d;
+  r[stride] = c1;
+  r[2 * stride] = b2;
+  r[3 * stride] = a3;
+}
+
+// Split <patch> in half along its second parameter (i.e., splitting
+// the curves x[i][0..3]), if <alongJ> is set, or along its first
+// parameter.
+static void splitPatch(GfxPatch *patch, GBool alongJ, int nComps,
+		       GfxPatch *p0, GfxPatch *p1) {
+  int i, k;
+
+  for (i = 0; i < 4; ++i) {
+    if (alongJ) {
+      splitCubic(&patch->x[i][0], &p0->x[i][0], &p1->x[i][0], 1);
+      splitCubic(&patch->y[i][0], &p0->y[i][0], &p1->y[i][0], 1);
+    } else {
+      splitCubic(&patch->x[0][i], &p0->x[0][i], &p1->x[0][i], 4);
+      splitCubic(&patch->y[0][i], &p0->y[0][i], &p1->y[0][i], 4);
+    }
+  }
+  for (i = 0; i < 2; ++i) {
+    for (k = 0; k < nComps; ++k) {
+      if (alongJ) {
+	p0->color[i][0].c[k] = patch->color[i][0].c[k];
+	p0->color[i][1].c[k] = p1->color[i][0].c[k] =
+	    (patch->color[i][0].c[k] + patch->color[i][1].c[k]) / 2;
+	p1->color[i][1].c[k] = patch->color[i][1].c[k];
+      } else {
+	p0->color[0][i].c[k] = patch->color[0][i].c[k];
+	p0->color[1][i].c[k] = p1->color[0][i].c[k] =
+	    (patch->color[0][i].c[k] + patch->color[1][i].c[k]) / 2;
+	p1->color[1][i].c[k] = patch->color[1][i].c[k];
+      }
+    }
+  }
+}
+
+// A patch is drawn as two Gouraud triangles once it is close enough
+// to that: all of its control points must be within patchMaxError
+// (in device space) of the bilinear patch through its corners, which
+// bounds the distance from the surface, plus the error from splitting
+// the bilinear patch along a diagonal.  The color twist is checked the
+// same way.  Otherwise the patch is split in half, across the
+// direction in which it is most curved.
+void SplashOutputDev::fillPatch(GfxPatch *patch, GfxColorSpace *colorSpace,
+				SplashColor *lookup, double tMin, double tMul,
+				int depth) {
+  GfxPatch patch0, patch1;
+  SplashClip *clip;
+  double xMin, yMin, xMax, yMax, u, v, bx, by, err, errI, errJ, e, dx, dy;
+  int nComps, i, j, k;
+
+  nComps = lookup ? 1 : colorSpace->getNComps();
+
+  // skip patches which are entirely clipped (the control points
+  // bound the patch)
+  xMin = xMax = patch->x[0][0];
+  yMin = yMax = patch->y[0][0];
+  for (i = 0; i < 4; ++i) {
+    for (j = 0; j < 4; ++j) {
+      if (patch->x[i][j] < xMin) {
+	xMin = patch->x[i][j];
+      } else if (patch->x[i][j] > xMax) {
+	xMax = patch->x[i][j];
+      }
+      if (patch->y[i][j] < yMin) {
+	yMin = patch->y[i][j];
+      } else if (patch->y[i][j] > yMax) {
+	yMax = patch->y[i][j];
+      }
+    }
+  }
+  clip = splash->getClip();
+  if (xMax < clip->getXMin() || xMin >= clip->getXMax() + 1 ||
+      yMax < clip->getYMin() || yMin >= clip->getYMax() + 1) {
+    return;
+  }
+
+  if (depth < patchMaxDepth) {
+
+    // distance from the bilinear patch, and curvature in each
+    // direction
+    err = errI = errJ = 0;
+    for (i = 0; i < 4; ++i) {
+      u = i / 3.0;
+      for (j = 0; j < 4; ++j) {
+	v = j / 3.0;
+	bx = (1 - u) * ((1 - v) * patch->x[0][0] + v * patch->x[0][3]) +
+	     u * ((1 - v) * patch->x[3][0] + v * patch->x[3][3]);
+	by = (1 - u) * ((1 - v) * patch->y[0][0] + v * patch->y[0][3]) +
+	     u * ((1 - v) * patch->y[3][0] + v * patch->y[3][3]);
+	dx = patch->x[i][j] - bx;
+	dy = patch->y[i][j] - by;
+	e = dx * dx + dy * dy;
+	if (e > err) {
+	  err = e;
+	}
+	if (j == 1 || j == 2) {
+	  dx = patch->x[i][j] - ((3 - j) * patch->x[i][0] + j * patch->x[i][3]) / 3;
+	  dy = patch->y[i][j] - ((3 - j) * patch->y[i][0] + j * patch->y[i][3]) / 3;
+	  e = dx * dx + dy * dy;
+	  if (e > errJ) {
+	    errJ = e;
+	  }
+	}
+	if (i == 1 || i == 2) {
+	  dx = patch->x[i][j] - ((3 - i) * patch->x[0][j] + i * patch->x[3][j]) / 3;
+	  dy = patch->y[i][j] - ((3 - i) * patch->y[0][j] + i * patch->y[3][j]) / 3;
+	  e = dx * dx + dy * dy;
+	  if (e > errI) {
+	    errI = e;
+	  }
+	}
+      }
+    }
+    dx = 0.25 * (patch->x[0][0] - patch->x[0][3] - patch->x[3][0] +
+		 patch->x[3][3]);
+    dy = 0.25 * (patch->y[0][0] - patch->y[0][3] - patch->y[3][0] +
+		 patch->y[3][3]);
+    e = sqrt(err) + sqrt(dx * dx + dy * dy);
+
+    for (k = 0; k < nComps; ++k) {
+      if (abs(patch->color[0][0].c[k] - patch->color[0][1].c[k] -
+	      patch->color[1][0].c[k] + patch->color[1][1].c[k])
+	  > 4 * patchColorDelta) {
+	break;
+      }
+    }
+
+    if (e > patchMaxError || k < nComps) {
+      if (errI == errJ) {
+	// no curvature: split the longer dimension
+	dx = patch->x[0][3] - patch->x[0][0];
+	dy = patch->y[0][3] - patch->y[0][0];
+	errJ = dx * dx + dy * dy;
+	dx = patch->x[3][0] - patch->x[0][0];
+	dy = patch->y[3][0] - patch->y[0][0];
+	errI = dx * dx + dy * dy;
+      }
+      splitPatch(patch, errJ >= errI, nComps, &patch0, &patch1);
+      fillPatch(&patch0, colorSpace, lookup, tMin, tMul, depth + 1);
+      fillPatch(&patch1, colorSpace, lookup, tMin, tMul, depth + 1);
+      return;
+    }
+  }
+
+  if (lookup) {
+    splash->gouraudTriangle(
+	(SplashCoord)patch->x[0][0], (SplashCoord)patch->y[0][0],
+	(SplashCoord)((colToDbl(patch->color[0][0].c[0]) - tMin) * tMul),
+	(SplashCoord)patch->x[0][3], (SplashCoord)patch->y[0][3],
+	(SplashCoord)((colToDbl(patch->color[0][1].c[0]) - tMin) * tMul),
+	(SplashCoord)patch->x[3][3], (SplashCoord)patch->y[3][3],
+	(SplashCoord)((colToDbl(patch->color[1][1].c[0]) - tMin) * tMul),
+	lookup, meshLookupSize);
+    splash->gouraudTriangle(
+	(SplashCoord)patch->x[0][0], (SplashCoord)patch->y[0][0],
+	(SplashCoord)((colToDbl(patch->color[0][0].c[0]) - tMin) * tMul),
+	(SplashCoord)patch->x[3][3], (SplashCoord)patch->y[3][3],
+	(SplashCoord)((colToDbl(patch->color[1][1].c[0]) - tMin) * tMul),
+	(SplashCoord)patch->x[3][0], (SplashCoord)patch->y[3][0],
+	(SplashCoord)((colToDbl(patch->color[1][0].c[0]) - tMin) * tMul),
+	lookup, meshLookupSize);
+  } else {
+    gouraudFillTriangle(patch->x[0][0], patch->y[0][0], &patch->color[0][0],
+			patch->x[0][3], patch->y[0][3], &patch->color[0][1],
+			patch->x[3][3], patch->y[3][3], &patch->color[1][1],
+			colorSpace, 0);
+    gouraudFillTriangle(patch->x[0][0], patch->y[0][0], &patch->color[0][0],
+			patch->x[3][3], patch->y[3][3], &patch->color[1][1],
+			patch->x[3][0], patch->y[3][0], &patch->color[1][0],
+			colorSpace, 0);
+  }
+}
+
+void SplashOutputDev::getShadingColor(GfxColorSpace *colorSpace,
+				      GfxColor *color, SplashColorPtr dest) {
+  GfxGray gray;
+  GfxRGB rgb;
+#if SPLASH_CMYK
+  GfxCMYK cmyk;
+#endif
+
+  switch (colorMode) {
+  case splashModeMono1:
+  case splashModeMono8:
+  case splashModeAMono8:
+    colorSpace->getGray(color, &gray);
+    if (reverseVideo) {
+      gray = gfxColorComp1 - gray;
+    }
+    if (colorMode == splashModeAMono8) {
+      dest[0] = 255;
+      dest[1] = colToByte(gray);
+    } else {
+      dest[0] = colToByte(gray);
+    }
+    break;
+  case splashModeRGB8:
+  case splashModeBGR8:
+  case splashModeARGB8:
+  case splashModeBGRA8:
+    colorSpace->getRGB(color, &rgb);
+    if (reverseVideo) {
+      rgb.r = gfxColorComp1 - rgb.r;
+      rgb.g = gfxColorComp1 - rgb.g;
+      rgb.b = gfxColorComp1 - rgb.b;
+    }
+    switch (colorMode) {
+    case splashModeRGB8:
+      dest[0] = colToByte(rgb.r);
+      dest[1] = colToByte(rgb.g);
+      dest[2] = colToByte(rgb.b);
+      break;
+    case splashModeBGR8:
+      dest[2] = colToByte(rgb.r);
+      dest[1] = colToByte(rgb.g);
+      dest[0] = colToByte(rgb.b);
+      break;
+    case splashModeARGB8:
+      dest[0] = 255;
+      dest[1] = colToByte(rgb.r);
+      dest[2] = colToByte(rgb.g);
+      dest[3] = colToByte(rgb.b);
+      break;
+    default: // splashModeBGRA8
+      dest[3] = 255;
+      dest[2] = colToByte(rgb.r);
+      dest[1] = colToByte(rgb.g);
+      dest[0] = colToByte(rgb.b);
+      break;
+    }
+    break;
+#if SPLASH_CMYK
+  case splashModeCMYK8:
+    colorSpace->getCMYK(color, &cmyk);
+    dest[0] = colToByte(cmyk.c);
+    dest[1] = colToByte(cmyk.m);
+    dest[2] = colToByte(cmyk.y);
+    dest[3] = colToByte(cmyk.k);
+    break;
+  case splashModeACMYK8:
+    colorSpace->getCMYK(color, &cmyk);
+    dest[0] = 255;
+    dest[1] = colToByte(cmyk.c);
+    dest[2] = colToByte(cmyk.m);
+    dest[3] = colToByte(cmyk.y);
+    dest[4] = colToByte(cmyk.k);
+    break;
+#endif
+  }
 }
 
 void SplashOutputDev::clip(GfxState *state) {
@@ -1295,7 +1955,6 @@ void SplashOutputDev::clip(GfxState *state) {
 
   path = convertPath(state, state->getPath());
   splash->clipToPath(path, gFalse);
-  delete path;
 }
 
 void SplashOutputDev::eoClip(GfxState *state) {
@@ -1303,16 +1962,18 @@ void SplashOutputDev::eoClip(GfxState *state) {
 
   path = convertPath(state, state->getPath());
   splash->clipToPath(path, gTrue);
-  delete path;
 }
 
+// Converts <path> to device space.  The result is stored in a buffer
+// which is reused by the next call, so it must not be deleted.
 SplashPath *SplashOutputDev::convertPath(GfxState *state, GfxPath *path) {
   SplashPath *sPath;
   GfxSubpath *subpath;
   double x1, y1, x2, y2, x3, y3;
   int i, j;
 
-  sPath = new SplashPath();
+  sPath = convPath;
+  sPath->reset();
   for (i = 0; i < path->getNumSubpaths(); ++i) {
     subpath = path->getSubpath(i);
     if (subpath->getNumPoints() > 0) {
@@ -1633,7 +2294,7 @@ void SplashOutputDev::type3D1(GfxState *state, double wx, double wy,
   } else {
     bitmap = new SplashBitmap(t3Font->glyphW, t3Font->glyphH, 1,
 			      splashModeMono8);
-    splash = new Splash(bitmap);
+    splash = new Splash(bitmap, vectorAntialias);
     color[0] = 0x00;
     splash->clear(color);
     color[0] = 0xff;
@@ -1670,6 +2331,8 @@ void SplashOutputDev::endTextObject(GfxState *state) {
 
 struct SplashOutImageMaskData {
   ImageStream *imgStr;
+  Stream *str;			// for imageMaskRunSrc
+  int *runs;			// buffer for imageMaskRunSrc
   GBool invert;
   int width, height, y;
 };
@@ -1692,6 +2355,46 @@ GBool SplashOutputDev::imageMaskSrc(void *data, SplashColorPtr line) {
   return gTrue;
 }
 
+// Reads a row of runs from the decoder.  The decoder's runs are the
+// 1 bits; the painted pixels are the complement unless <invert> is 0.
+// As with ImageStream, rows past the end of the data are all 1 bits.
+GBool SplashOutputDev::imageMaskRunSrc(void *data, int *runs, int *nRuns) {
+  SplashOutImageMaskData *imgMaskData = (SplashOutImageMaskData *)data;
+  int *r;
+  int n, i, x;
+
+  if (imgMaskData->y == imgMaskData->height) {
+    return gFalse;
+  }
+  r = imgMaskData->invert ? imgMaskData->runs : runs;
+  if ((n = imgMaskData->str->getRuns(r)) < 0) {
+    r[0] = 0;
+    r[1] = imgMaskData->width;
+    n = 1;
+  }
+  if (imgMaskData->invert) {
+    x = 0;
+    *nRuns = 0;
+    for (i = 0; i < n; ++i) {
+      if (r[2*i] > x) {
+	runs[2 * *nRuns] = x;
+	runs[2 * *nRuns + 1] = r[2*i];
+	++*nRuns;
+      }
+      x = r[2*i+1];
+    }
+    if (x < imgMaskData->width) {
+      runs[2 * *nRuns] = x;
+      runs[2 * *nRuns + 1] = imgMaskData->width;
+      ++*nRuns;
+    }
+  } else {
+    *nRuns = n;
+  }
+  ++imgMaskData->y;
+  return gTrue;
+}
+
 void SplashOutputDev::drawImageMask(GfxState *state, Object *ref, Stream *str,
 				    int width, int height, GBool invert,
 				    GBool inlineImg) {
@@ -1709,27 +2412,189 @@ void SplashOutputDev::drawImageMask(GfxState *state, Object *ref, Stream *str,
 
   imgMaskData.imgStr = new ImageStream(str, width, 1, 1);
   imgMaskData.imgStr->reset();
+  imgMaskData.str = str;
+  imgMaskData.runs = NULL;
   imgMaskData.invert = invert ? 0 : 1;
   imgMaskData.width = width;
   imgMaskData.height = height;
   imgMaskData.y = 0;
 
-  splash->fillImageMask(&imageMaskSrc, &imgMaskData, width, height, mat);
+  // CCITT and JBIG2 masks can be read as runs of black pixels; if the
+  // mask isn't rotated or sheared, fill them as spans
+  if (mat[1] == 0 && mat[2] == 0 && str->hasRuns(width)) {
+    imgMaskData.runs = (int *)gmallocn(width + 1, sizeof(int));
+    splash->fillImageMaskRuns(&imageMaskRunSrc, &imgMaskData,
+			      width, height, mat);
+  } else {
+    splash->fillImageMask(&imageMaskSrc, &imgMaskData, width, height, mat);
+  }
   if (inlineImg) {
     while (imgMaskData.y < height) {
-      imgMaskData.imgStr->getLine();
+      if (imgMaskData.runs) {
+	str->getRuns(imgMaskData.runs);
+      } else {
+	imgMaskData.imgStr->getLine();
+      }
       ++imgMaskData.y;
     }
   }
 
+  gfree(imgMaskData.runs);
   delete imgMaskData.imgStr;
   str->close();
 }
 
+struct SplashOutCachedImageData {
+  SplashImageCacheEntry *entry;
+  int y;
+};
+
+GBool SplashOutputDev::cachedImageSrc(void *data, SplashColorPtr line) {
+  SplashOutCachedImageData *imgData = (SplashOutCachedImageData *)data;
+  SplashImageCacheEntry *entry;
+  int rowSize;
+
+  entry = imgData->entry;
+  if (imgData->y == entry->height) {
+    return gFalse;
+  }
+  rowSize = entry->width * splashColorModeNComps[entry->mode];
+  memcpy(line, entry->data + imgData->y * rowSize, rowSize);
+  ++imgData->y;
+  return gTrue;
+}
+
+// Returns the biggest power of two by which a <width> x <height> image
+// can be reduced without dropping below the device resolution given by
+// <mat>.
+static int getImageReduction(int width, int height, SplashCoord *mat) {
+  double w, h;
+  int reduction;
+
+  w = sqrt((double)(mat[0] * mat[0] + mat[1] * mat[1])) + 1;
+  h = sqrt((double)(mat[2] * mat[2] + mat[3] * mat[3])) + 1;
+  reduction = 1;
+  while (reduction < 64 &&
+	 width >= 2 * reduction * w && height >= 2 * reduction * h) {
+    reduction *= 2;
+  }
+  return reduction;
+}
+
+// Find the part of a <width> x <height> image, drawn with <mat>, which
+// lies inside the rectangle of <clip>, in image pixels, plus a margin
+// of <margin> pixels.  Returns false if that is the whole image.
+static GBool getVisibleImageRect(int width, int height, SplashCoord *mat,
+				 SplashClip *clip, int margin,
+				 int *x0, int *y0, int *x1, int *y1) {
+  double det, dx, dy, u, v, uMin, vMin, uMax, vMax;
+  int i;
+
+  det = mat[0] * mat[3] - mat[1] * mat[2];
+  if (fabs(det) < 0.000001) {
+    return gFalse;
+  }
+  uMin = vMin = 1;
+  uMax = vMax = 0;
+  for (i = 0; i < 4; ++i) {
+    dx = ((i & 1) ? clip->getXMax() + 1 : clip->getXMin()) - mat[4];
+    dy = ((i & 2) ? clip->getYMax() + 1 : clip->getYMin()) - mat[5];
+    u = (mat[3] * dx - mat[2] * dy) / det;
+    v = (mat[0] * dy - mat[1] * dx) / det;
+    if (u < uMin) {
+      uMin = u;
+    }
+    if (u > uMax) {
+      uMax = u;
+    }
+    if (v < vMin) {
+      vMin = v;
+    }
+    if (v > vMax) {
+      vMax = v;
+    }
+  }
+  *x0 = uMin > 0 ? (int)(uMin * width) - margin : 0;
+  *y0 = vMin > 0 ? (int)(vMin * height) - margin : 0;
+  *x1 = uMax < 1 ? (int)(uMax * width) + 1 + margin : width;
+  *y1 = vMax < 1 ? (int)(vMax * height) + 1 + margin : height;
+  return *x0 > 0 || *y0 > 0 || *x1 < width || *y1 < height;
+}
+
+// Read an image from <src> and reduce it by averaging <reduction> x
+// <reduction> blocks.  Returns NULL if the result would be bigger than
+// <maxSize> bytes.
+static SplashImageCacheEntry *decodeImage(SplashImageSource src,
+					  void *srcData,
+					  SplashColorMode mode,
+					  int width, int height,
+					  int reduction, int maxSize) {
+  SplashImageCacheEntry *entry;
+  SplashColorPtr line, p, q;
+  int *acc;
+  int nComps, w, h, rowSize, x, y, y1, yy, xx, blockW, blockH, n, i;
+
+  nComps = splashColorModeNComps[mode];
+  w = (width + reduction - 1) / reduction;
+  h = (height + reduction - 1) / reduction;
+  if (w > maxSize / nComps || h > maxSize / (w * nComps)) {
+    return NULL;
+  }
+  rowSize = w * nComps;
+
+  entry = new SplashImageCacheEntry;
+  entry->mode = mode;
+  entry->reduction = reduction;
+  entry->width = w;
+  entry->height = h;
+  entry->size = h * rowSize;
+  entry->data = (SplashColorPtr)gmallocn(h, rowSize);
+
+  if (reduction == 1) {
+    for (y = 0; y < height; ++y) {
+      (*src)(srcData, entry->data + y * rowSize);
+    }
+    return entry;
+  }
+
+  line = (SplashColorPtr)gmallocn(width, nComps);
+  acc = (int *)gmallocn(rowSize, sizeof(int));
+  for (y = 0, y1 = 0; y < h; ++y, y1 += reduction) {
+    memset(acc, 0, rowSize * sizeof(int));
+    blockH = height - y1 < reduction ? height - y1 : reduction;
+    for (yy = 0; yy < blockH; ++yy) {
+      (*src)(srcData, line);
+      p = line;
+      for (x = 0; x < w; ++x) {
+	blockW = width - x * reduction < reduction ? width - x * reduction
+	                                           : reduction;
+	for (xx = 0; xx < blockW; ++xx) {
+	  for (i = 0; i < nComps; ++i) {
+	    acc[x * nComps + i] += *p++;
+	  }
+	}
+      }
+    }
+    q = entry->data + y * rowSize;
+    for (x = 0; x < w; ++x) {
+      blockW = width - x * reduction < reduction ? width - x * reduction
+	                                         : reduction;
+      n = blockW * blockH;
+      for (i = 0; i < nComps; ++i) {
+	*q++ = (Guchar)((acc[x * nComps + i] + n / 2) / n);
+      }
+    }
+  }
+  gfree(acc);
+  gfree(line);
+  return entry;
+}
+
 struct SplashOutImageData {
   ImageStream *imgStr;
   GfxImageColorMap *colorMap;
   SplashColorPtr lookup;
+  Guchar *colorLine;		// converted pixels, for alphaImageSrc
   int *maskColors;
   SplashColorMode colorMode;
   int width, height, y;
@@ -1739,19 +2604,17 @@ GBool SplashOutputDev::imageSrc(void *data, SplashColorPtr line) {
   SplashOutImageData *imgData = (SplashOutImageData *)data;
   Guchar *p;
   SplashColorPtr q, col;
-  GfxRGB rgb;
-  GfxGray gray;
+  Guchar t;
 #if SPLASH_CMYK
   GfxCMYK cmyk;
+  int nComps;
 #endif
-  int nComps, x;
+  int x;
 
   if (imgData->y == imgData->height) {
     return gFalse;
   }
 
-  nComps = imgData->colorMap->getNumPixelComps();
-
   if (imgData->lookup) {
     switch (imgData->colorMode) {
     case splashModeMono1:
@@ -1799,35 +2662,25 @@ GBool SplashOutputDev::imageSrc(void *data, SplashColorPtr line) {
     switch (imgData->colorMode) {
     case splashModeMono1:
     case splashModeMono8:
-      for (x = 0, p = imgData->imgStr->getLine(), q = line;
-	   x < imgData->width;
-	   ++x, p += nComps) {
-	imgData->colorMap->getGray(p, &gray);
-	*q++ = colToByte(gray);
-      }
+      imgData->colorMap->getGrayLine(imgData->imgStr->getLine(),
+				     line, imgData->width);
       break;
     case splashModeRGB8:
-      for (x = 0, p = imgData->imgStr->getLine(), q = line;
-	   x < imgData->width;
-	   ++x, p += nComps) {
-	imgData->colorMap->getRGB(p, &rgb);
-	*q++ = colToByte(rgb.r);
-	*q++ = colToByte(rgb.g);
-	*q++ = colToByte(rgb.b);
-      }
+      imgData->colorMap->getRGBLine(imgData->imgStr->getLine(),
+				    line, imgData->width);
       break;
     case splashModeBGR8:
-      for (x = 0, p = imgData->imgStr->getLine(), q = line;
-	   x < imgData->width;
-	   ++x, p += nComps) {
-	imgData->colorMap->getRGB(p, &rgb);
-	*q++ = colToByte(rgb.b);
-	*q++ = colToByte(rgb.g);
-	*q++ = colToByte(rgb.r);
+      imgData->colorMap->getRGBLine(imgData->imgStr->getLine(),
+				    line, imgData->width);
+      for (x = 0, q = line; x < imgData->width; ++x, q += 3) {
+	t = q[0];
+	q[0] = q[2];
+	q[2] = t;
       }
       break;
 #if SPLASH_CMYK
     case splashModeCMYK8:
+      nComps = imgData->colorMap->getNumPixelComps();
       for (x = 0, p = imgData->imgStr->getLine(), q = line;
 	   x < imgData->width;
 	   ++x, p += nComps) {
@@ -1856,10 +2709,8 @@ GBool SplashOutputDev::imageSrc(void *data, SplashColorPtr line) {
 
 GBool SplashOutputDev::alphaImageSrc(void *data, SplashColorPtr line) {
   SplashOutImageData *imgData = (SplashOutImageData *)data;
-  Guchar *p;
+  Guchar *p, *c;
   SplashColorPtr q, col;
-  GfxRGB rgb;
-  GfxGray gray;
 #if SPLASH_CMYK
   GfxCMYK cmyk;
 #endif
@@ -1871,8 +2722,25 @@ GBool SplashOutputDev::alphaImageSrc(void *data, SplashColorPtr line) {
   }
 
   nComps = imgData->colorMap->getNumPixelComps();
+  p = imgData->imgStr->getLine();
+
+  // without a lookup table, convert the whole line up front
+  if (!imgData->lookup) {
+    switch (imgData->colorMode) {
+    case splashModeMono1:
+    case splashModeMono8:
+      imgData->colorMap->getGrayLine(p, imgData->colorLine, imgData->width);
+      break;
+    case splashModeRGB8:
+    case splashModeBGR8:
+      imgData->colorMap->getRGBLine(p, imgData->colorLine, imgData->width);
+      break;
+    default:
+      break;
+    }
+  }
 
-  for (x = 0, p = imgData->imgStr->getLine(), q = line;
+  for (x = 0, c = imgData->colorLine, q = line;
        x < imgData->width;
        ++x, p += nComps) {
     alpha = 0;
@@ -1927,23 +2795,22 @@ GBool SplashOutputDev::alphaImageSrc(void *data, SplashColorPtr line) {
       switch (imgData->colorMode) {
       case splashModeMono1:
       case splashModeMono8:
-	imgData->colorMap->getGray(p, &gray);
 	*q++ = alpha;
-	*q++ = colToByte(gray);
+	*q++ = *c++;
 	break;
       case splashModeRGB8:
-	imgData->colorMap->getRGB(p, &rgb);
 	*q++ = alpha;
-	*q++ = colToByte(rgb.r);
-	*q++ = colToByte(rgb.g);
-	*q++ = colToByte(rgb.b);
+	*q++ = c[0];
+	*q++ = c[1];
+	*q++ = c[2];
+	c += 3;
 	break;
       case splashModeBGR8:
-	imgData->colorMap->getRGB(p, &rgb);
-	*q++ = colToByte(rgb.b);
-	*q++ = colToByte(rgb.g);
-	*q++ = colToByte(rgb.r);
+	*q++ = c[2];
+	*q++ = c[1];
+	*q++ = c[0];
 	*q++ = alpha;
+	c += 3;
 	break;
 #if SPLASH_CMYK
       case splashModeCMYK8:
@@ -1978,6 +2845,8 @@ void SplashOutputDev::drawImage(GfxState *state, Object *ref, Stream *str,
   double *ctm;
   SplashCoord mat[6];
   SplashOutImageData imgData;
+  SplashOutCachedImageData cachedData;
+  SplashImageCacheEntry *cacheEntry;
   SplashColorMode srcMode;
   SplashImageSource src;
   GfxGray gray;
@@ -1986,7 +2855,9 @@ void SplashOutputDev::drawImage(GfxState *state, Object *ref, Stream *str,
   GfxCMYK cmyk;
 #endif
   Guchar pix;
-  int n, i;
+  GBool cacheable;
+  int reduction, strReduction;
+  int x0, y0, x1, y1, n, i;
 
   ctm = state->getCTM();
   mat[0] = ctm[0];
@@ -1996,6 +2867,67 @@ void SplashOutputDev::drawImage(GfxState *state, Object *ref, Stream *str,
   mat[4] = ctm[2] + ctm[4];
   mat[5] = ctm[3] + ctm[5];
 
+  switch (colorMode) {
+  case splashModeMono1:
+  case splashModeMono8:
+    srcMode = maskColors ? splashModeAMono8 : splashModeMono8;
+    break;
+  case splashModeRGB8:
+    srcMode = maskColors ? splashModeARGB8 : splashModeRGB8;
+    break;
+  case splashModeBGR8:
+    srcMode = maskColors ? splashModeBGRA8 : splashModeBGR8;
+    break;
+#if SPLASH_CMYK
+  case splashModeCMYK8:
+    srcMode = maskColors ? splashModeACMYK8 : splashModeCMYK8;
+    break;
+#endif
+  default:
+    //~ unimplemented
+    srcMode = splashModeRGB8;
+    break;
+  }  
+
+  // image XObjects are decoded once and kept in the image cache
+  cacheable = ref && ref->isRef() && !inlineImg;
+  reduction = inlineImg ? 1 : getImageReduction(width, height, mat);
+  if (cacheable) {
+    if ((cacheEntry = imageCache->lookup(ref->getRef(), srcMode,
+					 colorMap->getColorSpace()->getMode(),
+					 colorMap->getBits(), reduction))) {
+      cachedData.entry = cacheEntry;
+      cachedData.y = 0;
+      splash->drawImage(&cachedImageSrc, &cachedData, srcMode,
+			cacheEntry->width, cacheEntry->height, mat);
+      return;
+    }
+  }
+
+  // JPEG images are decoded at up to 1/8 of their size by the DCT
+  // decoder itself, and JPEG 2000 images at any reduction by the JPX
+  // decoder; decodeImage does any further reduction
+  strReduction = 1;
+  if (!inlineImg && str->getKind() == strDCT) {
+    strReduction = reduction < 8 ? reduction : 8;
+    ((DCTStream *)str)->setReduction(strReduction);
+  } else if (!inlineImg && str->getKind() == strJPX) {
+    strReduction = reduction;
+    ((JPXStream *)str)->setReduction(strReduction);
+    // JPEG 2000 images too big for the cache are only decoded where
+    // they can be seen (e.g., in the current slice of the page)
+    if ((double)((width + reduction - 1) / reduction) *
+	  ((height + reduction - 1) / reduction) *
+	  splashColorModeNComps[srcMode] > splashOutImageCacheSize &&
+	getVisibleImageRect(width, height, mat, splash->getClip(),
+			    2 * reduction, &x0, &y0, &x1, &y1)) {
+      ((JPXStream *)str)->setRegion(x0, y0, x1, y1);
+      cacheable = gFalse;
+    }
+  }
+  width = (width + strReduction - 1) / strReduction;
+  height = (height + strReduction - 1) / strReduction;
+
   imgData.imgStr = new ImageStream(str, width,
 				   colorMap->getNumPixelComps(),
 				   colorMap->getBits());
@@ -2061,29 +2993,38 @@ void SplashOutputDev::drawImage(GfxState *state, Object *ref, Stream *str,
     }
   }
 
-  switch (colorMode) {
-  case splashModeMono1:
-  case splashModeMono8:
-    srcMode = maskColors ? splashModeAMono8 : splashModeMono8;
-    break;
-  case splashModeRGB8:
-    srcMode = maskColors ? splashModeARGB8 : splashModeRGB8;
-    break;
-  case splashModeBGR8:
-    srcMode = maskColors ? splashModeBGRA8 : splashModeBGR8;
-    break;
-#if SPLASH_CMYK
-  case splashModeCMYK8:
-    srcMode = maskColors ? splashModeACMYK8 : splashModeCMYK8;
-    break;
-#endif
-  default:
-    //~ unimplemented
-    srcMode = splashModeRGB8;
-    break;
-  }  
+  // alphaImageSrc converts other images a line at a time into this
+  // buffer before interleaving the alpha values
+  imgData.colorLine = NULL;
+  if (!imgData.lookup && maskColors) {
+    imgData.colorLine = (Guchar *)gmallocn(width, 3);
+  }
+
   src = maskColors ? &alphaImageSrc : &imageSrc;
-  splash->drawImage(src, &imgData, srcMode, width, height, mat);
+
+  // images too big for the cache are drawn straight from the stream
+  cacheEntry = NULL;
+  if (cacheable) {
+    cacheEntry = decodeImage(src, &imgData, srcMode, width, height,
+			     reduction / strReduction,
+			     splashOutImageCacheSize);
+  }
+  if (cacheEntry) {
+    cacheEntry->ref = ref->getRef();
+    cacheEntry->reduction = reduction;
+    cacheEntry->csMode = colorMap->getColorSpace()->getMode();
+    cacheEntry->bits = colorMap->getBits();
+    cachedData.entry = cacheEntry;
+    cachedData.y = 0;
+    splash->drawImage(&cachedImageSrc, &cachedData, srcMode,
+		      cacheEntry->width, cacheEntry->height, mat);
+    if (!imageCache->add(cacheEntry)) {
+      gfree(cacheEntry->data);
+      delete cacheEntry;
+    }
+  } else {
+    splash->drawImage(src, &imgData, srcMode, width, height, mat);
+  }
   if (inlineImg) {
     while (imgData.y < height) {
       imgData.imgStr->getLine();
@@ -2092,6 +3033,7 @@ void SplashOutputDev::drawImage(GfxState *state, Object *ref, Stream *str,
   }
 
   gfree(imgData.lookup);
+  gfree(imgData.colorLine);
   delete imgData.imgStr;
   str->close();
 }
@@ -2101,17 +3043,16 @@ struct SplashOutMaskedImageData {
   GfxImageColorMap *colorMap;
   SplashBitmap *mask;
   SplashColorPtr lookup;
+  Guchar *colorLine;		// converted pixels
   SplashColorMode colorMode;
   int width, height, y;
 };
 
 GBool SplashOutputDev::maskedImageSrc(void *data, SplashColorPtr line) {
   SplashOutMaskedImageData *imgData = (SplashOutMaskedImageData *)data;
-  Guchar *p;
+  Guchar *p, *c;
   SplashColor maskColor;
   SplashColorPtr q, col;
-  GfxRGB rgb;
-  GfxGray gray;
 #if SPLASH_CMYK
   GfxCMYK cmyk;
 #endif
@@ -2123,8 +3064,25 @@ GBool SplashOutputDev::maskedImageSrc(void *data, SplashColorPtr line) {
   }
 
   nComps = imgData->colorMap->getNumPixelComps();
+  p = imgData->imgStr->getLine();
+
+  // without a lookup table, convert the whole line up front
+  if (!imgData->lookup) {
+    switch (imgData->colorMode) {
+    case splashModeMono1:
+    case splashModeMono8:
+      imgData->colorMap->getGrayLine(p, imgData->colorLine, imgData->width);
+      break;
+    case splashModeRGB8:
+    case splashModeBGR8:
+      imgData->colorMap->getRGBLine(p, imgData->colorLine, imgData->width);
+      break;
+    default:
+      break;
+    }
+  }
 
-  for (x = 0, p = imgData->imgStr->getLine(), q = line;
+  for (x = 0, c = imgData->colorLine, q = line;
        x < imgData->width;
        ++x, p += nComps) {
     imgData->mask->getPixel(x, imgData->y, maskColor);
@@ -2173,23 +3131,22 @@ GBool SplashOutputDev::maskedImageSrc(void *data, SplashColorPtr line) {
       switch (imgData->colorMode) {
       case splashModeMono1:
       case splashModeMono8:
-	imgData->colorMap->getGray(p, &gray);
 	*q++ = alpha;
-	*q++ = colToByte(gray);
+	*q++ = *c++;
 	break;
       case splashModeRGB8:
-	imgData->colorMap->getRGB(p, &rgb);
 	*q++ = alpha;
-	*q++ = colToByte(rgb.r);
-	*q++ = colToByte(rgb.g);
-	*q++ = colToByte(rgb.b);
+	*q++ = c[0];
+	*q++ = c[1];
+	*q++ = c[2];
+	c += 3;
 	break;
       case splashModeBGR8:
-	imgData->colorMap->getRGB(p, &rgb);
-	*q++ = colToByte(rgb.b);
-	*q++ = colToByte(rgb.g);
-	*q++ = colToByte(rgb.r);
+	*q++ = c[2];
+	*q++ = c[1];
+	*q++ = c[0];
 	*q++ = alpha;
+	c += 3;
 	break;
 #if SPLASH_CMYK
       case splashModeCMYK8:
@@ -2339,6 +3296,13 @@ void SplashOutputDev::drawMaskedImage(GfxState *state, Object *ref,
     }
   }
 
+  // maskedImageSrc converts other images a line at a time into this
+  // buffer before interleaving the alpha values
+  imgData.colorLine = NULL;
+  if (!imgData.lookup) {
+    imgData.colorLine = (Guchar *)gmallocn(width, 3);
+  }
+
   switch (colorMode) {
   case splashModeMono1:
   case splashModeMono8:
@@ -2364,6 +3328,7 @@ void SplashOutputDev::drawMaskedImage(GfxState *state, Object *ref,
 
   delete maskBitmap;
   gfree(imgData.lookup);
+  gfree(imgData.colorLine);
   delete imgData.imgStr;
   str->close();
 }
@@ -2406,6 +3371,7 @@ void SplashOutputDev::drawSoftMaskedImage(GfxState *state, Object *ref,
   imgMaskData.imgStr->reset();
   imgMaskData.colorMap = maskColorMap;
   imgMaskData.maskColors = NULL;
+  imgMaskData.colorLine = NULL;
   imgMaskData.colorMode = splashModeMono8;
   imgMaskData.width = maskWidth;
   imgMaskData.height = maskHeight;
@@ -2438,6 +3404,7 @@ void SplashOutputDev::drawSoftMaskedImage(GfxState *state, Object *ref,
   imgData.imgStr->reset();
   imgData.colorMap = colorMap;
   imgData.maskColors = NULL;
+  imgData.colorLine = NULL;
   imgData.colorMode = colorMode;
   imgData.width = width;
   imgData.height = height;
@@ -29,6 +29,7 @@ class SplashPattern;
 class SplashFontEngine;
 class SplashFont;
 class T3FontCache;
+class SplashImageCache;
 struct T3FontCacheTag;
 struct T3GlyphStack;
 
@@ -37,6 +38,9 @@ struct T3GlyphStack;
 // number of Type 3 fonts to cache
 #define splashOutT3FontCacheSize 8
 
+// memory used to cache decoded images, in bytes
+#define splashOutImageCacheSize (8 * 1024 * 1024)
+
 //------------------------------------------------------------------------
 // SplashOutputDev
 //------------------------------------------------------------------------
@@ -66,6 +70,12 @@ public:
   // text in Type 3 fonts will be drawn with drawChar/drawString.
   virtual GBool interpretType3Chars() { return gTrue; }
 
+  // Does this device use gouraudTriangleShadedFill() and
+  // patchMeshShadedFill()?  (Mono1 bitmaps are halftoned, so mesh
+  // shadings are reduced to flat fills.)
+  virtual GBool useMeshShadedFills()
+    { return colorMode != splashModeMono1; }
+
   //----- initialization and control
 
   // Start a page.
@@ -104,6 +114,10 @@ public:
   virtual void stroke(GfxState *state);
   virtual void fill(GfxState *state);
   virtual void eoFill(GfxState *state);
+  virtual void gouraudTriangleShadedFill(GfxState *state,
+					 GfxGouraudTriangleShading *shading);
+  virtual void patchMeshShadedFill(GfxState *state,
+				   GfxPatchMeshShading *shading);
 
   //----- path clipping
   virtual void clip(GfxState *state);
@@ -192,18 +206,36 @@ private:
   SplashPattern *getColor(GfxGray gray, GfxRGB *rgb);
 #endif
   SplashPath *convertPath(GfxState *state, GfxPath *path);
+  void getShadingColor(GfxColorSpace *colorSpace, GfxColor *color,
+		       SplashColorPtr dest);
+  void gouraudFillTriangle(double x0, double y0, GfxColor *color0,
+			   double x1, double y1, GfxColor *color1,
+			   double x2, double y2, GfxColor *color2,
+			   GfxColorSpace *colorSpace, int depth);
+  void gouraudFillTriangle(double x0, double y0, GfxColor *color0,
+			   SplashColorPtr dColor0,
+			   double x1, double y1, GfxColor *color1,
+			   SplashColorPtr dColor1,
+			   double x2, double y2, GfxColor *color2,
+			   SplashColorPtr dColor2,
+			   GfxColorSpace *colorSpace, int depth);
+  void fillPatch(GfxPatch *patch, GfxColorSpace *colorSpace,
+		 SplashColor *lookup, double tMin, double tMul, int depth);
   void drawType3Glyph(T3FontCache *t3Font,
 		      T3FontCacheTag *tag, Guchar *data,
 		      double x, double y);
   static GBool imageMaskSrc(void *data, SplashColorPtr line);
+  static GBool imageMaskRunSrc(void *data, int *runs, int *nRuns);
   static GBool imageSrc(void *data, SplashColorPtr line);
   static GBool alphaImageSrc(void *data, SplashColorPtr line);
   static GBool maskedImageSrc(void *data, SplashColorPtr line);
+  static GBool cachedImageSrc(void *data, SplashColorPtr line);
 
   SplashColorMode colorMode;
   int bitmapRowPad;
   GBool bitmapTopDown;
   GBool allowAntialias;
+  GBool vectorAntialias;	// anti-alias paths (set by startDoc)
   GBool reverseVideo;		// reverse video mode
   SplashColor paperColor;	// paper color
 
@@ -218,9 +250,12 @@ private:
   int nT3Fonts;			// number of valid entries in t3FontCache
   T3GlyphStack *t3GlyphStack;	// Type 3 glyph context stack
 
+  SplashImageCache *imageCache;	// decoded image XObjects
+
   SplashFont *font;		// current font
   GBool needFontUpdate;		// set when the font needs to be updated
   SplashPath *textClipPath;	// clipping path built with text object
+  SplashPath *convPath;		// buffer for convertPath
 };
 
 #endif
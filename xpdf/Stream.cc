@@ -20,9 +20,18 @@
 #endif
 #include <string.h>
 #include <ctype.h>
+#ifndef WIN32
+#include <sys/mman.h>
+#endif
 #include "gmem.h"
 #include "gfile.h"
+#include "defines.h"
+#if MULTITHREADED
+#include "GMutex.h"
+#endif
+#include "GString.h"
 #include "config.h"
+#include "GlobalParams.h"
 #include "Error.h"
 #include "Object.h"
 #include "Lexer.h"
@@ -32,6 +41,8 @@
 #include "JBIG2Stream.h"
 #include "JPXStream.h"
 #include "Stream-CCITT.h"
+#include "DCTKernels.h"
+#include "PredictorKernels.h"
 
 #ifdef __DJGPP__
 static GBool setDJSYSFLAGS = gFalse;
@@ -64,6 +75,18 @@ int Stream::getRawChar() {
   return EOF;
 }
 
+int Stream::getRawBlock(char *blk, int size) {
+  int n, c;
+
+  for (n = 0; n < size; ++n) {
+    if ((c = getRawChar()) == EOF) {
+      break;
+    }
+    blk[n] = (char)c;
+  }
+  return n;
+}
+
 char *Stream::getLine(char *buf, int size) {
   int i;
   int c;
@@ -85,6 +108,18 @@ char *Stream::getLine(char *buf, int size) {
   return buf;
 }
 
+int Stream::getBlock(char *blk, int size) {
+  int n, c;
+
+  for (n = 0; n < size; ++n) {
+    if ((c = getChar()) == EOF) {
+      break;
+    }
+    blk[n] = (char)c;
+  }
+  return n;
+}
+
 GString *Stream::getPSFilter(int psLevel, char *indent) {
   return new GString();
 }
@@ -141,7 +176,7 @@ Stream *Stream::makeFilter(char *name, Stream *str, Object *params) {
   int encoding;
   GBool endOfLine, byteAlign, endOfBlock, black;
   int columns, rows;
-  Object globals, obj;
+  Object globals, globalsRef, obj;
 
   if (!strcmp(name, "ASCIIHexDecode") || !strcmp(name, "AHx")) {
     str = new ASCIIHexStream(str);
@@ -254,8 +289,13 @@ Stream *Stream::makeFilter(char *name, Stream *str, Object *params) {
   } else if (!strcmp(name, "JBIG2Decode")) {
     if (params->isDict()) {
       params->dictLookup("JBIG2Globals", &globals);
+      params->dictLookupNF("JBIG2Globals", &globalsRef);
+      str = new JBIG2Stream(str, &globals, &globalsRef,
+			    params->getDict()->getXRef());
+      globalsRef.free();
+    } else {
+      str = new JBIG2Stream(str, &globals);
     }
-    str = new JBIG2Stream(str, &globals);
     globals.free();
   } else if (!strcmp(name, "JPXDecode")) {
     str = new JPXStream(str);
@@ -367,8 +407,10 @@ Guchar *ImageStream::getLine() {
       imgLine[i+7] = (Guchar)(c & 1);
     }
   } else if (nBits == 8) {
-    for (i = 0; i < nVals; ++i) {
-      imgLine[i] = str->getChar();
+    // a short read is padded as getChar's EOF would be
+    i = str->getBlock((char *)imgLine, nVals);
+    for (; i < nVals; ++i) {
+      imgLine[i] = 0xff;
     }
   } else {
     bitMask = (1 << nBits) - 1;
@@ -412,11 +454,14 @@ StreamPredictor::StreamPredictor(Stream *strA, int predictorA,
   rowBytes = ((nVals * nBits + 7) >> 3) + pixBytes;
   predLine = (Guchar *)gmalloc(rowBytes);
   memset(predLine, 0, rowBytes);
+  prevLine = (Guchar *)gmalloc(rowBytes);
+  memset(prevLine, 0, rowBytes);
   predIdx = rowBytes;
 }
 
 StreamPredictor::~StreamPredictor() {
   gfree(predLine);
+  gfree(prevLine);
 }
 
 int StreamPredictor::lookChar() {
@@ -437,14 +482,34 @@ int StreamPredictor::getChar() {
   return predLine[predIdx++];
 }
 
+int StreamPredictor::getBlock(char *blk, int size) {
+  int n, m;
+
+  n = 0;
+  while (n < size) {
+    if (predIdx >= rowBytes) {
+      if (!getNextLine()) {
+	break;
+      }
+    }
+    m = rowBytes - predIdx;
+    if (m > size - n) {
+      m = size - n;
+    }
+    memcpy(blk + n, predLine + predIdx, m);
+    predIdx += m;
+    n += m;
+  }
+  return n;
+}
+
 GBool StreamPredictor::getNextLine() {
   int curPred;
   Guchar upLeftBuf[gfxColorMaxComps * 2 + 1];
-  int left, up, upLeft, p, pa, pb, pc;
-  int c;
+  Guchar *p;
   Gulong inBuf, outBuf, bitMask;
   int inBits, outBits;
-  int i, j, k, kk;
+  int n, i, j, k, kk;
 
   // get PNG optimum predictor number
   if (predictor >= 10) {
@@ -456,56 +521,29 @@ GBool StreamPredictor::getNextLine() {
     curPred = predictor;
   }
 
-  // read the raw line, apply PNG (byte) predictor
-  memset(upLeftBuf, 0, pixBytes + 1);
-  for (i = pixBytes; i < rowBytes; ++i) {
-    for (j = pixBytes; j > 0; --j) {
-      upLeftBuf[j] = upLeftBuf[j-1];
-    }
-    upLeftBuf[0] = predLine[i];
-    if ((c = str->getRawChar()) == EOF) {
-      if (i > pixBytes) {
-	// this ought to return false, but some (broken) PDF files
-	// contain truncated image data, and Adobe apparently reads the
-	// last partial line
-	break;
-      }
+  // read the raw line into predLine, keeping the previous line (for
+  // the PNG predictors) in prevLine
+  p = prevLine;
+  prevLine = predLine;
+  predLine = p;
+  n = str->getRawBlock((char *)predLine + pixBytes, rowBytes - pixBytes);
+  if (n < rowBytes - pixBytes) {
+    if (n == 0) {
+      predLine = prevLine;
+      prevLine = p;
       return gFalse;
     }
-    switch (curPred) {
-    case 11:			// PNG sub
-      predLine[i] = predLine[i - pixBytes] + (Guchar)c;
-      break;
-    case 12:			// PNG up
-      predLine[i] = predLine[i] + (Guchar)c;
-      break;
-    case 13:			// PNG average
-      predLine[i] = ((predLine[i - pixBytes] + predLine[i]) >> 1) +
-	            (Guchar)c;
-      break;
-    case 14:			// PNG Paeth
-      left = predLine[i - pixBytes];
-      up = predLine[i];
-      upLeft = upLeftBuf[pixBytes];
-      p = left + up - upLeft;
-      if ((pa = p - left) < 0)
-	pa = -pa;
-      if ((pb = p - up) < 0)
-	pb = -pb;
-      if ((pc = p - upLeft) < 0)
-	pc = -pc;
-      if (pa <= pb && pa <= pc)
-	predLine[i] = left + (Guchar)c;
-      else if (pb <= pc)
-	predLine[i] = up + (Guchar)c;
-      else
-	predLine[i] = upLeft + (Guchar)c;
-      break;
-    case 10:			// PNG none
-    default:			// no predictor or TIFF predictor
-      predLine[i] = (Guchar)c;
-      break;
-    }
+    // this ought to return false, but some (broken) PDF files
+    // contain truncated image data, and Adobe apparently reads the
+    // last partial line (the rest of the previous line is kept)
+    memcpy(predLine + pixBytes + n, prevLine + pixBytes + n,
+	   rowBytes - pixBytes - n);
+  }
+
+  // apply PNG (byte) predictor
+  if (curPred >= 11 && curPred <= 14) {
+    predUndoPNG(curPred - 10, predLine + pixBytes, prevLine + pixBytes,
+		n, pixBytes);
   }
 
   // apply TIFF (component) predictor
@@ -518,9 +556,9 @@ GBool StreamPredictor::getNextLine() {
 	predLine[i] ^= inBuf >> nComps;
       }
     } else if (nBits == 8) {
-      for (i = pixBytes; i < rowBytes; ++i) {
-	predLine[i] += predLine[i - nComps];
-      }
+      // same as the PNG sub predictor, as pixBytes = nComps
+      predUndoPNG(predPNGSub, predLine + pixBytes, prevLine + pixBytes,
+		  rowBytes - pixBytes, pixBytes);
     } else {
       memset(upLeftBuf, 0, nComps + 1);
       bitMask = (1 << nBits) - 1;
@@ -641,6 +679,25 @@ GBool FileStream::fillBuf() {
   return gTrue;
 }
 
+int FileStream::getBlock(char *blk, int size) {
+  int n, m;
+
+  n = 0;
+  while (n < size) {
+    if (bufPtr >= bufEnd && !fillBuf()) {
+      break;
+    }
+    m = (int)(bufEnd - bufPtr);
+    if (m > size - n) {
+      m = size - n;
+    }
+    memcpy(blk + n, bufPtr, m);
+    bufPtr += m;
+    n += m;
+  }
+  return n;
+}
+
 void FileStream::setPos(Guint pos, int dir) {
   Guint size;
 
@@ -734,6 +791,18 @@ void MemStream::reset() {
 void MemStream::close() {
 }
 
+int MemStream::getBlock(char *blk, int size) {
+  int n;
+
+  n = (int)(bufEnd - bufPtr);
+  if (n > size) {
+    n = size;
+  }
+  memcpy(blk, bufPtr, n);
+  bufPtr += n;
+  return n;
+}
+
 void MemStream::setPos(Guint pos, int dir) {
   Guint i;
 
@@ -1062,6 +1131,34 @@ int LZWStream::getRawChar() {
   return seqBuf[seqIndex++];
 }
 
+int LZWStream::getBlock(char *blk, int size) {
+  if (pred) {
+    return pred->getBlock(blk, size);
+  }
+  return getRawBlock(blk, size);
+}
+
+int LZWStream::getRawBlock(char *blk, int size) {
+  int n, m;
+
+  n = 0;
+  while (n < size && !eof) {
+    if (seqIndex >= seqLength) {
+      if (!processNextCode()) {
+	break;
+      }
+    }
+    m = seqLength - seqIndex;
+    if (m > size - n) {
+      m = size - n;
+    }
+    memcpy(blk + n, seqBuf + seqIndex, m);
+    seqIndex += m;
+    n += m;
+  }
+  return n;
+}
+
 void LZWStream::reset() {
   str->reset();
   eof = gFalse;
@@ -1310,9 +1407,6 @@ void CCITTFaxStream::reset() {
 }
 
 int CCITTFaxStream::lookChar() {
-  short code1, code2, code3;
-  int a0New;
-  GBool err, gotEOL;
   int ret;
   int bits, i;
 
@@ -1322,233 +1416,10 @@ int CCITTFaxStream::lookChar() {
   }
 
   // read the next row
-  err = gFalse;
   if (codingLine[a0] >= columns) {
-
-    // 2-D encoding
-    if (nextLine2D) {
-      for (i = 0; codingLine[i] < columns; ++i)
-	refLine[i] = codingLine[i];
-      refLine[i] = refLine[i + 1] = columns;
-      b1 = 1;
-      a0New = codingLine[a0 = 0] = 0;
-      do {
-	code1 = getTwoDimCode();
-	switch (code1) {
-	case twoDimPass:
-	  if (refLine[b1] < columns) {
-	    a0New = refLine[b1 + 1];
-	    b1 += 2;
-	  }
-	  break;
-	case twoDimHoriz:
-	  if ((a0 & 1) == 0) {
-	    code1 = code2 = 0;
-	    do {
-	      code1 += code3 = getWhiteCode();
-	    } while (code3 >= 64);
-	    do {
-	      code2 += code3 = getBlackCode();
-	    } while (code3 >= 64);
-	  } else {
-	    code1 = code2 = 0;
-	    do {
-	      code1 += code3 = getBlackCode();
-	    } while (code3 >= 64);
-	    do {
-	      code2 += code3 = getWhiteCode();
-	    } while (code3 >= 64);
-	  }
-	  if (code1 > 0 || code2 > 0) {
-	    codingLine[a0 + 1] = a0New + code1;
-	    ++a0;
-	    a0New = codingLine[a0 + 1] = codingLine[a0] + code2;
-	    ++a0;
-	    while (refLine[b1] <= codingLine[a0] && refLine[b1] < columns)
-	      b1 += 2;
-	  }
-	  break;
-	case twoDimVert0:
-	  a0New = codingLine[++a0] = refLine[b1];
-	  if (refLine[b1] < columns) {
-	    ++b1;
-	    while (refLine[b1] <= codingLine[a0] && refLine[b1] < columns)
-	      b1 += 2;
-	  }
-	  break;
-	case twoDimVertR1:
-	  a0New = codingLine[++a0] = refLine[b1] + 1;
-	  if (refLine[b1] < columns) {
-	    ++b1;
-	    while (refLine[b1] <= codingLine[a0] && refLine[b1] < columns)
-	      b1 += 2;
-	  }
-	  break;
-	case twoDimVertL1:
-	  if (a0 == 0 || refLine[b1] - 1 > a0New) {
-	    a0New = codingLine[++a0] = refLine[b1] - 1;
-	    --b1;
-	    while (refLine[b1] <= codingLine[a0] && refLine[b1] < columns)
-	      b1 += 2;
-	  }
-	  break;
-	case twoDimVertR2:
-	  a0New = codingLine[++a0] = refLine[b1] + 2;
-	  if (refLine[b1] < columns) {
-	    ++b1;
-	    while (refLine[b1] <= codingLine[a0] && refLine[b1] < columns)
-	      b1 += 2;
-	  }
-	  break;
-	case twoDimVertL2:
-	  if (a0 == 0 || refLine[b1] - 2 > a0New) {
-	    a0New = codingLine[++a0] = refLine[b1] - 2;
-	    --b1;
-	    while (refLine[b1] <= codingLine[a0] && refLine[b1] < columns)
-	      b1 += 2;
-	  }
-	  break;
-	case twoDimVertR3:
-	  a0New = codingLine[++a0] = refLine[b1] + 3;
-	  if (refLine[b1] < columns) {
-	    ++b1;
-	    while (refLine[b1] <= codingLine[a0] && refLine[b1] < columns)
-	      b1 += 2;
-	  }
-	  break;
-	case twoDimVertL3:
-	  if (a0 == 0 || refLine[b1] - 3 > a0New) {
-	    a0New = codingLine[++a0] = refLine[b1] - 3;
-	    --b1;
-	    while (refLine[b1] <= codingLine[a0] && refLine[b1] < columns)
-	      b1 += 2;
-	  }
-	  break;
-	case EOF:
-	  eof = gTrue;
-	  codingLine[a0 = 0] = columns;
-	  return EOF;
-	default:
-	  error(getPos(), "Bad 2D code %04x in CCITTFax stream", code1);
-	  err = gTrue;
-	  break;
-	}
-      } while (codingLine[a0] < columns);
-
-    // 1-D encoding
-    } else {
-      codingLine[a0 = 0] = 0;
-      while (1) {
-	code1 = 0;
-	do {
-	  code1 += code3 = getWhiteCode();
-	} while (code3 >= 64);
-	codingLine[a0+1] = codingLine[a0] + code1;
-	++a0;
-	if (codingLine[a0] >= columns)
-	  break;
-	code2 = 0;
-	do {
-	  code2 += code3 = getBlackCode();
-	} while (code3 >= 64);
-	codingLine[a0+1] = codingLine[a0] + code2;
-	++a0;
-	if (codingLine[a0] >= columns)
-	  break;
-      }
-    }
-
-    if (codingLine[a0] != columns) {
-      error(getPos(), "CCITTFax row is wrong length (%d)", codingLine[a0]);
-      // force the row to be the correct length
-      while (codingLine[a0] > columns) {
-	--a0;
-      }
-      codingLine[++a0] = columns;
-      err = gTrue;
-    }
-
-    // byte-align the row
-    if (byteAlign) {
-      inputBits &= ~7;
-    }
-
-    // check for end-of-line marker, skipping over any extra zero bits
-    gotEOL = gFalse;
-    if (!endOfBlock && row == rows - 1) {
-      eof = gTrue;
-    } else {
-      code1 = lookBits(12);
-      while (code1 == 0) {
-	eatBits(1);
-	code1 = lookBits(12);
-      }
-      if (code1 == 0x001) {
-	eatBits(12);
-	gotEOL = gTrue;
-      } else if (code1 == EOF) {
-	eof = gTrue;
-      }
-    }
-
-    // get 2D encoding tag
-    if (!eof && encoding > 0) {
-      nextLine2D = !lookBits(1);
-      eatBits(1);
-    }
-
-    // check for end-of-block marker
-    if (endOfBlock && gotEOL) {
-      code1 = lookBits(12);
-      if (code1 == 0x001) {
-	eatBits(12);
-	if (encoding > 0) {
-	  lookBits(1);
-	  eatBits(1);
-	}
-	if (encoding >= 0) {
-	  for (i = 0; i < 4; ++i) {
-	    code1 = lookBits(12);
-	    if (code1 != 0x001) {
-	      error(getPos(), "Bad RTC code in CCITTFax stream");
-	    }
-	    eatBits(12);
-	    if (encoding > 0) {
-	      lookBits(1);
-	      eatBits(1);
-	    }
-	  }
-	}
-	eof = gTrue;
-      }
-
-    // look for an end-of-line marker after an error -- we only do
-    // this if we know the stream contains end-of-line markers because
-    // the "just plow on" technique tends to work better otherwise
-    } else if (err && endOfLine) {
-      do {
-	if (code1 == EOF) {
-	  eof = gTrue;
-	  return EOF;
-	}
-	eatBits(1);
-	code1 = lookBits(13);
-      } while ((code1 >> 1) != 0x001);
-      eatBits(12); 
-      if (encoding > 0) {
-	eatBits(1);
-	nextLine2D = !(code1 & 1);
-      }
-    }
-
-    a0 = 0;
-    outputBits = codingLine[1] - codingLine[0];
-    if (outputBits == 0) {
-      a0 = 1;
-      outputBits = codingLine[2] - codingLine[1];
+    if (!readRow()) {
+      return EOF;
     }
-
-    ++row;
   }
 
   // get a byte
@@ -1589,6 +1460,273 @@ int CCITTFaxStream::lookChar() {
   return buf;
 }
 
+// The changing elements in codingLine delimit the runs directly: the
+// white runs start at the even indexes, and the black runs at the odd
+// ones.
+int CCITTFaxStream::getRuns(int *runs) {
+  int n, i;
+
+  if (codingLine[a0] >= columns) {
+    if (eof || !readRow()) {
+      return -1;
+    }
+  }
+  n = 0;
+  for (i = black ? 1 : 0; codingLine[i] < columns; i += 2) {
+    if (codingLine[i + 1] > codingLine[i]) {
+      runs[2*n] = codingLine[i];
+      runs[2*n+1] = codingLine[i + 1] < columns ? codingLine[i + 1]
+	                                          : columns;
+      ++n;
+    }
+    if (codingLine[i + 1] >= columns) {
+      ++i;
+      break;
+    }
+  }
+  a0 = i;
+  buf = EOF;
+  return n;
+}
+
+// Decode the next row into codingLine.  Returns false at the end of
+// the stream.
+GBool CCITTFaxStream::readRow() {
+  short code1, code2, code3;
+  int a0New;
+  GBool err, gotEOL;
+  int i;
+
+  err = gFalse;
+
+  // 2-D encoding
+  if (nextLine2D) {
+    for (i = 0; codingLine[i] < columns; ++i)
+      refLine[i] = codingLine[i];
+    refLine[i] = refLine[i + 1] = columns;
+    b1 = 1;
+    a0New = codingLine[a0 = 0] = 0;
+    do {
+      code1 = getTwoDimCode();
+      switch (code1) {
+      case twoDimPass:
+	if (refLine[b1] < columns) {
+	  a0New = refLine[b1 + 1];
+	  b1 += 2;
+	}
+	break;
+      case twoDimHoriz:
+	if ((a0 & 1) == 0) {
+	  code1 = code2 = 0;
+	  do {
+	    code1 += code3 = getWhiteCode();
+	  } while (code3 >= 64);
+	  do {
+	    code2 += code3 = getBlackCode();
+	  } while (code3 >= 64);
+	} else {
+	  code1 = code2 = 0;
+	  do {
+	    code1 += code3 = getBlackCode();
+	  } while (code3 >= 64);
+	  do {
+	    code2 += code3 = getWhiteCode();
+	  } while (code3 >= 64);
+	}
+	if (code1 > 0 || code2 > 0) {
+	  codingLine[a0 + 1] = a0New + code1;
+	  ++a0;
+	  a0New = codingLine[a0 + 1] = codingLine[a0] + code2;
+	  ++a0;
+	  while (refLine[b1] <= codingLine[a0] && refLine[b1] < columns)
+	    b1 += 2;
+	}
+	break;
+      case twoDimVert0:
+	a0New = codingLine[++a0] = refLine[b1];
+	if (refLine[b1] < columns) {
+	  ++b1;
+	  while (refLine[b1] <= codingLine[a0] && refLine[b1] < columns)
+	    b1 += 2;
+	}
+	break;
+      case twoDimVertR1:
+	a0New = codingLine[++a0] = refLine[b1] + 1;
+	if (refLine[b1] < columns) {
+	  ++b1;
+	  while (refLine[b1] <= codingLine[a0] && refLine[b1] < columns)
+	    b1 += 2;
+	}
+	break;
+      case twoDimVertL1:
+	if (a0 == 0 || refLine[b1] - 1 > a0New) {
+	  a0New = codingLine[++a0] = refLine[b1] - 1;
+	  --b1;
+	  while (refLine[b1] <= codingLine[a0] && refLine[b1] < columns)
+	    b1 += 2;
+	}
+	break;
+      case twoDimVertR2:
+	a0New = codingLine[++a0] = refLine[b1] + 2;
+	if (refLine[b1] < columns) {
+	  ++b1;
+	  while (refLine[b1] <= codingLine[a0] && refLine[b1] < columns)
+	    b1 += 2;
+	}
+	break;
+      case twoDimVertL2:
+	if (a0 == 0 || refLine[b1] - 2 > a0New) {
+	  a0New = codingLine[++a0] = refLine[b1] - 2;
+	  --b1;
+	  while (refLine[b1] <= codingLine[a0] && refLine[b1] < columns)
+	    b1 += 2;
+	}
+	break;
+      case twoDimVertR3:
+	a0New = codingLine[++a0] = refLine[b1] + 3;
+	if (refLine[b1] < columns) {
+	  ++b1;
+	  while (refLine[b1] <= codingLine[a0] && refLine[b1] < columns)
+	    b1 += 2;
+	}
+	break;
+      case twoDimVertL3:
+	if (a0 == 0 || refLine[b1] - 3 > a0New) {
+	  a0New = codingLine[++a0] = refLine[b1] - 3;
+	  --b1;
+	  while (refLine[b1] <= codingLine[a0] && refLine[b1] < columns)
+	    b1 += 2;
+	}
+	break;
+      case EOF:
+	eof = gTrue;
+	codingLine[a0 = 0] = columns;
+	return gFalse;
+      default:
+	error(getPos(), "Bad 2D code %04x in CCITTFax stream", code1);
+	err = gTrue;
+	break;
+      }
+    } while (codingLine[a0] < columns);
+
+  // 1-D encoding
+  } else {
+    codingLine[a0 = 0] = 0;
+    while (1) {
+      code1 = 0;
+      do {
+	code1 += code3 = getWhiteCode();
+      } while (code3 >= 64);
+      codingLine[a0+1] = codingLine[a0] + code1;
+      ++a0;
+      if (codingLine[a0] >= columns)
+	break;
+      code2 = 0;
+      do {
+	code2 += code3 = getBlackCode();
+      } while (code3 >= 64);
+      codingLine[a0+1] = codingLine[a0] + code2;
+      ++a0;
+      if (codingLine[a0] >= columns)
+	break;
+    }
+  }
+
+  if (codingLine[a0] != columns) {
+    error(getPos(), "CCITTFax row is wrong length (%d)", codingLine[a0]);
+    // force the row to be the correct length
+    while (codingLine[a0] > columns) {
+      --a0;
+    }
+    codingLine[++a0] = columns;
+    err = gTrue;
+  }
+
+  // byte-align the row
+  if (byteAlign) {
+    inputBits &= ~7;
+  }
+
+  // check for end-of-line marker, skipping over any extra zero bits
+  gotEOL = gFalse;
+  if (!endOfBlock && row == rows - 1) {
+    eof = gTrue;
+  } else {
+    code1 = lookBits(12);
+    while (code1 == 0) {
+      eatBits(1);
+      code1 = lookBits(12);
+    }
+    if (code1 == 0x001) {
+      eatBits(12);
+      gotEOL = gTrue;
+    } else if (code1 == EOF) {
+      eof = gTrue;
+    }
+  }
+
+  // get 2D encoding tag
+  if (!eof && encoding > 0) {
+    nextLine2D = !lookBits(1);
+    eatBits(1);
+  }
+
+  // check for end-of-block marker
+  if (endOfBlock && gotEOL) {
+    code1 = lookBits(12);
+    if (code1 == 0x001) {
+      eatBits(12);
+      if (encoding > 0) {
+	lookBits(1);
+	eatBits(1);
+      }
+      if (encoding >= 0) {
+	for (i = 0; i < 4; ++i) {
+	  code1 = lookBits(12);
+	  if (code1 != 0x001) {
+	    error(getPos(), "Bad RTC code in CCITTFax stream");
+	  }
+	  eatBits(12);
+	  if (encoding > 0) {
+	    lookBits(1);
+	    eatBits(1);
+	  }
+	}
+      }
+      eof = gTrue;
+    }
+
+  // look for an end-of-line marker after an error -- we only do
+  // this if we know the stream contains end-of-line markers because
+  // the "just plow on" technique tends to work better otherwise
+  } else if (err && endOfLine) {
+    do {
+      if (code1 == EOF) {
+	eof = gTrue;
+	return gFalse;
+      }
+      eatBits(1);
+      code1 = lookBits(13);
+    } while ((code1 >> 1) != 0x001);
+    eatBits(12); 
+    if (encoding > 0) {
+      eatBits(1);
+      nextLine2D = !(code1 & 1);
+    }
+  }
+
+  a0 = 0;
+  outputBits = codingLine[1] - codingLine[0];
+  if (outputBits == 0) {
+    a0 = 1;
+    outputBits = codingLine[2] - codingLine[1];
+  }
+
+  ++row;
+
+  return gTrue;
+}
+
 short CCITTFaxStream::getTwoDimCode() {
   short code;
   const CCITTCode *p;
@@ -1596,15 +1734,18 @@ short CCITTFaxStream::getTwoDimCode() {
 
   code = 0; // make gcc happy
   if (endOfBlock) {
-    code = lookBits(7);
-    p = &twoDimTab1[code];
-    if (p->bits > 0) {
-      eatBits(p->bits);
-      return p->n;
+    if ((code = lookBits(7)) != EOF) {
+      p = &twoDimTab1[code];
+      if (p->bits > 0) {
+	eatBits(p->bits);
+	return p->n;
+      }
     }
   } else {
     for (n = 1; n <= 7; ++n) {
-      code = lookBits(n);
+      if ((code = lookBits(n)) == EOF) {
+	break;
+      }
       if (n < 7) {
 	code <<= 7 - n;
       }
@@ -1626,19 +1767,22 @@ short CCITTFaxStream::getWhiteCode() {
 
   code = 0; // make gcc happy
   if (endOfBlock) {
-    code = lookBits(12);
-    if ((code >> 5) == 0) {
-      p = &whiteTab1[code];
-    } else {
-      p = &whiteTab2[code >> 3];
-    }
-    if (p->bits > 0) {
-      eatBits(p->bits);
-      return p->n;
+    if ((code = lookBits(12)) != EOF) {
+      if ((code >> 5) == 0) {
+	p = &whiteTab1[code];
+      } else {
+	p = &whiteTab2[code >> 3];
+      }
+      if (p->bits > 0) {
+	eatBits(p->bits);
+	return p->n;
+      }
     }
   } else {
     for (n = 1; n <= 9; ++n) {
-      code = lookBits(n);
+      if ((code = lookBits(n)) == EOF) {
+	break;
+      }
       if (n < 9) {
 	code <<= 9 - n;
       }
@@ -1648,8 +1792,10 @@ short CCITTFaxStream::getWhiteCode() {
 	return p->n;
       }
     }
-    for (n = 11; n <= 12; ++n) {
-      code = lookBits(n);
+    for (n = 11; n <= 12 && code != EOF; ++n) {
+      if ((code = lookBits(n)) == EOF) {
+	break;
+      }
       if (n < 12) {
 	code <<= 12 - n;
       }
@@ -1674,21 +1820,24 @@ short CCITTFaxStream::getBlackCode() {
 
   code = 0; // make gcc happy
   if (endOfBlock) {
-    code = lookBits(13);
-    if ((code >> 7) == 0) {
-      p = &blackTab1[code];
-    } else if ((code >> 9) == 0) {
-      p = &blackTab2[(code >> 1) - 64];
-    } else {
-      p = &blackTab3[code >> 7];
-    }
-    if (p->bits > 0) {
-      eatBits(p->bits);
-      return p->n;
+    if ((code = lookBits(13)) != EOF) {
+      if ((code >> 7) == 0) {
+	p = &blackTab1[code];
+      } else if ((code >> 9) == 0) {
+	p = &blackTab2[(code >> 1) - 64];
+      } else {
+	p = &blackTab3[code >> 7];
+      }
+      if (p->bits > 0) {
+	eatBits(p->bits);
+	return p->n;
+      }
     }
   } else {
     for (n = 2; n <= 6; ++n) {
-      code = lookBits(n);
+      if ((code = lookBits(n)) == EOF) {
+	break;
+      }
       if (n < 6) {
 	code <<= 6 - n;
       }
@@ -1698,8 +1847,10 @@ short CCITTFaxStream::getBlackCode() {
 	return p->n;
       }
     }
-    for (n = 7; n <= 12; ++n) {
-      code = lookBits(n);
+    for (n = 7; n <= 12 && code != EOF; ++n) {
+      if ((code = lookBits(n)) == EOF) {
+	break;
+      }
       if (n < 12) {
 	code <<= 12 - n;
       }
@@ -1711,8 +1862,10 @@ short CCITTFaxStream::getBlackCode() {
 	}
       }
     }
-    for (n = 10; n <= 13; ++n) {
-      code = lookBits(n);
+    for (n = 10; n <= 13 && code != EOF; ++n) {
+      if ((code = lookBits(n)) == EOF) {
+	break;
+      }
       if (n < 13) {
 	code <<= 13 - n;
       }
@@ -1795,21 +1948,21 @@ GBool CCITTFaxStream::isBinary(GBool last) {
 // DCTStream
 //------------------------------------------------------------------------
 
-// IDCT constants (20.12 fixed point format)
-#define dctCos1    4017		// cos(pi/16)
-#define dctSin1     799		// sin(pi/16)
-#define dctCos3    3406		// cos(3*pi/16)
-#define dctSin3    2276		// sin(3*pi/16)
-#define dctCos6    1567		// cos(6*pi/16)
-#define dctSin6    3784		// sin(6*pi/16)
-#define dctSqrt2   5793		// sqrt(2)
-#define dctSqrt1d2 2896		// sqrt(2) / 2
-
-// color conversion parameters (16.16 fixed point format)
-#define dctCrToR   91881	//  1.4020
-#define dctCbToG  -22553	// -0.3441363
-#define dctCrToG  -46802	// -0.71413636
-#define dctCbToB  116130	//  1.772
+// reduced IDCT matrices (20.12 fixed point format): for decoding at
+// 1/2 (1/4) scale, each output sample is the 8-point IDCT evaluated
+// at the centre of the 2x2 (4x4) block of pixels it replaces, which
+// only needs the 4x4 (2x2) lowest frequency coefficients:
+//   dctReducedN[i][u] = C(u)/2 * cos((2i+1) * u * pi / 2N)
+static int dctReduced4[4][4] = {
+  { 1448,  1892,  1448,   784 },
+  { 1448,   784, -1448, -1892 },
+  { 1448,  -784, -1448,  1892 },
+  { 1448, -1892,  1448,  -784 }
+};
+static int dctReduced2[2][2] = {
+  { 1448,  1448 },
+  { 1448, -1448 }
+};
 
 // clip [-256,511] --> [0,255]
 #define dctClipOffset 256
@@ -1835,13 +1988,43 @@ static int dctZigZag[64] = {
   63
 };
 
+// memory used by DCTStream buffers in this thread, and its peak --
+// without thread-local storage (see OP_THREAD_CACHE in goo/defines.h)
+// they count the buffers of all threads, under dctMemMutex
+#if OP_THREAD_CACHE
+static OP_THREAD_LOCAL int dctMemUsed = 0;
+static OP_THREAD_LOCAL int dctPeakMemUsed = 0;
+#define dctLockMem()
+#define dctUnlockMem()
+#else
+static int dctMemUsed = 0;
+static int dctPeakMemUsed = 0;
+#if MULTITHREADED
+class DCTMemMutex {
+public:
+  DCTMemMutex() { gInitMutex(&mutex); }
+  ~DCTMemMutex() { gDestroyMutex(&mutex); }
+  G_Mutex mutex;
+};
+static DCTMemMutex dctMemMutex;
+#define dctLockMem() gLockMutex(&dctMemMutex.mutex)
+#define dctUnlockMem() gUnlockMutex(&dctMemMutex.mutex)
+#else
+#define dctLockMem()
+#define dctUnlockMem()
+#endif
+#endif
+
 DCTStream::DCTStream(Stream *strA):
     FilterStream(strA) {
   int i, j;
 
+  reduction = 1;
   progressive = interleaved = gFalse;
   width = height = 0;
+  outWidth = outHeight = 0;
   mcuWidth = mcuHeight = 0;
+  outMcuHeight = 0;
   numComps = 0;
   comp = 0;
   x = y = dy = 0;
@@ -1849,8 +2032,13 @@ DCTStream::DCTStream(Stream *strA):
     for (j = 0; j < 32; ++j) {
       rowBuf[i][j] = NULL;
     }
-    frameBuf[i] = NULL;
+    coefBuf[i] = NULL;
+    nonZeroBuf[i] = NULL;
   }
+  coefMem = NULL;
+  coefMemSize = 0;
+  coefMemMapped = gFalse;
+  memSize = 0;
 
   if (!dctClipInit) {
     for (i = -256; i < 0; ++i)
@@ -1864,29 +2052,69 @@ DCTStream::DCTStream(Stream *strA):
 }
 
 DCTStream::~DCTStream() {
+  delete str;
+  freeBuffers();
+}
+
+void DCTStream::freeBuffers() {
   int i, j;
 
-  delete str;
-  if (progressive || !interleaved) {
-    for (i = 0; i < numComps; ++i) {
-      gfree(frameBuf[i]);
-    }
-  } else {
-    for (i = 0; i < numComps; ++i) {
-      for (j = 0; j < mcuHeight; ++j) {
-	gfree(rowBuf[i][j]);
-      }
+  for (i = 0; i < 4; ++i) {
+    for (j = 0; j < 32; ++j) {
+      gfree(rowBuf[i][j]);
+      rowBuf[i][j] = NULL;
     }
+    coefBuf[i] = NULL;
+    nonZeroBuf[i] = NULL;
+  }
+  if (coefMem) {
+#ifndef WIN32
+    if (coefMemMapped) {
+      munmap(coefMem, coefMemSize);
+    } else
+#endif
+      gfree(coefMem);
+    coefMem = NULL;
   }
+  coefMemSize = 0;
+  coefMemMapped = gFalse;
+  trackMemory(-memSize);
+}
+
+void DCTStream::trackMemory(int delta) {
+  memSize += delta;
+  dctLockMem();
+  dctMemUsed += delta;
+  if (dctMemUsed > dctPeakMemUsed) {
+    dctPeakMemUsed = dctMemUsed;
+  }
+  dctUnlockMem();
+}
+
+int DCTStream::getPeakMemory() {
+  int peak;
+
+  dctLockMem();
+  peak = dctPeakMemUsed;
+  dctUnlockMem();
+  return peak;
+}
+
+void DCTStream::resetPeakMemory() {
+  dctLockMem();
+  dctPeakMemUsed = dctMemUsed;
+  dctUnlockMem();
 }
 
 void DCTStream::reset() {
   int i, j;
 
   str->reset();
+  freeBuffers();
 
   progressive = interleaved = gFalse;
   width = height = 0;
+  outWidth = outHeight = 0;
   numComps = 0;
   numQuantTables = 0;
   numDCHuffTables = 0;
@@ -1897,9 +2125,14 @@ void DCTStream::reset() {
   restartInterval = 0;
 
   if (!readHeader()) {
-    y = height;
+    y = outHeight;
     return;
   }
+  if (reduction != 2 && reduction != 4 && reduction != 8) {
+    reduction = 1;
+  }
+  outWidth = (width + reduction - 1) / reduction;
+  outHeight = (height + reduction - 1) / reduction;
 
   // compute MCU size
   if (numComps == 1) {
@@ -1917,6 +2150,7 @@ void DCTStream::reset() {
   }
   mcuWidth *= 8;
   mcuHeight *= 8;
+  outMcuHeight = mcuHeight / reduction;
 
   // figure out color transform
   if (!gotAdobeMarker && numComps == 3) {
@@ -1930,14 +2164,23 @@ void DCTStream::reset() {
     }
   }
 
+  // allocate a buffer for one row of MCUs
+  bufWidth = ((width + mcuWidth - 1) / mcuWidth) * mcuWidth;
+  bufHeight = ((height + mcuHeight - 1) / mcuHeight) * mcuHeight;
+  for (i = 0; i < numComps; ++i) {
+    for (j = 0; j < outMcuHeight; ++j) {
+      rowBuf[i][j] = (Guchar *)gmallocn(bufWidth / reduction,
+					sizeof(Guchar));
+    }
+  }
+  trackMemory(numComps * outMcuHeight * (bufWidth / reduction));
+
   if (progressive || !interleaved) {
 
-    // allocate a buffer for the whole image
-    bufWidth = ((width + mcuWidth - 1) / mcuWidth) * mcuWidth;
-    bufHeight = ((height + mcuHeight - 1) / mcuHeight) * mcuHeight;
-    for (i = 0; i < numComps; ++i) {
-      frameBuf[i] = (int *)gmallocn(bufWidth * bufHeight, sizeof(int));
-      memset(frameBuf[i], 0, bufWidth * bufHeight * sizeof(int));
+    // allocate the coefficient buffers
+    if (!allocCoefs()) {
+      y = outHeight;
+      return;
     }
 
     // read the image data
@@ -1946,71 +2189,120 @@ void DCTStream::reset() {
       restart();
       readScan();
     } while (readHeader());
+    mcuRow = 0;
 
-    // decode
-    decodeImage();
+  } else {
+    restartMarker = 0xd0;
+    restart();
+  }
 
-    // initialize counters
-    comp = 0;
-    x = 0;
-    y = 0;
+  // initialize counters
+  comp = 0;
+  x = 0;
+  y = 0;
+  dy = outMcuHeight;
+}
+
+// Allocate the coefficient buffers for a progressive or
+// non-interleaved image.  Only the coefficients used by the (reduced)
+// IDCT are kept, as 16-bit values, plus -- for progressive images --
+// a flag for each of the others, which is all that refinement scans
+// need to know about them.  If the buffers are over dctCoefMemLimit,
+// they are spilled to a temp file.
+GBool DCTStream::allocCoefs() {
+  int nUnits[4];
+  double size;
+  GString *tmpName;
+  FILE *tmpFile;
+  char *p;
+  int horiz, vert, i;
 
-  } else {
+  coefSize = (8 / reduction) * (8 / reduction);
+  size = 0;
+  for (i = 0; i < numComps; ++i) {
+    horiz = mcuWidth / compInfo[i].hSample;
+    vert = mcuHeight / compInfo[i].vSample;
+    coefBufWidth[i] = bufWidth / horiz;
+    nUnits[i] = coefBufWidth[i] * (bufHeight / vert);
+    size += (double)nUnits[i] * coefSize * sizeof(short);
+    if (progressive && coefSize < 64) {
+      size += (double)nUnits[i] * 8;
+    }
+  }
+  if (size >= 0x7fffffff) {
+    error(getPos(), "DCT image is too big");
+    globalParams->setBigImage();
+    return gFalse;
+  }
+  coefMemSize = (int)size;
 
-    // allocate a buffer for one row of MCUs
-    bufWidth = ((width + mcuWidth - 1) / mcuWidth) * mcuWidth;
-    for (i = 0; i < numComps; ++i) {
-      for (j = 0; j < mcuHeight; ++j) {
-	rowBuf[i][j] = (Guchar *)gmallocn(bufWidth, sizeof(Guchar));
+  if (coefMemSize <= dctCoefMemLimit) {
+    coefMem = (char *)gmalloc(coefMemSize);
+    memset(coefMem, 0, coefMemSize);
+  } else {
+#ifndef WIN32
+    // the temp file is unlinked right away; ftruncate zero-fills it
+    if (openTempFile(&tmpName, &tmpFile, "w+b", NULL)) {
+      unlink(tmpName->getCString());
+      delete tmpName;
+      if (ftruncate(fileno(tmpFile), coefMemSize) == 0) {
+	p = (char *)mmap(NULL, coefMemSize, PROT_READ | PROT_WRITE,
+			 MAP_SHARED, fileno(tmpFile), 0);
+	if (p != (char *)MAP_FAILED) {
+	  coefMem = p;
+	  coefMemMapped = gTrue;
+	}
       }
+      fclose(tmpFile);
     }
+#endif
+    if (!coefMem) {
+      error(getPos(), "Couldn't create temp file for DCT image");
+      globalParams->setBigImage();
+      coefMemSize = 0;
+      return gFalse;
+    }
+  }
+  trackMemory(coefMemSize);
 
-    // initialize counters
-    comp = 0;
-    x = 0;
-    y = 0;
-    dy = mcuHeight;
-
-    restartMarker = 0xd0;
-    restart();
+  p = coefMem;
+  for (i = 0; i < numComps; ++i) {
+    coefBuf[i] = (short *)p;
+    p += nUnits[i] * coefSize * sizeof(short);
+  }
+  if (progressive && coefSize < 64) {
+    for (i = 0; i < numComps; ++i) {
+      nonZeroBuf[i] = (Guchar *)p;
+      p += nUnits[i] * 8;
+    }
   }
+  return gTrue;
 }
 
 int DCTStream::getChar() {
   int c;
 
-  if (y >= height) {
+  if (y >= outHeight) {
     return EOF;
   }
-  if (progressive || !interleaved) {
-    c = frameBuf[comp][y * bufWidth + x];
-    if (++comp == numComps) {
-      comp = 0;
-      if (++x == width) {
-	x = 0;
-	++y;
-      }
+  if (dy >= outMcuHeight) {
+    if (!fillRowBuf()) {
+      y = outHeight;
+      return EOF;
     }
-  } else {
-    if (dy >= mcuHeight) {
-      if (!readMCURow()) {
-	y = height;
-	return EOF;
-      }
-      comp = 0;
+    comp = 0;
+    x = 0;
+    dy = 0;
+  }
+  c = rowBuf[comp][dy][x];
+  if (++comp == numComps) {
+    comp = 0;
+    if (++x == outWidth) {
       x = 0;
-      dy = 0;
-    }
-    c = rowBuf[comp][dy][x];
-    if (++comp == numComps) {
-      comp = 0;
-      if (++x == width) {
-	x = 0;
-	++y;
-	++dy;
-	if (y == height) {
-	  readTrailer();
-	}
+      ++y;
+      ++dy;
+      if (y == outHeight && interleaved && !progressive) {
+	readTrailer();
       }
     }
   }
@@ -2018,23 +2310,27 @@ int DCTStream::getChar() {
 }
 
 int DCTStream::lookChar() {
-  if (y >= height) {
+  if (y >= outHeight) {
     return EOF;
   }
-  if (progressive || !interleaved) {
-    return frameBuf[comp][y * bufWidth + x];
-  } else {
-    if (dy >= mcuHeight) {
-      if (!readMCURow()) {
-	y = height;
-	return EOF;
-      }
-      comp = 0;
-      x = 0;
-      dy = 0;
+  if (dy >= outMcuHeight) {
+    if (!fillRowBuf()) {
+      y = outHeight;
+      return EOF;
     }
-    return rowBuf[comp][dy][x];
+    comp = 0;
+    x = 0;
+    dy = 0;
+  }
+  return rowBuf[comp][dy][x];
+}
+
+// Fill rowBuf with the next row of MCUs.
+GBool DCTStream::fillRowBuf() {
+  if (progressive || !interleaved) {
+    return decodeMCURow();
   }
+  return readMCURow();
 }
 
 void DCTStream::restart() {
@@ -2052,10 +2348,8 @@ void DCTStream::restart() {
 GBool DCTStream::readMCURow() {
   int data1[64];
   Guchar data2[64];
-  Guchar *p1, *p2;
-  int pY, pCb, pCr, pR, pG, pB;
-  int h, v, horiz, vert, hSub, vSub;
-  int x1, x2, y2, x3, y3, x4, y4, x5, y5, cc, i;
+  int h, v, horiz, vert;
+  int x1, x2, y2, cc;
   int c;
 
   for (x1 = 0; x1 < width; x1 += mcuWidth) {
@@ -2078,8 +2372,6 @@ GBool DCTStream::readMCURow() {
       v = compInfo[cc].vSample;
       horiz = mcuWidth / h;
       vert = mcuHeight / v;
-      hSub = horiz / 8;
-      vSub = vert / 8;
       for (y2 = 0; y2 < mcuHeight; y2 += vert) {
 	for (x2 = 0; x2 < mcuWidth; x2 += horiz) {
 	  if (!readDataUnit(&dcHuffTables[scanInfo.dcHuffTable[cc]],
@@ -2088,93 +2380,31 @@ GBool DCTStream::readMCURow() {
 			    data1)) {
 	    return gFalse;
 	  }
-	  transformDataUnit(quantTables[compInfo[cc].quantTable],
-			    data1, data2);
-	  if (hSub == 1 && vSub == 1) {
-	    for (y3 = 0, i = 0; y3 < 8; ++y3, i += 8) {
-	      p1 = &rowBuf[cc][y2+y3][x1+x2];
-	      p1[0] = data2[i];
-	      p1[1] = data2[i+1];
-	      p1[2] = data2[i+2];
-	      p1[3] = data2[i+3];
-	      p1[4] = data2[i+4];
-	      p1[5] = data2[i+5];
-	      p1[6] = data2[i+6];
-	      p1[7] = data2[i+7];
-	    }
-	  } else if (hSub == 2 && vSub == 2) {
-	    for (y3 = 0, i = 0; y3 < 16; y3 += 2, i += 8) {
-	      p1 = &rowBuf[cc][y2+y3][x1+x2];
-	      p2 = &rowBuf[cc][y2+y3+1][x1+x2];
-	      p1[0] = p1[1] = p2[0] = p2[1] = data2[i];
-	      p1[2] = p1[3] = p2[2] = p2[3] = data2[i+1];
-	      p1[4] = p1[5] = p2[4] = p2[5] = data2[i+2];
-	      p1[6] = p1[7] = p2[6] = p2[7] = data2[i+3];
-	      p1[8] = p1[9] = p2[8] = p2[9] = data2[i+4];
-	      p1[10] = p1[11] = p2[10] = p2[11] = data2[i+5];
-	      p1[12] = p1[13] = p2[12] = p2[13] = data2[i+6];
-	      p1[14] = p1[15] = p2[14] = p2[15] = data2[i+7];
-	    }
+	  if (reduction == 1) {
+	    dctTransformDataUnit(quantTables[compInfo[cc].quantTable],
+				 data1, data2);
 	  } else {
-	    i = 0;
-	    for (y3 = 0, y4 = 0; y3 < 8; ++y3, y4 += vSub) {
-	      for (x3 = 0, x4 = 0; x3 < 8; ++x3, x4 += hSub) {
-		for (y5 = 0; y5 < vSub; ++y5)
-		  for (x5 = 0; x5 < hSub; ++x5)
-		    rowBuf[cc][y2+y4+y5][x1+x2+x4+x5] = data2[i];
-		++i;
-	      }
-	    }
+	    transformReducedDataUnit(quantTables[compInfo[cc].quantTable],
+				     data1, data2);
 	  }
+	  storeDataUnit(cc, x1 + x2, y2, data2);
 	}
       }
     }
     --restartCtr;
-
-    // color space conversion
-    if (colorXform) {
-      // convert YCbCr to RGB
-      if (numComps == 3) {
-	for (y2 = 0; y2 < mcuHeight; ++y2) {
-	  for (x2 = 0; x2 < mcuWidth; ++x2) {
-	    pY = rowBuf[0][y2][x1+x2];
-	    pCb = rowBuf[1][y2][x1+x2] - 128;
-	    pCr = rowBuf[2][y2][x1+x2] - 128;
-	    pR = ((pY << 16) + dctCrToR * pCr + 32768) >> 16;
-	    rowBuf[0][y2][x1+x2] = dctClip[dctClipOffset + pR];
-	    pG = ((pY << 16) + dctCbToG * pCb + dctCrToG * pCr + 32768) >> 16;
-	    rowBuf[1][y2][x1+x2] = dctClip[dctClipOffset + pG];
-	    pB = ((pY << 16) + dctCbToB * pCb + 32768) >> 16;
-	    rowBuf[2][y2][x1+x2] = dctClip[dctClipOffset + pB];
-	  }
-	}
-      // convert YCbCrK to CMYK (K is passed through unchanged)
-      } else if (numComps == 4) {
-	for (y2 = 0; y2 < mcuHeight; ++y2) {
-	  for (x2 = 0; x2 < mcuWidth; ++x2) {
-	    pY = rowBuf[0][y2][x1+x2];
-	    pCb = rowBuf[1][y2][x1+x2] - 128;
-	    pCr = rowBuf[2][y2][x1+x2] - 128;
-	    pR = ((pY << 16) + dctCrToR * pCr + 32768) >> 16;
-	    rowBuf[0][y2][x1+x2] = 255 - dctClip[dctClipOffset + pR];
-	    pG = ((pY << 16) + dctCbToG * pCb + dctCrToG * pCr + 32768) >> 16;
-	    rowBuf[1][y2][x1+x2] = 255 - dctClip[dctClipOffset + pG];
-	    pB = ((pY << 16) + dctCbToB * pCb + 32768) >> 16;
-	    rowBuf[2][y2][x1+x2] = 255 - dctClip[dctClipOffset + pB];
-	  }
-	}
-      }
-    }
   }
+
+  convertMCURow();
   return gTrue;
 }
 
 // Read one scan from a progressive or non-interleaved JPEG stream.
 void DCTStream::readScan() {
   int data[64];
-  int x1, y1, dx1, dy1, x2, y2, y3, cc, i;
-  int h, v, horiz, vert, vSub;
-  int *p1;
+  int x1, y1, dx1, dy1, x2, y2, u, v1, cc, i, j;
+  int h, v, horiz, vert, size;
+  short *p1;
+  Guchar *p2;
   int c;
 
   if (scanInfo.numComps == 1) {
@@ -2216,22 +2446,30 @@ void DCTStream::readScan() {
 	v = compInfo[cc].vSample;
 	horiz = mcuWidth / h;
 	vert = mcuHeight / v;
-	vSub = vert / 8;
+	size = 8 / reduction;
 	for (y2 = 0; y2 < dy1; y2 += vert) {
 	  for (x2 = 0; x2 < dx1; x2 += horiz) {
+	    i = ((y1+y2) / vert) * coefBufWidth[cc] + (x1+x2) / horiz;
+	    p1 = coefBuf[cc] + i * coefSize;
+	    p2 = nonZeroBuf[cc] ? nonZeroBuf[cc] + i * 8 : (Guchar *)NULL;
 
-	    // pull out the current values
-	    p1 = &frameBuf[cc][(y1+y2) * bufWidth + (x1+x2)];
-	    for (y3 = 0, i = 0; y3 < 8; ++y3, i += 8) {
-	      data[i] = p1[0];
-	      data[i+1] = p1[1];
-	      data[i+2] = p1[2];
-	      data[i+3] = p1[3];
-	      data[i+4] = p1[4];
-	      data[i+5] = p1[5];
-	      data[i+6] = p1[6];
-	      data[i+7] = p1[7];
-	      p1 += bufWidth * vSub;
+	    // pull out the current values (a sequential scan replaces
+	    // all of them)
+	    if (progressive) {
+	      if (size == 8) {
+		for (i = 0; i < 64; ++i) {
+		  data[i] = p1[i];
+		}
+	      } else {
+		for (i = 0; i < 64; ++i) {
+		  data[i] = (p2[i >> 3] >> (i & 7)) & 1;
+		}
+		for (v1 = 0, j = 0; v1 < size; ++v1) {
+		  for (u = 0; u < size; ++u, ++j) {
+		    data[v1 * 8 + u] = p1[j];
+		  }
+		}
+	      }
 	    }
 
 	    // read one data unit
@@ -2252,18 +2490,29 @@ void DCTStream::readScan() {
 	      }
 	    }
 
-	    // add the data unit into frameBuf
-	    p1 = &frameBuf[cc][(y1+y2) * bufWidth + (x1+x2)];
-	    for (y3 = 0, i = 0; y3 < 8; ++y3, i += 8) {
-	      p1[0] = data[i];
-	      p1[1] = data[i+1];
-	      p1[2] = data[i+2];
-	      p1[3] = data[i+3];
-	      p1[4] = data[i+4];
-	      p1[5] = data[i+5];
-	      p1[6] = data[i+6];
-	      p1[7] = data[i+7];
-	      p1 += bufWidth * vSub;
+	    // store the data unit back into coefBuf
+	    if (size == 8) {
+	      for (i = 0; i < 64; ++i) {
+		p1[i] = (short)data[i];
+	      }
+	    } else {
+	      for (v1 = 0, j = 0; v1 < size; ++v1) {
+		for (u = 0; u < size; ++u, ++j) {
+		  p1[j] = (short)data[v1 * 8 + u];
+		}
+	      }
+	      if (p2) {
+		for (i = 0; i < 8; ++i) {
+		  p2[i] = (Guchar)((data[i*8] != 0) |
+				   ((data[i*8+1] != 0) << 1) |
+				   ((data[i*8+2] != 0) << 2) |
+				   ((data[i*8+3] != 0) << 3) |
+				   ((data[i*8+4] != 0) << 4) |
+				   ((data[i*8+5] != 0) << 5) |
+				   ((data[i*8+6] != 0) << 6) |
+				   ((data[i*8+7] != 0) << 7));
+		}
+	      }
 	    }
 	  }
 	}
@@ -2366,7 +2615,11 @@ GBool DCTStream::readProgressiveDataUnit(DCTHuffTable *dcHuffTable,
 	  return gFalse;
 	}
 	if (bit) {
-	  data[j] += 1 << scanInfo.al;
+	  if (data[j] >= 0) {
+	    data[j] += 1 << scanInfo.al;
+	  } else {
+	    data[j] -= 1 << scanInfo.al;
+	  }
 	}
       }
     }
@@ -2392,7 +2645,11 @@ GBool DCTStream::readProgressiveDataUnit(DCTHuffTable *dcHuffTable,
 	    return gFalse;
 	  }
 	  if (bit) {
-	    data[j] += 1 << scanInfo.al;
+	    if (data[j] >= 0) {
+	      data[j] += 1 << scanInfo.al;
+	    } else {
+	      data[j] -= 1 << scanInfo.al;
+	    }
 	  }
 	}
       }
@@ -2415,7 +2672,11 @@ GBool DCTStream::readProgressiveDataUnit(DCTHuffTable *dcHuffTable,
 	    return gFalse;
 	  }
 	  if (bit) {
-	    data[j] += 1 << scanInfo.al;
+	    if (data[j] >= 0) {
+	      data[j] += 1 << scanInfo.al;
+	    } else {
+	      data[j] -= 1 << scanInfo.al;
+	    }
 	  }
 	}
       }
@@ -2437,7 +2698,11 @@ GBool DCTStream::readProgressiveDataUnit(DCTHuffTable *dcHuffTable,
 	    return gFalse;
 	  }
 	  if (bit) {
-	    data[j] += 1 << scanInfo.al;
+	    if (data[j] >= 0) {
+	      data[j] += 1 << scanInfo.al;
+	    } else {
+	      data[j] -= 1 << scanInfo.al;
+	    }
 	  }
 	  j = dctZigZag[i++];
 	}
@@ -2450,299 +2715,160 @@ GBool DCTStream::readProgressiveDataUnit(DCTHuffTable *dcHuffTable,
   return gTrue;
 }
 
-// Decode a progressive JPEG image.
-void DCTStream::decodeImage() {
+// Decode one row of MCUs of a progressive or non-interleaved image
+// from coefBuf.
+GBool DCTStream::decodeMCURow() {
   int dataIn[64];
   Guchar dataOut[64];
   Gushort *quantTable;
-  int pY, pCb, pCr, pR, pG, pB;
-  int x1, y1, x2, y2, x3, y3, x4, y4, x5, y5, cc, i;
-  int h, v, horiz, vert, hSub, vSub;
-  int *p0, *p1, *p2;
+  int x1, y1, x2, y2, u, v1, cc, i, j;
+  int h, v, horiz, vert, size;
+  short *p1;
 
-  for (y1 = 0; y1 < bufHeight; y1 += mcuHeight) {
-    for (x1 = 0; x1 < bufWidth; x1 += mcuWidth) {
-      for (cc = 0; cc < numComps; ++cc) {
-	quantTable = quantTables[compInfo[cc].quantTable];
-	h = compInfo[cc].hSample;
-	v = compInfo[cc].vSample;
-	horiz = mcuWidth / h;
-	vert = mcuHeight / v;
-	hSub = horiz / 8;
-	vSub = vert / 8;
-	for (y2 = 0; y2 < mcuHeight; y2 += vert) {
-	  for (x2 = 0; x2 < mcuWidth; x2 += horiz) {
-
-	    // pull out the coded data unit
-	    p1 = &frameBuf[cc][(y1+y2) * bufWidth + (x1+x2)];
-	    for (y3 = 0, i = 0; y3 < 8; ++y3, i += 8) {
-	      dataIn[i]   = p1[0];
-	      dataIn[i+1] = p1[1];
-	      dataIn[i+2] = p1[2];
-	      dataIn[i+3] = p1[3];
-	      dataIn[i+4] = p1[4];
-	      dataIn[i+5] = p1[5];
-	      dataIn[i+6] = p1[6];
-	      dataIn[i+7] = p1[7];
-	      p1 += bufWidth * vSub;
-	    }
+  y1 = mcuRow * mcuHeight;
+  if (y1 >= bufHeight) {
+    return gFalse;
+  }
+  size = 8 / reduction;
+  for (x1 = 0; x1 < width; x1 += mcuWidth) {
+    for (cc = 0; cc < numComps; ++cc) {
+      quantTable = quantTables[compInfo[cc].quantTable];
+      h = compInfo[cc].hSample;
+      v = compInfo[cc].vSample;
+      horiz = mcuWidth / h;
+      vert = mcuHeight / v;
+      for (y2 = 0; y2 < mcuHeight; y2 += vert) {
+	for (x2 = 0; x2 < mcuWidth; x2 += horiz) {
 
-	    // transform
-	    transformDataUnit(quantTable, dataIn, dataOut);
-
-	    // store back into frameBuf, doing replication for
-	    // subsampled components
-	    p1 = &frameBuf[cc][(y1+y2) * bufWidth + (x1+x2)];
-	    if (hSub == 1 && vSub == 1) {
-	      for (y3 = 0, i = 0; y3 < 8; ++y3, i += 8) {
-		p1[0] = dataOut[i] & 0xff;
-		p1[1] = dataOut[i+1] & 0xff;
-		p1[2] = dataOut[i+2] & 0xff;
-		p1[3] = dataOut[i+3] & 0xff;
-		p1[4] = dataOut[i+4] & 0xff;
-		p1[5] = dataOut[i+5] & 0xff;
-		p1[6] = dataOut[i+6] & 0xff;
-		p1[7] = dataOut[i+7] & 0xff;
-		p1 += bufWidth;
-	      }
-	    } else if (hSub == 2 && vSub == 2) {
-	      p2 = p1 + bufWidth;
-	      for (y3 = 0, i = 0; y3 < 16; y3 += 2, i += 8) {
-		p1[0] = p1[1] = p2[0] = p2[1] = dataOut[i] & 0xff;
-		p1[2] = p1[3] = p2[2] = p2[3] = dataOut[i+1] & 0xff;
-		p1[4] = p1[5] = p2[4] = p2[5] = dataOut[i+2] & 0xff;
-		p1[6] = p1[7] = p2[6] = p2[7] = dataOut[i+3] & 0xff;
-		p1[8] = p1[9] = p2[8] = p2[9] = dataOut[i+4] & 0xff;
-		p1[10] = p1[11] = p2[10] = p2[11] = dataOut[i+5] & 0xff;
-		p1[12] = p1[13] = p2[12] = p2[13] = dataOut[i+6] & 0xff;
-		p1[14] = p1[15] = p2[14] = p2[15] = dataOut[i+7] & 0xff;
-		p1 += bufWidth * 2;
-		p2 += bufWidth * 2;
-	      }
-	    } else {
-	      i = 0;
-	      for (y3 = 0, y4 = 0; y3 < 8; ++y3, y4 += vSub) {
-		for (x3 = 0, x4 = 0; x3 < 8; ++x3, x4 += hSub) {
-		  p2 = p1 + x4;
-		  for (y5 = 0; y5 < vSub; ++y5) {
-		    for (x5 = 0; x5 < hSub; ++x5) {
-		      p2[x5] = dataOut[i] & 0xff;
-		    }
-		    p2 += bufWidth;
-		  }
-		  ++i;
-		}
-		p1 += bufWidth * vSub;
+	  // pull out the coded data unit -- the reduced transforms only
+	  // look at the top left size x size coefficients
+	  i = ((y1+y2) / vert) * coefBufWidth[cc] + (x1+x2) / horiz;
+	  p1 = coefBuf[cc] + i * coefSize;
+	  if (size == 8) {
+	    for (i = 0; i < 64; ++i) {
+	      dataIn[i] = p1[i];
+	    }
+	  } else {
+	    for (v1 = 0, j = 0; v1 < size; ++v1) {
+	      for (u = 0; u < size; ++u, ++j) {
+		dataIn[v1 * 8 + u] = p1[j];
 	      }
 	    }
 	  }
-	}
-      }
 
-      // color space conversion
-      if (colorXform) {
-	// convert YCbCr to RGB
-	if (numComps == 3) {
-	  for (y2 = 0; y2 < mcuHeight; ++y2) {
-	    p0 = &frameBuf[0][(y1+y2) * bufWidth + x1];
-	    p1 = &frameBuf[1][(y1+y2) * bufWidth + x1];
-	    p2 = &frameBuf[2][(y1+y2) * bufWidth + x1];
-	    for (x2 = 0; x2 < mcuWidth; ++x2) {
-	      pY = *p0;
-	      pCb = *p1 - 128;
-	      pCr = *p2 - 128;
-	      pR = ((pY << 16) + dctCrToR * pCr + 32768) >> 16;
-	      *p0++ = dctClip[dctClipOffset + pR];
-	      pG = ((pY << 16) + dctCbToG * pCb + dctCrToG * pCr +
-		    32768) >> 16;
-	      *p1++ = dctClip[dctClipOffset + pG];
-	      pB = ((pY << 16) + dctCbToB * pCb + 32768) >> 16;
-	      *p2++ = dctClip[dctClipOffset + pB];
-	    }
-	  }
-	// convert YCbCrK to CMYK (K is passed through unchanged)
-	} else if (numComps == 4) {
-	  for (y2 = 0; y2 < mcuHeight; ++y2) {
-	    p0 = &frameBuf[0][(y1+y2) * bufWidth + x1];
-	    p1 = &frameBuf[1][(y1+y2) * bufWidth + x1];
-	    p2 = &frameBuf[2][(y1+y2) * bufWidth + x1];
-	    for (x2 = 0; x2 < mcuWidth; ++x2) {
-	      pY = *p0;
-	      pCb = *p1 - 128;
-	      pCr = *p2 - 128;
-	      pR = ((pY << 16) + dctCrToR * pCr + 32768) >> 16;
-	      *p0++ = 255 - dctClip[dctClipOffset + pR];
-	      pG = ((pY << 16) + dctCbToG * pCb + dctCrToG * pCr +
-		    32768) >> 16;
-	      *p1++ = 255 - dctClip[dctClipOffset + pG];
-	      pB = ((pY << 16) + dctCbToB * pCb + 32768) >> 16;
-	      *p2++ = 255 - dctClip[dctClipOffset + pB];
-	    }
+	  // transform
+	  if (reduction == 1) {
+	    dctTransformDataUnit(quantTable, dataIn, dataOut);
+	  } else {
+	    transformReducedDataUnit(quantTable, dataIn, dataOut);
 	  }
+	  storeDataUnit(cc, x1 + x2, y2, dataOut);
 	}
       }
     }
   }
+  ++mcuRow;
+
+  convertMCURow();
+  return gTrue;
 }
 
-// Transform one data unit -- this performs the dequantization and
-// IDCT steps.  This IDCT algorithm is taken from:
-//   Christoph Loeffler, Adriaan Ligtenberg, George S. Moschytz,
-//   "Practical Fast 1-D DCT Algorithms with 11 Multiplications",
-//   IEEE Intl. Conf. on Acoustics, Speech & Signal Processing, 1989,
-//   988-991.
-// The stage numbers mentioned in the comments refer to Figure 1 in this
-// paper.
-void DCTStream::transformDataUnit(Gushort *quantTable,
-				  int dataIn[64], Guchar dataOut[64]) {
-  int v0, v1, v2, v3, v4, v5, v6, v7, t;
-  int *p;
-  int i;
+// Store a transformed data unit of component <cc> into rowBuf, at
+// (<x1>, <y1>) within the current row of MCUs (in full size pixels),
+// doing replication for subsampled components.
+void DCTStream::storeDataUnit(int cc, int x1, int y1, Guchar data[64]) {
+  Guchar *p1;
+  int horiz, vert, hSub, vSub, size;
+  int x3, y3, x4, y4, x5, y5, ox, oy, i;
+
+  horiz = mcuWidth / compInfo[cc].hSample;
+  vert = mcuHeight / compInfo[cc].vSample;
+  hSub = horiz / 8;
+  vSub = vert / 8;
+  if (reduction == 1 && hSub == 1 && vSub == 1) {
+    for (y3 = 0, i = 0; y3 < 8; ++y3, i += 8) {
+      p1 = &rowBuf[cc][y1+y3][x1];
+      p1[0] = data[i];
+      p1[1] = data[i+1];
+      p1[2] = data[i+2];
+      p1[3] = data[i+3];
+      p1[4] = data[i+4];
+      p1[5] = data[i+5];
+      p1[6] = data[i+6];
+      p1[7] = data[i+7];
+    }
+  } else if (reduction == 1 && hSub == 2 && vSub == 2) {
+    dctUpsampleH2V2(data, &rowBuf[cc][y1], x1);
+  } else {
+    size = 8 / reduction;
+    ox = x1 / reduction;
+    oy = y1 / reduction;
+    i = 0;
+    for (y3 = 0, y4 = 0; y3 < size; ++y3, y4 += vSub) {
+      for (x3 = 0, x4 = 0; x3 < size; ++x3, x4 += hSub) {
+	for (y5 = 0; y5 < vSub; ++y5)
+	  for (x5 = 0; x5 < hSub; ++x5)
+	    rowBuf[cc][oy+y4+y5][ox+x4+x5] = data[i];
+	++i;
+      }
+    }
+  }
+}
 
-  // dequant
-  for (i = 0; i < 64; ++i) {
-    dataIn[i] *= quantTable[i];
-  }
-
-  // inverse DCT on rows
-  for (i = 0; i < 64; i += 8) {
-    p = dataIn + i;
-
-    // check for all-zero AC coefficients
-    if (p[1] == 0 && p[2] == 0 && p[3] == 0 &&
-	p[4] == 0 && p[5] == 0 && p[6] == 0 && p[7] == 0) {
-      t = (dctSqrt2 * p[0] + 512) >> 10;
-      p[0] = t;
-      p[1] = t;
-      p[2] = t;
-      p[3] = t;
-      p[4] = t;
-      p[5] = t;
-      p[6] = t;
-      p[7] = t;
-      continue;
+// Color space conversion of the current row of MCUs (YCbCrK to CMYK
+// inverts the first three components, and passes K through
+// unchanged).
+void DCTStream::convertMCURow() {
+  int y2;
+
+  if (colorXform && (numComps == 3 || numComps == 4)) {
+    for (y2 = 0; y2 < outMcuHeight; ++y2) {
+      dctConvertYCbCr(rowBuf[0][y2], rowBuf[1][y2], rowBuf[2][y2],
+		      bufWidth / reduction, numComps == 4);
     }
+  }
+}
 
-    // stage 4
-    v0 = (dctSqrt2 * p[0] + 128) >> 8;
-    v1 = (dctSqrt2 * p[4] + 128) >> 8;
-    v2 = p[2];
-    v3 = p[6];
-    v4 = (dctSqrt1d2 * (p[1] - p[7]) + 128) >> 8;
-    v7 = (dctSqrt1d2 * (p[1] + p[7]) + 128) >> 8;
-    v5 = p[3] << 4;
-    v6 = p[5] << 4;
-
-    // stage 3
-    t = (v0 - v1+ 1) >> 1;
-    v0 = (v0 + v1 + 1) >> 1;
-    v1 = t;
-    t = (v2 * dctSin6 + v3 * dctCos6 + 128) >> 8;
-    v2 = (v2 * dctCos6 - v3 * dctSin6 + 128) >> 8;
-    v3 = t;
-    t = (v4 - v6 + 1) >> 1;
-    v4 = (v4 + v6 + 1) >> 1;
-    v6 = t;
-    t = (v7 + v5 + 1) >> 1;
-    v5 = (v7 - v5 + 1) >> 1;
-    v7 = t;
-
-    // stage 2
-    t = (v0 - v3 + 1) >> 1;
-    v0 = (v0 + v3 + 1) >> 1;
-    v3 = t;
-    t = (v1 - v2 + 1) >> 1;
-    v1 = (v1 + v2 + 1) >> 1;
-    v2 = t;
-    t = (v4 * dctSin3 + v7 * dctCos3 + 2048) >> 12;
-    v4 = (v4 * dctCos3 - v7 * dctSin3 + 2048) >> 12;
-    v7 = t;
-    t = (v5 * dctSin1 + v6 * dctCos1 + 2048) >> 12;
-    v5 = (v5 * dctCos1 - v6 * dctSin1 + 2048) >> 12;
-    v6 = t;
-
-    // stage 1
-    p[0] = v0 + v7;
-    p[7] = v0 - v7;
-    p[1] = v1 + v6;
-    p[6] = v1 - v6;
-    p[2] = v2 + v5;
-    p[5] = v2 - v5;
-    p[3] = v3 + v4;
-    p[4] = v3 - v4;
-  }
-
-  // inverse DCT on columns
-  for (i = 0; i < 8; ++i) {
-    p = dataIn + i;
-
-    // check for all-zero AC coefficients
-    if (p[1*8] == 0 && p[2*8] == 0 && p[3*8] == 0 &&
-	p[4*8] == 0 && p[5*8] == 0 && p[6*8] == 0 && p[7*8] == 0) {
-      t = (dctSqrt2 * dataIn[i+0] + 8192) >> 14;
-      p[0*8] = t;
-      p[1*8] = t;
-      p[2*8] = t;
-      p[3*8] = t;
-      p[4*8] = t;
-      p[5*8] = t;
-      p[6*8] = t;
-      p[7*8] = t;
-      continue;
+// Transform one data unit to 4x4, 2x2, or 1x1 samples, for decoding
+// at 1/2, 1/4, or 1/8 scale.  The output is stored in the first
+// (8/reduction)^2 entries of <dataOut>.
+void DCTStream::transformReducedDataUnit(Gushort *quantTable,
+					 int dataIn[64], Guchar dataOut[64]) {
+  int tmp[16];
+  int *m;
+  int size, i, j, u, t;
+
+  // DC only: the mean of the 8x8 block
+  if (reduction == 8) {
+    t = (dataIn[0] * quantTable[0] + 4) >> 3;
+    dataOut[0] = dctClip[dctClipOffset + 128 + t];
+    return;
+  }
+
+  size = 8 / reduction;
+  m = size == 4 ? &dctReduced4[0][0] : &dctReduced2[0][0];
+
+  // dequant and inverse DCT on rows (4 fraction bits are kept)
+  for (j = 0; j < size; ++j) {
+    for (i = 0; i < size; ++i) {
+      t = 0;
+      for (u = 0; u < size; ++u) {
+	t += dataIn[j * 8 + u] * quantTable[j * 8 + u] * m[i * size + u];
+      }
+      tmp[j * size + i] = (t + 128) >> 8;
     }
+  }
 
-    // stage 4
-    v0 = (dctSqrt2 * p[0*8] + 2048) >> 12;
-    v1 = (dctSqrt2 * p[4*8] + 2048) >> 12;
-    v2 = p[2*8];
-    v3 = p[6*8];
-    v4 = (dctSqrt1d2 * (p[1*8] - p[7*8]) + 2048) >> 12;
-    v7 = (dctSqrt1d2 * (p[1*8] + p[7*8]) + 2048) >> 12;
-    v5 = p[3*8];
-    v6 = p[5*8];
-
-    // stage 3
-    t = (v0 - v1 + 1) >> 1;
-    v0 = (v0 + v1 + 1) >> 1;
-    v1 = t;
-    t = (v2 * dctSin6 + v3 * dctCos6 + 2048) >> 12;
-    v2 = (v2 * dctCos6 - v3 * dctSin6 + 2048) >> 12;
-    v3 = t;
-    t = (v4 - v6 + 1) >> 1;
-    v4 = (v4 + v6 + 1) >> 1;
-    v6 = t;
-    t = (v7 + v5 + 1) >> 1;
-    v5 = (v7 - v5 + 1) >> 1;
-    v7 = t;
-
-    // stage 2
-    t = (v0 - v3 + 1) >> 1;
-    v0 = (v0 + v3 + 1) >> 1;
-    v3 = t;
-    t = (v1 - v2 + 1) >> 1;
-    v1 = (v1 + v2 + 1) >> 1;
-    v2 = t;
-    t = (v4 * dctSin3 + v7 * dctCos3 + 2048) >> 12;
-    v4 = (v4 * dctCos3 - v7 * dctSin3 + 2048) >> 12;
-    v7 = t;
-    t = (v5 * dctSin1 + v6 * dctCos1 + 2048) >> 12;
-    v5 = (v5 * dctCos1 - v6 * dctSin1 + 2048) >> 12;
-    v6 = t;
-
-    // stage 1
-    p[0*8] = v0 + v7;
-    p[7*8] = v0 - v7;
-    p[1*8] = v1 + v6;
-    p[6*8] = v1 - v6;
-    p[2*8] = v2 + v5;
-    p[5*8] = v2 - v5;
-    p[3*8] = v3 + v4;
-    p[4*8] = v3 - v4;
-  }
-
-  // convert to 8-bit integers
-  for (i = 0; i < 64; ++i) {
-    dataOut[i] = dctClip[dctClipOffset + 128 + ((dataIn[i] + 8) >> 4)];
+  // inverse DCT on columns, and convert to 8-bit integers
+  for (i = 0; i < size; ++i) {
+    for (j = 0; j < size; ++j) {
+      t = 0;
+      for (u = 0; u < size; ++u) {
+	t += tmp[u * size + i] * m[j * size + u];
+      }
+      t = (t + 32768) >> 16;
+      dataOut[j * size + i] = dctClip[dctClipOffset + 128 + t];
+    }
   }
 }
 
@@ -3780,7 +3906,7 @@ static FlateCode flateFixedLitCodeTabCodes[512] = {
 };
 
 FlateHuffmanTab FlateStream::fixedLitCodeTab = {
-  flateFixedLitCodeTabCodes, 9
+  flateFixedLitCodeTabCodes, 9, 9
 };
 
 static FlateCode flateFixedDistCodeTabCodes[32] = {
@@ -3819,7 +3945,7 @@ static FlateCode flateFixedDistCodeTabCodes[32] = {
 };
 
 FlateHuffmanTab FlateStream::fixedDistCodeTab = {
-  flateFixedDistCodeTabCodes, 5
+  flateFixedDistCodeTabCodes, 5, 5
 };
 
 FlateStream::FlateStream(Stream *strA, int predictor, int columns,
@@ -3860,11 +3986,16 @@ void FlateStream::reset() {
 
   str->reset();
 
+  // the data of an inline image is followed directly by the rest of
+  // the content stream, so it has to be read a byte at a time
+  inPtr = inEnd = inBuf;
+  inBufLen = str->isEmbedded() ? 1 : flateInBufSize;
+
   // read header
   //~ need to look at window size?
   endOfBlock = eof = gTrue;
-  cmf = str->getChar();
-  flg = str->getChar();
+  cmf = getInChar();
+  flg = getInChar();
   if (cmf == EOF || flg == EOF)
     return;
   if ((cmf & 0x0f) != 0x08) {
@@ -3929,6 +4060,38 @@ int FlateStream::getRawChar() {
   return c;
 }
 
+int FlateStream::getBlock(char *blk, int size) {
+  if (pred) {
+    return pred->getBlock(blk, size);
+  }
+  return getRawBlock(blk, size);
+}
+
+int FlateStream::getRawBlock(char *blk, int size) {
+  int n, m;
+
+  n = 0;
+  while (n < size) {
+    while (remain == 0) {
+      if (endOfBlock && eof)
+	return n;
+      readSome();
+    }
+    m = remain;
+    if (m > size - n) {
+      m = size - n;
+    }
+    if (m > flateWindow - index) {
+      m = flateWindow - index;
+    }
+    memcpy(blk + n, buf + index, m);
+    index = (index + m) & flateMask;
+    remain -= m;
+    n += m;
+  }
+  return n;
+}
+
 GString *FlateStream::getPSFilter(int psLevel, char *indent) {
   GString *s;
 
@@ -3946,11 +4109,63 @@ GBool FlateStream::isBinary(GBool last) {
   return str->isBinary(gTrue);
 }
 
+// Read the next part of the compressed data into inBuf.
+GBool FlateStream::fillInBuf() {
+  int n;
+
+  n = str->getBlock((char *)inBuf, inBufLen);
+  inPtr = inBuf;
+  inEnd = inBuf + (n > 0 ? n : 0);
+  return n > 0;
+}
+
+// Fill the bit buffer <cBuf>/<cSize> to at least 25 bits (less at
+// the end of the stream) from inBuf, where <p> and <pEnd> stand in
+// for inPtr and inEnd: enough for a literal/length code and its
+// extra bits, or for a distance code.  If inBuf holds enough data,
+// the bit buffer is filled all the way up, so that the following
+// codes don't need to refill it.  (An inline image's inBuf only
+// holds one byte, so no more than 3 bytes are read past its data:
+// they're part of the Adler-32 checksum, and the EI is left alone.)
+inline void FlateStream::fillCodeBuf(Gulong *cBuf, int *cSize,
+				     Guchar **p, Guchar **pEnd) {
+  Guchar *q;
+  int n;
+
+  if (*cSize > 24) {
+    return;
+  }
+  n = ((int)sizeof(Gulong) * 8 - *cSize) >> 3;
+  if (*pEnd - *p >= n) {
+    for (q = *p; q < *p + n; ++q) {
+      *cBuf |= (Gulong)*q << *cSize;
+      *cSize += 8;
+    }
+    *p = q;
+    return;
+  }
+  while (*cSize <= 24) {
+    if (*p >= *pEnd) {
+      if (!fillInBuf()) {
+	break;
+      }
+      *p = inPtr;
+      *pEnd = inEnd;
+    }
+    *cBuf |= (Gulong)*(*p)++ << *cSize;
+    *cSize += 8;
+  }
+}
+
+// Decode up to flateChunk bytes into buf.  Only called when buf is
+// empty (remain == 0).
 void FlateStream::readSome() {
-  int code1, code2;
-  int len, dist;
-  int i, j, k;
-  int c;
+  FlateCode *code;
+  Guchar *p, *pEnd;
+  Gulong cBuf;
+  int cSize;
+  int code1, bits, len, dist;
+  int i, j, k, n;
 
   if (endOfBlock) {
     if (!startBlock())
@@ -3958,46 +4173,143 @@ void FlateStream::readSome() {
   }
 
   if (compressedBlock) {
-    if ((code1 = getHuffmanCodeWord(&litCodeTab)) == EOF)
-      goto err;
-    if (code1 < 256) {
-      buf[index] = code1;
-      remain = 1;
-    } else if (code1 == 256) {
-      endOfBlock = gTrue;
-      remain = 0;
-    } else {
-      code1 -= 257;
-      code2 = lengthDecode[code1].bits;
-      if (code2 > 0 && (code2 = getCodeWord(code2)) == EOF)
+
+    // the bit buffer and input pointers are kept in locals: the
+    // compiler can't keep the members in registers across the stores
+    // into buf
+    cBuf = codeBuf;
+    cSize = codeSize;
+    p = inPtr;
+    pEnd = inEnd;
+    i = index;
+    n = 0;
+    while (n < flateChunk) {
+
+      // literal/length code
+      fillCodeBuf(&cBuf, &cSize, &p, &pEnd);
+      code = &litCodeTab.codes[cBuf & ((1 << litCodeTab.bits) - 1)];
+      if (code->len & flateSubTable) {
+	code = &litCodeTab.codes[code->val +
+				 ((cBuf >> litCodeTab.bits) &
+				  ((1 << (code->len & 0xff)) - 1))];
+      }
+      if (code->len == 0 || code->len > cSize) {
 	goto err;
-      len = lengthDecode[code1].first + code2;
-      if ((code1 = getHuffmanCodeWord(&distCodeTab)) == EOF)
+      }
+      cBuf >>= code->len;
+      cSize -= code->len;
+      code1 = code->val;
+
+      // literal
+      if (code1 < 256) {
+	buf[i] = (Guchar)code1;
+	i = (i + 1) & flateMask;
+	++n;
+	continue;
+      }
+
+      // end of block
+      if (code1 == 256) {
+	endOfBlock = gTrue;
+	break;
+      }
+
+      // length
+      code1 -= 257;
+      bits = lengthDecode[code1].bits;
+      if (bits > cSize) {
 	goto err;
-      code2 = distDecode[code1].bits;
-      if (code2 > 0 && (code2 = getCodeWord(code2)) == EOF)
+      }
+      len = lengthDecode[code1].first + (cBuf & ((1 << bits) - 1));
+      cBuf >>= bits;
+      cSize -= bits;
+
+      // distance
+      fillCodeBuf(&cBuf, &cSize, &p, &pEnd);
+      code = &distCodeTab.codes[cBuf & ((1 << distCodeTab.bits) - 1)];
+      if (code->len & flateSubTable) {
+	code = &distCodeTab.codes[code->val +
+				  ((cBuf >> distCodeTab.bits) &
+				   ((1 << (code->len & 0xff)) - 1))];
+      }
+      if (code->len == 0 || code->len > cSize) {
 	goto err;
-      dist = distDecode[code1].first + code2;
-      i = index;
-      j = (index - dist) & flateMask;
-      for (k = 0; k < len; ++k) {
-	buf[i] = buf[j];
-	i = (i + 1) & flateMask;
-	j = (j + 1) & flateMask;
       }
-      remain = len;
+      cBuf >>= code->len;
+      cSize -= code->len;
+      code1 = code->val;
+      bits = distDecode[code1].bits;
+      if (bits > cSize) {
+	fillCodeBuf(&cBuf, &cSize, &p, &pEnd);
+	if (bits > cSize) {
+	  goto err;
+	}
+      }
+      dist = distDecode[code1].first + (cBuf & ((1 << bits) - 1));
+      cBuf >>= bits;
+      cSize -= bits;
+
+      // copy the match -- if neither end wraps around the window, an
+      // overlapping copy (dist < len) repeats the last dist bytes
+      j = (i - dist) & flateMask;
+      if (i + len <= flateWindow && j + len <= flateWindow) {
+	if (dist >= len) {
+	  memmove(buf + i, buf + j, len);
+	} else if (dist == 1) {
+	  memset(buf + i, buf[j], len);
+	} else {
+	  for (k = 0; k < len; ++k) {
+	    buf[i + k] = buf[j + k];
+	  }
+	}
+	i = (i + len) & flateMask;
+      } else {
+	for (k = 0; k < len; ++k) {
+	  buf[i] = buf[j];
+	  i = (i + 1) & flateMask;
+	  j = (j + 1) & flateMask;
+	}
+      }
+      n += len;
     }
+    codeBuf = cBuf;
+    codeSize = cSize;
+    inPtr = p;
+    remain = n;
 
   } else {
+
+    // stored block: whole bytes left in the bit buffer and inBuf
+    // come first
     len = (blockLen < flateWindow) ? blockLen : flateWindow;
-    for (i = 0, j = index; i < len; ++i, j = (j + 1) & flateMask) {
-      if ((c = str->getChar()) == EOF) {
+    n = 0;
+    j = index;
+    while (n < len && codeSize >= 8) {
+      buf[j] = (Guchar)(codeBuf & 0xff);
+      codeBuf >>= 8;
+      codeSize -= 8;
+      j = (j + 1) & flateMask;
+      ++n;
+    }
+    while (n < len && inPtr < inEnd) {
+      buf[j] = *inPtr++;
+      j = (j + 1) & flateMask;
+      ++n;
+    }
+    while (n < len) {
+      k = flateWindow - j;
+      if (k > len - n) {
+	k = len - n;
+      }
+      i = str->getBlock((char *)buf + j, k);
+      n += i;
+      j = (j + i) & flateMask;
+      if (i < k) {
 	endOfBlock = eof = gTrue;
 	break;
       }
-      buf[j] = c & 0xff;
     }
-    remain = i;
+    remain = n;
     blockLen -= len;
     if (blockLen == 0)
       endOfBlock = gTrue;
@@ -4007,13 +4319,15 @@ void FlateStream::readSome() {
 
 err:
   error(getPos(), "Unexpected end of file in flate stream");
+  codeBuf = cBuf;
+  codeSize = cSize;
+  inPtr = p;
   endOfBlock = eof = gTrue;
-  remain = 0;
+  remain = n;
 }
 
 GBool FlateStream::startBlock() {
   int blockHdr;
-  int c;
   int check;
 
   // free the code tables from the previous block
@@ -4032,25 +4346,18 @@ GBool FlateStream::startBlock() {
     eof = gTrue;
   blockHdr >>= 1;
 
-  // uncompressed block
+  // uncompressed block (skip to a byte boundary -- the bit buffer
+  // may hold some of the block's bytes)
   if (blockHdr == 0) {
     compressedBlock = gFalse;
-    if ((c = str->getChar()) == EOF)
-      goto err;
-    blockLen = c & 0xff;
-    if ((c = str->getChar()) == EOF)
-      goto err;
-    blockLen |= (c & 0xff) << 8;
-    if ((c = str->getChar()) == EOF)
+    codeBuf >>= codeSize & 7;
+    codeSize -= codeSize & 7;
+    if ((blockLen = getCodeWord(16)) == EOF)
       goto err;
-    check = c & 0xff;
-    if ((c = str->getChar()) == EOF)
+    if ((check = getCodeWord(16)) == EOF)
       goto err;
-    check |= (c & 0xff) << 8;
     if (check != (~blockLen & 0xffff))
       error(getPos(), "Bad uncompressed block length in flate stream");
-    codeBuf = 0;
-    codeSize = 0;
 
   // compressed block with fixed codes
   } else if (blockHdr == 1) {
@@ -4079,10 +4386,8 @@ err:
 }
 
 void FlateStream::loadFixedCodes() {
-  litCodeTab.codes = fixedLitCodeTab.codes;
-  litCodeTab.maxLen = fixedLitCodeTab.maxLen;
-  distCodeTab.codes = fixedDistCodeTab.codes;
-  distCodeTab.maxLen = fixedDistCodeTab.maxLen;
+  litCodeTab = fixedLitCodeTab;
+  distCodeTab = fixedDistCodeTab;
 }
 
 GBool FlateStream::readDynamicCodes() {
@@ -4124,7 +4429,8 @@ GBool FlateStream::readDynamicCodes() {
       goto err;
     }
   }
-  compHuffmanCodes(codeLenCodeLengths, flateMaxCodeLenCodes, &codeLenCodeTab);
+  compHuffmanCodes(codeLenCodeLengths, flateMaxCodeLenCodes, 7,
+		   &codeLenCodeTab);
 
   // build the literal and distance code tables
   len = 0;
@@ -4173,8 +4479,9 @@ GBool FlateStream::readDynamicCodes() {
       codeLengths[i++] = len = code;
     }
   }
-  compHuffmanCodes(codeLengths, numLitCodes, &litCodeTab);
-  compHuffmanCodes(codeLengths + numLitCodes, numDistCodes, &distCodeTab);
+  compHuffmanCodes(codeLengths, numLitCodes, flateLitTabBits, &litCodeTab);
+  compHuffmanCodes(codeLengths + numLitCodes, numDistCodes,
+		   flateDistTabBits, &distCodeTab);
 
   gfree(codeLenCodeTab.codes);
   return gTrue;
@@ -4186,50 +4493,90 @@ err:
 }
 
 // Convert an array <lengths> of <n> lengths, in value order, into a
-// Huffman code lookup table.
-void FlateStream::compHuffmanCodes(int *lengths, int n, FlateHuffmanTab *tab) {
-  int tabSize, len, code, code2, skip, val, i, t;
-
-  // find max code length
+// Huffman code lookup table, with a first-level table of up to
+// <tabBits> bits.
+void FlateStream::compHuffmanCodes(int *lengths, int n, int tabBits,
+				   FlateHuffmanTab *tab) {
+  int nextCode[flateMaxHuffman + 2];
+  int revCode[flateMaxLitCodes];
+  int subBits[1 << flateLitTabBits], subOffset[1 << flateLitTabBits];
+  int tabSize, len, code, prefix, val, i, t;
+
+  // find max code length, and the first code of each length
   tab->maxLen = 0;
+  for (len = 0; len <= flateMaxHuffman + 1; ++len) {
+    nextCode[len] = 0;
+  }
   for (val = 0; val < n; ++val) {
     if (lengths[val] > tab->maxLen) {
       tab->maxLen = lengths[val];
     }
+    ++nextCode[lengths[val] + 1];
   }
+  nextCode[1] = 0;
+  for (len = 2, code = 0; len <= tab->maxLen; ++len) {
+    code = (code + nextCode[len]) << 1;
+    nextCode[len] = code;
+  }
+  tab->bits = tab->maxLen < tabBits ? tab->maxLen : tabBits;
 
-  // allocate the table
-  tabSize = 1 << tab->maxLen;
-  tab->codes = (FlateCode *)gmallocn(tabSize, sizeof(FlateCode));
+  // assign the codes, bit-reversed, and find the size of the
+  // second-level table for each prefix
+  for (i = 0; i < (1 << tab->bits); ++i) {
+    subBits[i] = 0;
+  }
+  for (val = 0; val < n; ++val) {
+    if ((len = lengths[val]) == 0) {
+      continue;
+    }
+    code = nextCode[len]++;
+    revCode[val] = 0;
+    for (i = 0; i < len; ++i) {
+      revCode[val] = (revCode[val] << 1) | (code & 1);
+      code >>= 1;
+    }
+    if (len > tab->bits) {
+      prefix = revCode[val] & ((1 << tab->bits) - 1);
+      if (len - tab->bits > subBits[prefix]) {
+	subBits[prefix] = len - tab->bits;
+      }
+    }
+  }
+  tabSize = 1 << tab->bits;
+  for (i = 0; i < (1 << tab->bits); ++i) {
+    if (subBits[i]) {
+      subOffset[i] = tabSize;
+      tabSize += 1 << subBits[i];
+    }
+  }
 
-  // clear the table
+  // allocate and clear the table
+  tab->codes = (FlateCode *)gmallocn(tabSize, sizeof(FlateCode));
   for (i = 0; i < tabSize; ++i) {
     tab->codes[i].len = 0;
     tab->codes[i].val = 0;
   }
 
-  // build the table
-  for (len = 1, code = 0, skip = 2;
-       len <= tab->maxLen;
-       ++len, code <<= 1, skip <<= 1) {
-    for (val = 0; val < n; ++val) {
-      if (lengths[val] == len) {
-
-	// bit-reverse the code
-	code2 = 0;
-	t = code;
-	for (i = 0; i < len; ++i) {
-	  code2 = (code2 << 1) | (t & 1);
-	  t >>= 1;
-	}
-
-	// fill in the table entries
-	for (i = code2; i < tabSize; i += skip) {
-	  tab->codes[i].len = (Gushort)len;
-	  tab->codes[i].val = (Gushort)val;
-	}
-
-	++code;
+  // fill in the table entries
+  for (val = 0; val < n; ++val) {
+    if ((len = lengths[val]) == 0) {
+      continue;
+    }
+    if (len <= tab->bits) {
+      for (i = revCode[val]; i < (1 << tab->bits); i += 1 << len) {
+	tab->codes[i].len = (Gushort)len;
+	tab->codes[i].val = (Gushort)val;
+      }
+    } else {
+      prefix = revCode[val] & ((1 << tab->bits) - 1);
+      t = subOffset[prefix];
+      tab->codes[prefix].len = (Gushort)(flateSubTable | subBits[prefix]);
+      tab->codes[prefix].val = (Gushort)t;
+      for (i = revCode[val] >> tab->bits;
+	   i < (1 << subBits[prefix]);
+	   i += 1 << (len - tab->bits)) {
+	tab->codes[t + i].len = (Gushort)len;
+	tab->codes[t + i].val = (Gushort)val;
       }
     }
   }
@@ -4240,13 +4587,17 @@ int FlateStream::getHuffmanCodeWord(FlateHuffmanTab *tab) {
   int c;
 
   while (codeSize < tab->maxLen) {
-    if ((c = str->getChar()) == EOF) {
+    if ((c = getInChar()) == EOF) {
       break;
     }
     codeBuf |= (c & 0xff) << codeSize;
     codeSize += 8;
   }
-  code = &tab->codes[codeBuf & ((1 << tab->maxLen) - 1)];
+  code = &tab->codes[codeBuf & ((1 << tab->bits) - 1)];
+  if (code->len & flateSubTable) {
+    code = &tab->codes[code->val + ((codeBuf >> tab->bits) &
+				    ((1 << (code->len & 0xff)) - 1))];
+  }
   if (codeSize == 0 || codeSize < code->len || code->len == 0) {
     return EOF;
   }
@@ -4259,7 +4610,7 @@ int FlateStream::getCodeWord(int bits) {
   int c;
 
   while (codeSize < bits) {
-    if ((c = str->getChar()) == EOF)
+    if ((c = getInChar()) == EOF)
       return EOF;
     codeBuf |= (c & 0xff) << codeSize;
     codeSize += 8;
@@ -81,9 +81,29 @@ public:
   // This is only used by StreamPredictor.
   virtual int getRawChar();
 
+  // Get up to <size> chars from the stream into <blk> without using
+  // the predictor.  This is only used by StreamPredictor.
+  virtual int getRawBlock(char *blk, int size);
+
   // Get next line from stream.
   virtual char *getLine(char *buf, int size);
 
+  // Get up to <size> chars from the stream into <blk>.  Returns the
+  // number of chars read, which is less than <size> only at the end
+  // of the stream.
+  virtual int getBlock(char *blk, int size);
+
+  // Can the rows of a <width>-pixel, 1-bit image stored in this
+  // stream be read with getRuns()?  Called after reset().
+  virtual GBool hasRuns(int width) { return gFalse; }
+
+  // Get the next row of a 1-bit image as runs of 1 bits: run i
+  // covers pixels <runs>[2*i] .. <runs>[2*i+1] - 1.  <runs> must have
+  // room for width + 1 ints.  Returns the number of runs, or -1 at
+  // the end of the stream.  Only valid if hasRuns() returned true,
+  // and can't be mixed with getChar() within a row.
+  virtual int getRuns(int *runs) { return -1; }
+
   // Get current position in file.
   virtual int getPos() = 0;
 
@@ -107,6 +127,11 @@ public:
   // Is this an encoding filter?
   virtual GBool isEncoder() { return gFalse; }
 
+  // Is this stream embedded in another one (an inline image)?  If
+  // so, reading past the end of its data takes data that belongs to
+  // the enclosing stream.
+  virtual GBool isEmbedded() { return gFalse; }
+
   // Get image parameters which are defined by the stream contents.
   virtual void getImageParams(int *bitsPerComponent,
 			      StreamColorSpaceMode *csMode) {}
@@ -234,6 +259,7 @@ public:
 
   int lookChar();
   int getChar();
+  int getBlock(char *blk, int size);
 
 private:
 
@@ -248,6 +274,7 @@ private:
   int pixBytes;			// bytes per pixel
   int rowBytes;			// bytes per line
   Guchar *predLine;		// line buffer
+  Guchar *prevLine;		// previous line (swapped with predLine)
   int predIdx;			// current index in predLine
 };
 
@@ -272,6 +299,7 @@ public:
     { return (bufPtr >= bufEnd && !fillBuf()) ? EOF : (*bufPtr++ & 0xff); }
   virtual int lookChar()
     { return (bufPtr >= bufEnd && !fillBuf()) ? EOF : (*bufPtr & 0xff); }
+  virtual int getBlock(char *blk, int size);
   virtual int getPos() { return bufPos + (bufPtr - buf); }
   virtual void setPos(Guint pos, int dir = 0);
   virtual Guint getStart() { return start; }
@@ -311,6 +339,7 @@ public:
     { return (bufPtr < bufEnd) ? (*bufPtr++ & 0xff) : EOF; }
   virtual int lookChar()
     { return (bufPtr < bufEnd) ? (*bufPtr & 0xff) : EOF; }
+  virtual int getBlock(char *blk, int size);
   virtual int getPos() { return (int)(bufPtr - buf); }
   virtual void setPos(Guint pos, int dir = 0);
   virtual Guint getStart() { return start; }
@@ -353,6 +382,7 @@ public:
   virtual void setPos(Guint pos, int dir = 0);
   virtual Guint getStart();
   virtual void moveStart(int delta);
+  virtual GBool isEmbedded() { return gTrue; }
 
 private:
 
@@ -424,6 +454,8 @@ public:
   virtual int getChar();
   virtual int lookChar();
   virtual int getRawChar();
+  virtual int getBlock(char *blk, int size);
+  virtual int getRawBlock(char *blk, int size);
   virtual GString *getPSFilter(int psLevel, char *indent);
   virtual GBool isBinary(GBool last = gTrue);
 
@@ -499,6 +531,8 @@ public:
   virtual int getChar()
     { int c = lookChar(); buf = EOF; return c; }
   virtual int lookChar();
+  virtual GBool hasRuns(int width) { return width == columns; }
+  virtual int getRuns(int *runs);
   virtual GString *getPSFilter(int psLevel, char *indent);
   virtual GBool isBinary(GBool last = gTrue);
 
@@ -523,6 +557,7 @@ private:
   int outputBits;		// remaining ouput bits
   int buf;			// character buffer
 
+  GBool readRow();
   short getTwoDimCode();
   short getWhiteCode();
   short getBlackCode();
@@ -534,6 +569,10 @@ private:
 // DCTStream
 //------------------------------------------------------------------------
 
+// Coefficients of progressive and non-interleaved images are kept in
+// memory up to this size; bigger images spill them to a temp file.
+#define dctCoefMemLimit (8 * 1024 * 1024)
+
 // DCT component info
 struct DCTCompInfo {
   int id;			// component ID
@@ -573,13 +612,28 @@ public:
   virtual GBool isBinary(GBool last = gTrue);
   Stream *getRawStream() { return str; }
 
+  // Decode the image at 1/<reductionA> of its size (1, 2, 4 or 8),
+  // using reduced IDCTs.  Must be called before reset().
+  void setReduction(int reductionA) { reduction = reductionA; }
+
+  // Peak memory used by the decoding buffers (sample rows and
+  // coefficients, including coefficients spilled to temp files) of
+  // the DCTStreams in the calling thread (or in all threads, where
+  // the compiler has no thread-local storage), since the last call to
+  // resetPeakMemory().
+  static int getPeakMemory();
+  static void resetPeakMemory();
+
 private:
 
+  int reduction;		// output size is 1/reduction
+  int outWidth, outHeight;	// output image size
+  int outMcuHeight;		// output rows per MCU row
   GBool progressive;		// set if in progressive mode
   GBool interleaved;		// set if in interleaved mode
   int width, height;		// image size
   int mcuWidth, mcuHeight;	// size of min coding unit, in data units
-  int bufWidth, bufHeight;	// frameBuf size
+  int bufWidth, bufHeight;	// image size, in whole MCUs
   DCTCompInfo compInfo[4];	// info for each component
   DCTScanInfo scanInfo;		// info for the current scan
   int numComps;			// number of components in image
@@ -593,8 +647,19 @@ private:
   DCTHuffTable acHuffTables[4];	// AC Huffman tables
   int numDCHuffTables;		// number of DC Huffman tables
   int numACHuffTables;		// number of AC Huffman tables
-  Guchar *rowBuf[4][32];	// buffer for one MCU (non-progressive mode)
-  int *frameBuf[4];		// buffer for frame (progressive mode)
+  Guchar *rowBuf[4][32];	// buffer for one MCU row
+  short *coefBuf[4];		// coefficients of each data unit
+				//   (progressive or non-interleaved mode)
+  Guchar *nonZeroBuf[4];	// nonzero flags for the coefficients that
+				//   are not kept in coefBuf (progressive,
+				//   reduced mode)
+  int coefBufWidth[4];		// coefBuf width, in data units
+  int coefSize;			// coefficients kept per data unit
+  char *coefMem;		// memory for coefBuf and nonZeroBuf
+  int coefMemSize;		// size of coefMem, in bytes
+  GBool coefMemMapped;		// set if coefMem is a mapped temp file
+  int memSize;			// memory used by rowBuf and coefMem
+  int mcuRow;			// next MCU row to decode from coefBuf
   int comp, x, y, dy;		// current position within image/MCU
   int restartCtr;		// MCUs left until restart
   int restartMarker;		// next restart marker
@@ -603,6 +668,10 @@ private:
   int inputBits;		// number of valid bits in input buffer
 
   void restart();
+  void freeBuffers();
+  GBool allocCoefs();
+  void trackMemory(int delta);
+  GBool fillRowBuf();
   GBool readMCURow();
   void readScan();
   GBool readDataUnit(DCTHuffTable *dcHuffTable,
@@ -611,9 +680,11 @@ private:
   GBool readProgressiveDataUnit(DCTHuffTable *dcHuffTable,
 				DCTHuffTable *acHuffTable,
 				int *prevDC, int data[64]);
-  void decodeImage();
-  void transformDataUnit(Gushort *quantTable,
-			 int dataIn[64], Guchar dataOut[64]);
+  GBool decodeMCURow();
+  void storeDataUnit(int cc, int x1, int y1, Guchar data[64]);
+  void convertMCURow();
+  void transformReducedDataUnit(Gushort *quantTable,
+				int dataIn[64], Guchar dataOut[64]);
   int readHuffSym(DCTHuffTable *table);
   int readAmp(int size);
   int readBit();
@@ -641,16 +712,29 @@ private:
 #define flateMaxCodeLenCodes    19    // max # code length codes
 #define flateMaxLitCodes       288    // max # literal codes
 #define flateMaxDistCodes       30    // max # distance codes
+#define flateLitTabBits          9    // first-level literal table bits
+#define flateDistTabBits         6    // first-level distance table bits
+#define flateChunk            4096    // bytes decoded at a time
+#define flateInBufSize        4096    // input buffer size
 
 // Huffman code table entry
 struct FlateCode {
-  Gushort len;			// code length, in bits
-  Gushort val;			// value represented by this code
+  Gushort len;			// code length, in bits -- or, if
+				//   flateSubTable is set, the number of
+				//   bits indexing a second-level table
+  Gushort val;			// value represented by this code -- or
+				//   the offset of the second-level table
 };
 
+#define flateSubTable 0x8000
+
+// Two-level Huffman code lookup table: codes of up to <bits> bits
+// are looked up with one index; longer ones go through the
+// second-level table for their first <bits> bits.
 struct FlateHuffmanTab {
   FlateCode *codes;
-  int maxLen;
+  int maxLen;			// max code length
+  int bits;			// first-level table index bits
 };
 
 // Decoding info for length and distance code words
@@ -670,6 +754,8 @@ public:
   virtual int getChar();
   virtual int lookChar();
   virtual int getRawChar();
+  virtual int getBlock(char *blk, int size);
+  virtual int getRawBlock(char *blk, int size);
   virtual GString *getPSFilter(int psLevel, char *indent);
   virtual GBool isBinary(GBool last = gTrue);
 
@@ -679,8 +765,12 @@ private:
   Guchar buf[flateWindow];	// output data buffer
   int index;			// current index into output buffer
   int remain;			// number valid bytes in output buffer
-  int codeBuf;			// input buffer
-  int codeSize;			// number of bits in input buffer
+  Guchar inBuf[flateInBufSize];	// compressed data read ahead
+  Guchar *inPtr;		// next byte in inBuf
+  Guchar *inEnd;		// end of valid data in inBuf
+  int inBufLen;			// bytes to read into inBuf at a time
+  Gulong codeBuf;		// bit buffer
+  int codeSize;			// number of bits in bit buffer
   int				// literal and distance code lengths
     codeLengths[flateMaxLitCodes + flateMaxDistCodes];
   FlateHuffmanTab litCodeTab;	// literal code table
@@ -701,11 +791,16 @@ private:
   static FlateHuffmanTab	// fixed distance code table
     fixedDistCodeTab;
 
+  int getInChar()
+    { return (inPtr >= inEnd && !fillInBuf()) ? EOF : *inPtr++; }
+  GBool fillInBuf();
+  void fillCodeBuf(Gulong *cBuf, int *cSize, Guchar **p, Guchar **pEnd);
   void readSome();
   GBool startBlock();
   void loadFixedCodes();
   GBool readDynamicCodes();
-  void compHuffmanCodes(int *lengths, int n, FlateHuffmanTab *tab);
+  void compHuffmanCodes(int *lengths, int n, int tabBits,
+			FlateHuffmanTab *tab);
   int getHuffmanCodeWord(FlateHuffmanTab *tab);
   int getCodeWord(int bits);
 };
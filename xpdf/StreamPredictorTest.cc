@@ -0,0 +1,380 @@
+//========================================================================
+//
+// StreamPredictorTest.cc
+//
+// Checks that StreamPredictor, which undoes the predictors a row at a
+// time with the PredictorKernels, gives exactly the same data as the
+// byte-at-a-time StreamPredictor it replaced (copied below), for TIFF
+// predictor 2 and PNG predictors 10-15, 1-16 bits per component, 1-8
+// components, and random rows, including a truncated last row.  The
+// new one is read with a random mix of getChar(), lookChar(), and
+// getBlock().  Run by 'make check'; exits with status 1 on the first
+// mismatch.
+//
+//========================================================================
+
+#include <aconf.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gtypes.h"
+#include "gmem.h"
+#include "GfxState.h"
+#include "Stream.h"
+#include "PredictorKernels.h"
+
+// largest encoded stream tested, in bytes
+#define testMaxData 40000
+
+static unsigned long testRandState = 1;
+
+static int testRand() {
+  testRandState = testRandState * 1103515245 + 12345;
+  return (int)((testRandState >> 16) & 0x7fff);
+}
+
+//------------------------------------------------------------------------
+// TestStream: the encoded data, read with getRawChar()/getRawBlock()
+//------------------------------------------------------------------------
+
+class TestStream: public Stream {
+public:
+
+  TestStream(Guchar *dataA, int lengthA)
+    { data = dataA; length = lengthA; pos = 0; }
+  virtual StreamKind getKind() { return strWeird; }
+  virtual void reset() { pos = 0; }
+  virtual int getChar() { return pos < length ? data[pos++] : EOF; }
+  virtual int lookChar() { return pos < length ? data[pos] : EOF; }
+  virtual int getRawChar() { return getChar(); }
+  virtual int getRawBlock(char *blk, int size);
+  virtual int getPos() { return pos; }
+  virtual void setPos(Guint posA, int dir = 0) { pos = (int)posA; }
+  virtual GBool isBinary(GBool last = gTrue) { return gTrue; }
+  virtual BaseStream *getBaseStream() { return NULL; }
+  virtual Dict *getDict() { return NULL; }
+
+private:
+
+  Guchar *data;
+  int length;
+  int pos;
+};
+
+int TestStream::getRawBlock(char *blk, int size) {
+  if (size > length - pos) {
+    size = length - pos;
+  }
+  memcpy(blk, data + pos, size);
+  pos += size;
+  return size;
+}
+
+//------------------------------------------------------------------------
+// OldStreamPredictor: StreamPredictor as it was before the row kernels
+//------------------------------------------------------------------------
+
+class OldStreamPredictor {
+public:
+
+  OldStreamPredictor(Stream *strA, int predictorA,
+		     int widthA, int nCompsA, int nBitsA);
+  ~OldStreamPredictor();
+  int getChar();
+
+private:
+
+  GBool getNextLine();
+
+  Stream *str;			// base stream
+  int predictor;		// predictor
+  int width;			// pixels per line
+  int nComps;			// components per pixel
+  int nBits;			// bits per component
+  int nVals;			// components per line
+  int pixBytes;			// bytes per pixel
+  int rowBytes;			// bytes per line
+  Guchar *predLine;		// line buffer
+  int predIdx;			// current index in predLine
+};
+
+OldStreamPredictor::OldStreamPredictor(Stream *strA, int predictorA,
+				       int widthA, int nCompsA, int nBitsA) {
+  str = strA;
+  predictor = predictorA;
+  width = widthA;
+  nComps = nCompsA;
+  nBits = nBitsA;
+
+  nVals = width * nComps;
+  pixBytes = (nComps * nBits + 7) >> 3;
+  rowBytes = ((nVals * nBits + 7) >> 3) + pixBytes;
+  predLine = (Guchar *)gmalloc(rowBytes);
+  memset(predLine, 0, rowBytes);
+  predIdx = rowBytes;
+}
+
+OldStreamPredictor::~OldStreamPredictor() {
+  gfree(predLine);
+}
+
+int OldStreamPredictor::getChar() {
+  if (predIdx >= rowBytes) {
+    if (!getNextLine()) {
+      return EOF;
+    }
+  }
+  return predLine[predIdx++];
+}
+
+GBool OldStreamPredictor::getNextLine() {
+  int curPred;
+  Guchar upLeftBuf[gfxColorMaxComps * 2 + 1];
+  int left, up, upLeft, p, pa, pb, pc;
+  int c;
+  Gulong inBuf, outBuf, bitMask;
+  int inBits, outBits;
+  int i, j, k, kk;
+
+  // get PNG optimum predictor number
+  if (predictor >= 10) {
+    if ((curPred = str->getRawChar()) == EOF) {
+      return gFalse;
+    }
+    curPred += 10;
+  } else {
+    curPred = predictor;
+  }
+
+  // read the raw line, apply PNG (byte) predictor
+  memset(upLeftBuf, 0, pixBytes + 1);
+  for (i = pixBytes; i < rowBytes; ++i) {
+    for (j = pixBytes; j > 0; --j) {
+      upLeftBuf[j] = upLeftBuf[j-1];
+    }
+    upLeftBuf[0] = predLine[i];
+    if ((c = str->getRawChar()) == EOF) {
+      if (i > pixBytes) {
+	// this ought to return false, but some (broken) PDF files
+	// contain truncated image data, and Adobe apparently reads the
+	// last partial line
+	break;
+      }
+      return gFalse;
+    }
+    switch (curPred) {
+    case 11:			// PNG sub
+      predLine[i] = predLine[i - pixBytes] + (Guchar)c;
+      break;
+    case 12:			// PNG up
+      predLine[i] = predLine[i] + (Guchar)c;
+      break;
+    case 13:			// PNG average
+      predLine[i] = ((predLine[i - pixBytes] + predLine[i]) >> 1) +
+	            (Guchar)c;
+      break;
+    case 14:			// PNG Paeth
+      left = predLine[i - pixBytes];
+      up = predLine[i];
+      upLeft = upLeftBuf[pixBytes];
+      p = left + up - upLeft;
+      if ((pa = p - left) < 0)
+	pa = -pa;
+      if ((pb = p - up) < 0)
+	pb = -pb;
+      if ((pc = p - upLeft) < 0)
+	pc = -pc;
+      if (pa <= pb && pa <= pc)
+	predLine[i] = left + (Guchar)c;
+      else if (pb <= pc)
+	predLine[i] = up + (Guchar)c;
+      else
+	predLine[i] = upLeft + (Guchar)c;
+      break;
+    case 10:			// PNG none
+    default:			// no predictor or TIFF predictor
+      predLine[i] = (Guchar)c;
+      break;
+    }
+  }
+
+  // apply TIFF (component) predictor
+  if (predictor == 2) {
+    if (nBits == 1) {
+      inBuf = predLine[pixBytes - 1];
+      for (i = pixBytes; i < rowBytes; i += 8) {
+	// 1-bit add is just xor
+	inBuf = (inBuf << 8) | predLine[i];
+	predLine[i] ^= inBuf >> nComps;
+      }
+    } else if (nBits == 8) {
+      for (i = pixBytes; i < rowBytes; ++i) {
+	predLine[i] += predLine[i - nComps];
+      }
+    } else {
+      memset(upLeftBuf, 0, nComps + 1);
+      bitMask = (1 << nBits) - 1;
+      inBuf = outBuf = 0;
+      inBits = outBits = 0;
+      j = k = pixBytes;
+      for (i = 0; i < width; ++i) {
+	for (kk = 0; kk < nComps; ++kk) {
+	  if (inBits < nBits) {
+	    inBuf = (inBuf << 8) | (predLine[j++] & 0xff);
+	    inBits += 8;
+	  }
+	  upLeftBuf[kk] = (upLeftBuf[kk] +
+			   (inBuf >> (inBits - nBits))) & bitMask;
+	  inBits -= nBits;
+	  outBuf = (outBuf << nBits) | upLeftBuf[kk];
+	  outBits += nBits;
+	  if (outBits >= 8) {
+	    predLine[k++] = (Guchar)(outBuf >> (outBits - 8));
+	    outBits -= 8;
+	  }
+	}
+      }
+      if (outBits > 0) {
+	predLine[k++] = (Guchar)((outBuf << (8 - outBits)) +
+				 (inBuf & ((1 << (8 - outBits)) - 1)));
+      }
+    }
+  }
+
+  // reset to start of line
+  predIdx = pixBytes;
+
+  return gTrue;
+}
+
+//------------------------------------------------------------------------
+
+static const int testPredictors[7] = { 2, 10, 11, 12, 13, 14, 15 };
+static const int testBits[5] = { 1, 2, 4, 8, 16 };
+
+// Read all of <pred>, with a random mix of calls, into <out>.  Returns
+// the number of bytes read.
+static int readNew(StreamPredictor *pred, Guchar *out, int rowBytes) {
+  char blk[1024];
+  int n, size, c, m;
+
+  n = 0;
+  while (1) {
+    switch (testRand() % 4) {
+    case 0:
+      if ((c = pred->getChar()) == EOF) {
+	return n;
+      }
+      out[n++] = (Guchar)c;
+      break;
+    case 1:
+      c = pred->lookChar();
+      if (c != pred->getChar()) {
+	printf("FAIL lookChar() and getChar() differ at byte %d\n", n);
+	exit(1);
+      }
+      if (c == EOF) {
+	return n;
+      }
+      out[n++] = (Guchar)c;
+      break;
+    default:
+      size = 1 + testRand() % (testRand() & 1 ? 2 * rowBytes + 8 : 1024);
+      if (size > 1024) {
+	size = 1024;
+      }
+      m = pred->getBlock(blk, size);
+      memcpy(out + n, blk, m);
+      n += m;
+      if (m < size) {
+	return n;
+      }
+      break;
+    }
+  }
+}
+
+// Encode one random stream (random bytes, with random PNG tags at the
+// start of each row) and decode it with both predictors.  Returns
+// false on a mismatch.
+static GBool testCase(int predictor, int nBits, int nComps) {
+  static Guchar data[testMaxData];
+  static Guchar out0[testMaxData * 2], out1[testMaxData * 2];
+  TestStream *str0, *str1;
+  OldStreamPredictor *pred0;
+  StreamPredictor *pred1;
+  int width, rowBytes, nRows, length, tag, n0, n1, i, j;
+
+  width = 1 + (testRand() % 4 ? testRand() % 40 : testRand() % 400);
+  rowBytes = (width * nComps * nBits + 7) >> 3;
+  tag = predictor >= 10 ? 1 : 0;
+  nRows = testRand() % 12;
+  length = nRows * (rowBytes + tag);
+  if (length > testMaxData) {
+    nRows = testMaxData / (rowBytes + tag);
+    length = nRows * (rowBytes + tag);
+  }
+  for (i = 0; i < length; ++i) {
+    data[i] = (Guchar)testRand();
+  }
+  if (tag) {
+    for (i = 0; i < length; i += rowBytes + 1) {
+      data[i] = (Guchar)(testRand() % 8 ? testRand() % 5 : testRand());
+    }
+  }
+  // cut the last row short
+  if (length > 0 && testRand() % 3 == 0) {
+    length -= 1 + testRand() % (rowBytes + tag);
+  }
+
+  str0 = new TestStream(data, length);
+  pred0 = new OldStreamPredictor(str0, predictor, width, nComps, nBits);
+  n0 = 0;
+  while ((j = pred0->getChar()) != EOF) {
+    out0[n0++] = (Guchar)j;
+  }
+  str1 = new TestStream(data, length);
+  pred1 = new StreamPredictor(str1, predictor, width, nComps, nBits);
+  n1 = readNew(pred1, out1, rowBytes);
+  delete pred0;
+  delete pred1;
+  delete str0;
+  delete str1;
+
+  if (n0 != n1 || memcmp(out0, out1, n0)) {
+    for (i = 0; i < n0 && i < n1 && out0[i] == out1[i]; ++i) ;
+    printf("FAIL predictor=%d bpc=%d colors=%d width=%d length=%d: "
+	   "%d bytes, not %d; first difference at byte %d\n",
+	   predictor, nBits, nComps, width, length, n1, n0, i);
+    return gFalse;
+  }
+  return gTrue;
+}
+
+int main() {
+  static PredKernelsImpl impls[4] = {
+    predKernelsC, predKernelsWord, predKernelsSSE2, predKernelsNEON
+  };
+  static const char *implNames[4] = { "C", "word", "SSE2", "NEON" };
+  int i, p, b, nComps, rep;
+
+  for (i = 0; i < 4; ++i) {
+    if (!predSetKernelsImpl(impls[i])) {
+      printf("%-5s not available\n", implNames[i]);
+      continue;
+    }
+    for (p = 0; p < 7; ++p) {
+      for (b = 0; b < 5; ++b) {
+	for (nComps = 1; nComps <= 8; ++nComps) {
+	  for (rep = 0; rep < 100; ++rep) {
+	    if (!testCase(testPredictors[p], testBits[b], nComps)) {
+	      return 1;
+	    }
+	  }
+	}
+      }
+    }
+    printf("%-5s ok\n", implNames[i]);
+  }
+  return 0;
+}
@@ -24,6 +24,7 @@
 #include "Dict.h"
 #include "Error.h"
 #include "ErrorCodes.h"
+#include "JBIG2Stream.h"
 #include "XRef.h"
 
 //------------------------------------------------------------------------
@@ -201,6 +202,7 @@ XRef::XRef(BaseStream *strA) {
   streamEnds = NULL;
   streamEndsLen = 0;
   objStr = NULL;
+  jbig2Globals = new JBIG2GlobalsCache();
 
   encrypted = gFalse;
   permFlags = defPermFlags;
@@ -261,6 +263,7 @@ XRef::~XRef() {
   if (objStr) {
     delete objStr;
   }
+  delete jbig2Globals;
 }
 
 // Read the 'startxref' position.
@@ -22,6 +22,7 @@ class Dict;
 class Stream;
 class Parser;
 class ObjectStream;
+class JBIG2GlobalsCache;
 
 //------------------------------------------------------------------------
 // XRef
@@ -96,6 +97,11 @@ public:
   XRefEntry *getEntry(int i) { return &entries[i]; }
   Object *getTrailerDict() { return &trailerDict; }
 
+  // Decoded JBIG2Globals streams for this file.  The cache is
+  // created with the XRef, so that threads sharing the XRef never
+  // race to create it.
+  JBIG2GlobalsCache *getJBIG2GlobalsCache() { return jbig2Globals; }
+
 private:
 
   BaseStream *str;		// input stream
@@ -112,6 +118,7 @@ private:
 				//   damaged files
   int streamEndsLen;		// number of valid entries in streamEnds
   ObjectStream *objStr;		// cached object stream
+  JBIG2GlobalsCache *jbig2Globals; // decoded JBIG2Globals
   GBool encrypted;		// true if file is encrypted
   int permFlags;		// permission bits
   GBool ownerPasswordOk;	// true if owner password is correct